@@ -8,6 +8,7 @@
 #include "freertos/semphr.h"
 // Inclusión para acceso a almacenamiento persistente
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 // Inclusiones de los módulos de estados específicos
 #include "estado_automatico.h"
 #include "estado_manual.h"
@@ -19,6 +20,7 @@
 #include "wifi_sta.h"
 #include "mqtt_service.h"
 #include "time_manager.h"
+#include "boot_trace.h"
 
 // === NUEVOS INCLUDES PARA DIAGNÓSTICO DE MEMORIA ===
 #include "esp_heap_caps.h"
@@ -125,9 +127,6 @@ static void diagnostico_memoria_completo(void)
     ESP_LOGD(TAG, "[MEMORY] === FIN DIAGNÓSTICO ===");
 }
 
-// Clave usada para guardar el estado actual en NVS
-#define NVS_KEY_ESTADO "app_estado"
-
 // --- Constantes para mejorar legibilidad de logs ---
 #define LOG_PREFIX_BOOT "[BOOT]"   // Para logs de inicialización
 #define LOG_PREFIX_TRANS "[TRANS]" // Para logs de transición
@@ -223,12 +222,14 @@ static esp_err_t iniciar_estado(estado_app_t estado)
 
 /**
  * Cambia el estado actual del sistema, deteniendo el anterior e iniciando el nuevo.
- * Gestiona WiFi y MQTT según el estado. Guarda el nuevo estado en NVS.
+ * Guarda el nuevo estado en NVS.
  *
  * @param nuevo_estado El estado al que cambiar
+ * @param conectar true para levantar WiFi, NTP y MQTT si el estado los necesita;
+ *                 false en el arranque, donde lo hace el grafo de arranque en paralelo
  * @return ESP_OK si el cambio fue exitoso, o error en caso contrario
  */
-esp_err_t app_control_cambiar_estado(estado_app_t nuevo_estado)
+static esp_err_t cambiar_estado(estado_app_t nuevo_estado, bool conectar)
 {
     esp_err_t resultado = ESP_OK;
 
@@ -264,7 +265,7 @@ esp_err_t app_control_cambiar_estado(estado_app_t nuevo_estado)
         // Siempre detener estos servicios al entrar en configuración
         mqtt_service_stop();
         sta_wifi_disconnect();
-    } else if (nuevo_estado == ESTADO_MANUAL || nuevo_estado == ESTADO_AUTOMATICO) {
+    } else if (conectar && (nuevo_estado == ESTADO_MANUAL || nuevo_estado == ESTADO_AUTOMATICO)) {
         // Inicializar servicios en cualquiera de estos casos:
         // 1. Si venimos de CONFIGURACION (cambio directo)
         // 2. Si es primera inicialización (estado_actual == INVALIDO)
@@ -306,6 +307,18 @@ esp_err_t app_control_cambiar_estado(estado_app_t nuevo_estado)
     return resultado;
 }
 
+/**
+ * Cambia el estado actual del sistema, deteniendo el anterior e iniciando el nuevo.
+ * Gestiona WiFi y MQTT según el estado. Guarda el nuevo estado en NVS.
+ *
+ * @param nuevo_estado El estado al que cambiar
+ * @return ESP_OK si el cambio fue exitoso, o error en caso contrario
+ */
+esp_err_t app_control_cambiar_estado(estado_app_t nuevo_estado)
+{
+    return cambiar_estado(nuevo_estado, true);
+}
+
 /**
  * Obtiene el estado actual del sistema.
  *
@@ -335,7 +348,7 @@ estado_app_t app_control_get_estado(void)
  */
 esp_err_t app_control_guardar_estado(void)
 {
-    esp_err_t err = nvs_manager_set_u8(NVS_KEY_ESTADO, (uint8_t)estado_actual);
+    esp_err_t err = ecokey_config_set_app_estado((uint8_t)estado_actual);
 
     if (err != ESP_OK)
     {
@@ -350,18 +363,21 @@ esp_err_t app_control_guardar_estado(void)
  * Inicializa el sistema de estados, recuperando el último estado guardado o
  * estableciendo el estado inicial si es la primera ejecución.
  *
+ * No levanta WiFi, NTP ni MQTT: en el arranque lo hacen etapas propias en
+ * paralelo, y así el modo (y el escaneo BLE) no espera a la red.
+ *
  * @return ESP_OK si se inició correctamente, o error en caso contrario
  */
 esp_err_t app_control_iniciar_estado(void)
 {
     esp_err_t ret = ESP_OK;
-    uint8_t estado_nvs = nvs_manager_get_u8(NVS_KEY_ESTADO, ESTADO_INVALIDO);
+    uint8_t estado_nvs = ecokey_config()->app_estado;
     estado_app_t estado = (estado_app_t)estado_nvs;
 
     // Verificar si existen credenciales WiFi
     if (!nvs_manager_has_wifi_credentials())
     {
-        ret = app_control_cambiar_estado(ESTADO_CONFIGURACION);
+        ret = cambiar_estado(ESTADO_CONFIGURACION, false);
     }
     else
     {
@@ -370,9 +386,12 @@ esp_err_t app_control_iniciar_estado(void)
         {
             estado = ESTADO_AUTOMATICO; // Cambiar a un estado por defecto si es CONFIGURACION
         }
-        ret = app_control_cambiar_estado(estado);
+        ret = cambiar_estado(estado, false);
     }
 
+    if (ret == ESP_OK) {
+        boot_trace_marcar(BOOT_TRACE_MODO);
+    }
     return ret;
 }
 
@@ -51,6 +51,8 @@ esp_err_t app_control_guardar_estado(void);
  * - Si hay un estado previamente guardado en NVS
  * - Si no hay estado guardado, usa lógica predeterminada
  * 
+ * No inicia la conectividad: la arranca inicializar_componentes() en paralelo.
+ * 
  * @return ESP_OK si se inició correctamente un estado
  */
 esp_err_t app_control_iniciar_estado(void);
@@ -1,4 +1,5 @@
 #include "app_inicializacion.h"
+#include <inttypes.h>
 #include "esp_log.h"
 #include "esp_system.h"
 #include "nvs_manager.h"
@@ -10,76 +11,153 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_tls.h"
+#include "wifi_sta.h"
+#include "time_manager.h"
+#include "mqtt_service.h"
+#include "arranque.h"
+#include "boot_trace.h"
 
 static const char *TAG = "APP_INIT";
 
 extern const uint8_t ca_pem_start[] asm("_binary_ca_pem_start");
 extern const uint8_t ca_pem_end[]   asm("_binary_ca_pem_end");
 
-void inicializar_certificados_globales(void);
+static esp_err_t inicializar_certificados_globales(void);
 
-esp_err_t inicializar_componentes(void)
+// Etapas del arranque; las dependencias se expresan con estos índices
+enum {
+    ETAPA_NVS,
+    ETAPA_LED,
+    ETAPA_RELE,
+    ETAPA_BOTON,
+    ETAPA_CERTIFICADOS,
+    ETAPA_WIFI,
+    ETAPA_CONEXION,
+    ETAPA_NTP,
+    ETAPA_MQTT,
+    ETAPA_MODO,
+    NUM_ETAPAS
+};
+
+static esp_err_t etapa_nvs(void)
 {
-    esp_err_t ret;
+    esp_err_t ret = nvs_manager_init(NULL); // Usar namespace por defecto
+    if (ret == ESP_OK) {
+        boot_trace_marcar(BOOT_TRACE_NVS);
+    }
+    return ret;
+}
 
-    // 1. Inicializar NVS (paso crítico)
-    ret = nvs_manager_init(NULL); // Usar namespace por defecto
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error crítico al inicializar NVS Manager");
-        return ret;
+static esp_err_t etapa_led(void)
+{
+    esp_err_t ret = led_init();
+    if (ret == ESP_OK) {
+        led_blink_start(100);
+    }
+    return ret;
+}
+
+static esp_err_t etapa_rele(void)
+{
+    esp_err_t ret = relay_controller_init();
+    if (ret == ESP_OK) {
+        boot_trace_marcar(BOOT_TRACE_RELE);
     }
+    return ret;
+}
 
-    // Pausa más larga para asegurar que NVS esté listo
-    vTaskDelay(pdMS_TO_TICKS(500));
+static esp_err_t etapa_boton(void)
+{
+    return control_button_iniciar();
+}
 
-    // 2. Inicializar LED
-    ESP_LOGI(TAG, "Inicializando LED...");
-    ret = led_init();
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error al inicializar LED: %s", esp_err_to_name(ret));
-        return ret;
+// Sin credenciales el dispositivo arranca en configuración y la red no aplica
+static esp_err_t etapa_wifi(void)
+{
+    if (!nvs_manager_has_wifi_credentials()) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_err_t ret = sta_wifi_init();
+    if (ret == ESP_OK) {
+        boot_trace_marcar(BOOT_TRACE_WIFI_INICIADO);
     }
-    led_blink_start(100);
+    return ret;
+}
 
-    // 3. Inicializar Relay Controller
-    ESP_LOGI(TAG, "Inicializando Relay Controller...");
-    ret = relay_controller_init();
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error al inicializar Relay Controller: %s", esp_err_to_name(ret));
-        return ret;
+static esp_err_t etapa_conexion(void)
+{
+    // Un fallo aquí no es definitivo: la reconexión sigue en segundo plano
+    esp_err_t ret = sta_wifi_connect_with_nvs(7000);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "WiFi sin conexión al arrancar: %s", esp_err_to_name(ret));
     }
+    return ESP_OK;
+}
 
-    // Pausa corta
-    vTaskDelay(pdMS_TO_TICKS(100));
+static esp_err_t etapa_ntp(void)
+{
+    // Sin hora se sigue funcionando; se sincroniza al recuperar la IP
+    time_manager_init("pool.ntp.org");
+    return ESP_OK;
+}
 
-    // 6. Inicializar el control boton (solo inicialización interna)
-    ESP_LOGI(TAG, "Inicializando control por boton...");
-    ret = control_button_iniciar();
+static esp_err_t etapa_mqtt(void)
+{
+    // No espera a la conexión: el primer intento sin IP falla y mqtt_reconexion
+    // repite en cuanto llega la IP, sin backoff
+    mqtt_service_start();
+    return ESP_OK;
+}
+
+static esp_err_t etapa_modo(void)
+{
+    return app_control_iniciar_estado();
+}
+
+/*
+ * Grafo de arranque. El modo (y con él el escaneo BLE del modo automático)
+ * solo necesita NVS, LED y relé; espera además a que MQTT tenga el outbox
+ * listo para guardar lo que publique, pero no a que haya red. La conexión
+ * WiFi y NTP, que pueden tardar varios segundos, corren en paralelo.
+ */
+static const arranque_etapa_t s_etapas[NUM_ETAPAS] = {
+    [ETAPA_NVS]          = {"NVS", etapa_nvs, 0, 0, true},
+    [ETAPA_LED]          = {"LED", etapa_led, 0, 0, true},
+    [ETAPA_RELE]         = {"RELE", etapa_rele, 0, 0, true},
+    [ETAPA_BOTON]        = {"BOTON", etapa_boton, ARRANQUE_DEP(ETAPA_NVS), 0, true},
+    [ETAPA_CERTIFICADOS] = {"CERTIFICADOS", inicializar_certificados_globales, 0, 0, false},
+    [ETAPA_WIFI]         = {"WIFI", etapa_wifi, ARRANQUE_DEP(ETAPA_NVS), 0, false},
+    [ETAPA_CONEXION]     = {"CONEXION", etapa_conexion, ARRANQUE_DEP(ETAPA_WIFI), 0, false},
+    [ETAPA_NTP]          = {"NTP", etapa_ntp, ARRANQUE_DEP(ETAPA_CONEXION), 0, false},
+    [ETAPA_MQTT]         = {"MQTT", etapa_mqtt, ARRANQUE_DEP(ETAPA_WIFI),
+                            ARRANQUE_DEP(ETAPA_CERTIFICADOS), false},
+    [ETAPA_MODO]         = {"MODO", etapa_modo,
+                            ARRANQUE_DEP(ETAPA_NVS) | ARRANQUE_DEP(ETAPA_LED) | ARRANQUE_DEP(ETAPA_RELE),
+                            ARRANQUE_DEP(ETAPA_MQTT), true},
+};
+
+esp_err_t inicializar_componentes(void)
+{
+    esp_err_t ret = arranque_ejecutar(s_etapas, NUM_ETAPAS);
+    boot_trace_marcar(BOOT_TRACE_ARRANQUE_COMPLETO);
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error al inicializar el controlador de boton: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Error crítico durante el arranque: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Pausa corta
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    inicializar_certificados_globales();
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    ESP_LOGI(TAG, "Todos los componentes inicializados correctamente");
+    const arranque_registro_t *modo = arranque_obtener_registro(ETAPA_MODO);
+    ESP_LOGI(TAG, "Todos los componentes inicializados; dispositivo operativo a los %" PRId64 " ms",
+             modo->fin_us / 1000);
     return ESP_OK;
 }
 
-void inicializar_certificados_globales(void)
+static esp_err_t inicializar_certificados_globales(void)
 {
     esp_err_t err = esp_tls_init_global_ca_store();
     if (err != ESP_OK) {
         ESP_LOGE("OTA", "Error al inicializar CA store: %s", esp_err_to_name(err));
-        return;
+        return err;
     }
 
     size_t cert_len = ca_pem_end - ca_pem_start;
@@ -89,4 +167,5 @@ void inicializar_certificados_globales(void)
     } else {
         ESP_LOGI("OTA", "CA global cargado correctamente (%d bytes)", (int)cert_len);
     }
-}
\ No newline at end of file
+    return err;
+}
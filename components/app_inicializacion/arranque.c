@@ -0,0 +1,271 @@
+#include "arranque.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ARRANQUE";
+
+#define EVENTO_CAMBIO           (1u << 0)   // Una etapa terminó: puede haber otras listas
+#define EVENTO_TRABAJADOR(n)    (1u << (1 + (n)))
+
+static const arranque_etapa_t *s_etapas = NULL;
+static size_t s_num = 0;
+static arranque_registro_t s_registro[ARRANQUE_MAX_ETAPAS];
+static uint32_t s_terminadas = 0;           // Etapas en OK, FALLIDA u OMITIDA
+static uint32_t s_correctas = 0;            // Etapas en OK
+static esp_err_t s_error = ESP_OK;          // Error de la primera etapa crítica fallida
+static SemaphoreHandle_t s_mutex = NULL;
+static EventGroupHandle_t s_eventos = NULL;
+
+static const char *nombre_estado(arranque_estado_t estado)
+{
+    switch (estado) {
+    case ARRANQUE_OK:       return "OK";
+    case ARRANQUE_FALLIDA:  return "FALLIDA";
+    case ARRANQUE_OMITIDA:  return "omitida";
+    default:                return "sin terminar";
+    }
+}
+
+/**
+ * Comprueba que las dependencias apuntan a etapas de la tabla y que no hay
+ * ciclos (un ciclo dejaría a los trabajadores esperando para siempre).
+ */
+static bool grafo_valido(const arranque_etapa_t *etapas, size_t num)
+{
+    uint32_t todas = (1u << num) - 1;
+    uint32_t ordenadas = 0;
+
+    for (size_t i = 0; i < num; i++) {
+        uint32_t deps = etapas[i].requiere | etapas[i].despues_de;
+        if (etapas[i].fn == NULL || (deps & ~todas) != 0 || (deps & ARRANQUE_DEP(i)) != 0) {
+            ESP_LOGE(TAG, "Etapa '%s' mal definida", etapas[i].nombre);
+            return false;
+        }
+    }
+
+    // Orden topológico: en cada pasada entran las etapas con todas sus dependencias ya ordenadas
+    bool avance = true;
+    while (ordenadas != todas && avance) {
+        avance = false;
+        for (size_t i = 0; i < num; i++) {
+            uint32_t deps = etapas[i].requiere | etapas[i].despues_de;
+            if ((ordenadas & ARRANQUE_DEP(i)) == 0 && (deps & ~ordenadas) == 0) {
+                ordenadas |= ARRANQUE_DEP(i);
+                avance = true;
+            }
+        }
+    }
+    if (ordenadas != todas) {
+        ESP_LOGE(TAG, "El grafo de arranque tiene un ciclo");
+        return false;
+    }
+    return true;
+}
+
+static void terminar_etapa(size_t i, arranque_estado_t estado, esp_err_t error)
+{
+    s_registro[i].estado = estado;
+    s_registro[i].error = error;
+    s_registro[i].fin_us = esp_timer_get_time();
+    s_terminadas |= ARRANQUE_DEP(i);
+    if (estado == ARRANQUE_OK) {
+        s_correctas |= ARRANQUE_DEP(i);
+    }
+}
+
+/**
+ * Busca una etapa lista y la marca en curso. Por el camino omite las que ya
+ * no pueden ejecutarse. Se llama con s_mutex tomado.
+ *
+ * @param fin Se pone a true si no queda ninguna etapa pendiente
+ * @return Índice de la etapa a ejecutar, o -1 si no hay ninguna lista
+ */
+static int tomar_etapa_lista(bool *fin)
+{
+    bool cambio = true;
+    while (cambio) {
+        cambio = false;
+        for (size_t i = 0; i < s_num; i++) {
+            if (s_registro[i].estado != ARRANQUE_PENDIENTE) {
+                continue;
+            }
+            const arranque_etapa_t *etapa = &s_etapas[i];
+            uint32_t deps = etapa->requiere | etapa->despues_de;
+            if ((deps & ~s_terminadas) != 0) {
+                continue;
+            }
+            if (s_error != ESP_OK || (etapa->requiere & ~s_correctas) != 0) {
+                s_registro[i].inicio_us = esp_timer_get_time();
+                terminar_etapa(i, ARRANQUE_OMITIDA, ESP_OK);
+                cambio = true;  // Sus dependientes pueden pasar a omitidas también
+                continue;
+            }
+            s_registro[i].estado = ARRANQUE_EN_CURSO;
+            s_registro[i].inicio_us = esp_timer_get_time();
+            *fin = false;
+            return (int)i;
+        }
+    }
+
+    *fin = true;
+    for (size_t i = 0; i < s_num; i++) {
+        if (s_registro[i].estado == ARRANQUE_PENDIENTE) {
+            *fin = false;
+            break;
+        }
+    }
+    return -1;
+}
+
+static void ejecutar_etapa(size_t i)
+{
+    const arranque_etapa_t *etapa = &s_etapas[i];
+
+    ESP_LOGI(TAG, "Iniciando %s", etapa->nombre);
+    esp_err_t err = etapa->fn();
+
+    arranque_estado_t estado = ARRANQUE_OK;
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        estado = ARRANQUE_OMITIDA;
+    } else if (err != ESP_OK) {
+        estado = ARRANQUE_FALLIDA;
+        ESP_LOGE(TAG, "Etapa %s fallida: %s", etapa->nombre, esp_err_to_name(err));
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    terminar_etapa(i, estado, err);
+    if (estado == ARRANQUE_FALLIDA && etapa->critica && s_error == ESP_OK) {
+        s_error = err;
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+static void trabajador_arranque(void *arg)
+{
+    uint32_t bit_fin = EVENTO_TRABAJADOR((uint32_t)(uintptr_t)arg);
+
+    for (;;) {
+        bool fin = false;
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        int i = tomar_etapa_lista(&fin);
+        xSemaphoreGive(s_mutex);
+
+        if (fin) {
+            break;
+        }
+        if (i < 0) {
+            // Todo lo pendiente depende de etapas en curso en otros trabajadores
+            xEventGroupWaitBits(s_eventos, EVENTO_CAMBIO, pdTRUE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+        ejecutar_etapa((size_t)i);
+        xEventGroupSetBits(s_eventos, EVENTO_CAMBIO);
+    }
+
+    // CAMBIO despierta a los trabajadores que sigan esperando para que vean el final
+    xEventGroupSetBits(s_eventos, EVENTO_CAMBIO | bit_fin);
+    vTaskDelete(NULL);
+}
+
+static void registrar_linea_de_tiempo(int64_t inicio_us)
+{
+    int64_t fin_us = inicio_us;
+    int64_t serie_us = 0;
+
+    ESP_LOGI(TAG, "Línea de tiempo del arranque (ms desde el inicio del sistema):");
+    for (size_t i = 0; i < s_num; i++) {
+        const arranque_registro_t *r = &s_registro[i];
+        if (r->estado == ARRANQUE_OMITIDA && r->error == ESP_OK) {
+            ESP_LOGI(TAG, "  %-12s %26s", s_etapas[i].nombre, "omitida");
+            continue;
+        }
+        int64_t duracion_us = r->fin_us - r->inicio_us;
+        serie_us += duracion_us;
+        if (r->fin_us > fin_us) {
+            fin_us = r->fin_us;
+        }
+        ESP_LOGI(TAG, "  %-12s %6" PRId64 " -> %6" PRId64 " (%5" PRId64 " ms) %s%s%s",
+                 s_etapas[i].nombre, r->inicio_us / 1000, r->fin_us / 1000, duracion_us / 1000,
+                 nombre_estado(r->estado),
+                 r->estado == ARRANQUE_FALLIDA ? ": " : "",
+                 r->estado == ARRANQUE_FALLIDA ? esp_err_to_name(r->error) : "");
+    }
+    ESP_LOGI(TAG, "Arranque completo en %" PRId64 " ms (las etapas suman %" PRId64 " ms en serie)",
+             (fin_us - inicio_us) / 1000, serie_us / 1000);
+}
+
+esp_err_t arranque_ejecutar(const arranque_etapa_t *etapas, size_t num)
+{
+    if (etapas == NULL || num == 0 || num > ARRANQUE_MAX_ETAPAS || !grafo_valido(etapas, num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    s_eventos = xEventGroupCreate();
+    if (s_mutex == NULL || s_eventos == NULL) {
+        ESP_LOGE(TAG, "Sin memoria para el arranque");
+        if (s_mutex != NULL) {
+            vSemaphoreDelete(s_mutex);
+            s_mutex = NULL;
+        }
+        if (s_eventos != NULL) {
+            vEventGroupDelete(s_eventos);
+            s_eventos = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_etapas = etapas;
+    s_num = num;
+    s_terminadas = 0;
+    s_correctas = 0;
+    s_error = ESP_OK;
+    memset(s_registro, 0, sizeof(s_registro));
+
+    int64_t inicio_us = esp_timer_get_time();
+    size_t trabajadores = num < ARRANQUE_TRABAJADORES ? num : ARRANQUE_TRABAJADORES;
+    uint32_t bits_fin = 0;
+    UBaseType_t prioridad = uxTaskPriorityGet(NULL);
+
+    for (size_t n = 0; n < trabajadores; n++) {
+        char nombre[configMAX_TASK_NAME_LEN];
+        snprintf(nombre, sizeof(nombre), "arranque_%u", (unsigned)n);
+        if (xTaskCreate(trabajador_arranque, nombre, ARRANQUE_STACK, (void *)(uintptr_t)n,
+                        prioridad, NULL) == pdPASS) {
+            bits_fin |= EVENTO_TRABAJADOR(n);
+        } else {
+            ESP_LOGW(TAG, "No se pudo crear el trabajador %u", (unsigned)n);
+        }
+    }
+
+    if (bits_fin == 0) {
+        ESP_LOGE(TAG, "Sin memoria para los trabajadores de arranque");
+        vSemaphoreDelete(s_mutex);
+        vEventGroupDelete(s_eventos);
+        s_mutex = NULL;
+        s_eventos = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    xEventGroupWaitBits(s_eventos, bits_fin, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    vSemaphoreDelete(s_mutex);
+    vEventGroupDelete(s_eventos);
+    s_mutex = NULL;
+    s_eventos = NULL;
+
+    registrar_linea_de_tiempo(inicio_us);
+    return s_error;
+}
+
+const arranque_registro_t *arranque_obtener_registro(size_t i)
+{
+    return (s_etapas != NULL && i < s_num) ? &s_registro[i] : NULL;
+}
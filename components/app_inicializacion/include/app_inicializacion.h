@@ -7,7 +7,10 @@
 #include "esp_err.h"
 
 /**
- * @brief Inicializa todos los componentes del sistema
+ * @brief Inicializa todos los componentes del sistema e inicia el estado guardado
+ * 
+ * Ejecuta el grafo de arranque: las etapas independientes corren en paralelo
+ * y al final se registra la línea de tiempo de cada una.
  * 
  * @return esp_err_t ESP_OK si todos los componentes críticos se inicializaron correctamente,
  *                   código de error específico en caso contrario
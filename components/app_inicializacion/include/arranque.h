@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARRANQUE_MAX_ETAPAS         16
+#define ARRANQUE_TRABAJADORES       3       // Etapas ejecutándose a la vez como máximo
+#define ARRANQUE_STACK              4096    // Cada etapa corre en la pila de un trabajador
+
+/** Máscara de dependencia sobre la etapa de índice i */
+#define ARRANQUE_DEP(i)             (1u << (i))
+
+/**
+ * @brief Función de una etapa
+ *
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED si la etapa no aplica en este
+ *         arranque (se marca como omitida) o cualquier otro error (fallida)
+ */
+typedef esp_err_t (*arranque_fn_t)(void);
+
+/**
+ * @brief Nodo del grafo de arranque
+ *
+ * Una etapa se lanza cuando han terminado todas las de "requiere" y
+ * "despues_de". Si alguna de "requiere" falló o se omitió, la etapa se
+ * omite; "despues_de" solo impone el orden.
+ */
+typedef struct {
+    const char *nombre;
+    arranque_fn_t fn;
+    uint32_t requiere;          /**< ARRANQUE_DEP() de las etapas imprescindibles */
+    uint32_t despues_de;        /**< ARRANQUE_DEP() de las etapas que solo deben ir antes */
+    bool critica;               /**< Si falla no se lanzan más etapas y el arranque devuelve error */
+} arranque_etapa_t;
+
+typedef enum {
+    ARRANQUE_PENDIENTE = 0,
+    ARRANQUE_EN_CURSO,
+    ARRANQUE_OK,
+    ARRANQUE_FALLIDA,
+    ARRANQUE_OMITIDA,
+} arranque_estado_t;
+
+/**
+ * @brief Resultado de una etapa, con tiempos de esp_timer_get_time()
+ */
+typedef struct {
+    arranque_estado_t estado;
+    esp_err_t error;
+    int64_t inicio_us;
+    int64_t fin_us;
+} arranque_registro_t;
+
+/**
+ * @brief Ejecuta el grafo y espera a que terminen todas las etapas
+ *
+ * Las etapas independientes corren en paralelo en ARRANQUE_TRABAJADORES
+ * tareas; al terminar se registra la línea de tiempo del arranque.
+ *
+ * @param etapas Tabla de etapas; las dependencias son índices de esta tabla
+ * @param num Número de etapas (como máximo ARRANQUE_MAX_ETAPAS)
+ * @return ESP_OK, el error de la primera etapa crítica que falló,
+ *         ESP_ERR_INVALID_ARG si el grafo no es válido o ESP_ERR_NO_MEM
+ */
+esp_err_t arranque_ejecutar(const arranque_etapa_t *etapas, size_t num);
+
+/**
+ * @brief Registro de la etapa de índice i del último arranque (NULL si no existe)
+ */
+const arranque_registro_t *arranque_obtener_registro(size_t i);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,170 @@
+// ble_adv_matcher.c
+#include "ble_adv_matcher.h"
+#include <string.h>
+#include "esp_attr.h"
+
+// Tipos de estructura AD usados
+#define AD_TIPO_SERVICE_DATA_16   0x16
+#define AD_TIPO_FABRICANTE        0xFF
+
+// iBeacon: company Apple + subtipo 0x02, longitud 0x15
+#define IBEACON_COMPANY_ID        0x004C
+#define IBEACON_SUBTIPO           0x02
+#define IBEACON_LONGITUD          0x15
+
+// Eddystone: UUID de servicio 0xFEAA, trama UID 0x00
+#define EDDYSTONE_UUID            0xFEAA
+#define EDDYSTONE_TRAMA_UID       0x00
+
+#define CUBETA_MASK (BLE_ADV_BUCKETS - 1)
+
+/**
+ * Hash de la clave estable de una regla o paquete a su cubeta
+ */
+static IRAM_ATTR uint8_t hash_cubeta(const uint8_t *clave, size_t longitud)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < longitud; i++) {
+        h = (h ^ clave[i]) * 16777619u;
+    }
+    return (uint8_t)((h ^ (h >> 16)) & CUBETA_MASK);
+}
+
+static uint8_t cubeta_regla(const ble_adv_regla_t *regla)
+{
+    switch (regla->tipo) {
+        case BLE_ADV_REGLA_IBEACON:
+            return hash_cubeta(regla->ibeacon.uuid, 16);
+        case BLE_ADV_REGLA_EDDYSTONE_UID:
+            return hash_cubeta(regla->eddystone.espacio, 10);
+        case BLE_ADV_REGLA_FABRICANTE: {
+            uint8_t id[2] = {regla->fabricante.company_id & 0xFF, regla->fabricante.company_id >> 8};
+            return hash_cubeta(id, 2);
+        }
+        default:
+            return 0;
+    }
+}
+
+void ble_adv_matcher_limpiar(ble_adv_matcher_t *matcher)
+{
+    memset(matcher->cabeza, BLE_ADV_SIN_REGLA, sizeof(matcher->cabeza));
+    memset(matcher->siguiente, BLE_ADV_SIN_REGLA, sizeof(matcher->siguiente));
+    matcher->num_reglas = 0;
+}
+
+esp_err_t ble_adv_matcher_compilar(ble_adv_matcher_t *matcher, const ble_adv_regla_t *reglas, size_t num_reglas)
+{
+    if (num_reglas > BLE_ADV_MAX_REGLAS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ble_adv_matcher_limpiar(matcher);
+
+    // Insertar en orden inverso para que cada cadena conserve el orden original
+    for (int i = (int)num_reglas - 1; i >= 0; i--) {
+        const ble_adv_regla_t *regla = &reglas[i];
+        if (regla->tipo >= BLE_ADV_REGLA_NUM_TIPOS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint8_t cubeta = cubeta_regla(regla);
+        matcher->reglas[i] = *regla;
+        matcher->siguiente[i] = matcher->cabeza[regla->tipo][cubeta];
+        matcher->cabeza[regla->tipo][cubeta] = (uint8_t)i;
+    }
+    matcher->num_reglas = (uint8_t)num_reglas;
+
+    return ESP_OK;
+}
+
+static IRAM_ATTR int buscar_ibeacon(const ble_adv_matcher_t *matcher, const uint8_t *uuid, uint16_t major, uint16_t minor)
+{
+    for (uint8_t i = matcher->cabeza[BLE_ADV_REGLA_IBEACON][hash_cubeta(uuid, 16)];
+         i != BLE_ADV_SIN_REGLA; i = matcher->siguiente[i]) {
+        const ble_adv_regla_t *r = &matcher->reglas[i];
+        if (memcmp(r->ibeacon.uuid, uuid, 16) == 0 &&
+            (r->ibeacon.major < 0 || r->ibeacon.major == major) &&
+            (r->ibeacon.minor < 0 || r->ibeacon.minor == minor)) {
+            return r->target_idx;
+        }
+    }
+    return -1;
+}
+
+static IRAM_ATTR int buscar_eddystone(const ble_adv_matcher_t *matcher, const uint8_t *espacio, const uint8_t *instancia)
+{
+    for (uint8_t i = matcher->cabeza[BLE_ADV_REGLA_EDDYSTONE_UID][hash_cubeta(espacio, 10)];
+         i != BLE_ADV_SIN_REGLA; i = matcher->siguiente[i]) {
+        const ble_adv_regla_t *r = &matcher->reglas[i];
+        if (memcmp(r->eddystone.espacio, espacio, 10) == 0 &&
+            (r->eddystone.cualquier_instancia || memcmp(r->eddystone.instancia, instancia, 6) == 0)) {
+            return r->target_idx;
+        }
+    }
+    return -1;
+}
+
+static IRAM_ATTR int buscar_fabricante(const ble_adv_matcher_t *matcher, const uint8_t *payload, uint8_t longitud)
+{
+    // payload empieza por el company ID (little endian)
+    for (uint8_t i = matcher->cabeza[BLE_ADV_REGLA_FABRICANTE][hash_cubeta(payload, 2)];
+         i != BLE_ADV_SIN_REGLA; i = matcher->siguiente[i]) {
+        const ble_adv_regla_t *r = &matcher->reglas[i];
+        uint16_t company_id = payload[0] | (payload[1] << 8);
+        if (r->fabricante.company_id != company_id || longitud < 2 + r->fabricante.longitud) {
+            continue;
+        }
+        bool coincide = true;
+        for (uint8_t j = 0; j < r->fabricante.longitud && coincide; j++) {
+            coincide = ((payload[2 + j] ^ r->fabricante.datos[j]) & r->fabricante.mascara[j]) == 0;
+        }
+        if (coincide) {
+            return r->target_idx;
+        }
+    }
+    return -1;
+}
+
+IRAM_ATTR int ble_adv_matcher_buscar(const ble_adv_matcher_t *matcher, const uint8_t *datos, uint8_t longitud)
+{
+    if (matcher->num_reglas == 0 || datos == NULL) {
+        return -1;
+    }
+
+    // Recorrido de estructuras AD [len][tipo][payload] sobre el buffer de NimBLE
+    uint8_t pos = 0;
+    while (pos + 1 < longitud) {
+        uint8_t len_ad = datos[pos];
+        if (len_ad == 0 || pos + 1 + len_ad > longitud) {
+            break;
+        }
+        uint8_t tipo = datos[pos + 1];
+        const uint8_t *payload = &datos[pos + 2];
+        uint8_t len_payload = len_ad - 1;
+        int idx = -1;
+
+        if (tipo == AD_TIPO_FABRICANTE && len_payload >= 2) {
+            uint16_t company_id = payload[0] | (payload[1] << 8);
+            if (company_id == IBEACON_COMPANY_ID && len_payload >= 25 &&
+                payload[2] == IBEACON_SUBTIPO && payload[3] == IBEACON_LONGITUD) {
+                uint16_t major = (payload[20] << 8) | payload[21];
+                uint16_t minor = (payload[22] << 8) | payload[23];
+                idx = buscar_ibeacon(matcher, &payload[4], major, minor);
+            }
+            if (idx < 0) {
+                idx = buscar_fabricante(matcher, payload, len_payload);
+            }
+        } else if (tipo == AD_TIPO_SERVICE_DATA_16 && len_payload >= 20 &&
+                   (payload[0] | (payload[1] << 8)) == EDDYSTONE_UUID &&
+                   payload[2] == EDDYSTONE_TRAMA_UID) {
+            // [uuid 2][trama][tx][namespace 10][instancia 6]
+            idx = buscar_eddystone(matcher, &payload[4], &payload[14]);
+        }
+
+        if (idx >= 0) {
+            return idx;
+        }
+        pos += 1 + len_ad;
+    }
+    return -1;
+}
@@ -0,0 +1,54 @@
+// ble_detection_ring.c
+#include "ble_detection_ring.h"
+#include <string.h>
+#include "esp_attr.h"
+
+#define RING_MASK (BLE_DETECTION_RING_SIZE - 1)
+
+void ble_detection_ring_reset(ble_detection_ring_t *ring)
+{
+    memset(ring->elementos, 0, sizeof(ring->elementos));
+    atomic_store(&ring->cabeza, 0);
+    atomic_store(&ring->cola, 0);
+    atomic_store(&ring->desbordamientos, 0);
+    atomic_store(&ring->ocupacion_maxima, 0);
+    atomic_store(&ring->encolados, 0);
+}
+
+IRAM_ATTR bool ble_detection_ring_push(ble_detection_ring_t *ring, const detection_info_t *info)
+{
+    uint32_t cabeza = atomic_load_explicit(&ring->cabeza, memory_order_relaxed);
+    uint32_t cola = atomic_load_explicit(&ring->cola, memory_order_acquire);
+    uint32_t ocupacion = cabeza - cola;
+
+    if (ocupacion >= BLE_DETECTION_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->desbordamientos, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->elementos[cabeza & RING_MASK] = *info;
+    atomic_store_explicit(&ring->cabeza, cabeza + 1, memory_order_release);
+
+    // Solo el productor actualiza estos contadores
+    atomic_store_explicit(&ring->encolados,
+                          atomic_load_explicit(&ring->encolados, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    if (ocupacion + 1 > atomic_load_explicit(&ring->ocupacion_maxima, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->ocupacion_maxima, ocupacion + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool ble_detection_ring_pop(ble_detection_ring_t *ring, detection_info_t *info)
+{
+    uint32_t cola = atomic_load_explicit(&ring->cola, memory_order_relaxed);
+    uint32_t cabeza = atomic_load_explicit(&ring->cabeza, memory_order_acquire);
+
+    if (cola == cabeza) {
+        return false;
+    }
+
+    *info = ring->elementos[cola & RING_MASK];
+    atomic_store_explicit(&ring->cola, cola + 1, memory_order_release);
+    return true;
+}
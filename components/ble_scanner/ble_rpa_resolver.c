@@ -0,0 +1,128 @@
+// ble_rpa_resolver.c
+#include "ble_rpa_resolver.h"
+#include <string.h>
+
+void ble_rpa_resolver_init(ble_rpa_resolver_t *resolver)
+{
+    memset(resolver, 0, sizeof(*resolver));
+}
+
+void ble_rpa_resolver_liberar(ble_rpa_resolver_t *resolver)
+{
+    for (int i = 0; i < BLE_RPA_MAX_IRKS; i++) {
+        if (resolver->irks[i].en_uso) {
+            mbedtls_aes_free(&resolver->irks[i].aes);
+        }
+    }
+    ble_rpa_resolver_init(resolver);
+}
+
+void ble_rpa_resolver_limpiar_cache(ble_rpa_resolver_t *resolver)
+{
+    memset(resolver->cache, 0, sizeof(resolver->cache));
+    resolver->reloj = 0;
+}
+
+void ble_rpa_resolver_eliminar_irk(ble_rpa_resolver_t *resolver, uint16_t target_idx)
+{
+    for (int i = 0; i < BLE_RPA_MAX_IRKS; i++) {
+        ble_rpa_irk_t *irk = &resolver->irks[i];
+        if (irk->en_uso && irk->target_idx == target_idx) {
+            mbedtls_aes_free(&irk->aes);
+            memset(irk, 0, sizeof(*irk));
+            resolver->num_irks--;
+        }
+    }
+    ble_rpa_resolver_limpiar_cache(resolver);
+}
+
+esp_err_t ble_rpa_resolver_agregar_irk(ble_rpa_resolver_t *resolver, uint16_t target_idx, const uint8_t irk[16])
+{
+    ble_rpa_resolver_eliminar_irk(resolver, target_idx);
+
+    for (int i = 0; i < BLE_RPA_MAX_IRKS; i++) {
+        ble_rpa_irk_t *ranura = &resolver->irks[i];
+        if (!ranura->en_uso) {
+            // La expansión de clave se hace una sola vez aquí, no por anuncio
+            mbedtls_aes_init(&ranura->aes);
+            if (mbedtls_aes_setkey_enc(&ranura->aes, irk, 128) != 0) {
+                mbedtls_aes_free(&ranura->aes);
+                return ESP_FAIL;
+            }
+            ranura->target_idx = target_idx;
+            ranura->en_uso = true;
+            resolver->num_irks++;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * Función ah() de la especificación: hash == e(IRK, 0^104 || prand) mod 2^24
+ */
+static bool rpa_coincide(ble_rpa_irk_t *irk, const uint8_t addr[6])
+{
+    uint8_t entrada[16] = {0};
+    uint8_t salida[16];
+
+    // addr está en orden NimBLE (LSB primero): prand = addr[5..3], hash = addr[2..0]
+    entrada[13] = addr[5];
+    entrada[14] = addr[4];
+    entrada[15] = addr[3];
+
+    if (mbedtls_aes_crypt_ecb(&irk->aes, MBEDTLS_AES_ENCRYPT, entrada, salida) != 0) {
+        return false;
+    }
+    return salida[13] == addr[2] && salida[14] == addr[1] && salida[15] == addr[0];
+}
+
+int ble_rpa_resolver_buscar(ble_rpa_resolver_t *resolver, const uint8_t addr[6])
+{
+    resolver->consultas++;
+    resolver->reloj++;
+
+    // Búsqueda en caché y, de paso, la víctima LRU por si hay que insertar
+    ble_rpa_cache_entry_t *victima = &resolver->cache[0];
+    for (int i = 0; i < BLE_RPA_CACHE_SIZE; i++) {
+        ble_rpa_cache_entry_t *entrada = &resolver->cache[i];
+        if (!entrada->valida) {
+            if (victima->valida) {
+                victima = entrada;
+            }
+            continue;
+        }
+        if (memcmp(entrada->addr, addr, 6) == 0) {
+            entrada->ultimo_uso = resolver->reloj;
+            resolver->aciertos_cache++;
+            if (entrada->target_idx >= 0) {
+                resolver->resueltas++;
+            }
+            return entrada->target_idx;
+        }
+        if (victima->valida && entrada->ultimo_uso < victima->ultimo_uso) {
+            victima = entrada;
+        }
+    }
+
+    // Fallo de caché: probar cada IRK
+    int resultado = -1;
+    for (int i = 0; i < BLE_RPA_MAX_IRKS && resultado < 0; i++) {
+        if (resolver->irks[i].en_uso) {
+            resolver->resoluciones_aes++;
+            if (rpa_coincide(&resolver->irks[i], addr)) {
+                resultado = resolver->irks[i].target_idx;
+            }
+        }
+    }
+    if (resultado >= 0) {
+        resolver->resueltas++;
+    }
+
+    memcpy(victima->addr, addr, 6);
+    victima->target_idx = (int16_t)resultado;
+    victima->ultimo_uso = resolver->reloj;
+    victima->valida = true;
+
+    return resultado;
+}
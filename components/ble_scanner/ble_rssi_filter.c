@@ -0,0 +1,37 @@
+// ble_rssi_filter.c
+#include "ble_rssi_filter.h"
+#include "esp_attr.h"
+
+void ble_rssi_filter_reset(ble_rssi_filter_t *filtro)
+{
+    filtro->valor_q8 = 0;
+    filtro->zona = BLE_PROXIMITY_UNKNOWN;
+    filtro->inicializado = false;
+}
+
+IRAM_ATTR ble_proximity_zone_t ble_rssi_filter_actualizar(ble_rssi_filter_t *filtro, int8_t rssi, uint8_t shift,
+                                                          int8_t umbral_cerca, int8_t umbral_lejos)
+{
+    if (rssi == BLE_RSSI_NO_DISPONIBLE) {
+        return filtro->zona;
+    }
+
+    int32_t muestra_q8 = (int32_t)rssi * 256;
+    if (!filtro->inicializado) {
+        filtro->valor_q8 = muestra_q8;
+        filtro->inicializado = true;
+    } else {
+        filtro->valor_q8 += (muestra_q8 - filtro->valor_q8) >> shift;
+    }
+
+    int8_t valor = ble_rssi_filter_valor(filtro);
+    if (valor >= umbral_cerca) {
+        filtro->zona = BLE_PROXIMITY_NEAR;
+    } else if (valor < umbral_lejos) {
+        filtro->zona = BLE_PROXIMITY_FAR;
+    } else if (filtro->zona == BLE_PROXIMITY_UNKNOWN) {
+        // Primera muestra en la banda de histéresis: aún no está cerca
+        filtro->zona = BLE_PROXIMITY_FAR;
+    }
+    return filtro->zona;
+}
@@ -1,5 +1,12 @@
 // ble_scanner.c
 #include "ble_scanner.h"
+#include "ble_target_set.h"
+#include "ble_detection_ring.h"
+#include "ble_rssi_filter.h"
+#include "ble_rpa_resolver.h"
+#include "ble_adv_matcher.h"
+#include "ble_thermal_governor.h"
+#include "ble_telemetria.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_bt.h"
@@ -13,13 +20,14 @@
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "freertos/portmacro.h"
+#include "freertos/semphr.h"
 #include "driver/temperature_sensor.h"
 #include "esp_check.h"
 #include <math.h>
 #include "mqtt_service.h"
 #include "wifi_sta.h"
+#include "boot_trace.h"
 
 static const char *TAG = "BLE_SCANNER_S3";
 
@@ -29,27 +37,57 @@ static portMUX_TYPE s_ble_mux = portMUX_INITIALIZER_UNLOCKED;
 // Estructura para MACs objetivo
 typedef struct {
     uint8_t mac[6];
-    uint32_t mac_hash;
     bool en_uso;
+    bool tiene_mac;                   // false = objetivo identificado solo por IRK
     bool detectado;
     uint32_t detecciones_totales;
     int64_t ultima_deteccion;
+    int64_t ultima_deteccion_us;      // Recepción del último anuncio, para medir latencias
+    ble_rssi_filter_t rssi;           // Solo lo escribe el callback de escaneo
 } ble_scanner_target_t;
 
-// Estructura para información de detección
-typedef struct {
-    uint8_t target_idx;
-    int8_t rssi;
-    int64_t timestamp;
-} detection_info_t;
+// Tras este hueco sin anuncios el EMA se reinicia con la nueva muestra
+#define RSSI_REINICIO_FILTRO_MS 10000
+
+// Duty máximo (%) durante el enfriamiento forzado, como el antiguo modo ECO
+#define ENFRIAMIENTO_FORZADO_DUTY 50.0f
 
 // Variables del módulo
 static ble_scanner_target_t s_targets[BLE_SCANNER_MAX_TARGET_DEVICES] = {0};
+
+// Índice hash de MACs objetivo con doble buffer: se reconstruye en el inactivo
+// y se publica cambiando s_indice_activo, así el callback de escaneo nunca
+// lee un índice a medio construir ni necesita tomar el mutex
+static ble_target_set_t s_indices[2];
+static volatile uint8_t s_indice_activo = 0;
+static bool s_indices_inicializados = false;
 static ble_scanner_config_t s_config = BLE_SCANNER_DEFAULT_CONFIG();
 static bool s_inicializado = false;
 static bool s_escaneo_activo = false;
 static bool s_host_sincronizado = false;
-static QueueHandle_t s_detection_queue = NULL;
+static TaskHandle_t s_detection_task_handle = NULL;
+
+// Anillo sin bloqueo entre el callback de escaneo y detection_task
+static ble_detection_ring_t s_detection_ring;
+
+// Reglas de contenido de anuncio: la lista fuente se compila en el buffer
+// inactivo y se publica igual que el índice de MACs
+static ble_adv_regla_t s_reglas_anuncio[BLE_ADV_MAX_REGLAS];
+static uint8_t s_num_reglas_anuncio = 0;
+static ble_adv_matcher_t s_matchers[2];
+static volatile uint8_t s_matcher_activo = 0;
+
+// Época del callback de escaneo: impar mientras procesa un anuncio. Tras
+// publicar un buffer se espera a que cambie si era impar; así el buffer que
+// queda inactivo no se reescribe mientras el callback aún lo lee. El callback
+// corre siempre en la tarea host de NimBLE: hay un único lector
+static volatile uint32_t s_epoca_escaneo = 0;
+
+// Resolución de RPA: el callback toma el mutex sin esperar (si la configuración
+// lo tiene, ese anuncio se ignora y se resolverá en el siguiente)
+static ble_rpa_resolver_t s_rpa;
+static SemaphoreHandle_t s_rpa_mutex = NULL;
+static StaticSemaphore_t s_rpa_mutex_buffer;
 
 // Control térmico optimizado para ESP32-S3-MINI-1
 static bool s_control_termico_activo = true;
@@ -60,11 +98,27 @@ static float s_temp_emergency = BLE_SCANNER_TEMP_EMERGENCY;
 static float s_temperatura_actual = 25.0f;
 static ble_thermal_mode_t s_modo_termico = BLE_THERMAL_MODE_NORMAL;
 static ble_presence_state_t s_estado_presencia = BLE_PRESENCE_UNKNOWN;
+static volatile int8_t s_umbral_cerca = BLE_SCANNER_RSSI_NEAR_DBM;
+static volatile int8_t s_umbral_lejos = BLE_SCANNER_RSSI_FAR_DBM;
 static temperature_sensor_handle_t s_temp_sensor = NULL;
 static TaskHandle_t s_temp_task_handle = NULL;
 
-// Parámetros de escaneo optimizados para diferentes modos térmicos
-static struct ble_gap_disc_params s_scan_params[5] = {0}; // Para cada modo térmico
+/*
+ * Parada ordenada de detection_task y temp_monitor_task_s3: las dos publican
+ * por MQTT (outbox con mutex y escrituras en flash), así que no se borran
+ * desde fuera. deinicializar pide la salida, cada tarea sale en un punto
+ * seguro, confirma en su semáforo y se borra a sí misma.
+ */
+#define TAREA_TIMEOUT_SALIDA_MS 10000
+static volatile bool s_tareas_salir = false;
+static SemaphoreHandle_t s_detection_terminada = NULL;
+static StaticSemaphore_t s_detection_terminada_buffer;
+static SemaphoreHandle_t s_temp_terminada = NULL;
+static StaticSemaphore_t s_temp_terminada_buffer;
+
+// Parámetros de escaneo calculados por el gobernador térmico
+static struct ble_gap_disc_params s_scan_params = {0};
+static ble_thermal_governor_t s_gobernador;
 
 // Estadísticas y control de enfriamiento
 static float s_temp_samples[60] = {0}; // 1 minuto de muestras
@@ -75,10 +129,30 @@ static bool s_enfriamiento_forzado = false;
 static int64_t s_fin_enfriamiento_forzado = 0;
 static uint32_t s_detecciones_globales = 0;
 
-// Control de presencia para optimización
-static int64_t s_ultima_deteccion_cualquiera = 0;
-static int s_ciclos_consecutivos_sin_deteccion = 0;
-static int s_ciclos_consecutivos_con_deteccion = 0;
+// Motor de presencia: estado por objetivo, actualizado por detection_task
+typedef struct {
+    ble_presence_state_t estado;
+    uint8_t detecciones_ventana;      // Detecciones acumuladas para confirmar entrada
+    int64_t inicio_ventana;           // Inicio de la ventana de entrada (ms)
+    int64_t ultima_deteccion;         // Última detección o reinicio del objetivo (ms)
+    uint32_t timeout_salida_ms;       // 0 = usar el timeout global
+} ble_presencia_objetivo_t;
+
+// Suscriptor de transiciones de presencia (callback o notificación de tarea)
+typedef struct {
+    ble_scanner_presencia_cb_t cb;
+    void *arg;
+    TaskHandle_t tarea;
+    uint32_t bits;
+} ble_presencia_suscriptor_t;
+
+static ble_presencia_objetivo_t s_presencia[BLE_SCANNER_MAX_TARGET_DEVICES] = {0};
+static ble_presencia_suscriptor_t s_suscriptores[BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS] = {0};
+// Tareas notificadas en cada lote de detecciones (no solo en transiciones)
+static ble_presencia_suscriptor_t s_suscriptores_deteccion[BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS] = {0};
+static uint8_t s_presencia_detecciones_entrada = BLE_SCANNER_PRESENCE_ENTER_DETECTIONS;
+static uint32_t s_presencia_ventana_entrada_ms = BLE_SCANNER_PRESENCE_ENTER_WINDOW_MS;
+static uint32_t s_presencia_timeout_salida_ms = BLE_SCANNER_PRESENCE_EXIT_TIMEOUT_MS;
 
 // Prototipos
 static void detection_task(void *param);
@@ -88,21 +162,94 @@ static float leer_temperatura_s3(void);
 static void configurar_parametros_escaneo_s3(void);
 static ble_thermal_mode_t determinar_modo_termico_s3(void);
 static ble_presence_state_t determinar_estado_presencia_s3(void);
-static void aplicar_modo_termico_s3(ble_thermal_mode_t nuevo_modo);
-static esp_err_t iniciar_escaneo_con_modo_s3(ble_thermal_mode_t modo);
+static void procesar_deteccion_presencia(const detection_info_t *info);
+static TickType_t evaluar_salidas_presencia(int64_t now);
+static void notificar_presencia(uint16_t target_idx, ble_presence_state_t estado, int64_t timestamp);
+static void reiniciar_presencia_objetivo(uint16_t target_idx, int64_t now);
+static void notificar_suscriptores_deteccion(void);
+static void actualizar_parametros_gap_s3(void);
+static void aplicar_gobernador_termico_s3(void);
 static esp_err_t iniciar_escaneo_s3(void);
-static void crear_mac_hash(uint8_t target_idx);
+static void reconstruir_indice_objetivos(void);
+static esp_err_t recompilar_reglas_anuncio(void);
+static void activar_objetivo_sin_mac(uint16_t mac_index);
 
 /**
- * Hash para comparación rápida de MACs
+ * Espera a que termine el callback de escaneo que pudiera estar leyendo el
+ * buffer recién retirado (como mucho un anuncio)
  */
-static void crear_mac_hash(uint8_t target_idx)
+static void esperar_lectores_escaneo(void)
 {
-    const uint8_t *mac = s_targets[target_idx].mac;
-    s_targets[target_idx].mac_hash = ((uint32_t)mac[0] << 24) |
-                                     ((uint32_t)mac[1] << 16) |
-                                     ((uint32_t)mac[2] << 8) |
-                                     mac[3];
+    uint32_t epoca = __atomic_load_n(&s_epoca_escaneo, __ATOMIC_SEQ_CST);
+    while ((epoca & 1) && __atomic_load_n(&s_epoca_escaneo, __ATOMIC_SEQ_CST) == epoca) {
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * Reconstruye el índice hash a partir de s_targets y lo publica
+ */
+static void reconstruir_indice_objetivos(void)
+{
+    if (!s_indices_inicializados) {
+        ble_target_set_limpiar(&s_indices[0]);
+        ble_target_set_limpiar(&s_indices[1]);
+        s_indices_inicializados = true;
+    }
+
+    uint8_t siguiente = s_indice_activo ^ 1;
+    ble_target_set_t *indice = &s_indices[siguiente];
+    ble_target_set_limpiar(indice);
+
+    portENTER_CRITICAL(&s_ble_mux);
+    for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+        if (s_targets[i].en_uso && s_targets[i].tiene_mac) {
+            ble_target_set_insertar(indice, s_targets[i].mac, (uint16_t)i);
+        }
+    }
+    __atomic_store_n(&s_indice_activo, siguiente, __ATOMIC_SEQ_CST);
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    esperar_lectores_escaneo();
+}
+
+/**
+ * Compila s_reglas_anuncio en el matcher inactivo y lo publica
+ */
+static esp_err_t recompilar_reglas_anuncio(void)
+{
+    uint8_t siguiente = s_matcher_activo ^ 1;
+    esp_err_t ret = ble_adv_matcher_compilar(&s_matchers[siguiente], s_reglas_anuncio, s_num_reglas_anuncio);
+    if (ret == ESP_OK) {
+        __atomic_store_n(&s_matcher_activo, siguiente, __ATOMIC_SEQ_CST);
+        esperar_lectores_escaneo();
+    }
+    return ret;
+}
+
+/**
+ * Marca como en uso un objetivo identificado sin MAC fija (IRK o reglas)
+ */
+static void activar_objetivo_sin_mac(uint16_t mac_index)
+{
+    if (s_targets[mac_index].en_uso) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time() / 1000;
+    portENTER_CRITICAL(&s_ble_mux);
+    s_targets[mac_index].en_uso = true;
+    s_targets[mac_index].tiene_mac = false;
+    s_targets[mac_index].detectado = false;
+    s_targets[mac_index].detecciones_totales = 0;
+    s_targets[mac_index].ultima_deteccion = 0;
+    ble_rssi_filter_reset(&s_targets[mac_index].rssi);
+    reiniciar_presencia_objetivo(mac_index, now);
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (s_detection_task_handle != NULL) {
+        xTaskNotifyGive(s_detection_task_handle);
+    }
 }
 
 /**
@@ -112,48 +259,58 @@ static IRAM_ATTR int ble_app_scan_cb_s3(struct ble_gap_event *event, void *arg)
 {
     if (event->type == BLE_GAP_EVENT_DISC) {
         const uint8_t *adv_mac = event->disc.addr.val;
-        int64_t now = esp_timer_get_time() / 1000;
-
-        // Hash rápido para filtrado inicial
-        uint32_t adv_hash = ((uint32_t)adv_mac[0] << 24) |
-                            ((uint32_t)adv_mac[1] << 16) |
-                            ((uint32_t)adv_mac[2] << 8) |
-                            adv_mac[3];
-
-        // Comparar con MACs objetivo
-        for (int target_idx = 0; target_idx < BLE_SCANNER_MAX_TARGET_DEVICES; target_idx++) {
-            if (!s_targets[target_idx].en_uso || adv_hash != s_targets[target_idx].mac_hash) {
-                continue;
-            }
 
-            // Verificación completa de MAC
-            bool match = true;
-            for (int i = 0; i < 6; i++) {
-                if (adv_mac[i] != s_targets[target_idx].mac[i]) {
-                    match = false;
-                    break;
-                }
-            }
+        // Época impar antes de leer qué buffers están activos (ver esperar_lectores_escaneo)
+        __atomic_fetch_add(&s_epoca_escaneo, 1, __ATOMIC_SEQ_CST);
+        const ble_target_set_t *indice = &s_indices[__atomic_load_n(&s_indice_activo, __ATOMIC_SEQ_CST)];
+        const ble_adv_matcher_t *matcher = &s_matchers[__atomic_load_n(&s_matcher_activo, __ATOMIC_SEQ_CST)];
+
+        // Búsqueda O(1) sobre la dirección completa de 48 bits
+        int target_idx = ble_target_set_buscar(indice, adv_mac);
 
-            if (match) {
-                // Actualizar estadísticas desde ISR
-                portENTER_CRITICAL(&s_ble_mux);
-                s_targets[target_idx].detectado = true;
-                s_targets[target_idx].detecciones_totales++;
-                s_targets[target_idx].ultima_deteccion = now;
-                s_detecciones_globales++;
-                portEXIT_CRITICAL(&s_ble_mux);
-
-                // Enviar a cola para procesamiento
-                if (s_detection_queue != NULL) {
-                    detection_info_t info = {
-                        .target_idx = target_idx,
-                        .rssi = event->disc.rssi,
-                        .timestamp = now
-                    };
-                    xQueueSendFromISR(s_detection_queue, &info, NULL);
-                }
-                break;
+        // Identificadores estables en el contenido (iBeacon, Eddystone, fabricante)
+        if (target_idx < 0 && matcher->num_reglas > 0) {
+            target_idx = ble_adv_matcher_buscar(matcher, event->disc.data, event->disc.length_data);
+        }
+        __atomic_fetch_add(&s_epoca_escaneo, 1, __ATOMIC_RELEASE);
+
+        // Direcciones privadas resolubles: caché LRU y, si falla, AES por IRK
+        if (target_idx < 0 && s_rpa.num_irks > 0 &&
+            event->disc.addr.type == BLE_ADDR_RANDOM && ble_rpa_es_resoluble(adv_mac) &&
+            xSemaphoreTake(s_rpa_mutex, 0) == pdTRUE) {
+            target_idx = ble_rpa_resolver_buscar(&s_rpa, adv_mac);
+            xSemaphoreGive(s_rpa_mutex);
+        }
+
+        if (target_idx >= 0 && s_targets[target_idx].en_uso) {
+            int64_t now_us = esp_timer_get_time();
+            int64_t now = now_us / 1000;
+            ble_scanner_target_t *target = &s_targets[target_idx];
+
+            // El callback es el único escritor de estos contadores: sin sección crítica
+            if (now - target->ultima_deteccion > RSSI_REINICIO_FILTRO_MS) {
+                ble_rssi_filter_reset(&target->rssi);
+            }
+            ble_rssi_filter_actualizar(&target->rssi, event->disc.rssi, BLE_SCANNER_RSSI_EMA_SHIFT,
+                                       s_umbral_cerca, s_umbral_lejos);
+            target->detecciones_totales++;
+            target->ultima_deteccion = now;
+            target->ultima_deteccion_us = now_us;
+            s_detecciones_globales++;
+            __atomic_store_n(&target->detectado, true, __ATOMIC_RELEASE);
+
+            // Encolar para procesamiento y despertar siempre a detection_task:
+            // las notificaciones se acumulan en un contador, así que no cuesta
+            // más que una, y avisar solo al pasar de vacío a no vacío puede
+            // dejarla dormida con datos si el aviso cruza con el final del drenado
+            detection_info_t info = {
+                .target_idx = target_idx,
+                .rssi = event->disc.rssi,
+                .timestamp = now
+            };
+            if (ble_detection_ring_push(&s_detection_ring, &info) &&
+                s_detection_task_handle != NULL) {
+                xTaskNotifyGive(s_detection_task_handle);
             }
         }
     }
@@ -167,11 +324,23 @@ static void detection_task(void *param)
 {
     detection_info_t info;
     static bool primera_deteccion[BLE_SCANNER_MAX_TARGET_DEVICES] = {0};
+    uint32_t desbordamientos_reportados = 0;
     ESP_LOGI(TAG, "detection_task watermark=%u",
              uxTaskGetStackHighWaterMark(NULL));
 
-    while (1) {
-        if (xQueueReceive(s_detection_queue, &info, portMAX_DELAY)) {
+    while (!s_tareas_salir) {
+        // Dormir hasta la próxima detección o el próximo vencimiento de ausencia
+        TickType_t espera = evaluar_salidas_presencia(esp_timer_get_time() / 1000);
+        ulTaskNotifyTake(pdTRUE, espera);
+
+        bool suscriptores_notificados = false;
+        while (ble_detection_ring_pop(&s_detection_ring, &info)) {
+            // Avisar antes de cualquier trabajo lento (MQTT) para no añadir latencia
+            if (!suscriptores_notificados) {
+                notificar_suscriptores_deteccion();
+                suscriptores_notificados = true;
+            }
+
             // Log solo primera detección para reducir spam
             if (!primera_deteccion[info.target_idx]) {
                 primera_deteccion[info.target_idx] = true;
@@ -180,18 +349,45 @@ static void detection_task(void *param)
                 // Reporte MQTT de primera detección
                 const char *mac_clean = sta_wifi_get_mac_clean();
                 char topic[80];
+#if BLE_TELEMETRIA_CBOR
+                snprintf(topic, sizeof(topic), "dispositivos/%s/deteccion" BLE_TELEMETRIA_SUFIJO_CBOR, mac_clean);
+                uint8_t cbor[32];
+                cbor_writer_t w;
+                cbor_writer_init(&w, cbor, sizeof(cbor));
+                cbor_writer_mapa(&w, 1 + BLE_TELEMETRIA_DETECCION_NUM_CAMPOS);
+                cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_CLAVE_ESQUEMA), BLE_TELEMETRIA_ESQUEMA_DETECCION);
+                cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_DETECCION_DISPOSITIVO), info.target_idx);
+                cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_DETECCION_RSSI), info.rssi);
+                cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_DETECCION_TIMESTAMP), info.timestamp);
+                mqtt_service_enviar_cbor_writer(topic, &w, 1, 0);
+#else
                 snprintf(topic, sizeof(topic), "dispositivos/%s/deteccion", mac_clean);
                 char json[120];
-                snprintf(json, sizeof(json), 
-                        "{\"dispositivo\":%d,\"rssi\":%d,\"primera_vez\":true,\"timestamp\":%lld}", 
-                        info.target_idx, info.rssi, info.timestamp);
-                mqtt_service_enviar_dato(topic, json, 1, 0);
+                json_writer_t w;
+                json_writer_init(&w, json, sizeof(json));
+                json_writer_objeto(&w, NULL);
+                json_writer_int(&w, "dispositivo", info.target_idx);
+                json_writer_int(&w, "rssi", info.rssi);
+                json_writer_bool(&w, "primera_vez", true);
+                json_writer_int(&w, "timestamp", info.timestamp);
+                mqtt_service_enviar_json_writer(topic, &w, 1, 0);
+#endif
             }
             
-            // Actualizar timestamp global
-            s_ultima_deteccion_cualquiera = info.timestamp;
+            procesar_deteccion_presencia(&info);
+        }
+
+        uint32_t desbordamientos = atomic_load(&s_detection_ring.desbordamientos);
+        if (desbordamientos != desbordamientos_reportados) {
+            ESP_LOGW(TAG, "⚠️ Anillo de detecciones lleno: %lu detecciones descartadas en total",
+                     desbordamientos);
+            desbordamientos_reportados = desbordamientos;
         }
     }
+
+    ESP_LOGI(TAG, "Tarea de detección detenida");
+    xSemaphoreGive(s_detection_terminada);
+    vTaskDelete(NULL);
 }
 
 /**
@@ -235,85 +431,201 @@ static float leer_temperatura_s3(void)
 }
 
 /**
- * Configurar parámetros de escaneo optimizados para AUSENCIA prolongada
+ * Configurar el gobernador térmico a partir de los umbrales actuales
  */
 static void configurar_parametros_escaneo_s3(void)
 {
-    // NORMAL: Máxima detección cuando temperatura es buena
-    s_scan_params[BLE_THERMAL_MODE_NORMAL].passive = s_config.passive;
-    s_scan_params[BLE_THERMAL_MODE_NORMAL].itvl = 0x0008;      // 5ms intervalo (MÁS AGRESIVO)
-    s_scan_params[BLE_THERMAL_MODE_NORMAL].window = 0x0008;    // 5ms ventana (100%)
-    s_scan_params[BLE_THERMAL_MODE_NORMAL].filter_duplicates = false; // No filtrar para máxima detección
-    
-    // ECO: Primer nivel de enfriamiento pero manteniendo buena detección
-    s_scan_params[BLE_THERMAL_MODE_ECO].passive = true;
-    s_scan_params[BLE_THERMAL_MODE_ECO].itvl = 0x0010;         // 10ms intervalo
-    s_scan_params[BLE_THERMAL_MODE_ECO].window = 0x0008;       // 5ms ventana (50%)
-    s_scan_params[BLE_THERMAL_MODE_ECO].filter_duplicates = false;
-    
-    // WARNING: Reducción moderada pero funcional para ausencia
-    s_scan_params[BLE_THERMAL_MODE_WARNING].passive = true;
-    s_scan_params[BLE_THERMAL_MODE_WARNING].itvl = 0x0020;     // 20ms intervalo
-    s_scan_params[BLE_THERMAL_MODE_WARNING].window = 0x0008;   // 5ms ventana (25%)
-    s_scan_params[BLE_THERMAL_MODE_WARNING].filter_duplicates = true;
-    
-    // CRITICAL: Reducción agresiva pero manteniendo detección básica
-    s_scan_params[BLE_THERMAL_MODE_CRITICAL].passive = true;
-    s_scan_params[BLE_THERMAL_MODE_CRITICAL].itvl = 0x0080;    // 80ms intervalo
-    s_scan_params[BLE_THERMAL_MODE_CRITICAL].window = 0x0008;  // 5ms ventana (6.25%)
-    s_scan_params[BLE_THERMAL_MODE_CRITICAL].filter_duplicates = true;
-    
-    // EMERGENCY: Supervivencia mínima pero seguir funcionando
-    s_scan_params[BLE_THERMAL_MODE_EMERGENCY].passive = true;
-    s_scan_params[BLE_THERMAL_MODE_EMERGENCY].itvl = 0x0280;   // 400ms intervalo
-    s_scan_params[BLE_THERMAL_MODE_EMERGENCY].window = 0x0004; // 2.5ms ventana (0.625%)
-    s_scan_params[BLE_THERMAL_MODE_EMERGENCY].filter_duplicates = true;
+    // Duty máximo por debajo de ECO, mínimo (0.625%) en EMERGENCY
+    ble_thermal_governor_config_t cfg = {
+        .temp_inicio = s_temp_eco,
+        .temp_fin = s_temp_emergency,
+        .ventana = 0x0008,            // 5ms ventana
+        .itvl_min = 0x0008,           // 5ms intervalo (100%)
+        .itvl_max = 0x0500,           // 800ms intervalo (0.625%)
+        .pasos = BLE_SCANNER_THERMAL_STEPS,
+        .histeresis = BLE_SCANNER_THERMAL_HYSTERESIS_DECI_C / 10.0f,
+        .permanencia_min_ms = BLE_SCANNER_THERMAL_MIN_DWELL_MS,
+        .max_reinicios_hora = BLE_SCANNER_THERMAL_MAX_RESTARTS_HOUR,
+    };
+    ble_thermal_governor_init(&s_gobernador, &cfg, esp_timer_get_time() / 1000);
+    actualizar_parametros_gap_s3();
+}
+
+/**
+ * Traducir el nivel del gobernador a parámetros de GAP
+ */
+static void actualizar_parametros_gap_s3(void)
+{
+    uint16_t itvl = ble_thermal_governor_intervalo(&s_gobernador);
+    float duty = ble_thermal_governor_duty(&s_gobernador);
+
+    s_scan_params.passive = (s_gobernador.paso == 0) ? s_config.passive : true;
+    s_scan_params.itvl = itvl;
+    s_scan_params.window = s_gobernador.cfg.ventana;
+    // Con duty alto no filtrar duplicados para máxima detección
+    s_scan_params.filter_duplicates = duty < 50.0f;
 }
 
 /**
- * Determinar estado de presencia con lógica optimizada
+ * Estado de presencia agregado de todos los objetivos en uso
  */
 static ble_presence_state_t determinar_estado_presencia_s3(void)
 {
-    int64_t now = esp_timer_get_time() / 1000;
-    int64_t tiempo_sin_deteccion = now - s_ultima_deteccion_cualquiera;
-    
-    // Verificar detecciones recientes
-    bool hay_detecciones_recientes = false;
+    bool hay_presente = false, hay_transicion = false, hay_desconocido = false, hay_ausente = false;
+
     portENTER_CRITICAL(&s_ble_mux);
     for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
-        if (s_targets[i].en_uso && s_targets[i].detectado) {
-            hay_detecciones_recientes = true;
-            break;
+        if (!s_targets[i].en_uso) {
+            continue;
+        }
+        const ble_presencia_objetivo_t *p = &s_presencia[i];
+        if (p->estado == BLE_PRESENCE_PRESENT) {
+            hay_presente = true;
+        } else if (p->detecciones_ventana > 0) {
+            hay_transicion = true;
+        } else if (p->estado == BLE_PRESENCE_ABSENT) {
+            hay_ausente = true;
+        } else {
+            hay_desconocido = true;
         }
     }
     portEXIT_CRITICAL(&s_ble_mux);
-    
-    if (hay_detecciones_recientes) {
-        s_ciclos_consecutivos_con_deteccion++;
-        s_ciclos_consecutivos_sin_deteccion = 0;
-        
-        // Confirmar presencia después de algunas detecciones
-        if (s_ciclos_consecutivos_con_deteccion >= 3) {
-            return BLE_PRESENCE_PRESENT;
-        } else {
-            return BLE_PRESENCE_TRANSITIONING;
+
+    if (hay_presente) {
+        return BLE_PRESENCE_PRESENT;
+    } else if (hay_transicion) {
+        return BLE_PRESENCE_TRANSITIONING;
+    } else if (hay_desconocido || !hay_ausente) {
+        return BLE_PRESENCE_UNKNOWN;
+    }
+    return BLE_PRESENCE_ABSENT;
+}
+
+/**
+ * Reinicia el estado de presencia de un objetivo (llamar con s_ble_mux tomado)
+ */
+static void reiniciar_presencia_objetivo(uint16_t target_idx, int64_t now)
+{
+    ble_presencia_objetivo_t *p = &s_presencia[target_idx];
+    p->estado = BLE_PRESENCE_UNKNOWN;
+    p->detecciones_ventana = 0;
+    p->inicio_ventana = 0;
+    p->ultima_deteccion = now;  // El plazo de ausencia cuenta desde la configuración
+}
+
+/**
+ * Publica una transición a los suscriptores y actualiza el estado agregado
+ */
+static void notificar_presencia(uint16_t target_idx, ble_presence_state_t estado, int64_t timestamp)
+{
+    ble_presencia_suscriptor_t suscriptores[BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS];
+
+    portENTER_CRITICAL(&s_ble_mux);
+    memcpy(suscriptores, s_suscriptores, sizeof(suscriptores));
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    ble_presence_state_t global = determinar_estado_presencia_s3();
+    if (global != s_estado_presencia) {
+        ESP_LOGI(TAG, "👤 Presencia global: %d -> %d", s_estado_presencia, global);
+        s_estado_presencia = global;
+    }
+
+    ESP_LOGI(TAG, "👤 Objetivo #%d %s", target_idx,
+             estado == BLE_PRESENCE_PRESENT ? "PRESENTE" : "AUSENTE");
+
+    for (int i = 0; i < BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS; i++) {
+        if (suscriptores[i].cb != NULL) {
+            suscriptores[i].cb(target_idx, estado, timestamp, suscriptores[i].arg);
+        } else if (suscriptores[i].tarea != NULL) {
+            xTaskNotify(suscriptores[i].tarea, suscriptores[i].bits, eSetBits);
         }
-    } else {
-        s_ciclos_consecutivos_sin_deteccion++;
-        s_ciclos_consecutivos_con_deteccion = 0;
-        
-        // Confirmar ausencia
-        if (tiempo_sin_deteccion > 45000) { // 45 segundos
-            if (s_ciclos_consecutivos_sin_deteccion >= 15) { // ~3 segundos sin detección
-                return BLE_PRESENCE_ABSENT;
-            } else {
-                return BLE_PRESENCE_TRANSITIONING;
+    }
+}
+
+/**
+ * Notifica a las tareas suscritas a detecciones que hay detecciones nuevas
+ */
+static void notificar_suscriptores_deteccion(void)
+{
+    ble_presencia_suscriptor_t suscriptores[BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS];
+
+    portENTER_CRITICAL(&s_ble_mux);
+    memcpy(suscriptores, s_suscriptores_deteccion, sizeof(suscriptores));
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    for (int i = 0; i < BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS; i++) {
+        if (suscriptores[i].tarea != NULL) {
+            xTaskNotify(suscriptores[i].tarea, suscriptores[i].bits, eSetBits);
+        }
+    }
+}
+
+/**
+ * Histéresis de entrada: N detecciones dentro de la ventana confirman presencia
+ */
+static void procesar_deteccion_presencia(const detection_info_t *info)
+{
+    if (info->target_idx >= BLE_SCANNER_MAX_TARGET_DEVICES) {
+        return;
+    }
+
+    bool entra = false;
+
+    portENTER_CRITICAL(&s_ble_mux);
+    ble_presencia_objetivo_t *p = &s_presencia[info->target_idx];
+    p->ultima_deteccion = info->timestamp;
+    if (p->estado != BLE_PRESENCE_PRESENT) {
+        if (p->detecciones_ventana == 0 ||
+            (info->timestamp - p->inicio_ventana) > s_presencia_ventana_entrada_ms) {
+            p->detecciones_ventana = 0;
+            p->inicio_ventana = info->timestamp;
+        }
+        p->detecciones_ventana++;
+        if (p->detecciones_ventana >= s_presencia_detecciones_entrada) {
+            p->estado = BLE_PRESENCE_PRESENT;
+            p->detecciones_ventana = 0;
+            entra = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (entra) {
+        notificar_presencia(info->target_idx, BLE_PRESENCE_PRESENT, info->timestamp);
+    }
+}
+
+/**
+ * Histéresis de salida: marca AUSENTE a los objetivos cuyo timeout venció y
+ * devuelve cuánto puede dormir detection_task hasta el siguiente vencimiento
+ */
+static TickType_t evaluar_salidas_presencia(int64_t now)
+{
+    int64_t proximo_ms = -1;
+
+    for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+        bool sale = false;
+
+        portENTER_CRITICAL(&s_ble_mux);
+        ble_presencia_objetivo_t *p = &s_presencia[i];
+        if (s_targets[i].en_uso && p->estado != BLE_PRESENCE_ABSENT) {
+            uint32_t timeout = p->timeout_salida_ms ? p->timeout_salida_ms : s_presencia_timeout_salida_ms;
+            int64_t restante = p->ultima_deteccion + timeout - now;
+            if (restante <= 0) {
+                p->estado = BLE_PRESENCE_ABSENT;
+                p->detecciones_ventana = 0;
+                sale = true;
+            } else if (proximo_ms < 0 || restante < proximo_ms) {
+                proximo_ms = restante;
             }
         }
+        portEXIT_CRITICAL(&s_ble_mux);
+
+        if (sale) {
+            notificar_presencia(i, BLE_PRESENCE_ABSENT, now);
+        }
     }
-    
-    return s_estado_presencia; // Mantener estado actual
+
+    return (proximo_ms < 0) ? portMAX_DELAY : pdMS_TO_TICKS(proximo_ms) + 1;
 }
 
 /**
@@ -326,22 +638,14 @@ static ble_thermal_mode_t determinar_modo_termico_s3(void)
         return BLE_THERMAL_MODE_ECO;
     }
     
-    // **OPTIMIZACIÓN MEJORADA: Control más granular para cuadros eléctricos**
-    // Considerar la velocidad de subida de temperatura
-    static float temp_previa = 25.0f;
-    float velocidad_subida = s_temperatura_actual - temp_previa;
-    temp_previa = s_temperatura_actual;
-    
-    // Si sube muy rápido, ser más agresivo preventivamente
-    bool subida_rapida = velocidad_subida > 1.0f; // >1°C por ciclo de monitoreo
-    
+    // Solo etiqueta para informes: los parámetros de GAP los calcula el gobernador
     if (s_temperatura_actual >= s_temp_emergency) {        // 85°C+
         return BLE_THERMAL_MODE_EMERGENCY;  // 0.625% duty cycle
     } else if (s_temperatura_actual >= s_temp_critical) {  // 75°C+
         return BLE_THERMAL_MODE_CRITICAL;   // 6.25% duty cycle
     } else if (s_temperatura_actual >= s_temp_warning) {   // 65°C+
         return BLE_THERMAL_MODE_WARNING;    // 25% duty cycle
-    } else if (s_temperatura_actual >= s_temp_eco || subida_rapida) { // 55°C+ O subida rápida
+    } else if (s_temperatura_actual >= s_temp_eco) {       // 55°C+
         return BLE_THERMAL_MODE_ECO;        // 50% duty cycle
     } else {
         return BLE_THERMAL_MODE_NORMAL;     // 100% duty cycle
@@ -361,6 +665,7 @@ static void temp_monitor_task_s3(void *param)
     float last_reported_temp = -100.0f;
     TickType_t last_mqtt_report = 0;
     const TickType_t mqtt_interval = pdMS_TO_TICKS(90000); // 1.5 minutos
+    const TickType_t mqtt_intervalo_emergencia = pdMS_TO_TICKS(30000);
     
     // **MEJORA: Contador de tiempo en emergencia para estadísticas**
     uint32_t tiempo_total_emergencia = 0;
@@ -368,15 +673,17 @@ static void temp_monitor_task_s3(void *param)
 
     ESP_LOGI(TAG, "temp_monitor_task watermark=%u",
              uxTaskGetStackHighWaterMark(NULL));
-    
-    configurar_parametros_escaneo_s3();
 
     // Topic MQTT
     char temp_topic[80];
     const char *mac_clean = sta_wifi_get_mac_clean();
+#if BLE_TELEMETRIA_CBOR
+    snprintf(temp_topic, sizeof(temp_topic), "dispositivos/%s/termico_ausente" BLE_TELEMETRIA_SUFIJO_CBOR, mac_clean);
+#else
     snprintf(temp_topic, sizeof(temp_topic), "dispositivos/%s/termico_ausente", mac_clean);
+#endif
 
-    while (1) {
+    while (!s_tareas_salir) {
         uint32_t intervalo_actual = s_config.intervalo_monitoreo_ms;
         
         // Leer y filtrar temperatura
@@ -408,10 +715,16 @@ static void temp_monitor_task_s3(void *param)
             ESP_LOGI(TAG, "❄️ Enfriamiento forzado completado");
         }
         
-        // Determinar y aplicar modo térmico
+        // Etiqueta de modo y ajuste continuo de duty cycle
         ble_thermal_mode_t nuevo_modo = determinar_modo_termico_s3();
-        if (s_control_termico_activo && nuevo_modo != s_modo_termico) {
-            aplicar_modo_termico_s3(nuevo_modo);
+        if (nuevo_modo != s_modo_termico) {
+            const char* modos[] = {"NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"};
+            ESP_LOGI(TAG, "🌡️ Modo térmico AUSENTE: %s -> %s (%.1f°C)",
+                     modos[s_modo_termico], modos[nuevo_modo], s_temperatura_actual);
+            s_modo_termico = nuevo_modo;
+        }
+        if (s_control_termico_activo) {
+            aplicar_gobernador_termico_s3();
         }
         
         // Contar tiempo en modo crítico
@@ -441,35 +754,66 @@ static void temp_monitor_task_s3(void *param)
         TickType_t now_tick = xTaskGetTickCount();
         bool cambio_significativo = fabsf(s_temperatura_actual - last_reported_temp) >= 2.0f;
         bool es_momento_reporte = (now_tick - last_mqtt_report) >= mqtt_interval;
-        bool reportar_emergencia = condicion_critica && ((now_tick / pdMS_TO_TICKS(30000)) % 1 == 0); // Cada 30s en emergencia
+        // En emergencia el bucle va cada 25 ms: reporte cada 30 s, no en cada vuelta (va al outbox sin conexión)
+        bool reportar_emergencia = condicion_critica && (now_tick - last_mqtt_report) >= mqtt_intervalo_emergencia;
         
         if (cambio_significativo || es_momento_reporte || reportar_emergencia) {
-            const char* modos[] = {"NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"};
-            
             // Calcular duty cycle actual
-            struct ble_gap_disc_params *params = &s_scan_params[s_modo_termico];
-            float duty_actual = (float)(params->window * 100) / params->itvl;
+            struct ble_gap_disc_params *params = &s_scan_params;
+            float duty_actual = ble_thermal_governor_duty(&s_gobernador);
             
             // Determinar estado del cuadro eléctrico
-            const char* estado_cuadro = "NORMAL";
+            ble_telemetria_cuadro_t cuadro = BLE_TELEMETRIA_CUADRO_NORMAL;
             if (s_temperatura_actual >= s_temp_emergency) {
-                estado_cuadro = "SOBRECALENTADO";
+                cuadro = BLE_TELEMETRIA_CUADRO_SOBRECALENTADO;
             } else if (s_temperatura_actual >= s_temp_critical) {
-                estado_cuadro = "CALIENTE";
+                cuadro = BLE_TELEMETRIA_CUADRO_CALIENTE;
             } else if (s_temperatura_actual >= s_temp_warning) {
-                estado_cuadro = "TIBIO";
+                cuadro = BLE_TELEMETRIA_CUADRO_TIBIO;
             }
             
-            char json[350];
-            snprintf(json, sizeof(json),
-                    "{\"temp\":%.1f,\"modo_termico\":\"%s\",\"duty_cycle\":\"%.1f%%\",\"temp_max\":%.1f,"
-                    "\"detecciones\":%lu,\"tiempo_critico\":%lu,\"tiempo_emergencia\":%lu,"
-                    "\"trabajo\":\"INTENSIVO_AUSENTE\",\"estado_cuadro\":\"%s\",\"intervalo_escaneo\":%dms}",
-                    s_temperatura_actual, modos[s_modo_termico], duty_actual, s_temp_maxima,
-                    s_detecciones_globales, s_tiempo_critico_total, tiempo_total_emergencia / 1000,
-                    estado_cuadro, (params->itvl * 625) / 1000);
-            
-            mqtt_service_enviar_dato(temp_topic, json, 1, 0);
+#if BLE_TELEMETRIA_CBOR
+            uint8_t cbor[64];
+            cbor_writer_t w;
+            cbor_writer_init(&w, cbor, sizeof(cbor));
+            cbor_writer_mapa(&w, 1 + BLE_TELEMETRIA_TERMICO_NUM_CAMPOS);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_CLAVE_ESQUEMA), BLE_TELEMETRIA_ESQUEMA_TERMICO);
+            cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TEMP_DC), lroundf(s_temperatura_actual * 10.0f));
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_MODO), s_modo_termico);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_DUTY_PM), lroundf(duty_actual * 10.0f));
+            cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TEMP_MAX_DC), lroundf(s_temp_maxima * 10.0f));
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_DETECCIONES), s_detecciones_globales);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TIEMPO_CRITICO_S), s_tiempo_critico_total);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TIEMPO_EMERGENCIA_S), tiempo_total_emergencia / 1000);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_ESTADO_CUADRO), cuadro);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_INTERVALO_ESCANEO_MS), (params->itvl * 625) / 1000);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_REINICIOS_GAP), s_gobernador.reinicios);
+            cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_CAMBIOS_SUPRIMIDOS), s_gobernador.cambios_suprimidos);
+            mqtt_service_enviar_cbor_writer(temp_topic, &w, 1, 0);
+#else
+            const char* modos[] = {"NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"};
+            const char *cuadros[] = {"NORMAL", "TIBIO", "CALIENTE", "SOBRECALENTADO"};
+            char duty_str[16];
+            snprintf(duty_str, sizeof(duty_str), "%.1f%%", duty_actual);
+
+            char json[400];
+            json_writer_t w;
+            json_writer_init(&w, json, sizeof(json));
+            json_writer_objeto(&w, NULL);
+            json_writer_float(&w, "temp", s_temperatura_actual, 1);
+            json_writer_str(&w, "modo_termico", modos[s_modo_termico]);
+            json_writer_str(&w, "duty_cycle", duty_str);
+            json_writer_float(&w, "temp_max", s_temp_maxima, 1);
+            json_writer_uint(&w, "detecciones", s_detecciones_globales);
+            json_writer_uint(&w, "tiempo_critico", s_tiempo_critico_total);
+            json_writer_uint(&w, "tiempo_emergencia", tiempo_total_emergencia / 1000);
+            json_writer_str(&w, "trabajo", "INTENSIVO_AUSENTE");
+            json_writer_str(&w, "estado_cuadro", cuadros[cuadro]);
+            json_writer_uint(&w, "intervalo_escaneo", (params->itvl * 625) / 1000);
+            json_writer_uint(&w, "reinicios_gap", s_gobernador.reinicios);
+            json_writer_uint(&w, "cambios_suprimidos", s_gobernador.cambios_suprimidos);
+            mqtt_service_enviar_json_writer(temp_topic, &w, 1, 0);
+#endif
             last_reported_temp = s_temperatura_actual;
             last_mqtt_report = now_tick;
         }
@@ -489,82 +833,74 @@ static void temp_monitor_task_s3(void *param)
         
         vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(intervalo_actual));
     }
+
+    ESP_LOGI(TAG, "Monitor térmico detenido");
+    xSemaphoreGive(s_temp_terminada);
+    vTaskDelete(NULL);
 }
 
 /**
- * Aplicar cambios según modo térmico (optimizado para ausencia)
+ * Evaluar el gobernador y reiniciar el escaneo solo si cambia de nivel
  */
-static void aplicar_modo_termico_s3(ble_thermal_mode_t nuevo_modo)
+static void aplicar_gobernador_termico_s3(void)
 {
-    if (!s_inicializado || !s_control_termico_activo) {
+    if (!s_inicializado) {
         return;
     }
-    
-    const char* modos[] = {"NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"};
-    
-    // Calcular duty cycle real
-    struct ble_gap_disc_params *params = &s_scan_params[nuevo_modo];
-    float duty = (float)(params->window * 100) / params->itvl;
-    
-    ESP_LOGI(TAG, "🌡️ Modo térmico AUSENTE: %s -> %s (%.1f°C) Duty: %.1f%% Int: %dms",
-             modos[s_modo_termico], modos[nuevo_modo], s_temperatura_actual, 
-             duty, (params->itvl * 625) / 1000);
-    
-    s_modo_termico = nuevo_modo;
-    
+
+    // El enfriamiento forzado impone un nivel, no una temperatura: duty de ENFRIAMIENTO_FORZADO_DUTY como máximo
+    uint8_t minimo = s_enfriamiento_forzado
+                         ? ble_thermal_governor_paso_para_duty(&s_gobernador, ENFRIAMIENTO_FORZADO_DUTY)
+                         : 0;
+    ble_thermal_governor_fijar_minimo(&s_gobernador, minimo);
+
+    if (!ble_thermal_governor_actualizar(&s_gobernador, s_temperatura_actual, esp_timer_get_time() / 1000)) {
+        return;
+    }
+
+    actualizar_parametros_gap_s3();
+    ESP_LOGI(TAG, "🌡️ Gobernador térmico: nivel %d/%d (%.1f°C) Duty: %.1f%% Int: %dms",
+             s_gobernador.paso, s_gobernador.cfg.pasos - 1, s_temperatura_actual,
+             ble_thermal_governor_duty(&s_gobernador), (s_scan_params.itvl * 625) / 1000);
+
     // Reiniciar escaneo con nuevos parámetros si está activo
     if (s_escaneo_activo) {
         ble_scanner_detener();
         // En modo ausente, SIEMPRE mantener escaneo activo, incluso en emergencia
         // porque estado_automatico depende de las detecciones
-        iniciar_escaneo_con_modo_s3(nuevo_modo);
-        
-        // Log adicional para debugging
-        if (nuevo_modo >= BLE_THERMAL_MODE_CRITICAL) {
-            ESP_LOGW(TAG, "⚠️ BLE en modo térmico crítico pero manteniendo escaneo para detección");
-        }
+        iniciar_escaneo_s3();
     }
 }
 
 /**
- * Iniciar escaneo con modo térmico específico
+ * Iniciar escaneo con los parámetros actuales del gobernador
  */
-static esp_err_t iniciar_escaneo_con_modo_s3(ble_thermal_mode_t modo)
+static esp_err_t iniciar_escaneo_s3(void)
 {
     if (!s_inicializado) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    struct ble_gap_disc_params *params = &s_scan_params[modo];
-    
     int duration_ticks = BLE_HS_FOREVER;
     if (s_config.duration_ms > 0) {
         duration_ticks = s_config.duration_ms / 10;
     }
     
-    int rc = ble_gap_disc(BLE_OWN_ADDR_PUBLIC, duration_ticks, params, ble_app_scan_cb_s3, NULL);
+    int rc = ble_gap_disc(BLE_OWN_ADDR_PUBLIC, duration_ticks, &s_scan_params, ble_app_scan_cb_s3, NULL);
     
     if (rc != 0) {
-        ESP_LOGE(TAG, "❌ Error iniciando escaneo modo %d: %d", modo, rc);
+        ESP_LOGE(TAG, "❌ Error iniciando escaneo nivel %d: %d", s_gobernador.paso, rc);
         return ESP_FAIL;
     }
     
     s_escaneo_activo = true;
-    float duty = (float)(params->window * 100) / params->itvl;
-    ESP_LOGI(TAG, "🔄 Escaneo iniciado: Modo %d, Duty %.1f%%, Int %dms", 
-             modo, duty, (params->itvl * 625) / 1000);
+    boot_trace_marcar(BOOT_TRACE_PRIMER_ESCANEO);
+    ESP_LOGI(TAG, "🔄 Escaneo iniciado: Nivel %d, Duty %.1f%%, Int %dms", 
+             s_gobernador.paso, ble_thermal_governor_duty(&s_gobernador), (s_scan_params.itvl * 625) / 1000);
     
     return ESP_OK;
 }
 
-/**
- * Iniciar escaneo con modo térmico actual
- */
-static esp_err_t iniciar_escaneo_s3(void)
-{
-    return iniciar_escaneo_con_modo_s3(s_modo_termico);
-}
-
 // Callback sincronización host
 static void on_ble_host_sync(void)
 {
@@ -614,19 +950,25 @@ esp_err_t ble_scanner_iniciar(const ble_scanner_config_t *config)
         s_control_termico_activo = false;
     }
 
-    // Crear cola de detecciones
-    s_detection_queue = xQueueCreate(20, sizeof(detection_info_t));
-    if (!s_detection_queue) {
-        ESP_LOGE(TAG, "❌ Error creando cola de detecciones");
-        return ESP_ERR_NO_MEM;
+    // Confirmaciones de salida de las tareas (una salida anterior ya se esperó)
+    if (s_detection_terminada == NULL) {
+        s_detection_terminada = xSemaphoreCreateBinaryStatic(&s_detection_terminada_buffer);
+        s_temp_terminada = xSemaphoreCreateBinaryStatic(&s_temp_terminada_buffer);
     }
+    xSemaphoreTake(s_detection_terminada, 0);
+    xSemaphoreTake(s_temp_terminada, 0);
+    s_tareas_salir = false;
+
+    // Preparar anillo de detecciones y parámetros de escaneo iniciales
+    ble_detection_ring_reset(&s_detection_ring);
+    configurar_parametros_escaneo_s3();
 
     // Crear tarea de procesamiento de detecciones
     // detection_task uses <1k words; reduce stack from 4096 to 2048 words
-    BaseType_t res = xTaskCreate(detection_task, "ble_detect_s3", 2048, NULL, 6, NULL);
+    BaseType_t res = xTaskCreate(detection_task, "ble_detect_s3", 2048, NULL, 6, &s_detection_task_handle);
     if (res != pdPASS) {
         ESP_LOGE(TAG, "❌ Error creando tarea de detección");
-        vQueueDelete(s_detection_queue);
+        s_detection_task_handle = NULL;
         return ESP_FAIL;
     }
 
@@ -670,22 +1012,32 @@ esp_err_t ble_scanner_deinicializar(void)
 
     ble_scanner_detener();
 
+    // Pedir la salida a las dos tareas y esperar a que terminen lo que estén publicando
+    s_tareas_salir = true;
+    if (s_detection_task_handle) {
+        // Sin handle nadie más la notifica después de que salga
+        TaskHandle_t tarea = s_detection_task_handle;
+        s_detection_task_handle = NULL;
+        xTaskNotifyGive(tarea);
+        if (xSemaphoreTake(s_detection_terminada, pdMS_TO_TICKS(TAREA_TIMEOUT_SALIDA_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "detection_task no confirmó su salida en %d ms", TAREA_TIMEOUT_SALIDA_MS);
+        }
+    }
     if (s_temp_task_handle) {
-        vTaskDelete(s_temp_task_handle);
+        // Vuelve a mirar la petición en cada ciclo de monitoreo (200 ms como mucho)
+        if (xSemaphoreTake(s_temp_terminada, pdMS_TO_TICKS(TAREA_TIMEOUT_SALIDA_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "temp_monitor_task no confirmó su salida en %d ms", TAREA_TIMEOUT_SALIDA_MS);
+        }
         s_temp_task_handle = NULL;
     }
-    
+
+    // El sensor se libera después: el monitor lo lee hasta salir
     if (s_temp_sensor) {
         temperature_sensor_disable(s_temp_sensor);
         temperature_sensor_uninstall(s_temp_sensor);
         s_temp_sensor = NULL;
     }
 
-    if (s_detection_queue) {
-        vQueueDelete(s_detection_queue);
-        s_detection_queue = NULL;
-    }
-
     nimble_port_stop();
     nimble_port_deinit();
     s_inicializado = false;
@@ -720,36 +1072,73 @@ esp_err_t ble_scanner_reiniciar(void)
     return iniciar_escaneo_s3();
 }
 
-bool ble_scanner_tag_detectado(uint8_t mac_index)
+bool ble_scanner_tag_detectado(uint16_t mac_index)
 {
     if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !s_targets[mac_index].en_uso) {
         return false;
     }
 
-    bool detectado;
-    portENTER_CRITICAL(&s_ble_mux);
-    detectado = s_targets[mac_index].detectado;
-    s_targets[mac_index].detectado = false;
-    portEXIT_CRITICAL(&s_ble_mux);
-
-    return detectado;
+    // Leer y limpiar en una sola operación atómica
+    return __atomic_exchange_n(&s_targets[mac_index].detectado, false, __ATOMIC_ACQ_REL);
 }
 
 bool ble_scanner_cualquier_tag_detectado(void)
 {
-    bool detectado = false;
-    portENTER_CRITICAL(&s_ble_mux);
     for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
-        if (s_targets[i].en_uso && s_targets[i].detectado) {
-            detectado = true;
-            break;
+        if (s_targets[i].en_uso && __atomic_load_n(&s_targets[i].detectado, __ATOMIC_ACQUIRE)) {
+            return true;
         }
     }
-    portEXIT_CRITICAL(&s_ble_mux);
-    return detectado;
+    return false;
 }
 
-esp_err_t ble_scanner_configurar_mac_objetivo(uint8_t mac_index, const uint8_t *mac)
+ble_proximity_zone_t ble_scanner_obtener_zona(uint16_t mac_index)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !s_targets[mac_index].en_uso) {
+        return BLE_PROXIMITY_UNKNOWN;
+    }
+
+    // Una zona sin anuncios recientes ya no es fiable
+    const ble_scanner_target_t *target = &s_targets[mac_index];
+    int64_t now = esp_timer_get_time() / 1000;
+    if (now - target->ultima_deteccion > RSSI_REINICIO_FILTRO_MS) {
+        return BLE_PROXIMITY_UNKNOWN;
+    }
+    return target->rssi.zona;
+}
+
+bool ble_scanner_tag_cerca(uint16_t mac_index)
+{
+    return ble_scanner_obtener_zona(mac_index) == BLE_PROXIMITY_NEAR;
+}
+
+esp_err_t ble_scanner_obtener_rssi_filtrado(uint16_t mac_index, int8_t *rssi)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !rssi) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_targets[mac_index].en_uso || !s_targets[mac_index].rssi.inicializado) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *rssi = ble_rssi_filter_valor(&s_targets[mac_index].rssi);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_configurar_zonas(int8_t umbral_cerca, int8_t umbral_lejos)
+{
+    if (umbral_cerca <= umbral_lejos) {
+        ESP_LOGE(TAG, "❌ Umbral de cerca (%d) debe ser mayor que el de lejos (%d)", umbral_cerca, umbral_lejos);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_umbral_lejos = umbral_lejos;
+    s_umbral_cerca = umbral_cerca;
+    ESP_LOGI(TAG, "📶 Zonas RSSI: cerca>=%ddBm, lejos<%ddBm", umbral_cerca, umbral_lejos);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_configurar_mac_objetivo(uint16_t mac_index, const uint8_t *mac)
 {
     if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !mac) {
         return ESP_ERR_INVALID_ARG;
@@ -760,14 +1149,23 @@ esp_err_t ble_scanner_configurar_mac_objetivo(uint8_t mac_index, const uint8_t *
         s_targets[mac_index].mac[i] = mac[5 - i];
     }
 
+    int64_t now = esp_timer_get_time() / 1000;
     portENTER_CRITICAL(&s_ble_mux);
     s_targets[mac_index].en_uso = true;
+    s_targets[mac_index].tiene_mac = true;
     s_targets[mac_index].detectado = false;
     s_targets[mac_index].detecciones_totales = 0;
     s_targets[mac_index].ultima_deteccion = 0;
+    ble_rssi_filter_reset(&s_targets[mac_index].rssi);
+    reiniciar_presencia_objetivo(mac_index, now);
     portEXIT_CRITICAL(&s_ble_mux);
 
-    crear_mac_hash(mac_index);
+    reconstruir_indice_objetivos();
+
+    // Despertar al motor de presencia para recalcular el próximo vencimiento
+    if (s_detection_task_handle != NULL) {
+        xTaskNotifyGive(s_detection_task_handle);
+    }
 
     ESP_LOGI(TAG, "🎯 MAC #%d configurada: %02X:%02X:%02X:%02X:%02X:%02X",
              mac_index, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
@@ -775,7 +1173,7 @@ esp_err_t ble_scanner_configurar_mac_objetivo(uint8_t mac_index, const uint8_t *
     return ESP_OK;
 }
 
-esp_err_t ble_scanner_configurar_mac_objetivo_texto(uint8_t mac_index, const char *mac_str)
+esp_err_t ble_scanner_configurar_mac_objetivo_texto(uint16_t mac_index, const char *mac_str)
 {
     if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !mac_str) {
         return ESP_ERR_INVALID_ARG;
@@ -808,12 +1206,162 @@ esp_err_t ble_scanner_limpiar_macs_objetivo(void)
 {
     portENTER_CRITICAL(&s_ble_mux);
     memset(s_targets, 0, sizeof(s_targets));
+    for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+        reiniciar_presencia_objetivo(i, 0);
+    }
+    s_estado_presencia = BLE_PRESENCE_UNKNOWN;
     portEXIT_CRITICAL(&s_ble_mux);
 
+    reconstruir_indice_objetivos();
+
+    if (s_rpa_mutex != NULL) {
+        xSemaphoreTake(s_rpa_mutex, portMAX_DELAY);
+        ble_rpa_resolver_liberar(&s_rpa);
+        xSemaphoreGive(s_rpa_mutex);
+    }
+
+    s_num_reglas_anuncio = 0;
+    recompilar_reglas_anuncio();
+
     ESP_LOGI(TAG, "🧹 MACs objetivo limpiadas");
     return ESP_OK;
 }
 
+esp_err_t ble_scanner_configurar_irk_objetivo(uint16_t mac_index, const uint8_t irk[16])
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !irk) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_rpa_mutex == NULL) {
+        s_rpa_mutex = xSemaphoreCreateMutexStatic(&s_rpa_mutex_buffer);
+    }
+
+    xSemaphoreTake(s_rpa_mutex, portMAX_DELAY);
+    esp_err_t ret = ble_rpa_resolver_agregar_irk(&s_rpa, mac_index, irk);
+    xSemaphoreGive(s_rpa_mutex);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ No se pudo registrar IRK para objetivo #%d: %s", mac_index, esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Un objetivo solo-IRK ocupa su índice aunque no tenga MAC fija
+    activar_objetivo_sin_mac(mac_index);
+
+    ESP_LOGI(TAG, "🔑 IRK configurado para objetivo #%d", mac_index);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_configurar_irk_objetivo_texto(uint16_t mac_index, const char *irk_hex)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !irk_hex) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (strlen(irk_hex) != 32) {
+        ESP_LOGE(TAG, "❌ Formato IRK inválido (se esperan 32 caracteres hex)");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t irk[16];
+    for (int i = 0; i < 16; i++) {
+        if (!isxdigit((unsigned char)irk_hex[i * 2]) || !isxdigit((unsigned char)irk_hex[i * 2 + 1])) {
+            ESP_LOGE(TAG, "❌ Formato IRK inválido");
+            return ESP_ERR_INVALID_ARG;
+        }
+        char byte_str[3] = {irk_hex[i * 2], irk_hex[i * 2 + 1], 0};
+        irk[i] = (uint8_t)strtol(byte_str, NULL, 16);
+    }
+
+    return ble_scanner_configurar_irk_objetivo(mac_index, irk);
+}
+
+/**
+ * Añade una regla a la lista fuente y recompila el matcher
+ */
+static esp_err_t agregar_regla_anuncio(const ble_adv_regla_t *regla)
+{
+    if (s_num_reglas_anuncio >= BLE_ADV_MAX_REGLAS) {
+        ESP_LOGE(TAG, "❌ Sin espacio para más reglas de anuncio (%d)", BLE_ADV_MAX_REGLAS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_reglas_anuncio[s_num_reglas_anuncio++] = *regla;
+    esp_err_t ret = recompilar_reglas_anuncio();
+    if (ret != ESP_OK) {
+        s_num_reglas_anuncio--;
+        return ret;
+    }
+
+    activar_objetivo_sin_mac(regla->target_idx);
+    ESP_LOGI(TAG, "📡 Regla de anuncio tipo %d añadida para objetivo #%d", regla->tipo, regla->target_idx);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_agregar_regla_ibeacon(uint16_t mac_index, const uint8_t uuid[16], int32_t major, int32_t minor)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !uuid || major > 0xFFFF || minor > 0xFFFF) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ble_adv_regla_t regla = { .tipo = BLE_ADV_REGLA_IBEACON, .target_idx = mac_index };
+    memcpy(regla.ibeacon.uuid, uuid, 16);
+    regla.ibeacon.major = major;
+    regla.ibeacon.minor = minor;
+    return agregar_regla_anuncio(&regla);
+}
+
+esp_err_t ble_scanner_agregar_regla_eddystone_uid(uint16_t mac_index, const uint8_t espacio[10], const uint8_t *instancia)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !espacio) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ble_adv_regla_t regla = { .tipo = BLE_ADV_REGLA_EDDYSTONE_UID, .target_idx = mac_index };
+    memcpy(regla.eddystone.espacio, espacio, 10);
+    if (instancia) {
+        memcpy(regla.eddystone.instancia, instancia, 6);
+    } else {
+        regla.eddystone.cualquier_instancia = true;
+    }
+    return agregar_regla_anuncio(&regla);
+}
+
+esp_err_t ble_scanner_agregar_regla_fabricante(uint16_t mac_index, uint16_t company_id,
+                                               const uint8_t *datos, const uint8_t *mascara, uint8_t longitud)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || longitud > BLE_ADV_MAX_DATOS_FABRICANTE ||
+        (longitud > 0 && !datos)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ble_adv_regla_t regla = { .tipo = BLE_ADV_REGLA_FABRICANTE, .target_idx = mac_index };
+    regla.fabricante.company_id = company_id;
+    regla.fabricante.longitud = longitud;
+    for (uint8_t i = 0; i < longitud; i++) {
+        regla.fabricante.datos[i] = datos[i];
+        regla.fabricante.mascara[i] = mascara ? mascara[i] : 0xFF;
+    }
+    return agregar_regla_anuncio(&regla);
+}
+
+esp_err_t ble_scanner_obtener_estadisticas_rpa(ble_scanner_estadisticas_rpa_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stats->consultas = s_rpa.consultas;
+    stats->aciertos_cache = s_rpa.aciertos_cache;
+    stats->resoluciones_aes = s_rpa.resoluciones_aes;
+    stats->direcciones_resueltas = s_rpa.resueltas;
+    stats->tasa_aciertos = (stats->consultas > 0) ?
+        (100.0f * stats->aciertos_cache) / stats->consultas : 0.0f;
+
+    return ESP_OK;
+}
+
 bool ble_scanner_esta_activo(void)
 {
     return s_escaneo_activo;
@@ -834,6 +1382,150 @@ ble_presence_state_t ble_scanner_obtener_estado_presencia(void)
     return s_estado_presencia;
 }
 
+ble_presence_state_t ble_scanner_obtener_estado_presencia_objetivo(uint16_t mac_index)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES || !s_targets[mac_index].en_uso) {
+        return BLE_PRESENCE_UNKNOWN;
+    }
+
+    portENTER_CRITICAL(&s_ble_mux);
+    ble_presence_state_t estado = s_presencia[mac_index].estado;
+    portEXIT_CRITICAL(&s_ble_mux);
+    return estado;
+}
+
+esp_err_t ble_scanner_configurar_presencia(uint8_t detecciones_entrada, uint32_t ventana_entrada_ms,
+                                           uint32_t timeout_salida_ms)
+{
+    if (detecciones_entrada == 0 || timeout_salida_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_ble_mux);
+    s_presencia_detecciones_entrada = detecciones_entrada;
+    s_presencia_ventana_entrada_ms = ventana_entrada_ms;
+    s_presencia_timeout_salida_ms = timeout_salida_ms;
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (s_detection_task_handle != NULL) {
+        xTaskNotifyGive(s_detection_task_handle);
+    }
+
+    ESP_LOGI(TAG, "👤 Presencia: entrada=%u detecciones/%lums, salida=%lums",
+             detecciones_entrada, ventana_entrada_ms, timeout_salida_ms);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_configurar_timeout_presencia(uint16_t mac_index, uint32_t timeout_salida_ms)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_ble_mux);
+    s_presencia[mac_index].timeout_salida_ms = timeout_salida_ms;
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (s_detection_task_handle != NULL) {
+        xTaskNotifyGive(s_detection_task_handle);
+    }
+    return ESP_OK;
+}
+
+/**
+ * Registra un suscriptor en la primera ranura libre
+ */
+static esp_err_t agregar_suscriptor_presencia(const ble_presencia_suscriptor_t *nuevo)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    portENTER_CRITICAL(&s_ble_mux);
+    for (int i = 0; i < BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS; i++) {
+        if (s_suscriptores[i].cb == NULL && s_suscriptores[i].tarea == NULL) {
+            s_suscriptores[i] = *nuevo;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Sin ranuras libres para suscriptores de presencia");
+    }
+    return ret;
+}
+
+esp_err_t ble_scanner_suscribir_presencia(ble_scanner_presencia_cb_t cb, void *arg)
+{
+    if (cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ble_presencia_suscriptor_t nuevo = { .cb = cb, .arg = arg };
+    return agregar_suscriptor_presencia(&nuevo);
+}
+
+esp_err_t ble_scanner_suscribir_presencia_tarea(TaskHandle_t tarea, uint32_t bits)
+{
+    if (tarea == NULL || bits == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ble_presencia_suscriptor_t nuevo = { .tarea = tarea, .bits = bits };
+    return agregar_suscriptor_presencia(&nuevo);
+}
+
+esp_err_t ble_scanner_suscribir_deteccion_tarea(TaskHandle_t tarea, uint32_t bits)
+{
+    if (tarea == NULL || bits == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_ble_mux);
+    for (int i = 0; i < BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS; i++) {
+        if (s_suscriptores_deteccion[i].tarea == NULL) {
+            s_suscriptores_deteccion[i].tarea = tarea;
+            s_suscriptores_deteccion[i].bits = bits;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Sin ranuras libres para suscriptores de detección");
+    }
+    return ret;
+}
+
+int64_t ble_scanner_obtener_ultima_deteccion_us(uint16_t mac_index)
+{
+    if (mac_index >= BLE_SCANNER_MAX_TARGET_DEVICES) {
+        return 0;
+    }
+    return s_targets[mac_index].ultima_deteccion_us;
+}
+
+esp_err_t ble_scanner_desuscribir_presencia(ble_scanner_presencia_cb_t cb, TaskHandle_t tarea)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL(&s_ble_mux);
+    for (int i = 0; i < BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS; i++) {
+        if ((cb != NULL && s_suscriptores[i].cb == cb) ||
+            (tarea != NULL && s_suscriptores[i].tarea == tarea)) {
+            memset(&s_suscriptores[i], 0, sizeof(s_suscriptores[i]));
+            ret = ESP_OK;
+        }
+        if (tarea != NULL && s_suscriptores_deteccion[i].tarea == tarea) {
+            memset(&s_suscriptores_deteccion[i], 0, sizeof(s_suscriptores_deteccion[i]));
+            ret = ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&s_ble_mux);
+
+    return ret;
+}
+
 esp_err_t ble_scanner_configurar_umbrales_temperatura(float temp_eco, float temp_warning, 
                                                      float temp_critical, float temp_emergency)
 {
@@ -846,6 +1538,8 @@ esp_err_t ble_scanner_configurar_umbrales_temperatura(float temp_eco, float temp
     s_temp_warning = temp_warning;
     s_temp_critical = temp_critical;
     s_temp_emergency = temp_emergency;
+    s_gobernador.cfg.temp_inicio = temp_eco;
+    s_gobernador.cfg.temp_fin = temp_emergency;
     
     ESP_LOGI(TAG, "🌡️ Umbrales actualizados: ECO=%.1f°C, WARN=%.1f°C, CRIT=%.1f°C, EMER=%.1f°C",
              s_temp_eco, s_temp_warning, s_temp_critical, s_temp_emergency);
@@ -871,9 +1565,9 @@ esp_err_t ble_scanner_forzar_enfriamiento(uint32_t duracion_ms)
     
     ESP_LOGI(TAG, "❄️ Enfriamiento forzado para trabajo ausente: %lums", duracion_ms);
     
-    // Aplicar inmediatamente modo ECO si está escaneando
-    if (s_escaneo_activo && s_modo_termico != BLE_THERMAL_MODE_ECO) {
-        aplicar_modo_termico_s3(BLE_THERMAL_MODE_ECO);
+    // Aplicar inmediatamente si está escaneando: subir al nivel forzado no espera permanencia
+    if (s_escaneo_activo && s_control_termico_activo) {
+        aplicar_gobernador_termico_s3();
     }
     
     return ESP_OK;
@@ -902,4 +1596,19 @@ esp_err_t ble_scanner_obtener_estadisticas(float *temp_promedio, float *temp_max
     *tiempo_critico_seg = s_tiempo_critico_total;
     
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t ble_scanner_obtener_estadisticas_deteccion(ble_scanner_estadisticas_deteccion_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stats->detecciones_totales = s_detecciones_globales;
+    stats->eventos_encolados = atomic_load(&s_detection_ring.encolados);
+    stats->eventos_descartados = atomic_load(&s_detection_ring.desbordamientos);
+    stats->ocupacion_maxima = atomic_load(&s_detection_ring.ocupacion_maxima);
+    stats->capacidad_cola = BLE_DETECTION_RING_SIZE;
+
+    return ESP_OK;
+}
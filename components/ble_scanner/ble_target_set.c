@@ -0,0 +1,112 @@
+// ble_target_set.c
+#include "ble_target_set.h"
+#include <string.h>
+#include "esp_attr.h"
+
+#define SLOT_MASK (BLE_TARGET_SET_SLOTS - 1)
+#define PREFILTER_MASK (BLE_TARGET_SET_PREFILTER_BITS - 1)
+
+/**
+ * Empaqueta la dirección de 48 bits en dos palabras
+ */
+static inline void empaquetar_direccion(const uint8_t addr[6], uint32_t *lo, uint16_t *hi)
+{
+    *lo = (uint32_t)addr[0] | ((uint32_t)addr[1] << 8) |
+          ((uint32_t)addr[2] << 16) | ((uint32_t)addr[3] << 24);
+    *hi = (uint16_t)(addr[4] | (addr[5] << 8));
+}
+
+/**
+ * Mezcla de 32 bits (finalizador de murmur3) sobre los 48 bits de la dirección.
+ * Todos los bytes influyen, así que fabricantes con el mismo OUI no colisionan.
+ */
+static inline uint32_t hash_direccion(uint32_t lo, uint16_t hi)
+{
+    uint32_t h = lo ^ ((uint32_t)hi * 0x9E3779B1u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline bool prefiltro_contiene(const ble_target_set_t *set, uint32_t h)
+{
+    uint32_t b1 = h & PREFILTER_MASK;
+    uint32_t b2 = (h >> 16) & PREFILTER_MASK;
+    return (set->prefiltro[b1 >> 5] & (1u << (b1 & 31))) &&
+           (set->prefiltro[b2 >> 5] & (1u << (b2 & 31)));
+}
+
+static inline void prefiltro_marcar(ble_target_set_t *set, uint32_t h)
+{
+    uint32_t b1 = h & PREFILTER_MASK;
+    uint32_t b2 = (h >> 16) & PREFILTER_MASK;
+    set->prefiltro[b1 >> 5] |= 1u << (b1 & 31);
+    set->prefiltro[b2 >> 5] |= 1u << (b2 & 31);
+}
+
+void ble_target_set_limpiar(ble_target_set_t *set)
+{
+    memset(set->prefiltro, 0, sizeof(set->prefiltro));
+    for (int i = 0; i < BLE_TARGET_SET_SLOTS; i++) {
+        set->slots[i].target_idx = -1;
+    }
+    set->num_entradas = 0;
+}
+
+esp_err_t ble_target_set_insertar(ble_target_set_t *set, const uint8_t addr[6], uint16_t target_idx)
+{
+    uint32_t lo;
+    uint16_t hi;
+    empaquetar_direccion(addr, &lo, &hi);
+    uint32_t h = hash_direccion(lo, hi);
+
+    // Sondeo lineal; si la dirección ya existe se actualiza el índice
+    for (uint32_t n = 0, pos = (h >> 8) & SLOT_MASK; n < BLE_TARGET_SET_SLOTS; n++, pos = (pos + 1) & SLOT_MASK) {
+        ble_target_slot_t *slot = &set->slots[pos];
+        if (slot->target_idx < 0) {
+            slot->addr_lo = lo;
+            slot->addr_hi = hi;
+            slot->target_idx = target_idx;
+            set->num_entradas++;
+            prefiltro_marcar(set, h);
+            return ESP_OK;
+        }
+        if (slot->addr_lo == lo && slot->addr_hi == hi) {
+            slot->target_idx = target_idx;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+IRAM_ATTR int ble_target_set_buscar(const ble_target_set_t *set, const uint8_t addr[6])
+{
+    if (set->num_entradas == 0) {
+        return -1;
+    }
+
+    uint32_t lo;
+    uint16_t hi;
+    empaquetar_direccion(addr, &lo, &hi);
+    uint32_t h = hash_direccion(lo, hi);
+
+    // Camino rápido: la mayoría de anuncios no son objetivo y se descartan aquí
+    if (!prefiltro_contiene(set, h)) {
+        return -1;
+    }
+
+    // La tabla se mantiene al 50% de ocupación como máximo, el sondeo es corto
+    for (uint32_t n = 0, pos = (h >> 8) & SLOT_MASK; n < BLE_TARGET_SET_SLOTS; n++, pos = (pos + 1) & SLOT_MASK) {
+        const ble_target_slot_t *slot = &set->slots[pos];
+        if (slot->target_idx < 0) {
+            return -1;
+        }
+        if (slot->addr_lo == lo && slot->addr_hi == hi) {
+            return slot->target_idx;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,122 @@
+// ble_thermal_governor.c
+#include "ble_thermal_governor.h"
+#include <math.h>
+#include <string.h>
+
+// Ráfaga permitida por el límite de reinicios, en número de reinicios
+#define RAFAGA_REINICIOS 3
+
+static uint32_t coste_reinicio_ms(const ble_thermal_governor_t *gov)
+{
+    return gov->cfg.max_reinicios_hora ? 3600000UL / gov->cfg.max_reinicios_hora : 0;
+}
+
+/**
+ * Nivel que corresponde a una temperatura (floor: el último nivel solo se
+ * alcanza en temp_fin)
+ */
+static uint8_t paso_para(const ble_thermal_governor_t *gov, float temperatura)
+{
+    float rango = gov->cfg.temp_fin - gov->cfg.temp_inicio;
+    float t = (rango > 0.0f) ? (temperatura - gov->cfg.temp_inicio) / rango : 0.0f;
+    if (t <= 0.0f) {
+        return 0;
+    }
+    if (t >= 1.0f) {
+        return gov->cfg.pasos - 1;
+    }
+    return (uint8_t)(t * (gov->cfg.pasos - 1));
+}
+
+void ble_thermal_governor_init(ble_thermal_governor_t *gov, const ble_thermal_governor_config_t *cfg, int64_t now_ms)
+{
+    memset(gov, 0, sizeof(*gov));
+    gov->cfg = *cfg;
+    if (gov->cfg.pasos < 2) {
+        gov->cfg.pasos = 2;
+    }
+    gov->ultimo_cambio_ms = now_ms;
+    gov->ultima_recarga_ms = now_ms;
+    gov->credito_ms = coste_reinicio_ms(gov) * RAFAGA_REINICIOS;
+}
+
+bool ble_thermal_governor_actualizar(ble_thermal_governor_t *gov, float temperatura, int64_t now_ms)
+{
+    uint32_t coste = coste_reinicio_ms(gov);
+    uint32_t capacidad = coste * RAFAGA_REINICIOS;
+
+    // Recargar el cubo de testigos con el tiempo transcurrido
+    int64_t transcurrido = now_ms - gov->ultima_recarga_ms;
+    gov->ultima_recarga_ms = now_ms;
+    if (transcurrido > 0) {
+        uint64_t credito = (uint64_t)gov->credito_ms + (uint64_t)transcurrido;
+        gov->credito_ms = (credito > capacidad) ? capacidad : (uint32_t)credito;
+    }
+
+    // Histéresis: subir exige superar el límite en h/2, bajar quedar h/2 por debajo
+    float media_banda = gov->cfg.histeresis / 2.0f;
+    uint8_t sube = paso_para(gov, temperatura - media_banda);
+    uint8_t baja = paso_para(gov, temperatura + media_banda);
+    uint8_t objetivo = gov->paso;
+    if (sube > gov->paso) {
+        objetivo = sube;
+    } else if (baja < gov->paso) {
+        objetivo = baja;
+    }
+    bool forzado = false;
+    if (objetivo < gov->paso_minimo) {
+        objetivo = gov->paso_minimo;
+        forzado = (objetivo > gov->paso);
+    }
+
+    if (objetivo == gov->paso) {
+        return false;
+    }
+
+    bool urgente = forzado || (objetivo == gov->cfg.pasos - 1);
+    bool en_permanencia = (now_ms - gov->ultimo_cambio_ms) < gov->cfg.permanencia_min_ms;
+    if (!urgente && (en_permanencia || gov->credito_ms < coste)) {
+        gov->cambios_suprimidos++;
+        return false;
+    }
+
+    gov->credito_ms = (gov->credito_ms >= coste) ? gov->credito_ms - coste : 0;
+    gov->paso = objetivo;
+    gov->ultimo_cambio_ms = now_ms;
+    gov->reinicios++;
+    return true;
+}
+
+void ble_thermal_governor_fijar_minimo(ble_thermal_governor_t *gov, uint8_t paso)
+{
+    gov->paso_minimo = (paso < gov->cfg.pasos) ? paso : gov->cfg.pasos - 1;
+}
+
+static uint16_t intervalo_de_paso(const ble_thermal_governor_t *gov, uint8_t paso)
+{
+    // Interpolación geométrica: cada nivel reduce el duty en la misma proporción
+    float fraccion = (float)paso / (float)(gov->cfg.pasos - 1);
+    float itvl = gov->cfg.itvl_min * powf((float)gov->cfg.itvl_max / gov->cfg.itvl_min, fraccion);
+    uint16_t intervalo = (uint16_t)(itvl + 0.5f);
+    return (intervalo < gov->cfg.ventana) ? gov->cfg.ventana : intervalo;
+}
+
+uint8_t ble_thermal_governor_paso_para_duty(const ble_thermal_governor_t *gov, float duty_max)
+{
+    for (uint8_t paso = 0; paso < gov->cfg.pasos - 1; paso++) {
+        if ((float)(gov->cfg.ventana * 100) / intervalo_de_paso(gov, paso) <= duty_max) {
+            return paso;
+        }
+    }
+    return gov->cfg.pasos - 1;
+}
+
+uint16_t ble_thermal_governor_intervalo(const ble_thermal_governor_t *gov)
+{
+    return intervalo_de_paso(gov, gov->paso);
+}
+
+float ble_thermal_governor_duty(const ble_thermal_governor_t *gov)
+{
+    return (float)(gov->cfg.ventana * 100) / ble_thermal_governor_intervalo(gov);
+}
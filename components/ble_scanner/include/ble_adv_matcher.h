@@ -0,0 +1,98 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Número máximo de reglas de contenido de anuncio
+ */
+#ifdef CONFIG_BLE_SCANNER_MAX_ADV_RULES
+#define BLE_ADV_MAX_REGLAS CONFIG_BLE_SCANNER_MAX_ADV_RULES
+#else
+#define BLE_ADV_MAX_REGLAS 8
+#endif
+
+#define BLE_ADV_MAX_DATOS_FABRICANTE 8    /**< Bytes comparables tras el company ID */
+#define BLE_ADV_BUCKETS              16   /**< Cubetas por tipo de regla (potencia de 2) */
+#define BLE_ADV_SIN_REGLA            0xFF
+
+/**
+ * @brief Tipo de regla de contenido
+ */
+typedef enum {
+    BLE_ADV_REGLA_IBEACON = 0,        /**< UUID + major/minor opcionales */
+    BLE_ADV_REGLA_EDDYSTONE_UID,      /**< Namespace + instancia opcional */
+    BLE_ADV_REGLA_FABRICANTE,         /**< Company ID + datos con máscara */
+    BLE_ADV_REGLA_NUM_TIPOS
+} ble_adv_regla_tipo_t;
+
+/**
+ * @brief Regla de contenido asociada a un objetivo
+ */
+typedef struct {
+    ble_adv_regla_tipo_t tipo;
+    uint16_t target_idx;
+    union {
+        struct {
+            uint8_t uuid[16];
+            int32_t major;            /**< -1 = cualquiera */
+            int32_t minor;            /**< -1 = cualquiera */
+        } ibeacon;
+        struct {
+            uint8_t espacio[10];
+            uint8_t instancia[6];
+            bool cualquier_instancia;
+        } eddystone;
+        struct {
+            uint16_t company_id;
+            uint8_t datos[BLE_ADV_MAX_DATOS_FABRICANTE];
+            uint8_t mascara[BLE_ADV_MAX_DATOS_FABRICANTE];
+            uint8_t longitud;         /**< Bytes de datos a comparar (0 = solo company ID) */
+        } fabricante;
+    };
+} ble_adv_regla_t;
+
+/**
+ * @brief Conjunto de reglas compilado a tablas de búsqueda
+ *
+ * Cada tipo de regla tiene su tabla de cubetas indexada por la clave estable
+ * (UUID, namespace o company ID); en cada cubeta las reglas se encadenan por
+ * índice, así un paquete solo se compara con las reglas de su cubeta.
+ */
+typedef struct {
+    ble_adv_regla_t reglas[BLE_ADV_MAX_REGLAS];
+    uint8_t siguiente[BLE_ADV_MAX_REGLAS];
+    uint8_t cabeza[BLE_ADV_REGLA_NUM_TIPOS][BLE_ADV_BUCKETS];
+    uint8_t num_reglas;
+} ble_adv_matcher_t;
+
+/**
+ * @brief Deja el conjunto sin reglas
+ */
+void ble_adv_matcher_limpiar(ble_adv_matcher_t *matcher);
+
+/**
+ * @brief Compila una lista de reglas sustituyendo el contenido anterior
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE si hay más de BLE_ADV_MAX_REGLAS
+ */
+esp_err_t ble_adv_matcher_compilar(ble_adv_matcher_t *matcher, const ble_adv_regla_t *reglas, size_t num_reglas);
+
+/**
+ * @brief Recorre las estructuras AD del anuncio sin copiarlas y busca una regla
+ *
+ * @param datos Buffer de anuncio de NimBLE (event->disc.data)
+ * @param longitud Longitud del buffer
+ * @return Índice del objetivo de la primera regla que coincide, o -1
+ */
+int ble_adv_matcher_buscar(const ble_adv_matcher_t *matcher, const uint8_t *datos, uint8_t longitud);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Capacidad del anillo de detecciones (potencia de 2)
+ */
+#ifdef CONFIG_BLE_SCANNER_DETECTION_RING_SIZE
+#define BLE_DETECTION_RING_SIZE CONFIG_BLE_SCANNER_DETECTION_RING_SIZE
+#else
+#define BLE_DETECTION_RING_SIZE 64
+#endif
+
+_Static_assert((BLE_DETECTION_RING_SIZE & (BLE_DETECTION_RING_SIZE - 1)) == 0,
+               "BLE_DETECTION_RING_SIZE debe ser potencia de 2");
+
+/**
+ * @brief Información de una detección, del callback de escaneo a detection_task
+ */
+typedef struct {
+    uint16_t target_idx;
+    int8_t rssi;
+    int64_t timestamp;                /**< ms desde arranque */
+} detection_info_t;
+
+/**
+ * @brief Anillo sin bloqueo de un productor y un consumidor
+ *
+ * El productor es el callback de escaneo (tarea host de NimBLE) y el consumidor
+ * detection_task. Cada índice lo escribe un solo lado, por lo que basta con
+ * ordenar las cargas y almacenamientos (acquire/release), sin secciones críticas.
+ */
+typedef struct {
+    detection_info_t elementos[BLE_DETECTION_RING_SIZE];
+    _Atomic uint32_t cabeza;          /**< Escrito solo por el productor */
+    _Atomic uint32_t cola;            /**< Escrito solo por el consumidor */
+    _Atomic uint32_t desbordamientos; /**< Detecciones descartadas por anillo lleno */
+    _Atomic uint32_t ocupacion_maxima;/**< Marca de agua alta de ocupación */
+    _Atomic uint32_t encolados;       /**< Detecciones aceptadas en total */
+} ble_detection_ring_t;
+
+/**
+ * @brief Reinicia el anillo y sus contadores (sin productor ni consumidor activos)
+ */
+void ble_detection_ring_reset(ble_detection_ring_t *ring);
+
+/**
+ * @brief Encola una detección (solo productor)
+ *
+ * @return true si se encoló, false si el anillo estaba lleno (se cuenta desbordamiento)
+ */
+bool ble_detection_ring_push(ble_detection_ring_t *ring, const detection_info_t *info);
+
+/**
+ * @brief Extrae la detección más antigua (solo consumidor)
+ *
+ * @return true si había una detección, false si el anillo está vacío
+ */
+bool ble_detection_ring_pop(ble_detection_ring_t *ring, detection_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
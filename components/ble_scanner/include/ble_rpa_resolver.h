@@ -0,0 +1,103 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "mbedtls/aes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Número máximo de objetivos con IRK y tamaño de la caché de resolución
+ */
+#ifdef CONFIG_BLE_SCANNER_MAX_IRK_TARGETS
+#define BLE_RPA_MAX_IRKS       CONFIG_BLE_SCANNER_MAX_IRK_TARGETS
+#define BLE_RPA_CACHE_SIZE     CONFIG_BLE_SCANNER_RPA_CACHE_SIZE
+#else
+#define BLE_RPA_MAX_IRKS       4
+#define BLE_RPA_CACHE_SIZE     32
+#endif
+
+/**
+ * @brief Entrada de la caché: dirección ya evaluada y su resultado
+ */
+typedef struct {
+    uint8_t addr[6];                  /**< Dirección en orden NimBLE */
+    bool valida;
+    int16_t target_idx;               /**< Objetivo resuelto, -1 = ningún IRK la resuelve */
+    uint32_t ultimo_uso;              /**< Marca del reloj LRU */
+} ble_rpa_cache_entry_t;
+
+/**
+ * @brief IRK de un objetivo con su contexto AES ya expandido
+ */
+typedef struct {
+    mbedtls_aes_context aes;
+    uint16_t target_idx;
+    bool en_uso;
+} ble_rpa_irk_t;
+
+/**
+ * @brief Resolvedor de direcciones privadas resolubles (RPA) con caché LRU
+ *
+ * La caché guarda tanto aciertos como rechazos, así una RPA ajena que se
+ * anuncia varias veces por segundo solo cuesta un AES por IRK la primera vez.
+ */
+typedef struct {
+    ble_rpa_irk_t irks[BLE_RPA_MAX_IRKS];
+    uint8_t num_irks;
+    ble_rpa_cache_entry_t cache[BLE_RPA_CACHE_SIZE];
+    uint32_t reloj;
+    uint32_t consultas;               /**< Direcciones RPA evaluadas */
+    uint32_t aciertos_cache;          /**< Consultas resueltas sin AES */
+    uint32_t resoluciones_aes;        /**< Operaciones AES realizadas */
+    uint32_t resueltas;               /**< Consultas que coincidieron con un IRK */
+} ble_rpa_resolver_t;
+
+/**
+ * @brief Indica si la dirección (orden NimBLE) tiene el formato de una RPA
+ */
+static inline bool ble_rpa_es_resoluble(const uint8_t addr[6])
+{
+    return (addr[5] & 0xC0) == 0x40;
+}
+
+/**
+ * @brief Inicializa el resolvedor sin IRKs
+ */
+void ble_rpa_resolver_init(ble_rpa_resolver_t *resolver);
+
+/**
+ * @brief Libera los contextos AES y vacía el resolvedor
+ */
+void ble_rpa_resolver_liberar(ble_rpa_resolver_t *resolver);
+
+/**
+ * @brief Asocia un IRK (16 bytes, MSB primero) a un objetivo, sustituyendo el anterior
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM si no quedan ranuras de IRK
+ */
+esp_err_t ble_rpa_resolver_agregar_irk(ble_rpa_resolver_t *resolver, uint16_t target_idx, const uint8_t irk[16]);
+
+/**
+ * @brief Elimina el IRK asociado a un objetivo, si existe
+ */
+void ble_rpa_resolver_eliminar_irk(ble_rpa_resolver_t *resolver, uint16_t target_idx);
+
+/**
+ * @brief Invalida todas las entradas de la caché
+ */
+void ble_rpa_resolver_limpiar_cache(ble_rpa_resolver_t *resolver);
+
+/**
+ * @brief Resuelve una RPA (orden NimBLE) consultando primero la caché
+ *
+ * @return Índice del objetivo o -1 si ningún IRK la resuelve
+ */
+int ble_rpa_resolver_buscar(ble_rpa_resolver_t *resolver, const uint8_t addr[6]);
+
+#ifdef __cplusplus
+}
+#endif
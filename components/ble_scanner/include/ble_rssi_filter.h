@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble_scanner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Valor de RSSI que NimBLE entrega cuando no hay medida disponible
+ */
+#define BLE_RSSI_NO_DISPONIBLE 127
+
+/**
+ * @brief Filtro EMA de RSSI en punto fijo Q8 con zona de proximidad
+ *
+ * valor += (muestra - valor) / 2^shift, sin flotantes ni memoria dinámica:
+ * coste constante por anuncio, apto para el callback de escaneo.
+ */
+typedef struct {
+    int32_t valor_q8;                 /**< RSSI filtrado en dBm * 256 */
+    ble_proximity_zone_t zona;        /**< Zona actual con histéresis */
+    bool inicializado;
+} ble_rssi_filter_t;
+
+/**
+ * @brief Vuelve el filtro a su estado inicial (sin muestras, zona desconocida)
+ */
+void ble_rssi_filter_reset(ble_rssi_filter_t *filtro);
+
+/**
+ * @brief Añade una muestra y reevalúa la zona
+ *
+ * La zona pasa a CERCA al alcanzar umbral_cerca y a LEJOS al caer por debajo de
+ * umbral_lejos; entre ambos se conserva la zona anterior.
+ *
+ * @param shift Constante del EMA (alfa = 1 / 2^shift)
+ * @return Zona resultante
+ */
+ble_proximity_zone_t ble_rssi_filter_actualizar(ble_rssi_filter_t *filtro, int8_t rssi, uint8_t shift,
+                                                int8_t umbral_cerca, int8_t umbral_lejos);
+
+/**
+ * @brief RSSI filtrado redondeado a dBm
+ */
+static inline int8_t ble_rssi_filter_valor(const ble_rssi_filter_t *filtro)
+{
+    return (int8_t)((filtro->valor_q8 + 128) >> 8);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,6 +2,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,17 +13,64 @@ extern "C" {
 /**
  * @brief Número máximo de dispositivos MAC objetivo que se pueden monitorear
  */
+#ifdef CONFIG_BLE_SCANNER_MAX_TARGET_DEVICES
+#define BLE_SCANNER_MAX_TARGET_DEVICES CONFIG_BLE_SCANNER_MAX_TARGET_DEVICES
+#else
 #define BLE_SCANNER_MAX_TARGET_DEVICES 10
+#endif
+
+/**
+ * @brief Parámetros por defecto del motor de presencia
+ */
+#ifdef CONFIG_BLE_SCANNER_PRESENCE_ENTER_DETECTIONS
+#define BLE_SCANNER_PRESENCE_ENTER_DETECTIONS CONFIG_BLE_SCANNER_PRESENCE_ENTER_DETECTIONS
+#define BLE_SCANNER_PRESENCE_ENTER_WINDOW_MS  CONFIG_BLE_SCANNER_PRESENCE_ENTER_WINDOW_MS
+#define BLE_SCANNER_PRESENCE_EXIT_TIMEOUT_MS  CONFIG_BLE_SCANNER_PRESENCE_EXIT_TIMEOUT_MS
+#define BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS  CONFIG_BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS
+#else
+#define BLE_SCANNER_PRESENCE_ENTER_DETECTIONS 1
+#define BLE_SCANNER_PRESENCE_ENTER_WINDOW_MS  2000
+#define BLE_SCANNER_PRESENCE_EXIT_TIMEOUT_MS  45000
+#define BLE_SCANNER_MAX_PRESENCE_SUBSCRIBERS  4
+#endif
+
+/**
+ * @brief Filtro de RSSI y umbrales de zona por defecto (dBm)
+ */
+#ifdef CONFIG_BLE_SCANNER_RSSI_EMA_SHIFT
+#define BLE_SCANNER_RSSI_EMA_SHIFT   CONFIG_BLE_SCANNER_RSSI_EMA_SHIFT
+#define BLE_SCANNER_RSSI_NEAR_DBM    CONFIG_BLE_SCANNER_RSSI_NEAR_DBM
+#define BLE_SCANNER_RSSI_FAR_DBM     CONFIG_BLE_SCANNER_RSSI_FAR_DBM
+#else
+#define BLE_SCANNER_RSSI_EMA_SHIFT   3
+#define BLE_SCANNER_RSSI_NEAR_DBM    (-70)
+#define BLE_SCANNER_RSSI_FAR_DBM     (-80)
+#endif
+
+/**
+ * @brief Parámetros del gobernador térmico de duty cycle
+ */
+#ifdef CONFIG_BLE_SCANNER_THERMAL_STEPS
+#define BLE_SCANNER_THERMAL_STEPS              CONFIG_BLE_SCANNER_THERMAL_STEPS
+#define BLE_SCANNER_THERMAL_HYSTERESIS_DECI_C  CONFIG_BLE_SCANNER_THERMAL_HYSTERESIS_DECI_C
+#define BLE_SCANNER_THERMAL_MIN_DWELL_MS       CONFIG_BLE_SCANNER_THERMAL_MIN_DWELL_MS
+#define BLE_SCANNER_THERMAL_MAX_RESTARTS_HOUR  CONFIG_BLE_SCANNER_THERMAL_MAX_RESTARTS_HOUR
+#else
+#define BLE_SCANNER_THERMAL_STEPS              8
+#define BLE_SCANNER_THERMAL_HYSTERESIS_DECI_C  20
+#define BLE_SCANNER_THERMAL_MIN_DWELL_MS       10000
+#define BLE_SCANNER_THERMAL_MAX_RESTARTS_HOUR  30
+#endif
 
 /**
  * @brief Umbrales de temperatura optimizados para ESP32-S3-MINI-1 en trabajo AUSENTE intensivo
  * Estos valores están calibrados específicamente para cuando el BLE trabaja constantemente
  * buscando dispositivos ausentes (escenario más demandante térmicamente)
  */
-#define BLE_SCANNER_TEMP_ECO           55  /**< Inicio enfriamiento preventivo - trabajo intensivo */
-#define BLE_SCANNER_TEMP_WARNING       65  /**< Reducir duty cycle a 25% - calor moderado */
-#define BLE_SCANNER_TEMP_CRITICAL      75  /**< Reducir duty cycle a 6.25% - calor alto */
-#define BLE_SCANNER_TEMP_EMERGENCY     85  /**< Reducir duty cycle a 0.625% - supervivencia */
+#define BLE_SCANNER_TEMP_ECO           55  /**< Inicio de la reducción continua de duty cycle */
+#define BLE_SCANNER_TEMP_WARNING       65  /**< Calor moderado (etiqueta de modo) */
+#define BLE_SCANNER_TEMP_CRITICAL      75  /**< Calor alto (etiqueta de modo) */
+#define BLE_SCANNER_TEMP_EMERGENCY     85  /**< Duty cycle mínimo 0.625% - supervivencia */
 
 /**
  * @brief Modos de operación térmica optimizados para trabajo AUSENTE intensivo
@@ -45,6 +95,28 @@ typedef enum {
     BLE_PRESENCE_TRANSITIONING        /**< En transición */
 } ble_presence_state_t;
 
+/**
+ * @brief Zona de proximidad según el RSSI filtrado
+ */
+typedef enum {
+    BLE_PROXIMITY_UNKNOWN = 0,        /**< Sin muestras de RSSI */
+    BLE_PROXIMITY_NEAR,               /**< Cerca - RSSI filtrado >= umbral de cerca */
+    BLE_PROXIMITY_FAR                 /**< Lejos - RSSI filtrado < umbral de lejos */
+} ble_proximity_zone_t;
+
+/**
+ * @brief Callback de transición de presencia
+ *
+ * Se invoca desde la tarea de detección del escáner; debe ser breve y no bloquear.
+ *
+ * @param mac_index Índice del objetivo que cambió de estado
+ * @param estado BLE_PRESENCE_PRESENT o BLE_PRESENCE_ABSENT
+ * @param timestamp_ms Instante de la detección (entrada) o del vencimiento (salida)
+ * @param arg Argumento registrado con la suscripción
+ */
+typedef void (*ble_scanner_presencia_cb_t)(uint16_t mac_index, ble_presence_state_t estado,
+                                           int64_t timestamp_ms, void *arg);
+
 /**
  * @brief Configuración optimizada para trabajo AUSENTE intensivo en ESP32-S3-MINI-1
  */
@@ -81,6 +153,28 @@ typedef struct {
     .intervalo_monitoreo_ms = 150 \
 }
 
+/**
+ * @brief Estadísticas del camino de detección (callback -> detection_task)
+ */
+typedef struct {
+    uint32_t detecciones_totales;     /**< Anuncios que coincidieron con un objetivo */
+    uint32_t eventos_encolados;       /**< Detecciones aceptadas por el anillo */
+    uint32_t eventos_descartados;     /**< Detecciones perdidas por anillo lleno */
+    uint32_t ocupacion_maxima;        /**< Marca de agua alta del anillo */
+    uint32_t capacidad_cola;          /**< Capacidad del anillo */
+} ble_scanner_estadisticas_deteccion_t;
+
+/**
+ * @brief Estadísticas de resolución de direcciones privadas (RPA)
+ */
+typedef struct {
+    uint32_t consultas;               /**< Anuncios con RPA no encontrados por MAC */
+    uint32_t aciertos_cache;          /**< Consultas servidas desde la caché */
+    uint32_t resoluciones_aes;        /**< Cifrados AES realizados */
+    uint32_t direcciones_resueltas;   /**< Consultas que pertenecían a un objetivo */
+    float tasa_aciertos;              /**< aciertos_cache / consultas, en % */
+} ble_scanner_estadisticas_rpa_t;
+
 /**
  * @brief Inicializa el BLE scanner optimizado para ESP32-S3-MINI-1
  */
@@ -104,22 +198,44 @@ esp_err_t ble_scanner_reiniciar(void);
 /**
  * @brief Consulta si el tag objetivo fue detectado
  */
-bool ble_scanner_tag_detectado(uint8_t mac_index);
+bool ble_scanner_tag_detectado(uint16_t mac_index);
 
 /**
  * @brief Consulta si cualquier tag objetivo fue detectado
  */
 bool ble_scanner_cualquier_tag_detectado(void);
 
+/**
+ * @brief Zona de proximidad actual de un objetivo
+ */
+ble_proximity_zone_t ble_scanner_obtener_zona(uint16_t mac_index);
+
+/**
+ * @brief Consulta si el objetivo está en la zona CERCA
+ */
+bool ble_scanner_tag_cerca(uint16_t mac_index);
+
+/**
+ * @brief Obtiene el RSSI filtrado de un objetivo
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE si aún no hay muestras
+ */
+esp_err_t ble_scanner_obtener_rssi_filtrado(uint16_t mac_index, int8_t *rssi);
+
+/**
+ * @brief Configura los umbrales de zona (requiere umbral_cerca > umbral_lejos)
+ */
+esp_err_t ble_scanner_configurar_zonas(int8_t umbral_cerca, int8_t umbral_lejos);
+
 /**
  * @brief Define la dirección MAC objetivo en formato binario
  */
-esp_err_t ble_scanner_configurar_mac_objetivo(uint8_t mac_index, const uint8_t *mac);
+esp_err_t ble_scanner_configurar_mac_objetivo(uint16_t mac_index, const uint8_t *mac);
 
 /**
  * @brief Define la dirección MAC objetivo en formato texto
  */
-esp_err_t ble_scanner_configurar_mac_objetivo_texto(uint8_t mac_index, const char *mac_str);
+esp_err_t ble_scanner_configurar_mac_objetivo_texto(uint16_t mac_index, const char *mac_str);
 
 /**
  * @brief Limpia todas las MACs objetivo configuradas
@@ -138,6 +254,8 @@ float ble_scanner_obtener_temperatura(void);
 
 /**
  * @brief Obtiene el modo térmico actual
+ *
+ * Es una etiqueta por umbrales; el duty cycle real lo ajusta el gobernador térmico.
  */
 ble_thermal_mode_t ble_scanner_obtener_modo_termico(void);
 
@@ -146,6 +264,56 @@ ble_thermal_mode_t ble_scanner_obtener_modo_termico(void);
  */
 ble_presence_state_t ble_scanner_obtener_estado_presencia(void);
 
+/**
+ * @brief Obtiene el estado de presencia de un objetivo concreto
+ */
+ble_presence_state_t ble_scanner_obtener_estado_presencia_objetivo(uint16_t mac_index);
+
+/**
+ * @brief Configura la histéresis del motor de presencia
+ *
+ * @param detecciones_entrada Detecciones necesarias para confirmar PRESENTE
+ * @param ventana_entrada_ms Ventana en la que deben producirse esas detecciones
+ * @param timeout_salida_ms Tiempo sin detecciones para pasar a AUSENTE
+ */
+esp_err_t ble_scanner_configurar_presencia(uint8_t detecciones_entrada, uint32_t ventana_entrada_ms,
+                                           uint32_t timeout_salida_ms);
+
+/**
+ * @brief Configura el timeout de ausencia de un objetivo (0 = usar el global)
+ */
+esp_err_t ble_scanner_configurar_timeout_presencia(uint16_t mac_index, uint32_t timeout_salida_ms);
+
+/**
+ * @brief Suscribe un callback a las transiciones PRESENTE/AUSENTE
+ */
+esp_err_t ble_scanner_suscribir_presencia(ble_scanner_presencia_cb_t cb, void *arg);
+
+/**
+ * @brief Suscribe una tarea: recibe xTaskNotify(bits, eSetBits) en cada transición
+ */
+esp_err_t ble_scanner_suscribir_presencia_tarea(TaskHandle_t tarea, uint32_t bits);
+
+/**
+ * @brief Suscribe una tarea a cada lote de detecciones de objetivos
+ *
+ * La tarea recibe xTaskNotify(bits, eSetBits) en cuanto la tarea de detección
+ * recoge nuevas detecciones, antes de cualquier otro procesamiento.
+ */
+esp_err_t ble_scanner_suscribir_deteccion_tarea(TaskHandle_t tarea, uint32_t bits);
+
+/**
+ * @brief Instante (esp_timer, µs) en que se recibió el último anuncio del objetivo
+ */
+int64_t ble_scanner_obtener_ultima_deteccion_us(uint16_t mac_index);
+
+/**
+ * @brief Elimina la suscripción del callback o de la tarea indicados
+ *
+ * Con una tarea se eliminan tanto sus suscripciones de presencia como de detección.
+ */
+esp_err_t ble_scanner_desuscribir_presencia(ble_scanner_presencia_cb_t cb, TaskHandle_t tarea);
+
 /**
  * @brief Configura umbrales de temperatura personalizados
  */
@@ -172,6 +340,61 @@ esp_err_t ble_scanner_forzar_enfriamiento(uint32_t duracion_ms);
 esp_err_t ble_scanner_obtener_estadisticas(float *temp_promedio, float *temp_maxima, 
                                           uint32_t *detecciones_totales, uint32_t *tiempo_critico_seg);
 
+/**
+ * @brief Obtiene estadísticas del anillo de detecciones (desbordamientos y marca de agua)
+ */
+esp_err_t ble_scanner_obtener_estadisticas_deteccion(ble_scanner_estadisticas_deteccion_t *stats);
+
+/**
+ * @brief Asocia un IRK a un objetivo para reconocerlo aunque rote su MAC (RPA)
+ *
+ * Puede combinarse con una MAC fija en el mismo índice o usarse solo.
+ *
+ * @param mac_index Índice del objetivo
+ * @param irk Identity Resolving Key de 16 bytes, MSB primero
+ */
+esp_err_t ble_scanner_configurar_irk_objetivo(uint16_t mac_index, const uint8_t irk[16]);
+
+/**
+ * @brief Igual que ble_scanner_configurar_irk_objetivo con el IRK en 32 caracteres hex
+ */
+esp_err_t ble_scanner_configurar_irk_objetivo_texto(uint16_t mac_index, const char *irk_hex);
+
+/**
+ * @brief Obtiene estadísticas de la caché de resolución RPA
+ */
+esp_err_t ble_scanner_obtener_estadisticas_rpa(ble_scanner_estadisticas_rpa_t *stats);
+
+/**
+ * @brief Identifica un objetivo por su anuncio iBeacon
+ *
+ * @param uuid UUID de proximidad (16 bytes, tal como se anuncia)
+ * @param major Major a exigir, o -1 para cualquiera
+ * @param minor Minor a exigir, o -1 para cualquiera
+ */
+esp_err_t ble_scanner_agregar_regla_ibeacon(uint16_t mac_index, const uint8_t uuid[16], int32_t major, int32_t minor);
+
+/**
+ * @brief Identifica un objetivo por su trama Eddystone-UID
+ *
+ * @param espacio Namespace de 10 bytes
+ * @param instancia Instancia de 6 bytes, o NULL para cualquiera
+ */
+esp_err_t ble_scanner_agregar_regla_eddystone_uid(uint16_t mac_index, const uint8_t espacio[10], const uint8_t *instancia);
+
+/**
+ * @brief Identifica un objetivo por sus datos de fabricante
+ *
+ * Coinciden los anuncios con ese company ID cuyos primeros `longitud` bytes
+ * tras el ID cumplan (dato ^ datos[i]) & mascara[i] == 0.
+ *
+ * @param datos Datos esperados, o NULL si longitud es 0
+ * @param mascara Máscara por byte, o NULL para comparar todos los bits
+ * @param longitud Bytes a comparar (máximo 8)
+ */
+esp_err_t ble_scanner_agregar_regla_fabricante(uint16_t mac_index, uint16_t company_id,
+                                               const uint8_t *datos, const uint8_t *mascara, uint8_t longitud);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "ble_scanner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Número de ranuras del índice (potencia de 2, al menos el doble de objetivos)
+ */
+#define BLE_TARGET_SET_SLOTS \
+    ((BLE_SCANNER_MAX_TARGET_DEVICES) <= 8   ? 16  : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 16  ? 32  : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 32  ? 64  : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 64  ? 128 : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 128 ? 256 : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 256 ? 512 : \
+     (BLE_SCANNER_MAX_TARGET_DEVICES) <= 512 ? 1024 : 2048)
+
+/**
+ * @brief Bits del prefiltro (4 bits por ranura, mínimo 256)
+ */
+#define BLE_TARGET_SET_PREFILTER_BITS \
+    (BLE_TARGET_SET_SLOTS * 4 < 256 ? 256 : BLE_TARGET_SET_SLOTS * 4)
+
+/**
+ * @brief Ranura del índice: dirección completa de 48 bits + índice del objetivo
+ */
+typedef struct {
+    uint32_t addr_lo;                 /**< Bytes 0..3 de la dirección (orden NimBLE) */
+    uint16_t addr_hi;                 /**< Bytes 4..5 de la dirección */
+    int16_t target_idx;               /**< Índice en la tabla de objetivos, -1 = libre */
+} ble_target_slot_t;
+
+/**
+ * @brief Conjunto hash de direccionamiento abierto con prefiltro de bits
+ *
+ * El prefiltro descarta en O(1) casi todos los anuncios que no son objetivo
+ * sin tocar la tabla; solo los candidatos recorren el sondeo lineal.
+ */
+typedef struct {
+    uint32_t prefiltro[BLE_TARGET_SET_PREFILTER_BITS / 32];
+    ble_target_slot_t slots[BLE_TARGET_SET_SLOTS];
+    uint16_t num_entradas;
+} ble_target_set_t;
+
+/**
+ * @brief Vacía el conjunto
+ */
+void ble_target_set_limpiar(ble_target_set_t *set);
+
+/**
+ * @brief Inserta una dirección (en orden de bytes NimBLE) asociada a un objetivo
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM si el conjunto está lleno
+ */
+esp_err_t ble_target_set_insertar(ble_target_set_t *set, const uint8_t addr[6], uint16_t target_idx);
+
+/**
+ * @brief Busca una dirección (en orden de bytes NimBLE)
+ *
+ * @return Índice del objetivo o -1 si no pertenece al conjunto
+ */
+int ble_target_set_buscar(const ble_target_set_t *set, const uint8_t addr[6]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include "sdkconfig.h"
+
+/**
+ * @brief Codificación de la telemetría del escáner (térmica y detecciones)
+ *
+ * Con CBOR cada mensaje es un mapa con claves enteras; la clave 0 lleva el
+ * id de esquema y el tópico termina en BLE_TELEMETRIA_SUFIJO_CBOR, con la
+ * versión del esquema. El decodificador de referencia está en
+ * tools/telemetria_cbor.py y debe cambiar junto con estas tablas.
+ */
+#if CONFIG_BLE_TELEMETRIA_CBOR
+#define BLE_TELEMETRIA_CBOR             1
+#else
+#define BLE_TELEMETRIA_CBOR             0
+#endif
+
+#define BLE_TELEMETRIA_SUFIJO_CBOR      "/cbor/v1"
+
+#define BLE_TELEMETRIA_CLAVE_ESQUEMA    0
+
+/** Esquemas (valor de la clave 0) */
+typedef enum {
+    BLE_TELEMETRIA_ESQUEMA_TERMICO = 1,     /**< dispositivos/<mac>/termico_ausente/cbor/v1 */
+    BLE_TELEMETRIA_ESQUEMA_DETECCION = 2,   /**< dispositivos/<mac>/deteccion/cbor/v1 */
+} ble_telemetria_esquema_t;
+
+/**
+ * Claves del esquema térmico v1. Temperaturas en décimas de °C, duty en
+ * milésimas, modo_termico como ble_thermal_mode_t y estado_cuadro como
+ * ble_telemetria_cuadro_t. El campo "trabajo" del JSON es siempre
+ * "INTENSIVO_AUSENTE" y se omite.
+ */
+typedef enum {
+    BLE_TELEMETRIA_TERMICO_TEMP_DC = 1,
+    BLE_TELEMETRIA_TERMICO_MODO,
+    BLE_TELEMETRIA_TERMICO_DUTY_PM,
+    BLE_TELEMETRIA_TERMICO_TEMP_MAX_DC,
+    BLE_TELEMETRIA_TERMICO_DETECCIONES,
+    BLE_TELEMETRIA_TERMICO_TIEMPO_CRITICO_S,
+    BLE_TELEMETRIA_TERMICO_TIEMPO_EMERGENCIA_S,
+    BLE_TELEMETRIA_TERMICO_ESTADO_CUADRO,
+    BLE_TELEMETRIA_TERMICO_INTERVALO_ESCANEO_MS,
+    BLE_TELEMETRIA_TERMICO_REINICIOS_GAP,
+    BLE_TELEMETRIA_TERMICO_CAMBIOS_SUPRIMIDOS,
+    BLE_TELEMETRIA_TERMICO_NUM_CAMPOS = BLE_TELEMETRIA_TERMICO_CAMBIOS_SUPRIMIDOS,
+} ble_telemetria_termico_t;
+
+typedef enum {
+    BLE_TELEMETRIA_CUADRO_NORMAL = 0,
+    BLE_TELEMETRIA_CUADRO_TIBIO,
+    BLE_TELEMETRIA_CUADRO_CALIENTE,
+    BLE_TELEMETRIA_CUADRO_SOBRECALENTADO,
+} ble_telemetria_cuadro_t;
+
+/**
+ * Claves del esquema de detección v1 (siempre primera detección)
+ */
+typedef enum {
+    BLE_TELEMETRIA_DETECCION_DISPOSITIVO = 1,
+    BLE_TELEMETRIA_DETECCION_RSSI,
+    BLE_TELEMETRIA_DETECCION_TIMESTAMP,
+    BLE_TELEMETRIA_DETECCION_NUM_CAMPOS = BLE_TELEMETRIA_DETECCION_TIMESTAMP,
+} ble_telemetria_deteccion_t;
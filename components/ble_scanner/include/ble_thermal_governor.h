@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parámetros del gobernador térmico de duty cycle
+ *
+ * Intervalos y ventana en unidades BLE de 0.625 ms.
+ */
+typedef struct {
+    float temp_inicio;                /**< Por debajo: intervalo mínimo (duty máximo) */
+    float temp_fin;                   /**< Desde aquí: intervalo máximo (duty mínimo) */
+    uint16_t ventana;                 /**< Ventana de escaneo */
+    uint16_t itvl_min;                /**< Intervalo a temperatura baja */
+    uint16_t itvl_max;                /**< Intervalo a temp_fin */
+    uint8_t pasos;                    /**< Niveles discretos entre ambos extremos (>= 2) */
+    float histeresis;                 /**< Ancho de la banda de histéresis (°C) */
+    uint32_t permanencia_min_ms;      /**< Tiempo mínimo en un nivel antes de cambiar */
+    uint32_t max_reinicios_hora;      /**< Límite de reinicios de GAP por hora */
+} ble_thermal_governor_config_t;
+
+/**
+ * @brief Estado del gobernador
+ *
+ * El nivel 0 es el más frío (duty máximo) y pasos-1 el más caliente. Subir al
+ * último nivel ignora permanencia y límite de reinicios: la protección térmica
+ * manda sobre la estabilidad.
+ */
+typedef struct {
+    ble_thermal_governor_config_t cfg;
+    uint8_t paso;                     /**< Nivel aplicado */
+    uint8_t paso_minimo;              /**< Nivel por debajo del cual no se baja (enfriamiento forzado) */
+    int64_t ultimo_cambio_ms;
+    int64_t ultima_recarga_ms;
+    uint32_t credito_ms;              /**< Cubo de testigos del límite de reinicios */
+    uint32_t reinicios;               /**< Cambios de nivel aplicados */
+    uint32_t cambios_suprimidos;      /**< Cambios retenidos por permanencia o límite */
+} ble_thermal_governor_t;
+
+/**
+ * @brief Inicializa el gobernador en el nivel más frío
+ */
+void ble_thermal_governor_init(ble_thermal_governor_t *gov, const ble_thermal_governor_config_t *cfg, int64_t now_ms);
+
+/**
+ * @brief Evalúa una nueva lectura de temperatura
+ *
+ * @return true si el nivel cambió y hay que reiniciar el escaneo con los nuevos parámetros
+ */
+bool ble_thermal_governor_actualizar(ble_thermal_governor_t *gov, float temperatura, int64_t now_ms);
+
+/**
+ * @brief Impone un nivel mínimo, o lo quita con 0
+ *
+ * Se aplica en la siguiente llamada a ble_thermal_governor_actualizar(). Subir
+ * hasta el mínimo es inmediato (como el último nivel): no espera permanencia
+ * ni crédito de reinicios. Al quitarlo se baja con la histéresis normal.
+ */
+void ble_thermal_governor_fijar_minimo(ble_thermal_governor_t *gov, uint8_t paso);
+
+/**
+ * @brief Primer nivel cuyo duty no supera duty_max (%)
+ */
+uint8_t ble_thermal_governor_paso_para_duty(const ble_thermal_governor_t *gov, float duty_max);
+
+/**
+ * @brief Intervalo de escaneo correspondiente al nivel actual
+ */
+uint16_t ble_thermal_governor_intervalo(const ble_thermal_governor_t *gov);
+
+/**
+ * @brief Duty cycle del nivel actual en %
+ */
+float ble_thermal_governor_duty(const ble_thermal_governor_t *gov);
+
+#ifdef __cplusplus
+}
+#endif
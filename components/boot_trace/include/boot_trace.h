@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Hitos del arranque, en el orden en que se esperan
+     *
+     * Los nombres de boot_trace_nombre() son las claves de la traza publicada
+     * y las que entiende tools/boot_trace.py: no se renombran, solo se añaden.
+     */
+    typedef enum
+    {
+        BOOT_TRACE_APP_MAIN = 0,            /**< Entrada en app_main() */
+        BOOT_TRACE_NVS,                     /**< NVS y configuración cargadas */
+        BOOT_TRACE_RELE,                    /**< Relé inicializado (apagado) */
+        BOOT_TRACE_WIFI_INICIADO,           /**< Pila WiFi arrancada, sin conexión aún */
+        BOOT_TRACE_MQTT_INICIADO,           /**< Cliente MQTT creado */
+        BOOT_TRACE_MODO,                    /**< Estado guardado iniciado */
+        BOOT_TRACE_PRIMER_ESCANEO,          /**< Primer escaneo BLE en marcha */
+        BOOT_TRACE_PRIMERA_DECISION_RELE,   /**< Primera orden del modo automático al relé */
+        BOOT_TRACE_WIFI_CONECTADO,          /**< Primera IP */
+        BOOT_TRACE_NTP,                     /**< Primera sincronización NTP */
+        BOOT_TRACE_MQTT_CONECTADO,          /**< Primer CONNACK */
+        BOOT_TRACE_ARRANQUE_COMPLETO,       /**< Grafo de arranque terminado */
+        BOOT_TRACE_NUM
+    } boot_trace_punto_t;
+
+#if CONFIG_BOOT_TRACE_HABILITADO
+    /**
+     * @brief Marca un hito con esp_timer_get_time(); solo cuenta la primera vez
+     *
+     * Cuesta una lectura de esp_timer y una sección crítica corta, sin
+     * reservas: se puede llamar desde cualquier tarea o callback (no desde ISR).
+     */
+    void boot_trace_marcar(boot_trace_punto_t punto);
+#else
+    static inline void boot_trace_marcar(boot_trace_punto_t punto) { (void)punto; }
+#endif
+
+    /**
+     * @brief Instante del hito en microsegundos, o 0 si no se ha alcanzado
+     */
+    int64_t boot_trace_obtener(boot_trace_punto_t punto);
+
+    /**
+     * @brief Nombre estable del hito (clave de la traza publicada)
+     */
+    const char *boot_trace_nombre(boot_trace_punto_t punto);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,6 +6,7 @@
 #include "esp_log.h"
 #include "relay_controller.h"
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include "estado_manual.h"  // Añadido para acceder a las funciones de estado_manual
 
 static const char *TAG = "CONTROL_BUTTON";
@@ -85,7 +86,7 @@ static void accion_reset(void)
     // Asegurar que el estado inicial sea CONFIGURACION al reiniciar
     // Esto es redundante porque al borrar NVS ya no hay estado guardado
     // pero añade protección extra
-    nvs_manager_set_u8("app_estado", ESTADO_CONFIGURACION);
+    ecokey_config_set_app_estado(ESTADO_CONFIGURACION);
     
     // Reiniciar el dispositivo
     esp_restart();
@@ -0,0 +1,129 @@
+#include "automatico_logica.h"
+#include <string.h>
+
+void automatico_logica_init(automatico_logica_t *logica, const automatico_params_t *params)
+{
+    memset(logica, 0, sizeof(*logica));
+    logica->params = *params;
+}
+
+uint32_t automatico_logica_ventana_rechequeo(const automatico_params_t *params, uint32_t timeout_ms)
+{
+    uint32_t fraccion = params->fraccion_rechequeo ? params->fraccion_rechequeo : 1;
+    uint32_t ventana_rechequeo_ms = timeout_ms / fraccion;
+    if (ventana_rechequeo_ms < params->min_rechequeo_ms) ventana_rechequeo_ms = params->min_rechequeo_ms;
+    return ventana_rechequeo_ms;
+}
+
+static void programar_plazos_rele(const automatico_logica_t *logica, automatico_acciones_t *acciones)
+{
+    uint32_t ventana = automatico_logica_ventana_rechequeo(&logica->params, logica->params.timeout_ms);
+    acciones->plazos[AUTO_PLAZO_APAGADO] = logica->rele_apagado_time;
+    acciones->plazos[AUTO_PLAZO_RECHEQUEO] = logica->rele_apagado_time - ventana;
+}
+
+void automatico_logica_procesar(automatico_logica_t *logica, automatico_evento_t evento, int64_t now_ms,
+                                bool detectado, bool cerca, automatico_acciones_t *acciones)
+{
+    memset(acciones, 0, sizeof(*acciones));
+    for (int i = 0; i < AUTO_PLAZO_NUM; i++) {
+        acciones->plazos[i] = AUTO_PLAZO_SIN_CAMBIO;
+    }
+
+    const automatico_params_t *p = &logica->params;
+
+    switch (evento) {
+        case AUTO_EVT_INICIO:
+            // Relé apagado: escaneo BLE activo, duty cycle si sigue ausente
+            logica->escaneo_activo = true;
+            logica->last_detected_time = now_ms;
+            acciones->escaneo = AUTO_ESCANEO_INICIAR;
+            acciones->plazos[AUTO_PLAZO_DUTY] = now_ms + p->ausencia_duty_ms;
+            acciones->plazos[AUTO_PLAZO_REINICIO] = now_ms + p->reinicio_escaneo_ms;
+            acciones->motivo = "Escaneo BLE activado (relé apagado)";
+            break;
+
+        case AUTO_EVT_DETECCION:
+            if (!logica->rele_activado) {
+                // Solo se enciende si el tag, además de detectado, está cerca del armario
+                if (detectado && cerca) {
+                    logica->rele_activado = true;
+                    logica->escaneo_activo = false;
+                    logica->last_detected_time = now_ms;
+                    logica->rele_apagado_time = now_ms + p->timeout_ms;
+                    acciones->encender_rele = true;
+                    acciones->escaneo = AUTO_ESCANEO_DETENER;
+                    acciones->plazos[AUTO_PLAZO_DUTY] = AUTO_PLAZO_CANCELAR;
+                    programar_plazos_rele(logica, acciones);
+                    acciones->motivo = "Relé activado por detección BLE";
+                }
+            } else if (logica->escaneo_activo && detectado) {
+                logica->escaneo_activo = false;
+                logica->last_detected_time = now_ms;
+                logica->rele_apagado_time = now_ms + p->timeout_ms;
+                acciones->escaneo = AUTO_ESCANEO_DETENER;
+                acciones->plazos[AUTO_PLAZO_REINICIO] = now_ms + p->reinicio_escaneo_ms;
+                programar_plazos_rele(logica, acciones);
+                acciones->motivo = "Tag detectado de nuevo, temporizador reiniciado y escaneo parado";
+            }
+            break;
+
+        case AUTO_EVT_TIMEOUT_CAMBIADO:
+            // El apagado ya programado se respeta; solo cambia la ventana de re-chequeo
+            if (logica->rele_activado) {
+                programar_plazos_rele(logica, acciones);
+            }
+            break;
+
+        case AUTO_EVT_RECHEQUEO:
+            // Reactivar escaneo solo en la ventana de re-chequeo
+            if (logica->rele_activado && !logica->escaneo_activo) {
+                logica->escaneo_activo = true;
+                acciones->escaneo = AUTO_ESCANEO_INICIAR;
+                acciones->motivo = "Escaneo BLE reactivado (ventana de re-chequeo)";
+            }
+            break;
+
+        case AUTO_EVT_APAGADO:
+            if (logica->rele_activado) {
+                logica->rele_activado = false;
+                acciones->apagar_rele = true;
+                acciones->plazos[AUTO_PLAZO_RECHEQUEO] = AUTO_PLAZO_CANCELAR;
+                // Relé apagado: escaneo BLE siempre activo
+                if (!logica->escaneo_activo) {
+                    logica->escaneo_activo = true;
+                    acciones->escaneo = AUTO_ESCANEO_INICIAR;
+                }
+                acciones->plazos[AUTO_PLAZO_DUTY] = logica->last_detected_time + p->ausencia_duty_ms;
+                acciones->motivo = "Relé desactivado por timeout";
+            }
+            break;
+
+        case AUTO_EVT_DUTY:
+            // Duty cycle en ausencia: alternar tramos de escaneo y pausa
+            if (!logica->rele_activado) {
+                if (logica->escaneo_activo && p->duty_pausa_ms == 0) {
+                    // Llegada probable: seguir escaneando y reevaluar tras el tramo
+                    acciones->plazos[AUTO_PLAZO_DUTY] = now_ms + p->duty_escaneo_ms;
+                } else if (logica->escaneo_activo) {
+                    logica->escaneo_activo = false;
+                    acciones->escaneo = AUTO_ESCANEO_DETENER;
+                    acciones->plazos[AUTO_PLAZO_DUTY] = now_ms + p->duty_pausa_ms;
+                } else {
+                    logica->escaneo_activo = true;
+                    acciones->escaneo = AUTO_ESCANEO_INICIAR;
+                    acciones->plazos[AUTO_PLAZO_DUTY] = now_ms + p->duty_escaneo_ms;
+                }
+            }
+            break;
+
+        case AUTO_EVT_REINICIO_ESCANEO:
+            // Reiniciar escáner si lleva mucho tiempo ausente
+            if (!logica->rele_activado && logica->escaneo_activo) {
+                acciones->escaneo = AUTO_ESCANEO_INICIAR;
+                acciones->motivo = "Reiniciando escáner BLE por periodo largo de ausencia";
+            }
+            acciones->plazos[AUTO_PLAZO_REINICIO] = now_ms + p->reinicio_escaneo_ms;
+            break;
+    }
+}
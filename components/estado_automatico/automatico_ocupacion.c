@@ -0,0 +1,89 @@
+#include "automatico_ocupacion.h"
+#include <string.h>
+
+// Constante de la media móvil por slot: alfa = 1/4, unas pocas semanas para aprender
+#define OCUPACION_EMA_SHIFT 2
+
+// A priori neutro (~12%): entre ambos umbrales, duty cycle base hasta aprender
+#define OCUPACION_PRIOR 32
+
+#define PORCENTAJE_A_Q8(p) ((uint8_t)(((p) * 255 + 50) / 100))
+
+void automatico_ocupacion_init(automatico_ocupacion_t *modelo)
+{
+    memset(modelo, 0, sizeof(*modelo));
+    modelo->tabla.version = AUTOMATICO_OCUPACION_VERSION;
+    memset(modelo->tabla.prob, OCUPACION_PRIOR, sizeof(modelo->tabla.prob));
+    modelo->slot_actual = -1;
+}
+
+bool automatico_ocupacion_cargar(automatico_ocupacion_t *modelo, const void *blob, size_t longitud)
+{
+    const automatico_ocupacion_tabla_t *tabla = blob;
+    if (blob == NULL || longitud != sizeof(*tabla) || tabla->version != AUTOMATICO_OCUPACION_VERSION) {
+        return false;
+    }
+    modelo->tabla = *tabla;
+    modelo->sucio = false;
+    return true;
+}
+
+static void consolidar_slot(automatico_ocupacion_t *modelo)
+{
+    uint8_t *celda = &modelo->tabla.prob[modelo->slot_actual / AUTOMATICO_OCUPACION_HORAS]
+                                        [modelo->slot_actual % AUTOMATICO_OCUPACION_HORAS];
+    int32_t objetivo = modelo->llegada_en_slot ? 255 : 0;
+    int32_t valor = *celda;
+    int32_t delta = (objetivo - valor) / (1 << OCUPACION_EMA_SHIFT);
+    if (delta == 0 && objetivo != valor) {
+        delta = (objetivo > valor) ? 1 : -1; // Que el valor llegue a los extremos
+    }
+    if (delta != 0) {
+        *celda = (uint8_t)(valor + delta);
+        modelo->sucio = true;
+    }
+}
+
+void automatico_ocupacion_observar(automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora, bool llegada)
+{
+    if (dia >= AUTOMATICO_OCUPACION_DIAS || hora >= AUTOMATICO_OCUPACION_HORAS) {
+        return;
+    }
+
+    int16_t slot = dia * AUTOMATICO_OCUPACION_HORAS + hora;
+    if (slot != modelo->slot_actual) {
+        if (modelo->slot_actual >= 0) {
+            consolidar_slot(modelo);
+        }
+        modelo->slot_actual = slot;
+        modelo->llegada_en_slot = false;
+    }
+    if (llegada) {
+        modelo->llegada_en_slot = true;
+    }
+}
+
+uint8_t automatico_ocupacion_probabilidad(const automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora)
+{
+    if (dia >= AUTOMATICO_OCUPACION_DIAS || hora >= AUTOMATICO_OCUPACION_HORAS) {
+        return 0;
+    }
+    return (uint8_t)((modelo->tabla.prob[dia][hora] * 100 + 127) / 255);
+}
+
+uint32_t automatico_ocupacion_pausa_ms(const automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora,
+                                       uint32_t pausa_base_ms, uint32_t pausa_max_ms)
+{
+    if (dia >= AUTOMATICO_OCUPACION_DIAS || hora >= AUTOMATICO_OCUPACION_HORAS) {
+        return pausa_base_ms;
+    }
+
+    uint8_t prob = modelo->tabla.prob[dia][hora];
+    if (prob >= PORCENTAJE_A_Q8(AUTOMATICO_OCUPACION_UMBRAL_ALTO)) {
+        return 0;
+    }
+    if (prob <= PORCENTAJE_A_Q8(AUTOMATICO_OCUPACION_UMBRAL_BAJO)) {
+        return pausa_max_ms;
+    }
+    return pausa_base_ms;
+}
@@ -7,12 +7,17 @@
 #include "ble_scanner.h"
 #include "relay_controller.h"
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include <string.h>
 #include "mqtt_service.h"
 #include "wifi_sta.h"
 #include "time_manager.h"
 #include "led.h"
 #include "resource_manager.h" // Nuevo componente de gestión de recursos
+#include "automatico_logica.h"
+#include "automatico_ocupacion.h"
+#include "boot_trace.h"
+#include <time.h>
 
 static const char *TAG = "ESTADO_AUTO";
 static bool estado_activo = false;
@@ -21,12 +26,47 @@ static volatile uint32_t automatico_timeout_ms = 10 * 60 * 1000; // 10 minutos p
 static resource_context_t resource_ctx; // Contexto de recursos
 
 // Configuración
-#define AUTOMATICO_TASK_PERIOD_MS 500
 #define BLE_TARGET_INDEX 0 // Usar el índice 0 para la MAC objetivo
 
-// Parámetros de ventana de re-chequeo
-#define FRACCION_RECHEQUEO 4         // 1/4 del tiempo total
-#define MIN_RECHEQUEO_MS (50 * 1000) // Nunca menos de 50 segundos
+// Eventos de automatico_task (bits de notificación)
+#define EVT_DETECCION          (1 << 0)   // El escáner recogió detecciones nuevas
+#define EVT_APAGADO            (1 << 1)   // Venció el timeout del relé
+#define EVT_RECHEQUEO          (1 << 2)   // Empieza la ventana de re-chequeo
+#define EVT_DUTY               (1 << 3)   // Alternar escaneo en ausencia
+#define EVT_REINICIO_ESCANEO   (1 << 4)   // Reinicio periódico del escáner
+#define EVT_TIMEOUT_CAMBIADO   (1 << 5)   // Timeout actualizado en caliente
+#define EVT_SALIR              (1 << 6)   // Detener la tarea
+
+// Histograma de latencia anuncio BLE -> GPIO del relé (límites superiores en ms)
+static const uint32_t s_latencia_limites_ms[] = {10, 20, 50, 100, 200, 500, 1000};
+#define LATENCIA_NUM_CUBETAS (sizeof(s_latencia_limites_ms) / sizeof(s_latencia_limites_ms[0]) + 1)
+
+typedef struct {
+    uint32_t cubetas[LATENCIA_NUM_CUBETAS];
+    uint32_t muestras;
+    uint32_t max_us;
+    uint64_t suma_us;
+} latencia_histograma_t;
+
+static latencia_histograma_t s_latencia = {0};
+
+// Modelo de ocupación por día/hora; se persiste en NVS con escrituras espaciadas
+#define OCUPACION_NVS_KEY "ocupacion"
+static automatico_ocupacion_t s_ocupacion;
+static bool s_ocupacion_cargada = false;
+static int64_t s_ocupacion_ultimo_guardado = 0;
+
+// Plazos one-shot del modo automático, indexados por automatico_plazo_t
+static esp_timer_handle_t s_timers[AUTO_PLAZO_NUM] = {NULL};
+static const uint32_t s_timer_eventos[AUTO_PLAZO_NUM] = {
+    [AUTO_PLAZO_APAGADO] = EVT_APAGADO,
+    [AUTO_PLAZO_RECHEQUEO] = EVT_RECHEQUEO,
+    [AUTO_PLAZO_DUTY] = EVT_DUTY,
+    [AUTO_PLAZO_REINICIO] = EVT_REINICIO_ESCANEO,
+};
+static const char *const s_timer_nombres[AUTO_PLAZO_NUM] = {
+    "auto_apagado", "auto_recheq", "auto_duty", "auto_reinicio"
+};
 
 /**
  * @brief Cleanup específico para el estado automático
@@ -41,105 +81,288 @@ static void cleanup_automatico(void) {
     ESP_LOGI(TAG, "BLE scanner deinicializado");
 }
 
+/**
+ * @brief Callback de esp_timer: convierte el vencimiento en un evento de la tarea
+ */
+static void timer_evento_cb(void *arg)
+{
+    TaskHandle_t tarea = automatico_task_handle;
+    if (tarea != NULL) {
+        xTaskNotify(tarea, (uint32_t)(uintptr_t)arg, eSetBits);
+    }
+}
+
+static esp_err_t crear_timer(esp_timer_handle_t *timer, uint32_t evento, const char *nombre)
+{
+    const esp_timer_create_args_t args = {
+        .callback = timer_evento_cb,
+        .arg = (void *)(uintptr_t)evento,
+        .name = nombre,
+    };
+    return esp_timer_create(&args, timer);
+}
+
+static void borrar_timer(esp_timer_handle_t *timer)
+{
+    if (*timer != NULL) {
+        esp_timer_stop(*timer);
+        esp_timer_delete(*timer);
+        *timer = NULL;
+    }
+}
+
+/**
+ * @brief Aplica un plazo devuelto por la lógica; un plazo vencido se dispara de inmediato
+ */
+static void aplicar_plazo(esp_timer_handle_t timer, int64_t plazo_ms, int64_t now)
+{
+    if (plazo_ms == AUTO_PLAZO_SIN_CAMBIO) {
+        return;
+    }
+    esp_timer_stop(timer); // Puede no estar en marcha
+    if (plazo_ms != AUTO_PLAZO_CANCELAR) {
+        int64_t retardo_ms = plazo_ms - now;
+        esp_timer_start_once(timer, retardo_ms > 0 ? (uint64_t)retardo_ms * 1000 : 1);
+    }
+}
+
+/**
+ * @brief Registra la latencia desde el anuncio BLE hasta el cambio del GPIO y la publica
+ */
+static void registrar_latencia_encendido(void)
+{
+    int64_t t_anuncio = ble_scanner_obtener_ultima_deteccion_us(BLE_TARGET_INDEX);
+    int64_t t_gpio = relay_controller_get_ultimo_cambio_us();
+    if (t_anuncio <= 0 || t_gpio < t_anuncio) {
+        return;
+    }
+
+    uint32_t latencia_us = (uint32_t)(t_gpio - t_anuncio);
+    size_t cubeta = 0;
+    while (cubeta < LATENCIA_NUM_CUBETAS - 1 && latencia_us >= s_latencia_limites_ms[cubeta] * 1000) {
+        cubeta++;
+    }
+    s_latencia.cubetas[cubeta]++;
+    s_latencia.muestras++;
+    s_latencia.suma_us += latencia_us;
+    if (latencia_us > s_latencia.max_us) {
+        s_latencia.max_us = latencia_us;
+    }
+
+    ESP_LOGI(TAG, "Latencia anuncio->relé: %lu us", latencia_us);
+
+    char topic[80];
+    snprintf(topic, sizeof(topic), "dispositivos/%s/latencia_automatico", sta_wifi_get_mac_clean());
+
+    char json[256];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_objeto(&w, NULL);
+    json_writer_uint(&w, "ultima_us", latencia_us);
+    json_writer_uint(&w, "max_us", s_latencia.max_us);
+    json_writer_uint(&w, "media_us", s_latencia.suma_us / s_latencia.muestras);
+    json_writer_uint(&w, "muestras", s_latencia.muestras);
+    json_writer_objeto(&w, "cubetas");
+    for (size_t i = 0; i < LATENCIA_NUM_CUBETAS; i++) {
+        char clave[16];
+        if (i < LATENCIA_NUM_CUBETAS - 1) {
+            snprintf(clave, sizeof(clave), "<%lums", s_latencia_limites_ms[i]);
+        } else {
+            snprintf(clave, sizeof(clave), ">=%lums", s_latencia_limites_ms[i - 1]);
+        }
+        json_writer_uint(&w, clave, s_latencia.cubetas[i]);
+    }
+    mqtt_service_enviar_json_writer(topic, &w, 0, 0);
+
+    // La publicación (TLS) es el punto de más pila de automatico_task
+    resource_manager_monitor(&resource_ctx, "latencia");
+}
+
+/**
+ * @brief Día de la semana y hora local actuales; false si aún no hay hora sincronizada
+ */
+static bool obtener_slot_actual(uint8_t *dia, uint8_t *hora)
+{
+    int64_t unix_now = time_manager_get_unix_time_now();
+    if (unix_now == 0) {
+        return false;
+    }
+    time_t t = (time_t)unix_now;
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    *dia = (uint8_t)tm_info.tm_wday;
+    *hora = (uint8_t)tm_info.tm_hour;
+    return true;
+}
+
+static void cargar_modelo_ocupacion(void)
+{
+    if (s_ocupacion_cargada) {
+        return;
+    }
+    automatico_ocupacion_init(&s_ocupacion);
+
+    automatico_ocupacion_tabla_t tabla;
+    size_t longitud = sizeof(tabla);
+    if (nvs_manager_get_blob(OCUPACION_NVS_KEY, &tabla, &longitud) == ESP_OK &&
+        automatico_ocupacion_cargar(&s_ocupacion, &tabla, longitud)) {
+        ESP_LOGI(TAG, "Modelo de ocupación cargado de NVS");
+    } else {
+        ESP_LOGI(TAG, "Modelo de ocupación nuevo (sin datos previos válidos)");
+    }
+    s_ocupacion_cargada = true;
+    s_ocupacion_ultimo_guardado = esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Guarda el modelo si cambió y ha pasado el intervalo mínimo entre escrituras
+ */
+static void guardar_modelo_ocupacion(bool forzar)
+{
+    int64_t now = esp_timer_get_time() / 1000;
+    if (!s_ocupacion.sucio ||
+        (!forzar && (now - s_ocupacion_ultimo_guardado) < AUTOMATICO_OCUPACION_GUARDADO_MS)) {
+        return;
+    }
+
+    esp_err_t err = nvs_manager_set_blob(OCUPACION_NVS_KEY, &s_ocupacion.tabla, sizeof(s_ocupacion.tabla));
+    if (err == ESP_OK) {
+        s_ocupacion.sucio = false;
+        s_ocupacion_ultimo_guardado = now;
+    } else {
+        ESP_LOGW(TAG, "No se pudo guardar el modelo de ocupación: %s", esp_err_to_name(err));
+    }
+    resource_manager_monitor(&resource_ctx, "ocupacion-nvs");
+}
+
+/**
+ * @brief Alimenta el modelo de ocupación y devuelve la pausa de duty cycle para la hora actual
+ */
+static uint32_t actualizar_modelo_ocupacion(bool llegada)
+{
+    uint8_t dia, hora;
+    if (!obtener_slot_actual(&dia, &hora)) {
+        return AUTOMATICO_DUTY_PAUSA_MS;
+    }
+
+    automatico_ocupacion_observar(&s_ocupacion, dia, hora, llegada);
+    guardar_modelo_ocupacion(false);
+    return automatico_ocupacion_pausa_ms(&s_ocupacion, dia, hora,
+                                         AUTOMATICO_DUTY_PAUSA_MS, AUTOMATICO_OCUPACION_PAUSA_MAX_MS);
+}
+
+/**
+ * @brief Ejecuta sobre relé, escáner y temporizadores las acciones decididas por la lógica
+ */
+static void ejecutar_acciones(const automatico_acciones_t *acciones, int64_t now)
+{
+    if (acciones->encender_rele || acciones->apagar_rele) {
+        boot_trace_marcar(BOOT_TRACE_PRIMERA_DECISION_RELE);
+    }
+    if (acciones->encender_rele) {
+        relay_controller_activate();
+        registrar_latencia_encendido();
+    }
+    if (acciones->apagar_rele) {
+        relay_controller_deactivate();
+    }
+
+    if (acciones->escaneo == AUTO_ESCANEO_INICIAR) {
+        ble_scanner_reiniciar();
+    } else if (acciones->escaneo == AUTO_ESCANEO_DETENER) {
+        ble_scanner_detener();
+    }
+
+    for (int i = 0; i < AUTO_PLAZO_NUM; i++) {
+        aplicar_plazo(s_timers[i], acciones->plazos[i], now);
+    }
+
+    if (acciones->motivo != NULL) {
+        ESP_LOGI(TAG, "%s", acciones->motivo);
+    }
+}
+
 static void automatico_task(void *param)
 {
-    int64_t last_detected_time = 0;
-    bool rele_activado = false;
-    bool escaneo_activo = false;
-    int64_t rele_apagado_time = 0;
-    uint32_t timeout_ms = automatico_timeout_ms;
-    uint32_t ventana_rechequeo_ms = timeout_ms / FRACCION_RECHEQUEO;
-    if (ventana_rechequeo_ms < MIN_RECHEQUEO_MS) ventana_rechequeo_ms = MIN_RECHEQUEO_MS;
-
-    // Nuevo: contador para reinicio periódico del escáner
-    const int64_t REINICIO_ESCANEO_MS = 30 * 60 * 1000; // 30 minutos
-    int64_t ultimo_reinicio_escaneo = esp_timer_get_time() / 1000;
+    automatico_params_t params = AUTOMATICO_PARAMS_DEFAULT(automatico_timeout_ms);
+    automatico_logica_t logica;
+    automatico_acciones_t acciones;
+    automatico_logica_init(&logica, &params);
+    cargar_modelo_ocupacion();
 
     ESP_LOGI(TAG, "automatico_task watermark=%u",
              uxTaskGetStackHighWaterMark(NULL));
 
+    bool recursos_ok = true;
+    for (int i = 0; i < AUTO_PLAZO_NUM && recursos_ok; i++) {
+        recursos_ok = crear_timer(&s_timers[i], s_timer_eventos[i], s_timer_nombres[i]) == ESP_OK;
+    }
+    if (recursos_ok) {
+        recursos_ok = ble_scanner_suscribir_deteccion_tarea(xTaskGetCurrentTaskHandle(), EVT_DETECCION) == ESP_OK;
+    }
+    if (!recursos_ok) {
+        ESP_LOGE(TAG, "Error creando temporizadores o suscripción del modo automático");
+        estado_activo = false;
+    } else {
+        automatico_logica_procesar(&logica, AUTO_EVT_INICIO, esp_timer_get_time() / 1000, false, false, &acciones);
+        ejecutar_acciones(&acciones, esp_timer_get_time() / 1000);
+    }
+
+    // La tarea solo despierta por detecciones del escáner o por vencimiento de plazos
     while (estado_activo)
     {
-        timeout_ms = automatico_timeout_ms; // Por si cambia en caliente
-        ventana_rechequeo_ms = timeout_ms / FRACCION_RECHEQUEO;
-        if (ventana_rechequeo_ms < MIN_RECHEQUEO_MS) ventana_rechequeo_ms = MIN_RECHEQUEO_MS;
+        uint32_t eventos = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &eventos, portMAX_DELAY);
+        if ((eventos & EVT_SALIR) || !estado_activo) {
+            break;
+        }
 
         int64_t now = esp_timer_get_time() / 1000; // ms
 
-        if (!rele_activado) {
-            // Relé apagado: escaneo BLE siempre activo
-            if (!escaneo_activo) {
-                ble_scanner_reiniciar();
-                escaneo_activo = true;
-                ESP_LOGI(TAG, "Escaneo BLE activado (relé apagado)");
-            }
-
+        if (eventos & EVT_DETECCION) {
             bool detectado = ble_scanner_tag_detectado(BLE_TARGET_INDEX);
-            if (detectado) {
-                last_detected_time = now;
-                relay_controller_activate();
-                rele_activado = true;
-                ESP_LOGI(TAG, "Relé activado por detección BLE");
-                ble_scanner_detener();
-                escaneo_activo = false;
-                rele_apagado_time = now + timeout_ms;
-            } else {
-                // Si lleva ausente más de 1 minuto, aplicar duty cycle
-                if ((now - last_detected_time) > 60000) {
-                    // Duty cycle: escanear 5s, pausar 5s
-                    if (escaneo_activo && ((now / 5000) % 2 == 1)) {
-                        ble_scanner_detener();
-                        escaneo_activo = false;
-                    } else if (!escaneo_activo && ((now / 5000) % 2 == 0)) {
-                        ble_scanner_reiniciar();
-                        escaneo_activo = true;
-                    }
-                }
-            }
-
-            // Nuevo: reiniciar escáner si lleva mucho tiempo ausente
-            if (escaneo_activo && (now - ultimo_reinicio_escaneo) > REINICIO_ESCANEO_MS) {
-                ESP_LOGI(TAG, "Reiniciando escáner BLE por periodo largo de ausencia");
-                ble_scanner_reiniciar();
-                ultimo_reinicio_escaneo = now;
-            }
-        } else {
-            // Relé encendido: escaneo BLE parado
-            int64_t tiempo_restante = rele_apagado_time - now;
-            bool detectado = false; // Declarar aquí para todo el bloque
-
-            // Reactivar escaneo solo en la ventana de re-chequeo
-            if (tiempo_restante <= ventana_rechequeo_ms && !escaneo_activo) {
-                ble_scanner_reiniciar();
-                escaneo_activo = true;
-                ESP_LOGI(TAG, "Escaneo BLE reactivado (ventana de re-chequeo: %lu ms)", ventana_rechequeo_ms);
+            bool cerca = detectado && ble_scanner_tag_cerca(BLE_TARGET_INDEX);
+            automatico_logica_procesar(&logica, AUTO_EVT_DETECCION, now, detectado, cerca, &acciones);
+            if (acciones.encender_rele) {
+                actualizar_modelo_ocupacion(true);
             }
-
-            if (escaneo_activo) {
-                detectado = ble_scanner_tag_detectado(BLE_TARGET_INDEX);
-                if (detectado) {
-                    last_detected_time = now;
-                    rele_apagado_time = now + timeout_ms;
-                    ble_scanner_detener();
-                    escaneo_activo = false;
-                    ESP_LOGI(TAG, "Tag detectado de nuevo, temporizador reiniciado y escaneo parado");
-                }
-            }
-
-            if (now >= rele_apagado_time) {
-                relay_controller_deactivate();
-                rele_activado = false;
-                ESP_LOGI(TAG, "Relé desactivado por timeout");
-                // BLE escaneo se reactivará en el siguiente ciclo
-            }
-
-            // Al detectar el tag, reiniciar el contador de reinicio
-            if (detectado) {
-                ultimo_reinicio_escaneo = now;
+            ejecutar_acciones(&acciones, now);
+        }
+        if (eventos & EVT_TIMEOUT_CAMBIADO) {
+            logica.params.timeout_ms = automatico_timeout_ms; // Por si cambia en caliente
+            automatico_logica_procesar(&logica, AUTO_EVT_TIMEOUT_CAMBIADO, now, false, false, &acciones);
+            ejecutar_acciones(&acciones, now);
+        }
+        if (eventos & EVT_RECHEQUEO) {
+            automatico_logica_procesar(&logica, AUTO_EVT_RECHEQUEO, now, false, false, &acciones);
+            ejecutar_acciones(&acciones, now);
+        }
+        if (eventos & EVT_APAGADO) {
+            automatico_logica_procesar(&logica, AUTO_EVT_APAGADO, now, false, false, &acciones);
+            ejecutar_acciones(&acciones, now);
+        }
+        if (eventos & EVT_DUTY) {
+            // Pausa según la probabilidad de llegada aprendida para esta hora
+            uint32_t pausa_ms = actualizar_modelo_ocupacion(false);
+            if (pausa_ms != logica.params.duty_pausa_ms) {
+                ESP_LOGI(TAG, "Duty cycle de ausencia: pausa %lu ms", pausa_ms);
+                logica.params.duty_pausa_ms = pausa_ms;
             }
+            automatico_logica_procesar(&logica, AUTO_EVT_DUTY, now, false, false, &acciones);
+            ejecutar_acciones(&acciones, now);
         }
+        if (eventos & EVT_REINICIO_ESCANEO) {
+            automatico_logica_procesar(&logica, AUTO_EVT_REINICIO_ESCANEO, now, false, false, &acciones);
+            ejecutar_acciones(&acciones, now);
+        }
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(AUTOMATICO_TASK_PERIOD_MS));
+    actualizar_modelo_ocupacion(false);
+    guardar_modelo_ocupacion(true);
+
+    ble_scanner_desuscribir_presencia(NULL, xTaskGetCurrentTaskHandle());
+    for (int i = 0; i < AUTO_PLAZO_NUM; i++) {
+        borrar_timer(&s_timers[i]);
     }
 
     // Al salir, asegurar relé desactivado y BLE parado
@@ -200,26 +423,18 @@ esp_err_t estado_automatico_iniciar(void)
     relay_controller_set_state(false);
     ESP_LOGI(TAG, "Relé inicializado en APAGADO - se activará al detectar tag BLE");
 
-    // Recuperar la MAC objetivo desde NVS
-    char mac_objetivo[24] = {0}; // Formato XX:XX:XX:XX:XX:XX (17 chars + null + extra)
-    esp_err_t err = nvs_manager_get_string("mac_objetivo", mac_objetivo, sizeof(mac_objetivo));
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error al recuperar MAC objetivo de NVS: %s", esp_err_to_name(err));
-        return ESP_FAIL;
-    }
-    ESP_LOGI(TAG, "MAC objetivo cargada de NVS: [%s]", mac_objetivo);
-    if (strlen(mac_objetivo) < 12)
+    // MAC objetivo ya validada y en binario desde la configuración cargada al arrancar
+    const ecokey_config_t *cfg = ecokey_config();
+    if (!cfg->mac_objetivo_valida)
     {
-        ESP_LOGE(TAG, "MAC objetivo no válida: %s", mac_objetivo);
+        ESP_LOGE(TAG, "No hay MAC objetivo válida configurada");
         return ESP_FAIL;
     }
     
     resource_manager_monitor(&resource_ctx, "post-nvs");
     
     // Configurar la MAC en el escáner BLE
-    ESP_LOGI(TAG, "Configurando escáner BLE para MAC objetivo: %s", mac_objetivo);
-    err = ble_scanner_configurar_mac_objetivo_texto(BLE_TARGET_INDEX, mac_objetivo);
+    esp_err_t err = ble_scanner_configurar_mac_objetivo(BLE_TARGET_INDEX, cfg->mac_objetivo);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Error al configurar MAC objetivo en escáner BLE: %s", esp_err_to_name(err));
@@ -237,26 +452,8 @@ esp_err_t estado_automatico_iniciar(void)
 
     resource_manager_monitor(&resource_ctx, "post-ble");
 
-    // Recuperar el temporizador desde NVS (en minutos)
-    char temporizador_str[8] = {0};
-    int minutos = 10; // valor por defecto
-    err = nvs_manager_get_string("temporizador", temporizador_str, sizeof(temporizador_str));
-    if (err == ESP_OK)
-    {
-        int temp = atoi(temporizador_str);
-        if (temp >= 1 && temp <= 30)
-        {
-            minutos = temp;
-        }
-        else
-        {
-            ESP_LOGW(TAG, "Valor de temporizador fuera de rango (%d), usando 10 min por defecto", temp);
-        }
-    }
-    else
-    {
-        ESP_LOGW(TAG, "No se pudo recuperar temporizador, usando 10 min por defecto");
-    }
+    // Temporizador en minutos, validado al cargar la configuración
+    int minutos = cfg->temporizador_min;
     uint32_t timeout_ms = (uint32_t)minutos * 60 * 1000; // convertir minutos a ms
     automatico_timeout_ms = timeout_ms;
 
@@ -296,6 +493,9 @@ esp_err_t estado_automatico_detener(void)
     resource_manager_monitor(&resource_ctx, "pre-detener");
     
     estado_activo = false;
+    if (automatico_task_handle != NULL) {
+        xTaskNotify(automatico_task_handle, EVT_SALIR, eSetBits);
+    }
     
     // Cleanup usando el gestor de recursos
     resource_manager_cleanup(&resource_ctx, cleanup_automatico);
@@ -320,14 +520,15 @@ void estado_automatico_set_timeout_minutos(uint32_t minutos)
     ESP_LOGI(TAG, "Timeout actualizado dinámicamente a %lu minutos (%lu ms)", minutos, automatico_timeout_ms);
     
     // Calcular y mostrar la nueva ventana de re-chequeo
-    uint32_t ventana_rechequeo_ms = automatico_timeout_ms / FRACCION_RECHEQUEO;
-    if (ventana_rechequeo_ms < MIN_RECHEQUEO_MS) ventana_rechequeo_ms = MIN_RECHEQUEO_MS;
+    automatico_params_t params = AUTOMATICO_PARAMS_DEFAULT(automatico_timeout_ms);
+    uint32_t ventana_rechequeo_ms = automatico_logica_ventana_rechequeo(&params, automatico_timeout_ms);
     ESP_LOGI(TAG, "Nueva ventana de re-chequeo: %lu ms", ventana_rechequeo_ms);
+    if (automatico_task_handle != NULL) {
+        xTaskNotify(automatico_task_handle, EVT_TIMEOUT_CAMBIADO, eSetBits);
+    }
 
     // Guardar en NVS para persistencia tras reinicio
-    char temp_str[8];
-    snprintf(temp_str, sizeof(temp_str), "%lu", minutos);
-    esp_err_t err = nvs_manager_set_string("temporizador", temp_str);
+    esp_err_t err = ecokey_config_set_temporizador(minutos);
     if (err != ESP_OK)
     {
         ESP_LOGW(TAG, "No se pudo guardar el nuevo timeout en NVS: %s", esp_err_to_name(err));
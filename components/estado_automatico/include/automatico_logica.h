@@ -0,0 +1,132 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parámetros por defecto del modo automático
+ */
+#ifdef CONFIG_AUTOMATICO_FRACCION_RECHEQUEO
+#define AUTOMATICO_FRACCION_RECHEQUEO     CONFIG_AUTOMATICO_FRACCION_RECHEQUEO
+#define AUTOMATICO_MIN_RECHEQUEO_MS       (CONFIG_AUTOMATICO_MIN_RECHEQUEO_S * 1000)
+#define AUTOMATICO_AUSENCIA_DUTY_MS       (CONFIG_AUTOMATICO_AUSENCIA_DUTY_S * 1000)
+#define AUTOMATICO_DUTY_ESCANEO_MS        CONFIG_AUTOMATICO_DUTY_ESCANEO_MS
+#define AUTOMATICO_DUTY_PAUSA_MS          CONFIG_AUTOMATICO_DUTY_PAUSA_MS
+#define AUTOMATICO_REINICIO_ESCANEO_MS    (CONFIG_AUTOMATICO_REINICIO_ESCANEO_MIN * 60 * 1000)
+#else
+#define AUTOMATICO_FRACCION_RECHEQUEO     4                 // 1/4 del tiempo total
+#define AUTOMATICO_MIN_RECHEQUEO_MS       (50 * 1000)       // Nunca menos de 50 segundos
+#define AUTOMATICO_AUSENCIA_DUTY_MS       (60 * 1000)       // Ausente más de 1 minuto: duty cycle
+#define AUTOMATICO_DUTY_ESCANEO_MS        5000              // Escanear 5s
+#define AUTOMATICO_DUTY_PAUSA_MS          5000              // Pausar 5s
+#define AUTOMATICO_REINICIO_ESCANEO_MS    (30 * 60 * 1000)  // 30 minutos
+#endif
+
+/**
+ * @brief Parámetros de la lógica del modo automático
+ */
+typedef struct {
+    uint32_t timeout_ms;              /**< Tiempo encendido tras la última detección */
+    uint32_t fraccion_rechequeo;      /**< Ventana de re-chequeo = timeout / fracción */
+    uint32_t min_rechequeo_ms;        /**< Ventana de re-chequeo mínima */
+    uint32_t ausencia_duty_ms;        /**< Ausencia a partir de la cual se aplica duty cycle */
+    uint32_t duty_escaneo_ms;         /**< Tramo de escaneo del duty cycle */
+    uint32_t duty_pausa_ms;           /**< Tramo de pausa del duty cycle (0 = escaneo continuo) */
+    uint32_t reinicio_escaneo_ms;     /**< Reinicio periódico del escáner en ausencia */
+} automatico_params_t;
+
+#define AUTOMATICO_PARAMS_DEFAULT(timeout) { \
+    .timeout_ms = (timeout), \
+    .fraccion_rechequeo = AUTOMATICO_FRACCION_RECHEQUEO, \
+    .min_rechequeo_ms = AUTOMATICO_MIN_RECHEQUEO_MS, \
+    .ausencia_duty_ms = AUTOMATICO_AUSENCIA_DUTY_MS, \
+    .duty_escaneo_ms = AUTOMATICO_DUTY_ESCANEO_MS, \
+    .duty_pausa_ms = AUTOMATICO_DUTY_PAUSA_MS, \
+    .reinicio_escaneo_ms = AUTOMATICO_REINICIO_ESCANEO_MS, \
+}
+
+/**
+ * @brief Eventos que alimentan la lógica
+ */
+typedef enum {
+    AUTO_EVT_INICIO = 0,              /**< Arranque del modo automático */
+    AUTO_EVT_DETECCION,               /**< El escáner recogió detecciones nuevas */
+    AUTO_EVT_APAGADO,                 /**< Venció el plazo de apagado */
+    AUTO_EVT_RECHEQUEO,               /**< Empieza la ventana de re-chequeo */
+    AUTO_EVT_DUTY,                    /**< Toca alternar el duty cycle de ausencia */
+    AUTO_EVT_REINICIO_ESCANEO,        /**< Reinicio periódico del escáner */
+    AUTO_EVT_TIMEOUT_CAMBIADO,        /**< Se cambió params.timeout_ms en caliente */
+} automatico_evento_t;
+
+/**
+ * @brief Plazos one-shot que gestiona la lógica
+ */
+typedef enum {
+    AUTO_PLAZO_APAGADO = 0,
+    AUTO_PLAZO_RECHEQUEO,
+    AUTO_PLAZO_DUTY,
+    AUTO_PLAZO_REINICIO,
+    AUTO_PLAZO_NUM
+} automatico_plazo_t;
+
+#define AUTO_PLAZO_SIN_CAMBIO  (-1)   /**< No tocar el plazo */
+#define AUTO_PLAZO_CANCELAR    (-2)   /**< Detener el plazo */
+
+/**
+ * @brief Acciones que el llamador debe ejecutar tras procesar un evento
+ */
+typedef enum {
+    AUTO_ESCANEO_SIN_CAMBIO = 0,
+    AUTO_ESCANEO_INICIAR,             /**< Iniciar (o reiniciar) el escaneo */
+    AUTO_ESCANEO_DETENER,
+} automatico_escaneo_t;
+
+typedef struct {
+    bool encender_rele;
+    bool apagar_rele;
+    automatico_escaneo_t escaneo;
+    int64_t plazos[AUTO_PLAZO_NUM];   /**< Instante absoluto (ms) o AUTO_PLAZO_* */
+    const char *motivo;               /**< Descripción para el log, o NULL */
+} automatico_acciones_t;
+
+/**
+ * @brief Estado de la lógica del modo automático
+ *
+ * No depende de FreeRTOS, GAP, GPIO ni MQTT: recibe eventos y el reloj, y
+ * devuelve acciones, así puede reproducirse con un reloj virtual.
+ */
+typedef struct {
+    automatico_params_t params;
+    bool rele_activado;
+    bool escaneo_activo;
+    int64_t last_detected_time;
+    int64_t rele_apagado_time;
+} automatico_logica_t;
+
+/**
+ * @brief Inicializa la lógica con el relé apagado y el escaneo parado
+ */
+void automatico_logica_init(automatico_logica_t *logica, const automatico_params_t *params);
+
+/**
+ * @brief Ventana de re-chequeo para un timeout dado
+ */
+uint32_t automatico_logica_ventana_rechequeo(const automatico_params_t *params, uint32_t timeout_ms);
+
+/**
+ * @brief Procesa un evento
+ *
+ * @param detectado Para AUTO_EVT_DETECCION: el tag objetivo fue detectado
+ * @param cerca Para AUTO_EVT_DETECCION: el tag está en la zona cerca
+ * @param acciones Acciones resultantes
+ */
+void automatico_logica_procesar(automatico_logica_t *logica, automatico_evento_t evento, int64_t now_ms,
+                                bool detectado, bool cerca, automatico_acciones_t *acciones);
+
+#ifdef __cplusplus
+}
+#endif
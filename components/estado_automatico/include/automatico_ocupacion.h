@@ -0,0 +1,91 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Umbrales de probabilidad de llegada (en %) y pausas del duty cycle
+ */
+#ifdef CONFIG_AUTOMATICO_OCUPACION_UMBRAL_ALTO
+#define AUTOMATICO_OCUPACION_UMBRAL_ALTO      CONFIG_AUTOMATICO_OCUPACION_UMBRAL_ALTO
+#define AUTOMATICO_OCUPACION_UMBRAL_BAJO      CONFIG_AUTOMATICO_OCUPACION_UMBRAL_BAJO
+#define AUTOMATICO_OCUPACION_PAUSA_MAX_MS     CONFIG_AUTOMATICO_OCUPACION_PAUSA_MAX_MS
+#define AUTOMATICO_OCUPACION_GUARDADO_MS      (CONFIG_AUTOMATICO_OCUPACION_GUARDADO_H * 60 * 60 * 1000)
+#else
+#define AUTOMATICO_OCUPACION_UMBRAL_ALTO      30                    // >= 30%: escaneo continuo
+#define AUTOMATICO_OCUPACION_UMBRAL_BAJO      3                     // <= 3%: pausa larga
+#define AUTOMATICO_OCUPACION_PAUSA_MAX_MS     30000                 // Pausa en horas sin llegadas
+#define AUTOMATICO_OCUPACION_GUARDADO_MS      (6 * 60 * 60 * 1000)  // Como mucho una escritura cada 6h
+#endif
+
+#define AUTOMATICO_OCUPACION_DIAS     7
+#define AUTOMATICO_OCUPACION_HORAS    24
+#define AUTOMATICO_OCUPACION_VERSION  1
+
+/**
+ * @brief Tabla persistida: probabilidad de llegada por día de la semana y hora
+ *
+ * Cada celda es una media móvil exponencial en Q8 (255 = llegada segura) de
+ * si hubo llegada en esa hora, actualizada una vez por hora observada.
+ */
+typedef struct {
+    uint8_t version;
+    uint8_t prob[AUTOMATICO_OCUPACION_DIAS][AUTOMATICO_OCUPACION_HORAS];
+} automatico_ocupacion_tabla_t;
+
+/**
+ * @brief Modelo de ocupación en memoria
+ */
+typedef struct {
+    automatico_ocupacion_tabla_t tabla;
+    int16_t slot_actual;              /**< dia * 24 + hora observado, -1 = ninguno */
+    bool llegada_en_slot;             /**< Hubo llegada en el slot actual */
+    bool sucio;                       /**< Cambios pendientes de guardar */
+} automatico_ocupacion_t;
+
+/**
+ * @brief Inicializa el modelo con una probabilidad a priori neutra
+ */
+void automatico_ocupacion_init(automatico_ocupacion_t *modelo);
+
+/**
+ * @brief Carga una tabla persistida
+ *
+ * @return true si el blob es válido; si no, el modelo queda sin cambios
+ */
+bool automatico_ocupacion_cargar(automatico_ocupacion_t *modelo, const void *blob, size_t longitud);
+
+/**
+ * @brief Registra una observación en el slot (dia, hora)
+ *
+ * Al pasar a otro slot se consolida el anterior en la tabla. Los slots no
+ * observados (equipo apagado o sin eventos) no se actualizan.
+ *
+ * @param dia Día de la semana, 0 = domingo
+ * @param hora Hora local, 0..23
+ * @param llegada true si en este momento se produjo una llegada
+ */
+void automatico_ocupacion_observar(automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora, bool llegada);
+
+/**
+ * @brief Probabilidad de llegada del slot en %
+ */
+uint8_t automatico_ocupacion_probabilidad(const automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora);
+
+/**
+ * @brief Pausa del duty cycle de ausencia para el slot
+ *
+ * @return 0 (escaneo continuo) si la llegada es probable, pausa_max_ms si es
+ *         improbable y pausa_base_ms en el resto de casos
+ */
+uint32_t automatico_ocupacion_pausa_ms(const automatico_ocupacion_t *modelo, uint8_t dia, uint8_t hora,
+                                       uint32_t pausa_base_ms, uint32_t pausa_max_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
 #include "led.h"
 #include "wifi_provision_web.h"
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include "resource_manager.h" // Nuevo componente de gestión de recursos
 #include "relay_controller.h" // Añadido para controlar el relé
 
@@ -33,36 +34,22 @@ static void cleanup_configuracion(void) {
 void info_NVS() {
     ESP_LOGI(TAG, "========== CONFIGURACIÓN COMPLETADA ==========");
     
-    // Buffer para almacenar los valores leídos de NVS
-    char valor[64] = {0};
+    const ecokey_config_t *cfg = ecokey_config();
     
-    // Leer y mostrar mac_objetivo
-    if (nvs_manager_get_string("mac_objetivo", valor, sizeof(valor)) == ESP_OK) {
-        ESP_LOGI(TAG, "MAC Objetivo: %s", valor);
+    if (cfg->mac_objetivo_valida) {
+        ESP_LOGI(TAG, "MAC Objetivo: %02X:%02X:%02X:%02X:%02X:%02X",
+                 cfg->mac_objetivo[0], cfg->mac_objetivo[1], cfg->mac_objetivo[2],
+                 cfg->mac_objetivo[3], cfg->mac_objetivo[4], cfg->mac_objetivo[5]);
     } else {
         ESP_LOGI(TAG, "MAC Objetivo: [no encontrado]");
     }
     
-    // Leer y mostrar SSID
-    if (nvs_manager_get_string("ssid", valor, sizeof(valor)) == ESP_OK) {
-        ESP_LOGI(TAG, "SSID WiFi: %s", valor);
-    } else {
-        ESP_LOGI(TAG, "SSID WiFi: [no encontrado]");
-    }
+    ESP_LOGI(TAG, "SSID WiFi: %s", cfg->ssid[0] ? cfg->ssid : "[no encontrado]");
     
-    // Leer y mostrar password (por seguridad solo mostramos que existe)
-    if (nvs_manager_get_string("password", valor, sizeof(valor)) == ESP_OK) {
-        ESP_LOGI(TAG, "Password WiFi: [guardado]");
-    } else {
-        ESP_LOGI(TAG, "Password WiFi: [no encontrado]");
-    }
+    // Por seguridad solo mostramos que existe
+    ESP_LOGI(TAG, "Password WiFi: %s", cfg->password[0] ? "[guardado]" : "[no encontrado]");
     
-    // Leer y mostrar temporizador
-    if (nvs_manager_get_string("temporizador", valor, sizeof(valor)) == ESP_OK) {
-        ESP_LOGI(TAG, "Temporizador: %s", valor);
-    } else {
-        ESP_LOGI(TAG, "Temporizador: [no encontrado]");
-    }
+    ESP_LOGI(TAG, "Temporizador: %u", cfg->temporizador_min);
 
     ESP_LOGI(TAG, "==============================================");
 }
@@ -73,7 +60,7 @@ static void provision_completed_callback(void) {
     // Mostrar información de NVS (si lo deseas)
     info_NVS();
     // Guardar directamente el estado en NVS para que se cargue tras reinicio
-    esp_err_t err = nvs_manager_set_u8("app_estado", ESTADO_AUTOMATICO);
+    esp_err_t err = ecokey_config_set_app_estado(ESTADO_AUTOMATICO);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error al guardar estado en NVS: %s", esp_err_to_name(err));
     } else {
@@ -0,0 +1,120 @@
+#include "cbor_writer.h"
+#include <string.h>
+
+// Tipos mayores de CBOR (3 bits altos del byte inicial)
+#define CBOR_UINT       0x00
+#define CBOR_NEGATIVO   0x20
+#define CBOR_TEXTO      0x60
+#define CBOR_ARRAY      0x80
+#define CBOR_MAPA       0xA0
+#define CBOR_FALSE      0xF4
+#define CBOR_TRUE       0xF5
+#define CBOR_NULL       0xF6
+
+static void poner(cbor_writer_t *w, const void *datos, size_t n)
+{
+    if (w->desbordado) {
+        return;
+    }
+    if (w->longitud + n > w->capacidad) {
+        w->desbordado = true;
+        return;
+    }
+    memcpy(w->buf + w->longitud, datos, n);
+    w->longitud += n;
+}
+
+/**
+ * Cabecera de tipo mayor + argumento en la forma más corta (big endian)
+ */
+static void cabecera(cbor_writer_t *w, uint8_t tipo, uint64_t argumento)
+{
+    uint8_t b[9];
+    size_t bytes;
+
+    if (argumento < 24) {
+        b[0] = tipo | (uint8_t)argumento;
+        poner(w, b, 1);
+        return;
+    }
+    if (argumento <= UINT8_MAX) {
+        b[0] = tipo | 24;
+        bytes = 1;
+    } else if (argumento <= UINT16_MAX) {
+        b[0] = tipo | 25;
+        bytes = 2;
+    } else if (argumento <= UINT32_MAX) {
+        b[0] = tipo | 26;
+        bytes = 4;
+    } else {
+        b[0] = tipo | 27;
+        bytes = 8;
+    }
+    for (size_t i = bytes; i >= 1; i--) {
+        b[i] = (uint8_t)argumento;
+        argumento >>= 8;
+    }
+    poner(w, b, bytes + 1);
+}
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t capacidad)
+{
+    w->buf = buf;
+    w->capacidad = capacidad;
+    w->longitud = 0;
+    w->desbordado = (buf == NULL);
+}
+
+cbor_writer_t *cbor_writer_mapa(cbor_writer_t *w, size_t pares)
+{
+    cabecera(w, CBOR_MAPA, pares);
+    return w;
+}
+
+cbor_writer_t *cbor_writer_array(cbor_writer_t *w, size_t elementos)
+{
+    cabecera(w, CBOR_ARRAY, elementos);
+    return w;
+}
+
+cbor_writer_t *cbor_writer_uint(cbor_writer_t *w, uint64_t valor)
+{
+    cabecera(w, CBOR_UINT, valor);
+    return w;
+}
+
+cbor_writer_t *cbor_writer_int(cbor_writer_t *w, int64_t valor)
+{
+    if (valor >= 0) {
+        cabecera(w, CBOR_UINT, (uint64_t)valor);
+    } else {
+        // -1 - n sin desbordar con INT64_MIN
+        cabecera(w, CBOR_NEGATIVO, (uint64_t)(-(valor + 1)));
+    }
+    return w;
+}
+
+cbor_writer_t *cbor_writer_str(cbor_writer_t *w, const char *valor)
+{
+    if (valor == NULL) {
+        uint8_t b = CBOR_NULL;
+        poner(w, &b, 1);
+        return w;
+    }
+    size_t n = strlen(valor);
+    cabecera(w, CBOR_TEXTO, n);
+    poner(w, valor, n);
+    return w;
+}
+
+cbor_writer_t *cbor_writer_bool(cbor_writer_t *w, bool valor)
+{
+    uint8_t b = valor ? CBOR_TRUE : CBOR_FALSE;
+    poner(w, &b, 1);
+    return w;
+}
+
+size_t cbor_writer_terminar(cbor_writer_t *w)
+{
+    return w->desbordado ? 0 : w->longitud;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Codificador CBOR (RFC 8949) mínimo sobre un buffer del llamador.
+     *
+     * Igual que json_writer_t: no reserva memoria y, si el resultado no cabe,
+     * marca el escritor como desbordado (cbor_writer_terminar() devuelve 0).
+     * Mapas y arrays son de longitud definida: el llamador indica cuántos
+     * elementos siguen. Los enteros se codifican en la forma más corta.
+     *
+     *   uint8_t buf[32];
+     *   cbor_writer_t w;
+     *   cbor_writer_init(&w, buf, sizeof(buf));
+     *   cbor_writer_mapa(&w, 2);
+     *   cbor_writer_uint(cbor_writer_uint(&w, 0), 1);     // {0: 1,
+     *   cbor_writer_int(cbor_writer_uint(&w, 1), -60);    //  1: -60}
+     *   size_t len = cbor_writer_terminar(&w);
+     */
+    typedef struct cbor_writer
+    {
+        uint8_t *buf;
+        size_t capacidad;
+        size_t longitud;
+        bool desbordado;
+    } cbor_writer_t;
+
+    /**
+     * @brief Inicializa el escritor sobre buf.
+     */
+    void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t capacidad);
+
+    /**
+     * @brief Abre un mapa de pares clave/valor (2 * pares elementos a continuación).
+     */
+    cbor_writer_t *cbor_writer_mapa(cbor_writer_t *w, size_t pares);
+
+    /**
+     * @brief Abre un array de elementos valores.
+     */
+    cbor_writer_t *cbor_writer_array(cbor_writer_t *w, size_t elementos);
+
+    /**
+     * @brief Emite un entero sin signo.
+     */
+    cbor_writer_t *cbor_writer_uint(cbor_writer_t *w, uint64_t valor);
+
+    /**
+     * @brief Emite un entero con signo.
+     */
+    cbor_writer_t *cbor_writer_int(cbor_writer_t *w, int64_t valor);
+
+    /**
+     * @brief Emite una cadena UTF-8 (NULL se emite como null).
+     */
+    cbor_writer_t *cbor_writer_str(cbor_writer_t *w, const char *valor);
+
+    /**
+     * @brief Emite un booleano.
+     */
+    cbor_writer_t *cbor_writer_bool(cbor_writer_t *w, bool valor);
+
+    /**
+     * @brief Termina la codificación.
+     *
+     * @return Bytes escritos, o 0 si no cupo en el buffer.
+     */
+    size_t cbor_writer_terminar(cbor_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /** Anidamiento máximo de objetos/arrays */
+#define JSON_WRITER_MAX_PROFUNDIDAD 8
+
+    /**
+     * @brief Escritor JSON en streaming sobre un buffer del llamador.
+     *
+     * No reserva memoria: escribe directamente en el buffer y, si no cabe,
+     * marca el escritor como desbordado y deja de escribir (el resultado de
+     * json_writer_terminar() es entonces NULL). Las cadenas se escapan y los
+     * números y booleanos se emiten con su tipo JSON.
+     *
+     * Todas las funciones devuelven el propio escritor para encadenar:
+     *
+     *   char buf[128];
+     *   json_writer_t w;
+     *   json_writer_init(&w, buf, sizeof(buf));
+     *   json_writer_bool(json_writer_int(json_writer_str(json_writer_objeto(&w, NULL),
+     *                    "Estado", "Encendido"), "rssi", -60), "cerca", true);
+     *   const char *json = json_writer_terminar(&w);
+     */
+    typedef struct json_writer
+    {
+        char *buf;
+        size_t capacidad;
+        size_t longitud;
+        bool desbordado;
+        uint8_t profundidad;
+        bool con_elementos[JSON_WRITER_MAX_PROFUNDIDAD]; /**< El nivel ya tiene algún elemento (lleva ',') */
+        char cierre[JSON_WRITER_MAX_PROFUNDIDAD];       /**< '}' o ']' pendiente en cada nivel */
+    } json_writer_t;
+
+    /**
+     * @brief Inicializa el escritor sobre buf (capacidad incluye el '\0').
+     */
+    void json_writer_init(json_writer_t *w, char *buf, size_t capacidad);
+
+    /**
+     * @brief Abre un objeto. clave es NULL en la raíz o dentro de un array.
+     */
+    json_writer_t *json_writer_objeto(json_writer_t *w, const char *clave);
+
+    /**
+     * @brief Abre un array. clave es NULL en la raíz o dentro de un array.
+     */
+    json_writer_t *json_writer_array(json_writer_t *w, const char *clave);
+
+    /**
+     * @brief Cierra el objeto o array abierto más interno.
+     */
+    json_writer_t *json_writer_cerrar(json_writer_t *w);
+
+    /**
+     * @brief Emite una cadena escapada (NULL se emite como null).
+     */
+    json_writer_t *json_writer_str(json_writer_t *w, const char *clave, const char *valor);
+
+    /**
+     * @brief Emite un entero con signo.
+     */
+    json_writer_t *json_writer_int(json_writer_t *w, const char *clave, int64_t valor);
+
+    /**
+     * @brief Emite un entero sin signo.
+     */
+    json_writer_t *json_writer_uint(json_writer_t *w, const char *clave, uint64_t valor);
+
+    /**
+     * @brief Emite un número con los decimales indicados (NaN/inf se emiten como null).
+     */
+    json_writer_t *json_writer_float(json_writer_t *w, const char *clave, float valor, uint8_t decimales);
+
+    /**
+     * @brief Emite un booleano.
+     */
+    json_writer_t *json_writer_bool(json_writer_t *w, const char *clave, bool valor);
+
+    /**
+     * @brief Cierra los niveles que sigan abiertos y termina la cadena.
+     *
+     * @return El JSON terminado en '\0', o NULL si no cupo en el buffer.
+     */
+    const char *json_writer_terminar(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
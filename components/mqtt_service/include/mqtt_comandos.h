@@ -0,0 +1,92 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_router.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Parámetros del ejecutor de comandos
+     */
+#ifdef CONFIG_MQTT_COMANDOS_COLA
+#define MQTT_COMANDOS_COLA          CONFIG_MQTT_COMANDOS_COLA
+#define MQTT_COMANDOS_STACK         CONFIG_MQTT_COMANDOS_STACK
+#else
+#define MQTT_COMANDOS_COLA          8       // Comandos en espera como máximo
+#define MQTT_COMANDOS_STACK         8192    // Incluye la descarga OTA por HTTPS
+#endif
+
+#define MQTT_COMANDO_MAX_PARAMS     200     // Bytes de parámetros copiados con el comando
+#define MQTT_COMANDO_MAX_ID         24
+#define MQTT_COMANDO_MAX_TIPOS      8       // Nombres distintos con métricas propias
+#define MQTT_COMANDO_MAX_CORRELACION 32     // Correlation Data de MQTT 5
+
+    /**
+     * @brief Función que ejecuta un comando en la tarea del ejecutor
+     *
+     * @param params Copia de los parámetros pasados a mqtt_comandos_encolar()
+     * @return ESP_OK si el comando se completó
+     */
+    typedef esp_err_t (*mqtt_comando_fn_t)(const void *params);
+
+    /**
+     * @brief Métricas de latencia de un tipo de comando
+     */
+    typedef struct
+    {
+        const char *nombre;
+        uint32_t ejecutados;
+        uint32_t fallidos;
+        uint32_t espera_max_ms;     /**< Mayor tiempo en cola */
+        uint32_t total_max_ms;      /**< Mayor tiempo desde la recepción hasta el final */
+        uint32_t total_medio_ms;
+    } mqtt_comando_metricas_t;
+
+    /**
+     * @brief Crea la cola y la tarea del ejecutor. Es idempotente.
+     */
+    esp_err_t mqtt_comandos_iniciar(void);
+
+    /**
+     * @brief Detiene la tarea del ejecutor y descarta los comandos en cola.
+     *
+     * La tarea termina el comando en curso y sale por sí misma; se espera su
+     * confirmación un tiempo acotado. Llamada desde un comando, no espera.
+     * Si mqtt_comandos_iniciar() llega antes de que salga, la misma tarea
+     * sigue siendo el ejecutor.
+     */
+    void mqtt_comandos_detener(void);
+
+    /**
+     * @brief Encola un comando sin bloquear
+     *
+     * Si id no es NULL se publican acks en dispositivos/<mac>/respuesta:
+     * "aceptado" al encolar, y "completado" o "fallido" al terminar, con la
+     * latencia medida. Los comandos internos pasan id NULL y no generan acks.
+     * Si el mensaje pedía respuesta (MQTT 5), los acks van a su Response Topic
+     * con su Correlation Data.
+     *
+     * @param nombre Nombre del comando (literal; se usa para acks y métricas)
+     * @param id Identificador del comando o NULL
+     * @param respuesta Destino de respuesta del mensaje recibido o NULL
+     * @return ESP_OK, ESP_ERR_INVALID_SIZE si los parámetros no caben,
+     *         ESP_ERR_NO_MEM si la cola está llena (se publica "fallido")
+     */
+    esp_err_t mqtt_comandos_encolar(const char *nombre, const char *id, const mqtt_router_respuesta_t *respuesta,
+                                    mqtt_comando_fn_t fn, const void *params, size_t longitud);
+
+    /**
+     * @brief Copia las métricas por tipo de comando
+     *
+     * @return Número de entradas escritas en metricas
+     */
+    size_t mqtt_comandos_obtener_metricas(mqtt_comando_metricas_t *metricas, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
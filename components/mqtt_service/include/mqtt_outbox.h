@@ -0,0 +1,100 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Parámetros del outbox persistente
+     */
+#ifdef CONFIG_MQTT_OUTBOX_PARTICION
+#define MQTT_OUTBOX_PARTICION            CONFIG_MQTT_OUTBOX_PARTICION
+#define MQTT_OUTBOX_MAX_MENSAJE          CONFIG_MQTT_OUTBOX_MAX_MENSAJE
+#define MQTT_OUTBOX_INTERVALO_REENVIO_MS CONFIG_MQTT_OUTBOX_INTERVALO_REENVIO_MS
+#else
+#define MQTT_OUTBOX_PARTICION            "spiffs"  // Partición de datos que ocupa el log
+#define MQTT_OUTBOX_MAX_MENSAJE          1024      // Payload máximo guardado
+#define MQTT_OUTBOX_INTERVALO_REENVIO_MS 50        // Pausa entre mensajes al reenviar
+#endif
+
+#define MQTT_OUTBOX_MAX_TOPIC 128
+
+    /**
+     * @brief Mensaje leído del outbox pendiente de confirmar
+     */
+    typedef struct
+    {
+        uint32_t seq;          /**< Número de secuencia (orden de llegada) */
+        uint32_t direccion;    /**< Posición del registro en la partición */
+        uint16_t longitud;     /**< Bytes de payload */
+        uint8_t qos;
+        uint8_t retain;
+    } mqtt_outbox_entrada_t;
+
+    /**
+     * @brief Estadísticas del outbox
+     */
+    typedef struct
+    {
+        uint32_t pendientes;   /**< Mensajes guardados sin confirmar */
+        uint32_t agregados;    /**< Mensajes guardados desde el arranque */
+        uint32_t confirmados;  /**< Mensajes reenviados y confirmados */
+        uint32_t descartados;  /**< Mensajes perdidos por outbox lleno */
+        uint32_t compactados;  /**< Sectores borrados */
+    } mqtt_outbox_estadisticas_t;
+
+    /**
+     * @brief Monta el outbox sobre la partición MQTT_OUTBOX_PARTICION
+     *
+     * Recorre el log para recuperar los mensajes pendientes tras un reinicio.
+     * Es idempotente.
+     *
+     * @return ESP_OK, o ESP_ERR_NOT_FOUND si la partición no existe
+     */
+    esp_err_t mqtt_outbox_init(void);
+
+    /**
+     * @brief Añade un mensaje al final del log
+     *
+     * Si el log está lleno se descarta el sector más antiguo.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_STATE si no está montado,
+     *         ESP_ERR_INVALID_SIZE si el mensaje supera los límites
+     */
+    esp_err_t mqtt_outbox_agregar(const char *topic, const char *datos, size_t longitud, int qos, int retain);
+
+    /**
+     * @brief Indica si quedan mensajes sin confirmar
+     */
+    bool mqtt_outbox_pendiente(void);
+
+    /**
+     * @brief Lee el mensaje pendiente más antiguo sin retirarlo
+     *
+     * @param topic Buffer de al menos MQTT_OUTBOX_MAX_TOPIC bytes (se termina en '\0')
+     * @param datos Buffer de al menos MQTT_OUTBOX_MAX_MENSAJE bytes
+     * @return ESP_OK, o ESP_ERR_NOT_FOUND si no hay pendientes
+     */
+    esp_err_t mqtt_outbox_siguiente(mqtt_outbox_entrada_t *entrada, char *topic, char *datos);
+
+    /**
+     * @brief Marca como entregado un mensaje devuelto por mqtt_outbox_siguiente()
+     *
+     * Los sectores que quedan sin pendientes se borran (compactación).
+     */
+    esp_err_t mqtt_outbox_confirmar(const mqtt_outbox_entrada_t *entrada);
+
+    /**
+     * @brief Copia las estadísticas del outbox
+     */
+    void mqtt_outbox_obtener_estadisticas(mqtt_outbox_estadisticas_t *estadisticas);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Parámetros de la reconexión
+     */
+#ifdef CONFIG_MQTT_RECONEXION_BASE_MS
+#define MQTT_RECONEXION_BASE_MS     CONFIG_MQTT_RECONEXION_BASE_MS
+#define MQTT_RECONEXION_MAX_MS      CONFIG_MQTT_RECONEXION_MAX_MS
+#define MQTT_RECONEXION_SLO_MS      CONFIG_MQTT_RECONEXION_SLO_MS
+#else
+#define MQTT_RECONEXION_BASE_MS     1000    // Espera mínima entre intentos
+#define MQTT_RECONEXION_MAX_MS      300000  // Espera máxima entre intentos
+#define MQTT_RECONEXION_SLO_MS      30000   // Objetivo de desconexión a reconexión
+#endif
+
+#define MQTT_RECONEXION_CUBETAS     10      // <1 s, <2 s, <4 s ... <256 s, resto
+
+    /**
+     * @brief Tiempos de desconexión a reconexión
+     *
+     * La cubeta i cuenta las reconexiones de menos de 2^i segundos (la
+     * última, las demás).
+     */
+    typedef struct
+    {
+        uint32_t reconexiones;
+        uint32_t fuera_slo;         /**< Reconexiones que superaron MQTT_RECONEXION_SLO_MS */
+        uint32_t intentos;          /**< Llamadas a esp_mqtt_client_reconnect() */
+        uint32_t ultima_ms;
+        uint32_t maxima_ms;
+        uint32_t cubetas[MQTT_RECONEXION_CUBETAS];
+    } mqtt_reconexion_estadisticas_t;
+
+    /**
+     * @brief Crea la tarea de reconexión; se llama antes de esp_mqtt_client_start()
+     *
+     * El cliente mantiene su reconexión automática con reconnect_timeout_ms =
+     * MQTT_RECONEXION_MAX_MS como respaldo; esta tarea la adelanta con
+     * esp_mqtt_client_reconnect() siguiendo el backoff con jitter y el enlace WiFi.
+     */
+    esp_err_t mqtt_reconexion_iniciar(esp_mqtt_client_handle_t client);
+
+    /**
+     * @brief Detiene la tarea de reconexión y espera a que termine
+     */
+    void mqtt_reconexion_detener(void);
+
+    /**
+     * @brief Avisa de una conexión establecida (MQTT_EVENT_CONNECTED)
+     */
+    void mqtt_reconexion_conectado(void);
+
+    /**
+     * @brief Avisa de una desconexión o de un intento fallido (MQTT_EVENT_DISCONNECTED/ERROR)
+     */
+    void mqtt_reconexion_desconectado(void);
+
+    /**
+     * @brief Copia el histograma y los contadores de reconexión
+     */
+    void mqtt_reconexion_obtener_estadisticas(mqtt_reconexion_estadisticas_t *estadisticas);
+
+#ifdef __cplusplus
+}
+#endif
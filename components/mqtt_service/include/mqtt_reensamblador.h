@@ -0,0 +1,67 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "mqtt_router.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Tamaño máximo de un mensaje recibido en varios fragmentos
+     */
+#ifdef CONFIG_MQTT_MAX_MENSAJE_RECIBIDO
+#define MQTT_MAX_MENSAJE_RECIBIDO CONFIG_MQTT_MAX_MENSAJE_RECIBIDO
+#else
+#define MQTT_MAX_MENSAJE_RECIBIDO 16384
+#endif
+
+    typedef enum
+    {
+        MQTT_REENSAMBLADO_INCOMPLETO = 0,   /**< Faltan fragmentos */
+        MQTT_REENSAMBLADO_COMPLETO,         /**< Mensaje listo en buf/total/topic */
+        MQTT_REENSAMBLADO_DESCARTADO,       /**< Demasiado grande, sin buffer o fuera de orden */
+    } mqtt_reensamblado_t;
+
+    /**
+     * @brief Reensamblador de MQTT_EVENT_DATA fragmentados
+     *
+     * El cliente MQTT entrega los payloads mayores que su buffer en varios
+     * eventos: el primero con el tópico y current_data_offset = 0, los
+     * siguientes sin tópico. El buffer se reserva una vez (en PSRAM si está
+     * disponible) y se reutiliza para todos los mensajes.
+     */
+    typedef struct
+    {
+        char *buf;
+        size_t capacidad;
+        size_t total;             /**< total_data_len del mensaje en curso */
+        size_t recibido;          /**< Bytes contiguos recibidos */
+        char topic[MQTT_ROUTER_MAX_TOPIC];
+        size_t topic_len;
+        bool descartando;         /**< Ignorar el resto del mensaje en curso */
+    } mqtt_reensamblador_t;
+
+    /**
+     * @brief Prepara el reensamblador; el buffer se reserva en el primer uso
+     */
+    void mqtt_reensamblador_init(mqtt_reensamblador_t *r, size_t capacidad);
+
+    /**
+     * @brief Añade un fragmento
+     *
+     * @param topic Tópico (solo en el primer fragmento; NULL o vacío en el resto)
+     * @param offset current_data_offset del evento
+     * @param total total_data_len del evento
+     */
+    mqtt_reensamblado_t mqtt_reensamblador_agregar(mqtt_reensamblador_t *r,
+                                                   const char *topic, size_t topic_len,
+                                                   const char *datos, size_t longitud,
+                                                   size_t offset, size_t total);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+#include <stddef.h>
+#include "cJSON.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Capacidad del router de tópicos
+     */
+#ifdef CONFIG_MQTT_ROUTER_MAX_RUTAS
+#define MQTT_ROUTER_MAX_RUTAS     CONFIG_MQTT_ROUTER_MAX_RUTAS
+#define MQTT_ROUTER_MAX_NODOS     CONFIG_MQTT_ROUTER_MAX_NODOS
+#else
+#define MQTT_ROUTER_MAX_RUTAS     16    // Manejadores registrados
+#define MQTT_ROUTER_MAX_NODOS     32    // Niveles de tópico distintos en el árbol
+#endif
+
+#define MQTT_ROUTER_MAX_SEGMENTO  32    // Longitud máxima de un nivel de tópico
+#define MQTT_ROUTER_MAX_TOPIC     128
+
+    /**
+     * @brief Destino de respuesta pedido por el emisor (MQTT 5)
+     *
+     * Response Topic y Correlation Data del PUBLISH recibido; las respuestas
+     * deben ir a topic con la misma correlacion.
+     */
+    typedef struct
+    {
+        const char *topic;        /**< No terminado en '\0' */
+        size_t topic_len;
+        const void *correlacion;  /**< NULL si el emisor no la envió */
+        size_t correlacion_len;
+    } mqtt_router_respuesta_t;
+
+    /**
+     * @brief Vista de un mensaje recibido, ya analizada
+     *
+     * El JSON se analiza una sola vez por mensaje, antes de llamar a los
+     * manejadores; json es NULL si el payload no es JSON válido.
+     */
+    typedef struct
+    {
+        const char *topic;        /**< Tópico terminado en '\0' */
+        const char *datos;        /**< Payload (no terminado en '\0') */
+        size_t longitud;          /**< Bytes de payload */
+        const cJSON *json;        /**< Raíz del JSON o NULL */
+        const mqtt_router_respuesta_t *respuesta; /**< NULL si no se pidió respuesta */
+    } mqtt_router_mensaje_t;
+
+    typedef void (*mqtt_router_manejador_t)(const mqtt_router_mensaje_t *mensaje, void *arg);
+
+    /**
+     * @brief Registra un manejador para un filtro de tópico
+     *
+     * El filtro admite los comodines MQTT '+' (un nivel) y '#' (el resto de
+     * niveles, solo al final). Registrar de nuevo el mismo filtro y manejador
+     * solo actualiza arg. Debe llamarse desde la inicialización o desde la
+     * tarea MQTT, no en paralelo con el despacho.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG si el filtro no es válido,
+     *         ESP_ERR_NO_MEM si no quedan rutas o nodos libres
+     */
+    esp_err_t mqtt_router_registrar(const char *filtro, mqtt_router_manejador_t manejador, void *arg);
+
+    /**
+     * @brief Entrega un mensaje a todos los manejadores cuyo filtro coincide
+     *
+     * @param respuesta Destino de respuesta del mensaje o NULL
+     * @return Número de manejadores llamados
+     */
+    int mqtt_router_despachar(const char *topic, size_t topic_len, const char *datos, size_t longitud,
+                              const mqtt_router_respuesta_t *respuesta);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,8 +1,18 @@
 #pragma once
+#include "esp_err.h"
+#include "json_writer.h"
+#include "cbor_writer.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C"
 {
+#endif
+
+#ifdef CONFIG_MQTT_TEMP_OFFLINE_INTERVALO_MIN
+#define MQTT_TEMP_OFFLINE_INTERVALO_MIN CONFIG_MQTT_TEMP_OFFLINE_INTERVALO_MIN
+#else
+#define MQTT_TEMP_OFFLINE_INTERVALO_MIN 15      // Sin conexión, una lectura al outbox cada 15 min
 #endif
 
     /**
@@ -56,11 +66,53 @@ extern "C"
      */
     void mqtt_service_enviar_json(const char *topic, int qos, int retain, ...);
 
+    /**
+     * @brief Termina y publica el JSON construido con un json_writer_t.
+     *
+     * Si el JSON no cupo en el buffer del escritor no se publica nada.
+     *
+     * @param topic   Tópico MQTT.
+     * @param w       Escritor con el mensaje (los niveles abiertos se cierran).
+     * @param qos     Nivel de calidad de servicio (0, 1 o 2).
+     * @param retain  1 para retener el mensaje en el broker, 0 para no retener.
+     * @return ESP_OK si se publicó, ESP_ERR_NO_MEM si el JSON se truncó,
+     *         ESP_ERR_INVALID_STATE si el cliente no está inicializado.
+     */
+    esp_err_t mqtt_service_enviar_json_writer(const char *topic, json_writer_t *w, int qos, int retain);
+
+    /**
+     * @brief Publica un payload binario (p. ej. CBOR).
+     *
+     * Igual que mqtt_service_enviar_dato(), pero con longitud explícita: el
+     * payload puede contener bytes nulos.
+     */
+    void mqtt_service_enviar_binario(const char *topic, const uint8_t *datos, size_t len, int qos, int retain);
+
+    /**
+     * @brief Termina y publica el CBOR construido con un cbor_writer_t.
+     *
+     * @return ESP_OK si se publicó, ESP_ERR_NO_MEM si no cupo en el buffer.
+     */
+    esp_err_t mqtt_service_enviar_cbor_writer(const char *topic, cbor_writer_t *w, int qos, int retain);
+
+    /**
+     * @brief Publica una respuesta con Correlation Data (MQTT 5).
+     *
+     * Sin MQTT 5 o sin conexión se publica como mqtt_service_enviar_json_writer(),
+     * sin la correlación.
+     *
+     * @param correlacion      Correlation Data del mensaje al que se responde.
+     * @param correlacion_len  Bytes de correlacion.
+     */
+    esp_err_t mqtt_service_enviar_respuesta(const char *topic, json_writer_t *w, int qos,
+                                            const void *correlacion, size_t correlacion_len);
+
     /**
      * @brief Notifica una nueva lectura de temperatura para envío por MQTT.
      * 
      * Esta función es no bloqueante y segura para llamar desde tareas de sensores.
-     * Si la cola está llena o MQTT no está disponible, la temperatura se descarta.
+     * Si la cola está llena la temperatura se descarta. Sin conexión MQTT se
+     * guarda en el outbox una lectura cada MQTT_TEMP_OFFLINE_INTERVALO_MIN.
      * 
      * @param temperatura La temperatura en grados Celsius
      */
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Parámetros del modo MQTT 5
+     */
+#ifdef CONFIG_MQTT_USAR_V5
+#define MQTT_V5_SESION_EXPIRA_S     CONFIG_MQTT_V5_SESION_EXPIRA_S
+#define MQTT_V5_MAX_ALIAS           CONFIG_MQTT_V5_MAX_ALIAS
+#define MQTT_V5_UMBRAL_ALIAS        CONFIG_MQTT_V5_UMBRAL_ALIAS
+#else
+#define MQTT_V5_SESION_EXPIRA_S     3600    // La sesión sobrevive a cortes de hasta una hora
+#define MQTT_V5_MAX_ALIAS           8       // No debe superar el Topic Alias Maximum del broker
+#define MQTT_V5_UMBRAL_ALIAS        2       // Publicaciones en un tópico antes de darle alias
+#endif
+
+#define MQTT_V5_CANDIDATOS          16      // Tópicos con contador de publicaciones
+
+    /**
+     * @brief Contadores del modo MQTT 5
+     */
+    typedef struct
+    {
+        uint32_t publicaciones;
+        uint32_t con_alias;           /**< Enviadas solo con el alias, sin tópico */
+        int32_t bytes_ahorrados;      /**< Bytes de tópico no enviados menos los de la propiedad alias */
+    } mqtt_v5_estadisticas_t;
+
+    /**
+     * @brief Ajusta la configuración del cliente para MQTT 5 con sesión persistente
+     */
+    void mqtt_v5_configurar(esp_mqtt_client_config_t *cfg);
+
+    /**
+     * @brief Fija las propiedades de conexión (expiración de sesión y user properties)
+     *
+     * Debe llamarse tras esp_mqtt_client_init() y antes de esp_mqtt_client_start().
+     */
+    esp_err_t mqtt_v5_iniciar(esp_mqtt_client_handle_t client);
+
+    /**
+     * @brief Olvida los alias enviados: el broker los descarta en cada conexión
+     */
+    void mqtt_v5_conectado(void);
+
+    /**
+     * @brief Publica con alias de tópico automático y, opcionalmente, Correlation Data
+     *
+     * Los tópicos que se publican a menudo reciben un alias. La primera
+     * publicación de cada conexión lleva tópico y alias; las siguientes con
+     * QoS 0 solo el alias. Con QoS > 0 se envía siempre el tópico, porque el
+     * cliente puede retransmitir el paquete en otra conexión donde el alias
+     * ya no existe.
+     *
+     * @param len Longitud de datos (0 = strlen)
+     * @return msg_id como esp_mqtt_client_publish()
+     */
+    int mqtt_v5_publicar(esp_mqtt_client_handle_t client, const char *topic, const char *datos, int len,
+                         int qos, int retain, const void *correlacion, size_t correlacion_len);
+
+    /**
+     * @brief Copia los contadores de publicaciones y ahorro de bytes
+     */
+    void mqtt_v5_obtener_estadisticas(mqtt_v5_estadisticas_t *estadisticas);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Tiempo y memoria de los handshakes TLS
+     *
+     * Los handshakes "reanudados" son los que ofrecieron un ticket de sesión
+     * guardado; si el servidor lo rechaza el handshake es completo pero se
+     * cuenta igual, por eso se guardan los tiempos de ambos grupos por
+     * separado para compararlos.
+     */
+    typedef struct
+    {
+        uint32_t completos;             /**< Handshakes sin ticket */
+        uint32_t reanudados;            /**< Handshakes ofreciendo un ticket */
+        uint32_t fallidos;
+        uint32_t ms_completo_ultimo;
+        uint32_t ms_completo_max;
+        uint32_t ms_reanudado_ultimo;
+        uint32_t ms_reanudado_max;
+        uint32_t heap_completo_max;     /**< Pico de heap consumido durante el handshake (bytes) */
+        uint32_t heap_reanudado_max;
+    } tls_sesion_estadisticas_t;
+
+    /**
+     * @brief Crea un transporte TLS para esp-mqtt que reanuda la sesión.
+     *
+     * El transporte usa esp-tls directamente con el CA del broker y guarda el
+     * ticket de sesión tras cada conexión; la siguiente conexión al mismo
+     * host lo ofrece y se ahorra la verificación de la cadena y el
+     * intercambio de claves. El ticket sobrevive a la destrucción del
+     * transporte (mqtt_service_stop/start).
+     *
+     * Hay un único transporte: mientras siga vivo, llamadas sucesivas lo
+     * devuelven en lugar de crear otro.
+     *
+     * @param ca_pem CA en PEM terminado en '\0'
+     * @param ca_len Longitud incluyendo el '\0'
+     * @return Transporte para network.transport, o NULL sin memoria
+     */
+    esp_transport_handle_t tls_sesion_crear_transporte(const uint8_t *ca_pem, size_t ca_len);
+
+    /**
+     * @brief Destruye el transporte si nadie lo ha hecho ya
+     *
+     * Llamar tras esp_mqtt_client_destroy(): si el cliente ya lo destruyó no
+     * hace nada, así que no hay doble liberación ni fuga en ningún caso.
+     */
+    void tls_sesion_liberar_transporte(void);
+
+    /**
+     * @brief Descarta el ticket guardado (p. ej. al cambiar de broker)
+     */
+    void tls_sesion_olvidar(void);
+
+    /**
+     * @brief Copia las estadísticas de handshake
+     */
+    void tls_sesion_obtener_estadisticas(tls_sesion_estadisticas_t *estadisticas);
+
+#ifdef __cplusplus
+}
+#endif
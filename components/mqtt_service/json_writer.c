@@ -0,0 +1,200 @@
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static void poner(json_writer_t *w, const char *datos, size_t n)
+{
+    if (w->desbordado) {
+        return;
+    }
+    // Siempre queda un byte reservado para el '\0'
+    if (w->longitud + n >= w->capacidad) {
+        w->desbordado = true;
+        return;
+    }
+    memcpy(w->buf + w->longitud, datos, n);
+    w->longitud += n;
+}
+
+static void poner_char(json_writer_t *w, char c)
+{
+    poner(w, &c, 1);
+}
+
+static void poner_cadena(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    poner_char(w, '"');
+    const char *tramo = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        // Copiar de golpe el tramo sin caracteres especiales
+        poner(w, tramo, s - tramo);
+        tramo = s + 1;
+        switch (c) {
+            case '"':  poner(w, "\\\"", 2); break;
+            case '\\': poner(w, "\\\\", 2); break;
+            case '\n': poner(w, "\\n", 2); break;
+            case '\r': poner(w, "\\r", 2); break;
+            case '\t': poner(w, "\\t", 2); break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+                poner(w, esc, sizeof(esc));
+                break;
+            }
+        }
+    }
+    poner(w, tramo, s - tramo);
+    poner_char(w, '"');
+}
+
+/**
+ * Separador y clave previos a cualquier valor
+ */
+static void prefijo(json_writer_t *w, const char *clave)
+{
+    if (w->profundidad > 0) {
+        uint8_t nivel = w->profundidad - 1;
+        // Un indicador y no un contador: no se desborda con muchos elementos
+        if (w->con_elementos[nivel]) {
+            poner_char(w, ',');
+        }
+        w->con_elementos[nivel] = true;
+        if (clave && w->cierre[nivel] == '}') {
+            poner_cadena(w, clave);
+            poner_char(w, ':');
+        }
+    }
+}
+
+static json_writer_t *abrir(json_writer_t *w, const char *clave, char apertura, char cierre)
+{
+    prefijo(w, clave);
+    if (w->profundidad >= JSON_WRITER_MAX_PROFUNDIDAD) {
+        w->desbordado = true;
+        return w;
+    }
+    poner_char(w, apertura);
+    w->con_elementos[w->profundidad] = false;
+    w->cierre[w->profundidad] = cierre;
+    w->profundidad++;
+    return w;
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t capacidad)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->capacidad = capacidad;
+    if (buf == NULL || capacidad == 0) {
+        w->desbordado = true;
+    }
+}
+
+json_writer_t *json_writer_objeto(json_writer_t *w, const char *clave)
+{
+    return abrir(w, clave, '{', '}');
+}
+
+json_writer_t *json_writer_array(json_writer_t *w, const char *clave)
+{
+    return abrir(w, clave, '[', ']');
+}
+
+json_writer_t *json_writer_cerrar(json_writer_t *w)
+{
+    if (w->profundidad > 0) {
+        w->profundidad--;
+        poner_char(w, w->cierre[w->profundidad]);
+    }
+    return w;
+}
+
+json_writer_t *json_writer_str(json_writer_t *w, const char *clave, const char *valor)
+{
+    prefijo(w, clave);
+    if (valor) {
+        poner_cadena(w, valor);
+    } else {
+        poner(w, "null", 4);
+    }
+    return w;
+}
+
+static void poner_uint(json_writer_t *w, uint64_t valor)
+{
+    char digitos[20];
+    size_t n = sizeof(digitos);
+    do {
+        digitos[--n] = (char)('0' + valor % 10);
+        valor /= 10;
+    } while (valor);
+    poner(w, digitos + n, sizeof(digitos) - n);
+}
+
+json_writer_t *json_writer_int(json_writer_t *w, const char *clave, int64_t valor)
+{
+    prefijo(w, clave);
+    if (valor < 0) {
+        poner_char(w, '-');
+        poner_uint(w, (uint64_t)0 - (uint64_t)valor);
+    } else {
+        poner_uint(w, (uint64_t)valor);
+    }
+    return w;
+}
+
+json_writer_t *json_writer_uint(json_writer_t *w, const char *clave, uint64_t valor)
+{
+    prefijo(w, clave);
+    poner_uint(w, valor);
+    return w;
+}
+
+json_writer_t *json_writer_float(json_writer_t *w, const char *clave, float valor, uint8_t decimales)
+{
+    prefijo(w, clave);
+    if (isnan(valor) || isinf(valor)) {
+        poner(w, "null", 4);
+        return w;
+    }
+    char numero[32];
+    int n = snprintf(numero, sizeof(numero), "%.*f", decimales > 6 ? 6 : decimales, (double)valor);
+    if (n > 0 && n < (int)sizeof(numero)) {
+        poner(w, numero, n);
+    } else {
+        w->desbordado = true;
+    }
+    return w;
+}
+
+json_writer_t *json_writer_bool(json_writer_t *w, const char *clave, bool valor)
+{
+    prefijo(w, clave);
+    if (valor) {
+        poner(w, "true", 4);
+    } else {
+        poner(w, "false", 5);
+    }
+    return w;
+}
+
+const char *json_writer_terminar(json_writer_t *w)
+{
+    while (w->profundidad > 0) {
+        json_writer_cerrar(w);
+    }
+    if (w->desbordado) {
+        if (w->buf && w->capacidad) {
+            w->buf[0] = '\0';
+        }
+        return NULL;
+    }
+    w->buf[w->longitud] = '\0';
+    return w->buf;
+}
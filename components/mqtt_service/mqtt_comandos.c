@@ -0,0 +1,303 @@
+#include "mqtt_comandos.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mqtt_service.h"
+#include "wifi_sta.h"
+
+static const char *TAG = "mqtt_comandos";
+
+// Destino de los acks; topic vacío = dispositivos/<mac>/respuesta
+typedef struct {
+    char topic[MQTT_ROUTER_MAX_TOPIC];
+    uint8_t correlacion[MQTT_COMANDO_MAX_CORRELACION];
+    uint8_t correlacion_len;
+} destino_t;
+
+typedef struct {
+    const char *nombre;
+    char id[MQTT_COMANDO_MAX_ID];
+    destino_t destino;
+    mqtt_comando_fn_t fn;
+    int64_t recibido_us;
+    uint8_t params[MQTT_COMANDO_MAX_PARAMS];
+} comando_t;
+
+typedef struct {
+    mqtt_comando_metricas_t publicas;
+    uint64_t total_suma_ms;
+} metricas_t;
+
+// Espera máxima a que la tarea termine el comando en curso al detenerla
+#define COMANDOS_TIMEOUT_SALIDA_MS  10000
+
+static QueueHandle_t s_cola = NULL;
+static TaskHandle_t s_tarea = NULL;
+static SemaphoreHandle_t s_tarea_terminada = NULL;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool s_deteniendo = false;   // Salida pedida; mqtt_comandos_iniciar() la anula
+static SemaphoreHandle_t s_mutex_metricas = NULL;
+static metricas_t s_metricas[MQTT_COMANDO_MAX_TIPOS];
+static size_t s_num_metricas = 0;
+
+static void publicar_ack(const char *nombre, const char *id, const destino_t *destino, const char *estado,
+                         esp_err_t err, int32_t espera_ms, int32_t total_ms)
+{
+    char topic[MQTT_ROUTER_MAX_TOPIC];
+    if (destino->topic[0] != '\0') {
+        strlcpy(topic, destino->topic, sizeof(topic));
+    } else {
+        snprintf(topic, sizeof(topic), "dispositivos/%s/respuesta", sta_wifi_get_mac_clean());
+    }
+
+    char json[192];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "id", id);
+    json_writer_str(&w, "comando", nombre);
+    json_writer_str(&w, "estado", estado);
+    json_writer_str(&w, "tipo", "respuesta");
+    if (err != ESP_OK) {
+        json_writer_str(&w, "error", esp_err_to_name(err));
+    }
+    if (espera_ms >= 0) {
+        json_writer_int(&w, "espera_ms", espera_ms);
+    }
+    if (total_ms >= 0) {
+        json_writer_int(&w, "latencia_ms", total_ms);
+    }
+    if (destino->correlacion_len > 0) {
+        mqtt_service_enviar_respuesta(topic, &w, 1, destino->correlacion, destino->correlacion_len);
+    } else {
+        mqtt_service_enviar_json_writer(topic, &w, 1, 0);
+    }
+}
+
+static void copiar_destino(destino_t *destino, const mqtt_router_respuesta_t *respuesta)
+{
+    memset(destino, 0, sizeof(*destino));
+    if (respuesta == NULL || respuesta->topic_len == 0) {
+        return;
+    }
+    if (respuesta->topic_len >= sizeof(destino->topic) ||
+        respuesta->correlacion_len > sizeof(destino->correlacion)) {
+        ESP_LOGW(TAG, "Response Topic o Correlation Data demasiado largos, se usa el tópico por defecto");
+        return;
+    }
+    memcpy(destino->topic, respuesta->topic, respuesta->topic_len);
+    if (respuesta->correlacion != NULL) {
+        memcpy(destino->correlacion, respuesta->correlacion, respuesta->correlacion_len);
+        destino->correlacion_len = respuesta->correlacion_len;
+    }
+}
+
+static void registrar_metricas(const char *nombre, esp_err_t err, uint32_t espera_ms, uint32_t total_ms)
+{
+    xSemaphoreTake(s_mutex_metricas, portMAX_DELAY);
+
+    metricas_t *m = NULL;
+    for (size_t i = 0; i < s_num_metricas; i++) {
+        if (strcmp(s_metricas[i].publicas.nombre, nombre) == 0) {
+            m = &s_metricas[i];
+            break;
+        }
+    }
+    if (m == NULL && s_num_metricas < MQTT_COMANDO_MAX_TIPOS) {
+        m = &s_metricas[s_num_metricas++];
+        memset(m, 0, sizeof(*m));
+        m->publicas.nombre = nombre;
+    }
+    if (m != NULL) {
+        m->publicas.ejecutados++;
+        if (err != ESP_OK) {
+            m->publicas.fallidos++;
+        }
+        if (espera_ms > m->publicas.espera_max_ms) {
+            m->publicas.espera_max_ms = espera_ms;
+        }
+        if (total_ms > m->publicas.total_max_ms) {
+            m->publicas.total_max_ms = total_ms;
+        }
+        m->total_suma_ms += total_ms;
+        m->publicas.total_medio_ms = (uint32_t)(m->total_suma_ms / m->publicas.ejecutados);
+    }
+
+    xSemaphoreGive(s_mutex_metricas);
+}
+
+/*
+ * Tarea del ejecutor: los comandos lentos (cambios de modo, OTA) no bloquean la tarea MQTT.
+ * Un comando sin función es la orden de salida de mqtt_comandos_detener(); se
+ * ignora si entretanto se volvió a iniciar el servicio.
+ */
+static void mqtt_comandos_task(void *pvParameters)
+{
+    static comando_t cmd;
+
+    while (1) {
+        if (xQueueReceive(s_cola, &cmd, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (cmd.fn == NULL) {
+            portENTER_CRITICAL(&s_mux);
+            bool salir = s_deteniendo;
+            if (salir) {
+                s_deteniendo = false;
+                s_tarea = NULL;
+            }
+            portEXIT_CRITICAL(&s_mux);
+            if (salir) {
+                break;
+            }
+            continue;
+        }
+
+        int64_t inicio_us = esp_timer_get_time();
+        esp_err_t err = cmd.fn(cmd.params);
+        int64_t fin_us = esp_timer_get_time();
+
+        uint32_t espera_ms = (uint32_t)((inicio_us - cmd.recibido_us) / 1000);
+        uint32_t total_ms = (uint32_t)((fin_us - cmd.recibido_us) / 1000);
+        registrar_metricas(cmd.nombre, err, espera_ms, total_ms);
+
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Comando %s completado en %" PRIu32 " ms (%" PRIu32 " ms en cola)",
+                     cmd.nombre, total_ms, espera_ms);
+        } else {
+            ESP_LOGE(TAG, "Comando %s fallido: %s", cmd.nombre, esp_err_to_name(err));
+        }
+
+        if (cmd.id[0] != '\0') {
+            publicar_ack(cmd.nombre, cmd.id, &cmd.destino, err == ESP_OK ? "completado" : "fallido", err,
+                         espera_ms, total_ms);
+        }
+    }
+
+    ESP_LOGI(TAG, "Ejecutor de comandos detenido");
+    xSemaphoreGive(s_tarea_terminada);
+    vTaskDelete(NULL);
+}
+
+esp_err_t mqtt_comandos_iniciar(void)
+{
+    if (s_mutex_metricas == NULL) {
+        s_mutex_metricas = xSemaphoreCreateMutex();
+        if (s_mutex_metricas == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_cola == NULL) {
+        s_cola = xQueueCreate(MQTT_COMANDOS_COLA, sizeof(comando_t));
+        if (s_cola == NULL) {
+            ESP_LOGE(TAG, "Error creando cola de comandos");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_tarea_terminada == NULL) {
+        s_tarea_terminada = xSemaphoreCreateBinary();
+        if (s_tarea_terminada == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Si la tarea anterior aún no ha salido (comando largo), sigue siendo el ejecutor
+    portENTER_CRITICAL(&s_mux);
+    s_deteniendo = false;
+    bool crear = (s_tarea == NULL);
+    portEXIT_CRITICAL(&s_mux);
+
+    if (crear) {
+        xSemaphoreTake(s_tarea_terminada, 0);
+        BaseType_t res = xTaskCreate(mqtt_comandos_task, "mqtt_comandos", MQTT_COMANDOS_STACK, NULL,
+                                     tskIDLE_PRIORITY + 4, &s_tarea);
+        if (res != pdPASS) {
+            ESP_LOGE(TAG, "Error creando tarea de comandos");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+void mqtt_comandos_detener(void)
+{
+    portENTER_CRITICAL(&s_mux);
+    TaskHandle_t tarea = s_tarea;
+    s_deteniendo = (tarea != NULL);
+    portEXIT_CRITICAL(&s_mux);
+    if (tarea == NULL || s_cola == NULL) {
+        return;
+    }
+
+    // Se descartan los pendientes y la orden de salida queda la primera en la cola
+    static const comando_t salir = { .nombre = "salir" };
+    xQueueReset(s_cola);
+    xQueueSend(s_cola, &salir, 0);
+
+    // Desde un comando (p. ej. paso a configuración) la tarea sale al terminarlo
+    if (tarea == xTaskGetCurrentTaskHandle()) {
+        return;
+    }
+    if (xSemaphoreTake(s_tarea_terminada, pdMS_TO_TICKS(COMANDOS_TIMEOUT_SALIDA_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "El comando en curso no terminó en %d ms; el ejecutor saldrá al acabarlo",
+                 COMANDOS_TIMEOUT_SALIDA_MS);
+    }
+}
+
+esp_err_t mqtt_comandos_encolar(const char *nombre, const char *id, const mqtt_router_respuesta_t *respuesta,
+                                mqtt_comando_fn_t fn, const void *params, size_t longitud)
+{
+    if (nombre == NULL || fn == NULL || longitud > MQTT_COMANDO_MAX_PARAMS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_cola == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    comando_t cmd = {
+        .nombre = nombre,
+        .fn = fn,
+        .recibido_us = esp_timer_get_time(),
+    };
+    if (id != NULL) {
+        strlcpy(cmd.id, id, sizeof(cmd.id));
+        copiar_destino(&cmd.destino, respuesta);
+    }
+    if (params != NULL && longitud > 0) {
+        memcpy(cmd.params, params, longitud);
+    }
+
+    if (xQueueSend(s_cola, &cmd, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Cola de comandos llena, descartando %s", nombre);
+        registrar_metricas(nombre, ESP_ERR_NO_MEM, 0, 0);
+        if (id != NULL) {
+            publicar_ack(nombre, id, &cmd.destino, "fallido", ESP_ERR_NO_MEM, -1, -1);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (id != NULL) {
+        publicar_ack(nombre, id, &cmd.destino, "aceptado", ESP_OK, -1, -1);
+    }
+    return ESP_OK;
+}
+
+size_t mqtt_comandos_obtener_metricas(mqtt_comando_metricas_t *metricas, size_t max)
+{
+    if (s_mutex_metricas == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(s_mutex_metricas, portMAX_DELAY);
+    size_t n = (s_num_metricas < max) ? s_num_metricas : max;
+    for (size_t i = 0; i < n; i++) {
+        metricas[i] = s_metricas[i].publicas;
+    }
+    xSemaphoreGive(s_mutex_metricas);
+    return n;
+}
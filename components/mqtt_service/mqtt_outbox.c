@@ -0,0 +1,422 @@
+#include "mqtt_outbox.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "mqtt_outbox";
+
+/*
+ * Log circular de registros sobre la partición, sector a sector:
+ *
+ *   [cabecera 16 B][topic][payload][relleno hasta 4 B] [cabecera]...
+ *
+ * Un registro nunca cruza un sector. El estado solo pasa de 1 a 0 en flash,
+ * así que se reescribe en el sitio: ESCRIBIENDO -> VALIDO -> CONFIRMADO.
+ * Los sectores que quedan detrás del cursor de lectura se borran.
+ */
+#define OUTBOX_SECTOR       4096
+#define OUTBOX_MAGIC        0xB0C5
+#define ESTADO_ESCRIBIENDO  0xFF
+#define ESTADO_VALIDO       0xFE
+#define ESTADO_CONFIRMADO   0xFC
+
+#define ALINEAR4(x) (((x) + 3u) & ~3u)
+
+typedef struct {
+    uint16_t magic;
+    uint8_t estado;
+    uint8_t flags;              // bits 0-1: qos, bit 2: retain
+    uint16_t topic_len;
+    uint16_t longitud;
+    uint32_t seq;
+    uint32_t crc;               // CRC32 de topic + payload
+} cabecera_t;
+
+_Static_assert(sizeof(cabecera_t) == 16, "cabecera del outbox debe ocupar 16 bytes");
+
+// Posición en el log; offset puede valer OUTBOX_SECTOR (sector agotado)
+typedef struct {
+    uint32_t sector;
+    uint32_t offset;
+} posicion_t;
+
+static const esp_partition_t *s_particion = NULL;
+static SemaphoreHandle_t s_mutex = NULL;
+static uint32_t s_num_sectores = 0;
+static uint32_t s_cola = 0;         // Sector más antiguo sin borrar
+static posicion_t s_escritura;      // Dónde va el próximo registro
+static posicion_t s_lectura;        // Desde dónde buscar pendientes
+static uint32_t s_seq = 0;
+static mqtt_outbox_estadisticas_t s_estadisticas = {0};
+
+static inline uint32_t inicio_sector(uint32_t sector)
+{
+    return sector * OUTBOX_SECTOR;
+}
+
+static inline uint32_t direccion_de(const posicion_t *pos)
+{
+    return pos->sector * OUTBOX_SECTOR + pos->offset;
+}
+
+static inline uint32_t tam_registro(const cabecera_t *cab)
+{
+    return ALINEAR4(sizeof(cabecera_t) + cab->topic_len + cab->longitud);
+}
+
+static bool leer_cabecera(const posicion_t *pos, cabecera_t *cab)
+{
+    if (pos->offset + sizeof(cabecera_t) > OUTBOX_SECTOR) {
+        return false;
+    }
+    if (esp_partition_read(s_particion, direccion_de(pos), cab, sizeof(*cab)) != ESP_OK) {
+        return false;
+    }
+    return cab->magic == OUTBOX_MAGIC &&
+           cab->topic_len > 0 && cab->topic_len < MQTT_OUTBOX_MAX_TOPIC &&
+           cab->longitud <= MQTT_OUTBOX_MAX_MENSAJE &&
+           pos->offset + tam_registro(cab) <= OUTBOX_SECTOR;
+}
+
+static esp_err_t escribir_estado(uint32_t direccion, uint8_t estado)
+{
+    return esp_partition_write(s_particion, direccion + offsetof(cabecera_t, estado), &estado, 1);
+}
+
+static esp_err_t borrar_sector(uint32_t sector)
+{
+    return esp_partition_erase_range(s_particion, inicio_sector(sector), OUTBOX_SECTOR);
+}
+
+/**
+ * Cuenta los registros VALIDO de un sector
+ */
+static uint32_t contar_validos(uint32_t sector)
+{
+    uint32_t validos = 0;
+    posicion_t pos = { .sector = sector, .offset = 0 };
+    cabecera_t cab;
+    while (leer_cabecera(&pos, &cab)) {
+        if (cab.estado == ESTADO_VALIDO) {
+            validos++;
+        }
+        pos.offset += tam_registro(&cab);
+    }
+    return validos;
+}
+
+/**
+ * Pasa la escritura al sector siguiente; si es la cola, el outbox está lleno y
+ * se descarta el sector más antiguo
+ */
+static void avanzar_sector_escritura(void)
+{
+    uint32_t siguiente = (s_escritura.sector + 1) % s_num_sectores;
+
+    if (siguiente == s_cola) {
+        uint32_t perdidos = contar_validos(s_cola);
+        s_estadisticas.descartados += perdidos;
+        s_estadisticas.pendientes -= perdidos;
+        ESP_LOGW(TAG, "Outbox lleno: descartando sector %" PRIu32 " (%" PRIu32 " mensajes sin enviar)",
+                 s_cola, perdidos);
+        s_cola = (s_cola + 1) % s_num_sectores;
+        if (s_lectura.sector == siguiente) {
+            s_lectura = (posicion_t){ .sector = s_cola, .offset = 0 };
+        }
+    }
+
+    // El sector debería estar borrado; si no, se borra ahora
+    uint16_t magic = 0;
+    esp_partition_read(s_particion, inicio_sector(siguiente), &magic, sizeof(magic));
+    if (magic != 0xFFFF) {
+        borrar_sector(siguiente);
+    }
+    s_escritura = (posicion_t){ .sector = siguiente, .offset = 0 };
+}
+
+/**
+ * Borra los sectores de la cola que ya no tienen pendientes
+ */
+static void compactar(void)
+{
+    while (s_cola != s_lectura.sector && s_cola != s_escritura.sector) {
+        if (borrar_sector(s_cola) != ESP_OK) {
+            break;
+        }
+        s_estadisticas.compactados++;
+        s_cola = (s_cola + 1) % s_num_sectores;
+    }
+}
+
+/**
+ * Reconstruye cursores y contadores recorriendo el log
+ */
+static void recuperar_log(void)
+{
+    bool hay_datos = false;
+    uint32_t mas_nuevo = 0;
+    uint32_t seq_mas_nuevo = 0;
+
+    for (uint32_t s = 0; s < s_num_sectores; s++) {
+        cabecera_t cab;
+        posicion_t pos = { .sector = s, .offset = 0 };
+        if (esp_partition_read(s_particion, inicio_sector(s), &cab, sizeof(cab)) != ESP_OK) {
+            continue;
+        }
+        if (cab.magic == 0xFFFF) {
+            continue;
+        }
+        if (!leer_cabecera(&pos, &cab)) {
+            // Cabecera a medio escribir al principio del sector: no se puede ordenar
+            borrar_sector(s);
+            continue;
+        }
+        if (!hay_datos || cab.seq > seq_mas_nuevo) {
+            mas_nuevo = s;
+            seq_mas_nuevo = cab.seq;
+        }
+        hay_datos = true;
+    }
+
+    s_cola = 0;
+    s_escritura = (posicion_t){0};
+    s_lectura = (posicion_t){0};
+    s_seq = 0;
+    if (!hay_datos) {
+        return;
+    }
+
+    // Los sectores ocupados son contiguos: el más antiguo es el primero tras el más nuevo
+    s_cola = (mas_nuevo + 1) % s_num_sectores;
+    while (s_cola != mas_nuevo) {
+        uint16_t magic;
+        esp_partition_read(s_particion, inicio_sector(s_cola), &magic, sizeof(magic));
+        if (magic != 0xFFFF) {
+            break;
+        }
+        s_cola = (s_cola + 1) % s_num_sectores;
+    }
+
+    bool lectura_fijada = false;
+    uint32_t sector = s_cola;
+    while (true) {
+        posicion_t pos = { .sector = sector, .offset = 0 };
+        cabecera_t cab;
+        while (leer_cabecera(&pos, &cab)) {
+            if (cab.estado == ESTADO_VALIDO) {
+                s_estadisticas.pendientes++;
+                if (!lectura_fijada) {
+                    s_lectura = pos;
+                    lectura_fijada = true;
+                }
+            }
+            if (cab.seq >= s_seq) {
+                s_seq = cab.seq + 1;
+            }
+            pos.offset += tam_registro(&cab);
+        }
+
+        if (sector == mas_nuevo) {
+            // Tras el último registro: si hay basura de una escritura cortada, sector agotado
+            uint16_t magic = 0xFFFF;
+            if (pos.offset + sizeof(cabecera_t) <= OUTBOX_SECTOR) {
+                esp_partition_read(s_particion, direccion_de(&pos), &magic, sizeof(magic));
+            }
+            if (magic != 0xFFFF) {
+                pos.offset = OUTBOX_SECTOR;
+            }
+            s_escritura = pos;
+            break;
+        }
+        sector = (sector + 1) % s_num_sectores;
+    }
+
+    if (!lectura_fijada) {
+        s_lectura = s_escritura;
+    }
+    compactar();
+}
+
+esp_err_t mqtt_outbox_init(void)
+{
+    if (s_particion != NULL) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t *particion = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY,
+                                                                MQTT_OUTBOX_PARTICION);
+    if (particion == NULL || particion->size < 2 * OUTBOX_SECTOR) {
+        ESP_LOGE(TAG, "Partición '%s' no encontrada o demasiado pequeña", MQTT_OUTBOX_PARTICION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_particion = particion;
+    s_num_sectores = particion->size / OUTBOX_SECTOR;
+    recuperar_log();
+    xSemaphoreGive(s_mutex);
+
+    ESP_LOGI(TAG, "Outbox en '%s': %" PRIu32 " sectores, %" PRIu32 " mensajes pendientes",
+             MQTT_OUTBOX_PARTICION, s_num_sectores, s_estadisticas.pendientes);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_outbox_agregar(const char *topic, const char *datos, size_t longitud, int qos, int retain)
+{
+    if (s_particion == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len == 0 || topic_len >= MQTT_OUTBOX_MAX_TOPIC || longitud > MQTT_OUTBOX_MAX_MENSAJE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    cabecera_t cab = {
+        .magic = OUTBOX_MAGIC,
+        .estado = ESTADO_ESCRIBIENDO,
+        .flags = (uint8_t)((qos & 0x03) | (retain ? 0x04 : 0)),
+        .topic_len = (uint16_t)topic_len,
+        .longitud = (uint16_t)longitud,
+    };
+    cab.crc = esp_rom_crc32_le(0, (const uint8_t *)topic, topic_len);
+    cab.crc = esp_rom_crc32_le(cab.crc, (const uint8_t *)datos, longitud);
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    if (s_escritura.offset + tam_registro(&cab) > OUTBOX_SECTOR) {
+        avanzar_sector_escritura();
+    }
+    cab.seq = s_seq++;
+
+    // El registro solo cuenta cuando el estado pasa a VALIDO, tras escribir todo
+    uint32_t direccion = direccion_de(&s_escritura);
+    esp_err_t err = esp_partition_write(s_particion, direccion, &cab, sizeof(cab));
+    if (err == ESP_OK) {
+        err = esp_partition_write(s_particion, direccion + sizeof(cab), topic, topic_len);
+    }
+    if (err == ESP_OK && longitud > 0) {
+        err = esp_partition_write(s_particion, direccion + sizeof(cab) + topic_len, datos, longitud);
+    }
+    if (err == ESP_OK) {
+        err = escribir_estado(direccion, ESTADO_VALIDO);
+    }
+    s_escritura.offset += tam_registro(&cab);
+
+    if (err == ESP_OK) {
+        s_estadisticas.pendientes++;
+        s_estadisticas.agregados++;
+    } else {
+        ESP_LOGE(TAG, "Error escribiendo en el outbox: %s", esp_err_to_name(err));
+    }
+
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+bool mqtt_outbox_pendiente(void)
+{
+    return s_particion != NULL && s_estadisticas.pendientes > 0;
+}
+
+esp_err_t mqtt_outbox_siguiente(mqtt_outbox_entrada_t *entrada, char *topic, char *datos)
+{
+    if (s_particion == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    while (s_estadisticas.pendientes > 0) {
+        if (s_lectura.sector == s_escritura.sector && s_lectura.offset >= s_escritura.offset) {
+            break;
+        }
+        uint32_t direccion = direccion_de(&s_lectura);
+        cabecera_t cab;
+        if (!leer_cabecera(&s_lectura, &cab)) {
+            // Fin de los registros del sector
+            s_lectura = (posicion_t){ .sector = (s_lectura.sector + 1) % s_num_sectores, .offset = 0 };
+            continue;
+        }
+        if (cab.estado != ESTADO_VALIDO) {
+            s_lectura.offset += tam_registro(&cab);
+            continue;
+        }
+
+        esp_partition_read(s_particion, direccion + sizeof(cab), topic, cab.topic_len);
+        esp_partition_read(s_particion, direccion + sizeof(cab) + cab.topic_len, datos, cab.longitud);
+        uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)topic, cab.topic_len);
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)datos, cab.longitud);
+        if (crc != cab.crc) {
+            ESP_LOGW(TAG, "Registro %" PRIu32 " corrupto, se descarta", cab.seq);
+            escribir_estado(direccion, ESTADO_CONFIRMADO);
+            s_estadisticas.pendientes--;
+            s_estadisticas.descartados++;
+            s_lectura.offset += tam_registro(&cab);
+            continue;
+        }
+
+        topic[cab.topic_len] = '\0';
+        entrada->seq = cab.seq;
+        entrada->direccion = direccion;
+        entrada->longitud = cab.longitud;
+        entrada->qos = cab.flags & 0x03;
+        entrada->retain = (cab.flags & 0x04) ? 1 : 0;
+        err = ESP_OK;
+        break;
+    }
+
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+esp_err_t mqtt_outbox_confirmar(const mqtt_outbox_entrada_t *entrada)
+{
+    if (s_particion == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    posicion_t pos = { .sector = entrada->direccion / OUTBOX_SECTOR, .offset = entrada->direccion % OUTBOX_SECTOR };
+    cabecera_t cab;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (leer_cabecera(&pos, &cab) && cab.seq == entrada->seq && cab.estado == ESTADO_VALIDO) {
+        err = escribir_estado(entrada->direccion, ESTADO_CONFIRMADO);
+        if (err == ESP_OK) {
+            s_estadisticas.pendientes--;
+            s_estadisticas.confirmados++;
+            if (s_lectura.sector == pos.sector && s_lectura.offset == pos.offset) {
+                s_lectura.offset += tam_registro(&cab);
+            }
+            compactar();
+        }
+    }
+
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+void mqtt_outbox_obtener_estadisticas(mqtt_outbox_estadisticas_t *estadisticas)
+{
+    if (s_mutex == NULL) {
+        memset(estadisticas, 0, sizeof(*estadisticas));
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *estadisticas = s_estadisticas;
+    xSemaphoreGive(s_mutex);
+}
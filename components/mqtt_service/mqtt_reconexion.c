@@ -0,0 +1,211 @@
+#include "mqtt_reconexion.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "wifi_sta.h"
+
+static const char *TAG = "mqtt_reconexion";
+
+#define NOTIF_CONECTADO         (1 << 0)
+#define NOTIF_DESCONECTADO      (1 << 1)
+#define NOTIF_WIFI_ARRIBA       (1 << 2)
+#define NOTIF_WIFI_ABAJO        (1 << 3)
+#define NOTIF_SALIR             (1 << 4)
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static TaskHandle_t s_tarea = NULL;
+static TaskHandle_t s_esperando_salida = NULL;  // Quien pidió detener la tarea
+static volatile bool s_conectado = false;   // Último estado avisado por el cliente
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_reconexion_estadisticas_t s_estadisticas;
+
+static uint32_t aleatorio_entre(uint32_t min, uint32_t max)
+{
+    return (max > min) ? min + esp_random() % (max - min + 1) : min;
+}
+
+/**
+ * Backoff con jitter decorrelado: espera = min(máx, aleatorio(base, 3 * anterior)).
+ * Cada dispositivo sigue su propia secuencia, así que un corte del AP no
+ * produce reintentos sincronizados de todo el sitio.
+ */
+static uint32_t siguiente_espera(uint32_t anterior)
+{
+    uint64_t tope = (uint64_t)anterior * 3;
+    if (tope > MQTT_RECONEXION_MAX_MS) {
+        tope = MQTT_RECONEXION_MAX_MS;
+    }
+    return aleatorio_entre(MQTT_RECONEXION_BASE_MS, (uint32_t)tope);
+}
+
+static void registrar_reconexion(uint32_t ms)
+{
+    size_t cubeta = 0;
+    while (cubeta < MQTT_RECONEXION_CUBETAS - 1 && ms >= (1000u << cubeta)) {
+        cubeta++;
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    s_estadisticas.reconexiones++;
+    s_estadisticas.ultima_ms = ms;
+    if (ms > s_estadisticas.maxima_ms) {
+        s_estadisticas.maxima_ms = ms;
+    }
+    if (ms > MQTT_RECONEXION_SLO_MS) {
+        s_estadisticas.fuera_slo++;
+    }
+    s_estadisticas.cubetas[cubeta]++;
+    uint32_t reconexiones = s_estadisticas.reconexiones;
+    uint32_t fuera_slo = s_estadisticas.fuera_slo;
+    portEXIT_CRITICAL(&s_mux);
+
+    ESP_LOGI(TAG, "Reconectado en %" PRIu32 " ms (%" PRIu32 " de %" PRIu32 " reconexiones por encima de %d ms)",
+             ms, fuera_slo, reconexiones, MQTT_RECONEXION_SLO_MS);
+}
+
+static void enlace_wifi_cb(bool conectado, void *arg)
+{
+    if (s_tarea != NULL) {
+        xTaskNotify(s_tarea, conectado ? NOTIF_WIFI_ARRIBA : NOTIF_WIFI_ABAJO, eSetBits);
+    }
+}
+
+static void mqtt_reconexion_task(void *pvParameters)
+{
+    bool pendiente = false;             // Hay que reconectar (lo marca el primer DISCONNECTED)
+    bool conectado_antes = false;       // Ya hubo una conexión: lo siguiente es reconectar
+    bool wifi_arriba = sta_wifi_is_connected();
+    int64_t desconectado_us = 0;        // Inicio del corte en curso
+    uint32_t espera_ms = MQTT_RECONEXION_BASE_MS;
+    TickType_t proximo_intento = 0;
+    uint32_t bits;
+
+    ESP_LOGI(TAG, "mqtt_reconexion_task watermark=%u", uxTaskGetStackHighWaterMark(NULL));
+
+    while (1) {
+        // Sin nada pendiente o sin WiFi no hay plazo: solo se espera a un aviso
+        TickType_t espera = portMAX_DELAY;
+        if (pendiente && wifi_arriba) {
+            TickType_t ahora = xTaskGetTickCount();
+            espera = ((int32_t)(proximo_intento - ahora) > 0) ? proximo_intento - ahora : 0;
+        }
+
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, espera) == pdTRUE) {
+            if (bits & NOTIF_SALIR) {
+                break;
+            }
+            if (bits & NOTIF_WIFI_ABAJO) {
+                wifi_arriba = false;
+            }
+            // Los avisos pueden llegar juntos: manda el último estado del cliente
+            if (bits & (NOTIF_CONECTADO | NOTIF_DESCONECTADO)) {
+                if (s_conectado) {
+                    if (pendiente && conectado_antes) {
+                        registrar_reconexion((uint32_t)((esp_timer_get_time() - desconectado_us) / 1000));
+                    }
+                    conectado_antes = true;
+                    pendiente = false;
+                    espera_ms = MQTT_RECONEXION_BASE_MS;
+                } else if (!pendiente) {
+                    pendiente = true;
+                    desconectado_us = esp_timer_get_time();
+                    espera_ms = conectado_antes ? siguiente_espera(MQTT_RECONEXION_BASE_MS) : 0;
+                    proximo_intento = xTaskGetTickCount() + pdMS_TO_TICKS(espera_ms);
+                    ESP_LOGI(TAG, "Desconectado, primer intento en %" PRIu32 " ms", espera_ms);
+                }
+            }
+            if (bits & NOTIF_WIFI_ARRIBA) {
+                wifi_arriba = true;
+                // El enlace acaba de volver: se reintenta pronto, pero con jitter.
+                // En el arranque el cliente se inicia antes de tener IP y su primer
+                // intento falla; con la primera IP se intenta sin esperar
+                if (pendiente) {
+                    espera_ms = conectado_antes ? siguiente_espera(MQTT_RECONEXION_BASE_MS) : 0;
+                    proximo_intento = xTaskGetTickCount() + pdMS_TO_TICKS(espera_ms);
+                    ESP_LOGI(TAG, "WiFi recuperado, intento en %" PRIu32 " ms", espera_ms);
+                }
+            }
+            continue;
+        }
+
+        // Plazo cumplido con WiFi: se adelanta el reintento del cliente y se programa
+        // el siguiente por si falla. ESP_FAIL solo indica que el cliente no estaba
+        // esperando (p. ej. ya está conectando): se vuelve a probar en el siguiente plazo
+        if (pendiente && wifi_arriba && s_client != NULL) {
+            esp_err_t err = esp_mqtt_client_reconnect(s_client);
+            portENTER_CRITICAL(&s_mux);
+            s_estadisticas.intentos++;
+            portEXIT_CRITICAL(&s_mux);
+
+            espera_ms = siguiente_espera(espera_ms);
+            proximo_intento = xTaskGetTickCount() + pdMS_TO_TICKS(espera_ms);
+            ESP_LOGI(TAG, "Intento de reconexión (%s), siguiente en %" PRIu32 " ms si falla",
+                     esp_err_to_name(err), espera_ms);
+        }
+    }
+
+    TaskHandle_t esperando = s_esperando_salida;
+    s_tarea = NULL;
+    if (esperando != NULL) {
+        xTaskNotifyGive(esperando);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t mqtt_reconexion_iniciar(esp_mqtt_client_handle_t client)
+{
+    s_client = client;
+    s_conectado = false;
+    // Antes de crear la tarea: si el enlace sube mientras arranca, o lo lee
+    // al empezar o le llega el aviso
+    sta_wifi_registrar_enlace_cb(enlace_wifi_cb, NULL);
+    if (s_tarea == NULL) {
+        if (xTaskCreate(mqtt_reconexion_task, "mqtt_reconexion", 2560, NULL, 5, &s_tarea) != pdPASS) {
+            ESP_LOGE(TAG, "Error creando tarea de reconexión");
+            sta_wifi_registrar_enlace_cb(NULL, NULL);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+void mqtt_reconexion_detener(void)
+{
+    sta_wifi_registrar_enlace_cb(NULL, NULL);
+    if (s_tarea != NULL) {
+        // La tarea sale por su cuenta para no cortarla a mitad de esp_mqtt_client_reconnect()
+        s_esperando_salida = xTaskGetCurrentTaskHandle();
+        xTaskNotify(s_tarea, NOTIF_SALIR, eSetBits);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        s_esperando_salida = NULL;
+    }
+    s_client = NULL;
+}
+
+void mqtt_reconexion_conectado(void)
+{
+    s_conectado = true;
+    if (s_tarea != NULL) {
+        xTaskNotify(s_tarea, NOTIF_CONECTADO, eSetBits);
+    }
+}
+
+void mqtt_reconexion_desconectado(void)
+{
+    s_conectado = false;
+    if (s_tarea != NULL) {
+        xTaskNotify(s_tarea, NOTIF_DESCONECTADO, eSetBits);
+    }
+}
+
+void mqtt_reconexion_obtener_estadisticas(mqtt_reconexion_estadisticas_t *estadisticas)
+{
+    portENTER_CRITICAL(&s_mux);
+    *estadisticas = s_estadisticas;
+    portEXIT_CRITICAL(&s_mux);
+}
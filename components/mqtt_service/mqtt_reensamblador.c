@@ -0,0 +1,82 @@
+#include "mqtt_reensamblador.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "mqtt_reensamblador";
+
+void mqtt_reensamblador_init(mqtt_reensamblador_t *r, size_t capacidad)
+{
+    memset(r, 0, sizeof(*r));
+    r->capacidad = capacidad;
+}
+
+static bool reservar_buffer(mqtt_reensamblador_t *r)
+{
+    if (r->buf != NULL) {
+        return true;
+    }
+#if CONFIG_SPIRAM
+    r->buf = heap_caps_malloc(r->capacidad, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    if (r->buf == NULL) {
+        r->buf = heap_caps_malloc(r->capacidad, MALLOC_CAP_8BIT);
+    }
+    if (r->buf == NULL) {
+        ESP_LOGE(TAG, "Sin memoria para el buffer de reensamblado (%u bytes)", (unsigned)r->capacidad);
+        return false;
+    }
+    return true;
+}
+
+mqtt_reensamblado_t mqtt_reensamblador_agregar(mqtt_reensamblador_t *r,
+                                               const char *topic, size_t topic_len,
+                                               const char *datos, size_t longitud,
+                                               size_t offset, size_t total)
+{
+    if (offset == 0) {
+        // Primer fragmento: empieza un mensaje nuevo (se abandona el anterior si quedó a medias)
+        if (r->recibido > 0 && r->recibido < r->total && !r->descartando) {
+            ESP_LOGW(TAG, "Mensaje en %s incompleto (%u/%u bytes), descartado",
+                     r->topic, (unsigned)r->recibido, (unsigned)r->total);
+        }
+        r->total = total;
+        r->recibido = 0;
+        r->descartando = false;
+        r->topic_len = 0;
+        r->topic[0] = '\0';
+
+        if (topic == NULL || topic_len == 0 || topic_len >= sizeof(r->topic)) {
+            ESP_LOGW(TAG, "Fragmento inicial sin tópico válido");
+            r->descartando = true;
+            return MQTT_REENSAMBLADO_DESCARTADO;
+        }
+        memcpy(r->topic, topic, topic_len);
+        r->topic[topic_len] = '\0';
+        r->topic_len = topic_len;
+
+        if (total > r->capacidad) {
+            ESP_LOGW(TAG, "Mensaje en %s demasiado grande (%u > %u bytes), descartado",
+                     r->topic, (unsigned)total, (unsigned)r->capacidad);
+            r->descartando = true;
+            return MQTT_REENSAMBLADO_DESCARTADO;
+        }
+        if (!reservar_buffer(r)) {
+            r->descartando = true;
+            return MQTT_REENSAMBLADO_DESCARTADO;
+        }
+    } else if (r->descartando) {
+        return MQTT_REENSAMBLADO_INCOMPLETO;
+    }
+
+    if (offset != r->recibido || total != r->total || offset + longitud > r->total) {
+        ESP_LOGW(TAG, "Fragmento fuera de orden en %s (offset %u, esperado %u), descartado",
+                 r->topic, (unsigned)offset, (unsigned)r->recibido);
+        r->descartando = true;
+        return MQTT_REENSAMBLADO_DESCARTADO;
+    }
+
+    memcpy(r->buf + offset, datos, longitud);
+    r->recibido += longitud;
+    return (r->recibido == r->total) ? MQTT_REENSAMBLADO_COMPLETO : MQTT_REENSAMBLADO_INCOMPLETO;
+}
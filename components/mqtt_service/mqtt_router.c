@@ -0,0 +1,190 @@
+#include "mqtt_router.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "mqtt_router";
+
+#define NINGUNO 0xFF
+
+_Static_assert(MQTT_ROUTER_MAX_NODOS < NINGUNO && MQTT_ROUTER_MAX_RUTAS < NINGUNO,
+               "los índices del router son uint8_t");
+
+/*
+ * Árbol de niveles de tópico: cada nodo es un nivel ("dispositivos", "+",
+ * "#"...) con su primer hijo y su siguiente hermano. Las rutas cuelgan del
+ * nodo donde termina su filtro. El nodo 0 es la raíz (sin segmento).
+ */
+typedef struct {
+    char segmento[MQTT_ROUTER_MAX_SEGMENTO];
+    uint8_t hijo;
+    uint8_t hermano;
+    uint8_t ruta;                   // Primera ruta de este nodo
+} nodo_t;
+
+typedef struct {
+    mqtt_router_manejador_t manejador;
+    void *arg;
+    uint8_t siguiente;              // Siguiente ruta del mismo nodo
+} ruta_t;
+
+static nodo_t s_nodos[MQTT_ROUTER_MAX_NODOS] = {
+    [0] = { .hijo = NINGUNO, .hermano = NINGUNO, .ruta = NINGUNO },
+};
+static uint8_t s_num_nodos = 1;
+static ruta_t s_rutas[MQTT_ROUTER_MAX_RUTAS];
+static uint8_t s_num_rutas = 0;
+
+static uint8_t buscar_o_crear_hijo(uint8_t padre, const char *segmento, size_t len)
+{
+    for (uint8_t n = s_nodos[padre].hijo; n != NINGUNO; n = s_nodos[n].hermano) {
+        if (strlen(s_nodos[n].segmento) == len && memcmp(s_nodos[n].segmento, segmento, len) == 0) {
+            return n;
+        }
+    }
+    if (s_num_nodos >= MQTT_ROUTER_MAX_NODOS) {
+        return NINGUNO;
+    }
+
+    uint8_t n = s_num_nodos++;
+    memcpy(s_nodos[n].segmento, segmento, len);
+    s_nodos[n].segmento[len] = '\0';
+    s_nodos[n].hijo = NINGUNO;
+    s_nodos[n].ruta = NINGUNO;
+    s_nodos[n].hermano = s_nodos[padre].hijo;
+    s_nodos[padre].hijo = n;
+    return n;
+}
+
+esp_err_t mqtt_router_registrar(const char *filtro, mqtt_router_manejador_t manejador, void *arg)
+{
+    if (filtro == NULL || *filtro == '\0' || manejador == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t nodo = 0;
+    const char *p = filtro;
+    while (true) {
+        const char *fin = strchr(p, '/');
+        size_t len = fin ? (size_t)(fin - p) : strlen(p);
+        if (len >= MQTT_ROUTER_MAX_SEGMENTO) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        // Los comodines ocupan el nivel entero y '#' solo puede ir al final
+        bool comodin = memchr(p, '+', len) || memchr(p, '#', len);
+        if (comodin && !(len == 1 && (*p == '+' || (*p == '#' && fin == NULL)))) {
+            ESP_LOGE(TAG, "Filtro no válido: %s", filtro);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        nodo = buscar_o_crear_hijo(nodo, p, len);
+        if (nodo == NINGUNO) {
+            ESP_LOGE(TAG, "Sin nodos libres para %s", filtro);
+            return ESP_ERR_NO_MEM;
+        }
+        if (fin == NULL) {
+            break;
+        }
+        p = fin + 1;
+    }
+
+    for (uint8_t r = s_nodos[nodo].ruta; r != NINGUNO; r = s_rutas[r].siguiente) {
+        if (s_rutas[r].manejador == manejador) {
+            s_rutas[r].arg = arg;
+            return ESP_OK;
+        }
+    }
+    if (s_num_rutas >= MQTT_ROUTER_MAX_RUTAS) {
+        ESP_LOGE(TAG, "Sin rutas libres para %s", filtro);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t r = s_num_rutas++;
+    s_rutas[r].manejador = manejador;
+    s_rutas[r].arg = arg;
+    s_rutas[r].siguiente = s_nodos[nodo].ruta;
+    s_nodos[nodo].ruta = r;
+    ESP_LOGI(TAG, "Ruta registrada: %s", filtro);
+    return ESP_OK;
+}
+
+/**
+ * Recoge las rutas que coinciden con los niveles restantes del tópico
+ */
+static void buscar(uint8_t nodo, const char *nivel, bool ultimo, const char *resto,
+                   uint8_t *encontradas, int *num)
+{
+    size_t len = ultimo ? strlen(nivel) : (size_t)(resto - nivel - 1);
+
+    for (uint8_t n = s_nodos[nodo].hijo; n != NINGUNO; n = s_nodos[n].hermano) {
+        const char *seg = s_nodos[n].segmento;
+        bool coincide;
+        if (seg[0] == '#' && seg[1] == '\0') {
+            coincide = true;
+        } else if (seg[0] == '+' && seg[1] == '\0') {
+            coincide = true;
+        } else {
+            coincide = strlen(seg) == len && memcmp(seg, nivel, len) == 0;
+        }
+        if (!coincide) {
+            continue;
+        }
+
+        if (ultimo || seg[0] == '#') {
+            for (uint8_t r = s_nodos[n].ruta; r != NINGUNO && *num < MQTT_ROUTER_MAX_RUTAS; r = s_rutas[r].siguiente) {
+                encontradas[(*num)++] = r;
+            }
+            // "a/#" también coincide con "a"
+            if (ultimo && seg[0] != '#') {
+                for (uint8_t h = s_nodos[n].hijo; h != NINGUNO; h = s_nodos[h].hermano) {
+                    if (s_nodos[h].segmento[0] == '#' && s_nodos[h].segmento[1] == '\0') {
+                        for (uint8_t r = s_nodos[h].ruta; r != NINGUNO && *num < MQTT_ROUTER_MAX_RUTAS;
+                             r = s_rutas[r].siguiente) {
+                            encontradas[(*num)++] = r;
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+
+        const char *fin = strchr(resto, '/');
+        buscar(n, resto, fin == NULL, fin ? fin + 1 : NULL, encontradas, num);
+    }
+}
+
+int mqtt_router_despachar(const char *topic, size_t topic_len, const char *datos, size_t longitud,
+                          const mqtt_router_respuesta_t *respuesta)
+{
+    char topic_buf[MQTT_ROUTER_MAX_TOPIC];
+    if (topic == NULL || topic_len == 0 || topic_len >= sizeof(topic_buf)) {
+        ESP_LOGW(TAG, "Tópico vacío o demasiado largo (%u bytes)", (unsigned)topic_len);
+        return 0;
+    }
+    memcpy(topic_buf, topic, topic_len);
+    topic_buf[topic_len] = '\0';
+
+    uint8_t encontradas[MQTT_ROUTER_MAX_RUTAS];
+    int num = 0;
+    const char *fin = strchr(topic_buf, '/');
+    buscar(0, topic_buf, fin == NULL, fin ? fin + 1 : NULL, encontradas, &num);
+    if (num == 0) {
+        return 0;
+    }
+
+    // Un solo análisis del JSON para todos los manejadores
+    cJSON *json = (datos && longitud > 0) ? cJSON_ParseWithLength(datos, longitud) : NULL;
+    mqtt_router_mensaje_t mensaje = {
+        .topic = topic_buf,
+        .datos = datos,
+        .longitud = longitud,
+        .json = json,
+        .respuesta = respuesta,
+    };
+    for (int i = 0; i < num; i++) {
+        s_rutas[encontradas[i]].manejador(&mensaje, s_rutas[encontradas[i]].arg);
+    }
+    cJSON_Delete(json);
+    return num;
+}
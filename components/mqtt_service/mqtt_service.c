@@ -11,18 +11,30 @@
 #include "mqtt_client.h"
 #include "cJSON.h"
 #include "mqtt_service.h"
+#include "mqtt_outbox.h"
+#include "mqtt_router.h"
+#include "mqtt_reensamblador.h"
+#include "mqtt_comandos.h"
+#include "mqtt_v5.h"
+#include "mqtt_reconexion.h"
+#include "tls_sesion.h"
 #include "wifi_sta.h"
 #include "stdarg.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include "ble_scanner.h"
 #include "relay_controller.h"
 #include "app_control.h"
 #include "estado_automatico.h"
 #include "ota_service.h"
 #include "time_manager.h" // Asegúrate de incluir esta cabecera si no lo está ya
+#include "boot_trace.h"
+#include "esp_app_desc.h"
+#include "esp_timer.h"
 
 // Declaración externa de la variable del motivo de reinicio
 extern esp_reset_reason_t motivo_reinicio_global;
@@ -31,17 +43,24 @@ extern const char* str_motivo_reinicio_global;
 // Variable para controlar que el motivo de reinicio se envíe una sola vez por arranque real
 static bool motivo_reinicio_enviado = false;
 
+#define REINICIO_ESPERA_HORA_MS    10000   // Espera máxima por la hora NTP para fechar el reinicio
+#define REINICIO_REINTENTO_MS      1000    // Cada cuánto se vuelve a mirar si hay hora
+
+// Reencola el reinicio mientras no haya hora, sin bloquear la tarea de comandos
+static esp_timer_handle_t s_timer_reinicio = NULL;
+static int64_t s_reinicio_desde_us = 0;
+
+#if CONFIG_BOOT_TRACE_HABILITADO
+// La traza de arranque se publica una sola vez, tras la primera conexión
+static bool traza_arranque_enviada = false;
+#endif
+
 extern const uint8_t ca_pem_start[] asm("_binary_ca_pem_start");
 extern const uint8_t ca_pem_end[]   asm("_binary_ca_pem_end");
 
 static const char *TAG = "mqtt_service";
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 
-static TaskHandle_t mqtt_reconnect_task_handle = NULL;
-static volatile bool mqtt_reconnect_pending = false;
-static uint32_t mqtt_backoff_ms = 1000; // 1 segundo inicial
-static const uint32_t mqtt_backoff_max_ms = 300000; // 5 minutos máximo
-
 static char dispositivo_topic[64] = {0}; // Buffer para el tópico dinámico
 
 // Añadimos un buffer para el tópico de OTA, similar al del dispositivo
@@ -57,38 +76,203 @@ static uint32_t ultimo_mensaje_ota_enviado = 0;
 static QueueHandle_t temp_mqtt_queue = NULL;
 static TaskHandle_t temp_mqtt_task_handle = NULL;
 
+/*
+ * Salida ordenada de las tareas del servicio: mqtt_service_stop() pide la
+ * salida y espera la confirmación; la tarea sale en un punto seguro (sin
+ * publicar ni tener el mutex del outbox). Si mqtt_service_start() llega antes
+ * de que la vea, se anula y la tarea sigue.
+ */
+#define TAREA_TIMEOUT_SALIDA_MS 10000
+static portMUX_TYPE tareas_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool temp_mqtt_salir = false;
+static SemaphoreHandle_t temp_mqtt_terminada = NULL;
+
+// Reensamblado de mensajes recibidos en varios MQTT_EVENT_DATA
+static mqtt_reensamblador_t reensamblador;
+
+#if CONFIG_MQTT_USAR_V5
+// Destino de respuesta del mensaje en curso; se copia porque los fragmentos
+// siguientes del mismo mensaje no traen propiedades
+static char respuesta_topic[MQTT_ROUTER_MAX_TOPIC];
+static uint8_t respuesta_correlacion[MQTT_COMANDO_MAX_CORRELACION];
+static mqtt_router_respuesta_t respuesta_recibida;
+
+static void guardar_respuesta(const esp_mqtt5_event_property_t *propiedades)
+{
+    memset(&respuesta_recibida, 0, sizeof(respuesta_recibida));
+    if (propiedades == NULL || propiedades->response_topic == NULL || propiedades->response_topic_len <= 0 ||
+        propiedades->response_topic_len >= (int)sizeof(respuesta_topic) ||
+        propiedades->correlation_data_len > sizeof(respuesta_correlacion)) {
+        return;
+    }
+    memcpy(respuesta_topic, propiedades->response_topic, propiedades->response_topic_len);
+    respuesta_recibida.topic = respuesta_topic;
+    respuesta_recibida.topic_len = propiedades->response_topic_len;
+    if (propiedades->correlation_data != NULL && propiedades->correlation_data_len > 0) {
+        memcpy(respuesta_correlacion, propiedades->correlation_data, propiedades->correlation_data_len);
+        respuesta_recibida.correlacion = respuesta_correlacion;
+        respuesta_recibida.correlacion_len = propiedades->correlation_data_len;
+    }
+}
+#endif
+
+// Tarea que vacía el outbox persistente tras reconectar
+static TaskHandle_t outbox_task_handle = NULL;
+static volatile bool outbox_salir = false;
+static SemaphoreHandle_t outbox_terminada = NULL;
+#define OUTBOX_NOTIF_REENVIAR   (1 << 0)
+#define OUTBOX_NOTIF_PUBLICADO  (1 << 1)
+#define OUTBOX_NOTIF_SALIR      (1 << 2)
+#define OUTBOX_TIMEOUT_ACK_MS   5000
+
+/*
+ * PUBACK recibidos mientras el outbox espera confirmación. El msg_id solo se
+ * conoce cuando publicar() vuelve, y con un broker cercano el PUBACK puede
+ * llegar antes: por eso se anotan desde antes de publicar y la tarea busca
+ * después su msg_id entre ellos.
+ */
+#define OUTBOX_ACKS_RECIENTES   8
+static portMUX_TYPE outbox_acks_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool outbox_anotando_acks = false;
+static int outbox_acks[OUTBOX_ACKS_RECIENTES];
+static uint8_t outbox_acks_pos = 0;
+
+static void outbox_acks_empezar(void)
+{
+    portENTER_CRITICAL(&outbox_acks_mux);
+    for (size_t i = 0; i < OUTBOX_ACKS_RECIENTES; i++) {
+        outbox_acks[i] = -1;
+    }
+    outbox_anotando_acks = true;
+    portEXIT_CRITICAL(&outbox_acks_mux);
+}
+
+static void outbox_acks_terminar(void)
+{
+    portENTER_CRITICAL(&outbox_acks_mux);
+    outbox_anotando_acks = false;
+    portEXIT_CRITICAL(&outbox_acks_mux);
+}
+
+static bool outbox_ack_recibido(int msg_id)
+{
+    bool recibido = false;
+    portENTER_CRITICAL(&outbox_acks_mux);
+    for (size_t i = 0; i < OUTBOX_ACKS_RECIENTES && !recibido; i++) {
+        recibido = (outbox_acks[i] == msg_id);
+    }
+    portEXIT_CRITICAL(&outbox_acks_mux);
+    return recibido;
+}
+
+// Desde MQTT_EVENT_PUBLISHED; true si el outbox está esperando confirmación
+static bool outbox_anotar_ack(int msg_id)
+{
+    portENTER_CRITICAL(&outbox_acks_mux);
+    bool anotando = outbox_anotando_acks;
+    if (anotando) {
+        outbox_acks[outbox_acks_pos] = msg_id;
+        outbox_acks_pos = (outbox_acks_pos + 1) % OUTBOX_ACKS_RECIENTES;
+    }
+    portEXIT_CRITICAL(&outbox_acks_mux);
+    return anotando;
+}
+
 // Estructura para datos de temperatura
 typedef struct {
     float temperatura;
     uint32_t timestamp;
 } temp_data_t;
 
+// Desde la tarea: true si tiene que salir; a partir de ahí deja de contar como viva
+static bool tarea_debe_salir(volatile bool *salir, TaskHandle_t *handle)
+{
+    portENTER_CRITICAL(&tareas_mux);
+    bool sale = *salir;
+    if (sale) {
+        *salir = false;
+        *handle = NULL;
+    }
+    portEXIT_CRITICAL(&tareas_mux);
+    return sale;
+}
+
+// Desde start: true si hay que crear la tarea; si sigue viva se anula su salida
+static bool tarea_hay_que_crear(volatile bool *salir, TaskHandle_t *handle, SemaphoreHandle_t *terminada)
+{
+    if (*terminada == NULL) {
+        *terminada = xSemaphoreCreateBinary();
+        if (*terminada == NULL) {
+            return false;
+        }
+    }
+    portENTER_CRITICAL(&tareas_mux);
+    *salir = false;
+    bool crear = (*handle == NULL);
+    portEXIT_CRITICAL(&tareas_mux);
+    if (crear) {
+        xSemaphoreTake(*terminada, 0);  // Confirmación de una salida que llegó tarde
+    }
+    return crear;
+}
+
+// Desde stop: pide la salida y devuelve la tarea (NULL si no había); luego esperar_salida_tarea()
+static TaskHandle_t pedir_salida_tarea(volatile bool *salir, TaskHandle_t *handle)
+{
+    portENTER_CRITICAL(&tareas_mux);
+    TaskHandle_t tarea = *handle;
+    *salir = (tarea != NULL);
+    portEXIT_CRITICAL(&tareas_mux);
+    return tarea;
+}
+
+static bool esperar_salida_tarea(SemaphoreHandle_t terminada, const char *nombre)
+{
+    if (xSemaphoreTake(terminada, pdMS_TO_TICKS(TAREA_TIMEOUT_SALIDA_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "%s no confirmó su salida en %d ms", nombre, TAREA_TIMEOUT_SALIDA_MS);
+        return false;
+    }
+    return true;
+}
+
 // Tarea dedicada para el envío de temperatura por MQTT
 static void temp_mqtt_task(void *pvParameters)
 {
     temp_data_t temp_data;
     char temp_topic[96];
-    char temp_str[16];
-    char timestamp_str[16];
+    char json[64];
+    json_writer_t w;
+    TickType_t ultima_offline = 0;
+    bool hay_offline = false;
+    const TickType_t intervalo_offline = pdMS_TO_TICKS(MQTT_TEMP_OFFLINE_INTERVALO_MIN * 60u * 1000u);
 
     ESP_LOGI(TAG, "temp_mqtt_task watermark=%u",
              uxTaskGetStackHighWaterMark(NULL));
     
     ESP_LOGI(TAG, "Tarea de envío de temperatura iniciada");
     
-    while (1) {
+    while (!tarea_debe_salir(&temp_mqtt_salir, &temp_mqtt_task_handle)) {
         // Esperar a recibir temperatura (con timeout corto para evitar bloqueo)
         if (xQueueReceive(temp_mqtt_queue, &temp_data, pdMS_TO_TICKS(1000)) == pdTRUE) {
-            // Si no hay conexión MQTT, descartamos la temperatura pero no bloqueamos
-            if (!mqtt_is_connected || mqtt_client == NULL) {
-                ESP_LOGW(TAG, "MQTT no conectado, descartando temperatura: %.2f°C", temp_data.temperatura);
-                continue;
+            /*
+             * Conectado se publica con QoS 0. Sin conexión se submuestrea: una
+             * lectura por intervalo va con QoS 1 al outbox (lleva su timestamp)
+             * y las demás se descartan para no escribir flash cada pocos segundos.
+             */
+            int qos = 0;
+            if (!mqtt_is_connected) {
+                TickType_t ahora = xTaskGetTickCount();
+                if (MQTT_TEMP_OFFLINE_INTERVALO_MIN == 0 ||
+                    (hay_offline && (ahora - ultima_offline) < intervalo_offline)) {
+                    ESP_LOGD(TAG, "Sin conexión MQTT, temperatura %.2f°C descartada", temp_data.temperatura);
+                    vTaskDelay(pdMS_TO_TICKS(10));
+                    continue;
+                }
+                ultima_offline = ahora;
+                hay_offline = true;
+                qos = 1;
             }
-            
-            // Crear string de temperatura con precisión de 2 decimales
-            snprintf(temp_str, sizeof(temp_str), "%.2f", temp_data.temperatura);
-            snprintf(timestamp_str, sizeof(timestamp_str), "%lu", temp_data.timestamp);
-            
+
             // Obtener MAC sin dos puntos
             const char *mac_clean = sta_wifi_get_mac_clean();
             if (mac_clean == NULL || strlen(mac_clean) < 1) {
@@ -100,38 +284,93 @@ static void temp_mqtt_task(void *pvParameters)
             snprintf(temp_topic, sizeof(temp_topic), "dispositivos/%s/temperatura", mac_clean);
             
             // Publicar usando función no bloqueante
-            ESP_LOGI(TAG, "Enviando temperatura: %s°C por MQTT", temp_str);
-            mqtt_service_enviar_json(temp_topic, 0, 0, 
-                                   "temperatura", temp_str, 
-                                   "timestamp", timestamp_str, 
-                                   NULL);
+            ESP_LOGI(TAG, "Enviando temperatura: %.2f°C por MQTT", temp_data.temperatura);
+            json_writer_init(&w, json, sizeof(json));
+            json_writer_objeto(&w, NULL);
+            json_writer_float(&w, "temperatura", temp_data.temperatura, 2);
+            json_writer_uint(&w, "timestamp", temp_data.timestamp);
+            mqtt_service_enviar_json_writer(temp_topic, &w, qos, 0);
         }
         
         // Ceder CPU periódicamente para evitar watchdog
         vTaskDelay(pdMS_TO_TICKS(10)); // Pequeña pausa para no consumir CPU
     }
+
+    ESP_LOGI(TAG, "Tarea de envío de temperatura detenida");
+    xSemaphoreGive(temp_mqtt_terminada);
+    vTaskDelete(NULL);
 }
 
-// Tarea dedicada para reconexión con backoff
-static void mqtt_reconnect_task(void *pvParameters)
+// Publicación directa en el cliente; con MQTT 5 añade alias de tópico automáticos
+static int publicar(const char *topic, const char *datos, int len, int qos, int retain)
 {
-    ESP_LOGI(TAG, "mqtt_reconnect_task watermark=%u",
-             uxTaskGetStackHighWaterMark(NULL));
-    while (1) {
-        if (mqtt_reconnect_pending) {
-            ESP_LOGI(TAG, "Backoff antes de reintentar conexión: %" PRIu32 " ms", mqtt_backoff_ms);
-            vTaskDelay(mqtt_backoff_ms / portTICK_PERIOD_MS);
-            mqtt_backoff_ms *= 2;
-            if (mqtt_backoff_ms > mqtt_backoff_max_ms) mqtt_backoff_ms = mqtt_backoff_max_ms;
-            // Intentar reconectar
-            if (mqtt_client) {
-                esp_mqtt_client_stop(mqtt_client);
-                esp_mqtt_client_start(mqtt_client);
+#if CONFIG_MQTT_USAR_V5
+    return mqtt_v5_publicar(mqtt_client, topic, datos, len, qos, retain, NULL, 0);
+#else
+    return esp_mqtt_client_publish(mqtt_client, topic, datos, len, qos, retain);
+#endif
+}
+
+// Reenvía en orden los mensajes guardados sin conexión, con ritmo limitado
+static void mqtt_outbox_task(void *pvParameters)
+{
+    static char topic[MQTT_OUTBOX_MAX_TOPIC];
+    static char datos[MQTT_OUTBOX_MAX_MENSAJE];
+    mqtt_outbox_entrada_t entrada;
+    uint32_t bits = 0;
+
+    while (!tarea_debe_salir(&outbox_salir, &outbox_task_handle)) {
+        // Si quedó algo pendiente (ack perdido) se reintenta periódicamente
+        TickType_t espera = mqtt_outbox_pendiente() ? pdMS_TO_TICKS(OUTBOX_TIMEOUT_ACK_MS) : portMAX_DELAY;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, espera);
+
+        while (!outbox_salir && mqtt_is_connected && mqtt_client != NULL &&
+               mqtt_outbox_siguiente(&entrada, topic, datos) == ESP_OK) {
+            if (entrada.qos > 0) {
+                outbox_acks_empezar();
+            }
+            int msg_id = publicar(topic, datos, entrada.longitud, entrada.qos, entrada.retain);
+            if (msg_id < 0) {
+                outbox_acks_terminar();
+                break;
+            }
+
+            // Con QoS > 0 el mensaje solo se retira del outbox cuando el broker lo confirma
+            if (entrada.qos > 0) {
+                bool confirmado = outbox_ack_recibido(msg_id);
+                TickType_t limite = xTaskGetTickCount() + pdMS_TO_TICKS(OUTBOX_TIMEOUT_ACK_MS);
+                TickType_t ahora;
+                while (!confirmado && !outbox_salir && (int32_t)(limite - (ahora = xTaskGetTickCount())) > 0) {
+                    xTaskNotifyWait(0, OUTBOX_NOTIF_PUBLICADO, &bits, limite - ahora);
+                    confirmado = outbox_ack_recibido(msg_id);
+                }
+                outbox_acks_terminar();
+                if (!confirmado) {
+                    ESP_LOGW(TAG, "Sin confirmación del mensaje %" PRIu32 " del outbox, se reintentará", entrada.seq);
+                    break;
+                }
+            }
+            mqtt_outbox_confirmar(&entrada);
+            vTaskDelay(pdMS_TO_TICKS(MQTT_OUTBOX_INTERVALO_REENVIO_MS));
+        }
+
+        if (!mqtt_outbox_pendiente()) {
+            mqtt_outbox_estadisticas_t est;
+            mqtt_outbox_obtener_estadisticas(&est);
+            if (est.confirmados > 0) {
+                ESP_LOGI(TAG, "Outbox vacío: %" PRIu32 " reenviados, %" PRIu32 " descartados",
+                         est.confirmados, est.descartados);
             }
-            mqtt_reconnect_pending = false;
         }
-        vTaskDelay(pdMS_TO_TICKS(100)); // Pequeño retardo para evitar busy loop
     }
+
+    // Lo no confirmado sigue en flash y se reenvía en el próximo arranque del servicio.
+    // mqtt_service_stop() notifica tras pedir la salida: no borrarse antes de recibirlo
+    while ((bits & OUTBOX_NOTIF_SALIR) == 0 &&
+           xTaskNotifyWait(0, OUTBOX_NOTIF_SALIR, &bits, pdMS_TO_TICKS(TAREA_TIMEOUT_SALIDA_MS)) == pdTRUE) {
+    }
+    xSemaphoreGive(outbox_terminada);
+    vTaskDelete(NULL);
 }
 
 static void log_error_if_nonzero(const char *message, int error_code)
@@ -143,16 +382,179 @@ static void log_error_if_nonzero(const char *message, int error_code)
 //========================================================================================================================================================================
 
 // Función para procesar el estado remoto recibido
-static void procesar_estado_remoto(bool estado) {
+// Parámetros de los comandos que se ejecutan en la tarea del ejecutor
+typedef struct {
+    char url[160];
+    char version[24];
+    bool forzar;
+} comando_ota_t;
+
+static esp_err_t comando_estado(const void *params) {
+    bool estado = *(const bool *)params;
     ESP_LOGI(TAG, "Procesando Estado remoto: %s (prioridad REMOTA, fuerza modo MANUAL)", estado ? "true" : "false");
     app_control_cambiar_estado(ESTADO_MANUAL);
-    nvs_manager_set_int("estado_rele", estado ? 1 : 0);
+    ecokey_config_set_estado_rele(estado);
     // Aplicar el estado al relé
-    relay_controller_set_state(estado);
+    return relay_controller_set_state(estado);
+}
+
+static esp_err_t comando_mac_objetivo(const void *params) {
+    const char *mac = params;
+    ESP_LOGI(TAG, "Actualizando mac_objetivo en NVS: %s", mac);
+    esp_err_t err = ecokey_config_set_mac_objetivo_texto(mac);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return ble_scanner_configurar_mac_objetivo(0, ecokey_config()->mac_objetivo);
+}
+
+static esp_err_t comando_temporizador(const void *params) {
+    int temp_value = *(const int *)params;
+    if (temp_value < ECOKEY_CONFIG_TEMPORIZADOR_MIN || temp_value > ECOKEY_CONFIG_TEMPORIZADOR_MAX) {
+        ESP_LOGE(TAG, "Temporizador fuera de rango: %d minutos", temp_value);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Actualiza el temporizador en ejecución y lo guarda en la configuración
+    estado_automatico_set_timeout_minutos(temp_value);
+    ESP_LOGI(TAG, "Temporizador actualizado en tiempo de ejecución a %d minutos", temp_value);
+    return ESP_OK;
+}
+
+static esp_err_t comando_ota(const void *params) {
+    const comando_ota_t *ota = params;
+    ESP_LOGI(TAG, "Iniciando actualización OTA: URL=%s, versión=%s, forzar=%s", 
+            ota->url, ota->version, ota->forzar ? "sí" : "no");
+    return ota_service_start_update(ota->url, ota->forzar);
 }
 
-// Función para procesar el modo remoto recibido
-static void procesar_modo_remoto(const char *modo) {
+// Reporte del relé tras conectar, con una pausa para que la conexión se estabilice
+static void enviar_estado_actual_rele(void);
+static esp_err_t comando_estado_inicial(const void *params) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    enviar_estado_actual_rele();
+    return ESP_OK;
+}
+
+static esp_err_t comando_reinicio(const void *params);
+
+static void timer_reinicio_cb(void *arg) {
+    if (mqtt_comandos_encolar("reinicio", NULL, NULL, comando_reinicio, NULL, 0) != ESP_OK) {
+        // Cola llena: otro intento en el siguiente periodo
+        esp_timer_start_once(s_timer_reinicio, (uint64_t)REINICIO_REINTENTO_MS * 1000);
+    }
+}
+
+// true si el reinicio se volverá a encolar cuando pase REINICIO_REINTENTO_MS
+static bool reprogramar_reinicio(void) {
+    if (s_timer_reinicio == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = timer_reinicio_cb,
+            .name = "mqtt_reinicio",
+        };
+        if (esp_timer_create(&args, &s_timer_reinicio) != ESP_OK) {
+            s_timer_reinicio = NULL;
+            return false;
+        }
+    }
+    return esp_timer_start_once(s_timer_reinicio, (uint64_t)REINICIO_REINTENTO_MS * 1000) == ESP_OK;
+}
+
+// Publica el motivo del último reinicio, con fecha si NTP sincroniza a tiempo.
+// Sin hora todavía no espera aquí (retrasaría la traza, el estado inicial y
+// los comandos retenidos): vuelve a la cola cada REINICIO_REINTENTO_MS hasta
+// que haya hora o pase REINICIO_ESPERA_HORA_MS.
+static esp_err_t comando_reinicio(const void *params) {
+    const char *mac_clean = sta_wifi_get_mac_clean();
+    char fecha_actual[24] = {0}; // Buffer para la fecha
+    char reinicio_topic[160]; // Buffer más grande para acomodar la fecha
+
+    if (s_reinicio_desde_us == 0) {
+        s_reinicio_desde_us = esp_timer_get_time();
+    }
+    bool hay_hora = time_manager_esperar_sincronizacion(0) == ESP_OK;
+    bool en_plazo = esp_timer_get_time() - s_reinicio_desde_us < (int64_t)REINICIO_ESPERA_HORA_MS * 1000;
+    if (!hay_hora && en_plazo && reprogramar_reinicio()) {
+        return ESP_OK;
+    }
+
+    esp_err_t fecha_err = time_manager_get_fecha_actual(fecha_actual, sizeof(fecha_actual));
+
+    if (fecha_err == ESP_OK && strlen(fecha_actual) > 0) {
+        // Formatear el tópico con la fecha (reemplazando espacios y caracteres no válidos)
+        char fecha_formateada[24] = {0};
+        const char *src = fecha_actual;
+        char *dst = fecha_formateada;
+
+        // Convertir la fecha a un formato adecuado para tópico MQTT (sin espacios ni caracteres especiales)
+        while (*src != '\0' && (dst - fecha_formateada) < sizeof(fecha_formateada) - 1) {
+            if (*src == ' ' || *src == ':') {
+                *dst++ = '_'; // Reemplazar espacio o dos puntos con guión bajo
+            } else if (*src == '-' || (*src >= '0' && *src <= '9')) {
+                *dst++ = *src; // Mantener guiones y números
+            }
+            src++;
+        }
+        *dst = '\0'; // Terminar la cadena
+
+        // Crear el tópico con la fecha formateada
+        snprintf(reinicio_topic, sizeof(reinicio_topic), 
+                "dispositivos/%s/reinicio/%s", mac_clean, fecha_formateada);
+
+        ESP_LOGI(TAG, "Publicando reinicio en tópico con fecha: %s", reinicio_topic);
+    } else {
+        // Si no hay fecha disponible, usar el tópico sin fecha
+        snprintf(reinicio_topic, sizeof(reinicio_topic), 
+                "dispositivos/reinicio/%s", mac_clean);
+
+        ESP_LOGW(TAG, "Fecha no disponible, usando tópico sin fecha: %s", reinicio_topic);
+    }
+
+    mqtt_service_enviar_json(reinicio_topic, 2, 1, 
+                           "mac", mac_clean, 
+                           "motivo", str_motivo_reinicio_global, 
+                           "codigo", esp_reset_reason_to_str(motivo_reinicio_global), 
+                           "fecha", (fecha_err == ESP_OK) ? fecha_actual : "desconocida",
+                           NULL);
+
+    ESP_LOGI(TAG, "Motivo de reinicio enviado por MQTT: %s", str_motivo_reinicio_global);
+    return ESP_OK;
+}
+
+#if CONFIG_BOOT_TRACE_HABILITADO
+// Publica los hitos del arranque (µs de esp_timer) para tools/boot_trace.py
+static esp_err_t comando_traza_arranque(const void *params) {
+    char topic[64];
+    char json[512];
+    json_writer_t w;
+
+    snprintf(topic, sizeof(topic), "dispositivos/%s/arranque", sta_wifi_get_mac_clean());
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "fw", esp_app_get_description()->version);
+    json_writer_str(&w, "reinicio", esp_reset_reason_to_str(motivo_reinicio_global));
+    json_writer_objeto(&w, "puntos");
+    for (int i = 0; i < BOOT_TRACE_NUM; i++) {
+        int64_t marca = boot_trace_obtener((boot_trace_punto_t)i);
+        if (marca != 0) {
+            json_writer_int(&w, boot_trace_nombre((boot_trace_punto_t)i), marca);
+        }
+    }
+    json_writer_cerrar(&w);
+
+    // También al log, para sacar la traza del monitor serie sin broker
+    const char *texto = json_writer_terminar(&w);
+    if (texto != NULL) {
+        ESP_LOGI(TAG, "Traza de arranque: %s", texto);
+    }
+    return mqtt_service_enviar_json_writer(topic, &w, 1, 0);
+}
+#endif
+
+// Función para procesar el modo remoto recibido (se ejecuta en la tarea de comandos)
+static esp_err_t comando_modo(const void *params) {
+    const char *modo = params;
+    esp_err_t resultado = ESP_OK;
     ESP_LOGI(TAG, "Procesando Modo remoto: %s", modo);
     
     // Obtener el estado actual antes de intentar el cambio
@@ -162,7 +564,7 @@ static void procesar_modo_remoto(const char *modo) {
         // Implementación más robusta para cambio a modo manual
         if (estado_actual != ESTADO_MANUAL) {
             // Guardar en NVS antes del cambio para persistencia
-            nvs_manager_set_string("modo_operacion", "manual");
+            ecokey_config_set_modo(ECOKEY_MODO_MANUAL);
             ESP_LOGI(TAG, "Cambiando a modo MANUAL por control remoto");
             
             // Pequeña pausa para estabilidad
@@ -189,6 +591,7 @@ static void procesar_modo_remoto(const char *modo) {
                 ESP_LOGI(TAG, "Cambio a modo MANUAL confirmado");
             } else {
                 ESP_LOGE(TAG, "Estado inconsistente después del cambio a MANUAL");
+                resultado = ESP_ERR_INVALID_STATE;
             }
         } else {
             ESP_LOGI(TAG, "Ya se encuentra en modo MANUAL");
@@ -197,7 +600,7 @@ static void procesar_modo_remoto(const char *modo) {
     else if (strcasecmp(modo, "automatico") == 0) {
         // Implementación similar para modo automático
         if (estado_actual != ESTADO_AUTOMATICO) {
-            nvs_manager_set_string("modo_operacion", "automatico");
+            ecokey_config_set_modo(ECOKEY_MODO_AUTOMATICO);
             ESP_LOGI(TAG, "Cambiando a modo AUTOMÁTICO por control remoto");
             
             vTaskDelay(pdMS_TO_TICKS(100));
@@ -220,6 +623,7 @@ static void procesar_modo_remoto(const char *modo) {
                 ESP_LOGI(TAG, "Cambio a modo AUTOMÁTICO confirmado");
             } else {
                 ESP_LOGE(TAG, "Estado inconsistente después del cambio a AUTOMÁTICO");
+                resultado = ESP_ERR_INVALID_STATE;
             }
         } else {
             ESP_LOGI(TAG, "Ya se encuentra en modo AUTOMÁTICO");
@@ -227,15 +631,36 @@ static void procesar_modo_remoto(const char *modo) {
     }
     else {
         ESP_LOGW(TAG, "Modo no reconocido: %s (valores válidos: 'manual' o 'automatico')", modo);
+        resultado = ESP_ERR_INVALID_ARG;
+    }
+    return resultado;
+}
+
+// Id del comando: el campo "id" del mensaje (texto o número) o uno generado
+static void obtener_id_comando(const cJSON *root, char *id, size_t len)
+{
+    static uint32_t contador = 0;
+    const cJSON *id_obj = cJSON_GetObjectItem(root, "id");
+    if (cJSON_IsString(id_obj)) {
+        strlcpy(id, id_obj->valuestring, len);
+    } else if (cJSON_IsNumber(id_obj)) {
+        snprintf(id, len, "%d", id_obj->valueint);
+    } else {
+        snprintf(id, len, "auto-%" PRIu32, ++contador);
     }
 }
 
 // Función para procesar mensajes OTA mejorada
-static void procesar_mensaje_ota(const char *json) {
-    ESP_LOGI(TAG, "Procesando mensaje OTA: %s", json);
-    
+// Mensajes con "tipo":"respuesta" son nuestras propias publicaciones: se ignoran para evitar bucles
+static bool es_respuesta(const cJSON *root)
+{
+    const cJSON *tipo = cJSON_GetObjectItem(root, "tipo");
+    return cJSON_IsString(tipo) && strcmp(tipo->valuestring, "respuesta") == 0;
+}
+
+static void procesar_mensaje_ota(const cJSON *root, const char *id, const mqtt_router_respuesta_t *respuesta) {
     // Verificar si es un mensaje de respuesta enviado por nosotros mismos
-    if (strstr(json, "\"estado\":") != NULL) {
+    if (cJSON_GetObjectItem(root, "estado") != NULL) {
         uint32_t ahora = esp_log_timestamp();
         // Si recién enviamos un mensaje (menos de 2 segundos), ignorarlo para evitar bucle
         if (ahora - ultimo_mensaje_ota_enviado < 2000) {
@@ -244,142 +669,124 @@ static void procesar_mensaje_ota(const char *json) {
         }
     }
     
-    // Buscar URL de firmware (primero con método robusto)
-    const char *url_str = NULL;
-    cJSON *root = cJSON_Parse(json);
-    if (root) {
-        // Buscar URL de firmware en el JSON
-        cJSON *url_obj = cJSON_GetObjectItem(root, "url");
-        if (url_obj && cJSON_IsString(url_obj)) {
-            url_str = url_obj->valuestring;
-            ESP_LOGI(TAG, "URL de actualización recibida: %s", url_str);
-            
-            // Verificar si la URL es válida
-            if (strlen(url_str) < 8) { // Al menos "http://"
-                ESP_LOGE(TAG, "URL inválida para OTA: %s", url_str);
-                ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
-                mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "URL inválida", "tipo", "comando", NULL);
-                cJSON_Delete(root);
-                return;
-            }
-            
-            // Verificar si hay un campo de versión
-            cJSON *version_obj = cJSON_GetObjectItem(root, "version");
-            const char *version = version_obj && cJSON_IsString(version_obj) ? 
-                                 version_obj->valuestring : "desconocida";
-            
-            // Verificar si hay un campo de forzar actualización
-            bool forzar = false;
-            cJSON *force_obj = cJSON_GetObjectItem(root, "force");
-            if (force_obj && cJSON_IsBool(force_obj)) {
-                forzar = cJSON_IsTrue(force_obj);
-            }
-            
-            ESP_LOGI(TAG, "Iniciando actualización OTA: URL=%s, versión=%s, forzar=%s", 
-                    url_str, version, forzar ? "sí" : "no");
-                    
-            // Aquí iniciarías el proceso OTA con el firmware_url
-            // Por ejemplo, llamando a una función de un componente OTA:
-            ota_service_start_update(url_str, forzar);
-            
-            
-            // Reportar que se ha recibido la solicitud de actualización
+    // Buscar URL de firmware en el JSON
+    cJSON *url_obj = cJSON_GetObjectItem(root, "url");
+    if (url_obj && cJSON_IsString(url_obj)) {
+        const char *url_str = url_obj->valuestring;
+        ESP_LOGI(TAG, "URL de actualización recibida: %s", url_str);
+        
+        // Verificar si la URL es válida
+        if (strlen(url_str) < 8) { // Al menos "http://"
+            ESP_LOGE(TAG, "URL inválida para OTA: %s", url_str);
             ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
-            mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "iniciando", "version", version, "tipo", "respuesta", NULL);
-            cJSON_Delete(root);
+            mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "URL inválida", "tipo", "comando", NULL);
             return;
         }
         
-        cJSON_Delete(root);
+        // Verificar si hay un campo de versión
+        cJSON *version_obj = cJSON_GetObjectItem(root, "version");
+        const char *version = version_obj && cJSON_IsString(version_obj) ? 
+                             version_obj->valuestring : "desconocida";
+        
+        // Verificar si hay un campo de forzar actualización
+        bool forzar = false;
+        cJSON *force_obj = cJSON_GetObjectItem(root, "force");
+        if (force_obj && cJSON_IsBool(force_obj)) {
+            forzar = cJSON_IsTrue(force_obj);
+        }
+        
+        // La descarga se hace en la tarea de comandos, no en la tarea MQTT
+        comando_ota_t ota = { .forzar = forzar };
+        if (strlcpy(ota.url, url_str, sizeof(ota.url)) >= sizeof(ota.url)) {
+            ESP_LOGE(TAG, "URL demasiado larga para OTA (%u bytes)", (unsigned)strlen(url_str));
+            ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
+            mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "URL demasiado larga", "tipo", "respuesta", NULL);
+            return;
+        }
+        strlcpy(ota.version, version, sizeof(ota.version));
+        if (mqtt_comandos_encolar("ota", id, respuesta, comando_ota, &ota, sizeof(ota)) != ESP_OK) {
+            ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
+            mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "Comando no aceptado", "tipo", "respuesta", NULL);
+            return;
+        }
+        
+        // Reportar que se ha recibido la solicitud de actualización
+        ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
+        mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "iniciando", "version", version, "tipo", "respuesta", NULL);
+        return;
     }
     
     // Si llegamos aquí, no encontramos una URL válida
-    if (!strstr(json, "\"tipo\":\"respuesta\"")) { // No procesar si es una respuesta
-        ESP_LOGW(TAG, "Mensaje OTA sin URL de firmware o con formato incorrecto");
-        ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
-        mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "Falta URL o formato incorrecto", "tipo", "respuesta", NULL);
+    ESP_LOGW(TAG, "Mensaje OTA sin URL de firmware o con formato incorrecto");
+    ultimo_mensaje_ota_enviado = esp_log_timestamp(); // Marca temporal
+    mqtt_service_enviar_json(ota_topic, 1, 0, "estado", "error", "mensaje", "Falta URL o formato incorrecto", "tipo", "respuesta", NULL);
+}
+
+// Ruta ota/<mac>: solicitudes de actualización de firmware
+static void ruta_ota(const mqtt_router_mensaje_t *mensaje, void *arg)
+{
+    if (mensaje->json == NULL) {
+        ESP_LOGE(TAG, "Mensaje OTA con JSON inválido: %.*s", (int)mensaje->longitud, mensaje->datos);
+        return;
     }
+    if (es_respuesta(mensaje->json)) {
+        ESP_LOGD(TAG, "Ignorando mensaje de respuesta para evitar bucle");
+        return;
+    }
+    ESP_LOGI(TAG, "Mensaje OTA recibido en tópico: %s", mensaje->topic);
+    char id[MQTT_COMANDO_MAX_ID];
+    obtener_id_comando(mensaje->json, id, sizeof(id));
+    procesar_mensaje_ota(mensaje->json, id, mensaje->respuesta);
 }
 
-// Procesa el mensaje recibido por MQTT según el tópico y el JSON recibido
-static void mqtt_service_procesar_mensaje(const char *topic, const char *json)
+// Ruta dispositivos/<mac>: configuración y control remoto
+static void ruta_dispositivo(const mqtt_router_mensaje_t *mensaje, void *arg)
 {
-    if (!topic || !json) {
-        ESP_LOGE(TAG, "Topic o mensaje NULL recibido");
+    const cJSON *root = mensaje->json;
+    if (root == NULL) {
+        ESP_LOGE(TAG, "Error al analizar JSON: %.*s", (int)mensaje->longitud, mensaje->datos);
         return;
     }
-    
-    ESP_LOGI(TAG, "Procesando mensaje en tópico: %s", topic);
-    
-    // Verificar si es un mensaje de respuesta (ignorar para evitar bucles)
-    if (strstr(json, "\"tipo\":\"respuesta\"")) {
+    if (es_respuesta(root)) {
         ESP_LOGD(TAG, "Ignorando mensaje de respuesta para evitar bucle");
         return;
     }
+
+    char id[MQTT_COMANDO_MAX_ID];
+    obtener_id_comando(root, id, sizeof(id));
+
+    // Compatibilidad: una petición OTA enviada al tópico del dispositivo
+    if (cJSON_GetObjectItem(root, "url") != NULL) {
+        ESP_LOGW(TAG, "Posible mensaje OTA detectado por contenido en tópico incorrecto: %s", mensaje->topic);
+        procesar_mensaje_ota(root, id, mensaje->respuesta);
+        return;
+    }
+
+    // Cada campo es un comando; se ejecutan en orden en la tarea de comandos
+    cJSON *mac_obj = cJSON_GetObjectItem(root, "macObjetivo");
+    if (mac_obj && cJSON_IsString(mac_obj)) {
+        char mac[18] = {0};
+        strlcpy(mac, mac_obj->valuestring, sizeof(mac));
+        mqtt_comandos_encolar("macObjetivo", id, mensaje->respuesta, comando_mac_objetivo, mac, sizeof(mac));
+    }
     
-    // Primero verificamos si es un tópico OTA
-    if (strcmp(topic, ota_topic) == 0) {
-        ESP_LOGI(TAG, "Mensaje OTA recibido en tópico correcto: %s", ota_topic);
-        procesar_mensaje_ota(json);
-        return; // Procesado como OTA, no continuar
+    cJSON *temp_obj = cJSON_GetObjectItem(root, "temporizador");
+    if (temp_obj && cJSON_IsNumber(temp_obj)) {
+        int temp_value = temp_obj->valueint;
+        mqtt_comandos_encolar("temporizador", id, mensaje->respuesta, comando_temporizador, &temp_value, sizeof(temp_value));
     }
     
-    // Si no es OTA, intentamos detectar por contenido
-    if (strstr(json, "\"url\":") != NULL && 
-        !strstr(json, "\"tipo\":\"respuesta\"")) {
-        
-        ESP_LOGW(TAG, "Posible mensaje OTA detectado por contenido en tópico incorrecto: %s", topic);
-        procesar_mensaje_ota(json);
-        return; // Procesado como OTA, no continuar
+    cJSON *estado_obj = cJSON_GetObjectItem(root, "Estado");
+    if (estado_obj && cJSON_IsBool(estado_obj)) {
+        bool estado = cJSON_IsTrue(estado_obj);
+        mqtt_comandos_encolar("Estado", id, mensaje->respuesta, comando_estado, &estado, sizeof(estado));
     }
     
-    // Procesamiento de mensajes del dispositivo
-    if (strcmp(topic, dispositivo_topic) == 0) {
-        cJSON *root = cJSON_Parse(json);
-        if (root) {
-            // Procesar macObjetivo
-            cJSON *mac_obj = cJSON_GetObjectItem(root, "macObjetivo");
-            if (mac_obj && cJSON_IsString(mac_obj)) {
-                ESP_LOGI(TAG, "Actualizando mac_objetivo en NVS: %s", mac_obj->valuestring);
-                nvs_manager_set_string("mac_objetivo", mac_obj->valuestring);
-                ble_scanner_configurar_mac_objetivo_texto(0, mac_obj->valuestring);
-            }
-            
-            // Procesar temporizador
-            cJSON *temp_obj = cJSON_GetObjectItem(root, "temporizador");
-            if (temp_obj && cJSON_IsNumber(temp_obj)) {
-                char temp_str[8];
-                int temp_value = temp_obj->valueint;
-                snprintf(temp_str, sizeof(temp_str), "%d", temp_value);
-                ESP_LOGI(TAG, "Actualizando temporizador en NVS: %s minutos", temp_str);
-                nvs_manager_set_string("temporizador", temp_str);
-                
-                // Actualizar también el temporizador en el componente de estado_automatico
-                estado_automatico_set_timeout_minutos(temp_value);
-                ESP_LOGI(TAG, "Temporizador actualizado en tiempo de ejecución a %d minutos", temp_value);
-            }
-            
-            // Procesar Estado (booleano)
-            cJSON *estado_obj = cJSON_GetObjectItem(root, "Estado");
-            if (estado_obj && cJSON_IsBool(estado_obj)) {
-                bool estado = cJSON_IsTrue(estado_obj);
-                procesar_estado_remoto(estado);
-            }
-            
-            // Procesar Modo (string)
-            cJSON *modo_obj = cJSON_GetObjectItem(root, "Modo");
-            if (modo_obj && cJSON_IsString(modo_obj)) {
-                procesar_modo_remoto(modo_obj->valuestring);
-            }
-            
-            cJSON_Delete(root);
-        } else {
-            ESP_LOGE(TAG, "Error al analizar JSON: %s", json);
-        }
-    } else {
-        ESP_LOGW(TAG, "Mensaje recibido en tópico no manejado: %s", topic);
-        ESP_LOGW(TAG, "Tópicos registrados: dispositivo=%s, ota=%s", 
-                 dispositivo_topic, ota_topic);
+    cJSON *modo_obj = cJSON_GetObjectItem(root, "Modo");
+    if (modo_obj && cJSON_IsString(modo_obj)) {
+        char modo[16] = {0};
+        strlcpy(modo, modo_obj->valuestring, sizeof(modo));
+        mqtt_comandos_encolar("Modo", id, mensaje->respuesta, comando_modo, modo, sizeof(modo));
     }
 }
 
@@ -447,80 +854,63 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             
             // Configuración del tópico de dispositivo (como ya tenías)
             snprintf(dispositivo_topic, sizeof(dispositivo_topic), "dispositivos/%s", mac_clean);
-            mqtt_service_suscribirse(dispositivo_topic, 1);
             
             // Configuración del tópico OTA
             snprintf(ota_topic, sizeof(ota_topic), "ota/%s", mac_clean);
-            mqtt_service_suscribirse(ota_topic, 1);
-            ESP_LOGI(TAG, "Suscrito a tópicos de dispositivo y OTA");
+
+            // Con sesión persistente (MQTT 5) el broker conserva las suscripciones
+            if (event->session_present) {
+                ESP_LOGI(TAG, "Sesión reanudada, no hace falta suscribirse de nuevo");
+            } else {
+                mqtt_service_suscribirse(dispositivo_topic, 1);
+                mqtt_service_suscribirse(ota_topic, 1);
+            }
+#if CONFIG_MQTT_USAR_V5
+            mqtt_v5_conectado();
+#endif
+
+            // Registrar es idempotente: en reconexiones solo se actualiza la ruta existente
+            mqtt_router_registrar(dispositivo_topic, ruta_dispositivo, NULL);
+            mqtt_router_registrar(ota_topic, ruta_ota, NULL);
+            ESP_LOGI(TAG, "Rutas de tópicos de dispositivo y OTA registradas");
             
-            mqtt_backoff_ms = 1000; // Reset backoff al conectar
             mqtt_is_connected = true; // Actualizamos el estado de conexión
+            boot_trace_marcar(BOOT_TRACE_MQTT_CONECTADO);
+            mqtt_reconexion_conectado();
+
+            // Vaciar lo que se publicó durante la desconexión
+            if (outbox_task_handle != NULL && mqtt_outbox_pendiente()) {
+                xTaskNotify(outbox_task_handle, OUTBOX_NOTIF_REENVIAR, eSetBits);
+            }
 
             // Enviamos el motivo de reinicio por MQTT SOLO si es la primera vez después de un reinicio real
-            if (!motivo_reinicio_enviado) {
-                // Verificamos que sea un reinicio real y no una reconexión tras pérdida de internet
-                if (motivo_reinicio_global != ESP_RST_UNKNOWN) {
-                    char fecha_actual[24] = {0}; // Buffer para la fecha
-                    char reinicio_topic[160]; // Buffer más grande para acomodar la fecha
-                    
-                    // Intentar obtener la fecha actual
-                    esp_err_t fecha_err = time_manager_get_fecha_actual(fecha_actual, sizeof(fecha_actual));
-                    
-                    if (fecha_err == ESP_OK && strlen(fecha_actual) > 0) {
-                        // Formatear el tópico con la fecha (reemplazando espacios y caracteres no válidos)
-                        char fecha_formateada[24] = {0};
-                        const char *src = fecha_actual;
-                        char *dst = fecha_formateada;
-                        
-                        // Convertir la fecha a un formato adecuado para tópico MQTT (sin espacios ni caracteres especiales)
-                        while (*src != '\0' && (dst - fecha_formateada) < sizeof(fecha_formateada) - 1) {
-                            if (*src == ' ' || *src == ':') {
-                                *dst++ = '_'; // Reemplazar espacio o dos puntos con guión bajo
-                            } else if (*src == '-' || (*src >= '0' && *src <= '9')) {
-                                *dst++ = *src; // Mantener guiones y números
-                            }
-                            src++;
-                        }
-                        *dst = '\0'; // Terminar la cadena
-                        
-                        // Crear el tópico con la fecha formateada
-                        snprintf(reinicio_topic, sizeof(reinicio_topic), 
-                                "dispositivos/%s/reinicio/%s", mac_clean, fecha_formateada);
-                        
-                        ESP_LOGI(TAG, "Publicando reinicio en tópico con fecha: %s", reinicio_topic);
-                    } else {
-                        // Si no hay fecha disponible, usar el tópico sin fecha
-                        snprintf(reinicio_topic, sizeof(reinicio_topic), 
-                                "dispositivos/reinicio/%s", mac_clean);
-                        
-                        ESP_LOGW(TAG, "Fecha no disponible, usando tópico sin fecha: %s", reinicio_topic);
-                    }
-                    
-                    mqtt_service_enviar_json(reinicio_topic, 2, 1, 
-                                           "mac", mac_clean, 
-                                           "motivo", str_motivo_reinicio_global, 
-                                           "codigo", esp_reset_reason_to_str(motivo_reinicio_global), 
-                                           "fecha", (fecha_err == ESP_OK) ? fecha_actual : "desconocida",
-                                           NULL);
-                    
-                    ESP_LOGI(TAG, "Motivo de reinicio enviado por MQTT: %s", str_motivo_reinicio_global);
+            // (no una reconexión tras pérdida de internet). NTP arranca en paralelo con MQTT:
+            // comando_reinicio se reencola hasta tener la hora sin bloquear la tarea de comandos
+            if (!motivo_reinicio_enviado && motivo_reinicio_global != ESP_RST_UNKNOWN) {
+                if (mqtt_comandos_encolar("reinicio", NULL, NULL, comando_reinicio, NULL, 0) == ESP_OK) {
                     motivo_reinicio_enviado = true; // Marcamos como enviado para no repetirlo en reconexiones
                 }
             }
             
-            // NUEVO: Enviar estado actual del relé después de conectarse
-            // Pequeño delay para asegurar que la conexión esté estable
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            enviar_estado_actual_rele();
+#if CONFIG_BOOT_TRACE_HABILITADO
+            // Sale al conectar; si NTP aún no ha sincronizado la traza no lleva ese hito
+            if (!traza_arranque_enviada) {
+                traza_arranque_enviada = (mqtt_comandos_encolar("traza_arranque", NULL, NULL,
+                                                                comando_traza_arranque, NULL, 0) == ESP_OK);
+            }
+#endif
+
+            // Enviar estado actual del relé después de conectarse; la pausa de
+            // estabilización se hace en la tarea de comandos, no en la tarea MQTT
+            mqtt_comandos_encolar("estado_inicial", NULL, NULL, comando_estado_inicial, NULL, 0);
         }
         break;
         
     case MQTT_EVENT_DISCONNECTED:
         // Aquí puedes manejar la reconexión o cualquier otra lógica necesaria
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-        mqtt_reconnect_pending = true;
         mqtt_is_connected = false; // Actualizamos el estado de conexión
+        mqtt_reconexion_desconectado();
         break;
         
     case MQTT_EVENT_SUBSCRIBED:
@@ -533,21 +923,48 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         
     case MQTT_EVENT_PUBLISHED:
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        if (outbox_task_handle != NULL && outbox_anotar_ack(event->msg_id)) {
+            xTaskNotify(outbox_task_handle, OUTBOX_NOTIF_PUBLICADO, eSetBits);
+        }
         break;
         
     case MQTT_EVENT_DATA: {
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-        char json_buffer[256];
-        int len = event->data_len < sizeof(json_buffer) - 1 ? event->data_len : sizeof(json_buffer) - 1;
-        memcpy(json_buffer, event->data, len);
-        json_buffer[len] = '\0';
+        const char *topic = event->topic;
+        size_t topic_len = event->topic_len;
+        const char *datos = event->data;
+        size_t longitud = event->data_len;
 
-        char topic_buffer[128];
-        int tlen = event->topic_len < sizeof(topic_buffer) - 1 ? event->topic_len : sizeof(topic_buffer) - 1;
-        memcpy(topic_buffer, event->topic, tlen);
-        topic_buffer[tlen] = '\0';
+#if CONFIG_MQTT_USAR_V5
+        // Response Topic y Correlation Data solo llegan con el primer fragmento
+        if (event->current_data_offset == 0) {
+            guardar_respuesta(event->property);
+        }
+#endif
+
+        // Payload mayor que el buffer del cliente: llega en varios eventos y se reensambla
+        if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+            mqtt_reensamblado_t res = mqtt_reensamblador_agregar(&reensamblador, event->topic, event->topic_len,
+                                                                 event->data, event->data_len,
+                                                                 event->current_data_offset, event->total_data_len);
+            if (res != MQTT_REENSAMBLADO_COMPLETO) {
+                break;
+            }
+            topic = reensamblador.topic;
+            topic_len = reensamblador.topic_len;
+            datos = reensamblador.buf;
+            longitud = reensamblador.total;
+            ESP_LOGI(TAG, "Mensaje de %u bytes reensamblado en %s", (unsigned)longitud, topic);
+        }
 
-        mqtt_service_procesar_mensaje(topic_buffer, json_buffer);
+#if CONFIG_MQTT_USAR_V5
+        const mqtt_router_respuesta_t *respuesta = (respuesta_recibida.topic_len > 0) ? &respuesta_recibida : NULL;
+#else
+        const mqtt_router_respuesta_t *respuesta = NULL;
+#endif
+        if (mqtt_router_despachar(topic, topic_len, datos, longitud, respuesta) == 0) {
+            ESP_LOGW(TAG, "Mensaje recibido en tópico no manejado: %.*s", (int)topic_len, topic);
+        }
         break;
     }
     
@@ -559,7 +976,8 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             log_error_if_nonzero("captured as transport's socket errno", event->error_handle->esp_transport_sock_errno);
             ESP_LOGI(TAG, "Last errno string (%s)", strerror(event->error_handle->esp_transport_sock_errno));
         }
-        mqtt_reconnect_pending = true;
+        // Tras un error el cliente aborta la conexión y emite MQTT_EVENT_DISCONNECTED,
+        // que es el que programa la reconexión
         break;
         
     default:
@@ -586,16 +1004,47 @@ bool mqtt_service_esta_conectado(void) {
     return mqtt_is_connected;
 }
 
-void mqtt_service_enviar_dato(const char *topic, const char *valor, int qos, int retain)
+// Publica datos de longitud conocida (texto o binario) o los guarda en el outbox
+static void enviar(const char *topic, const char *datos, size_t len, bool texto, int qos, int retain)
 {
     if (qos < 0 || qos > 2) {
         ESP_LOGE(TAG, "QoS inválido (%d). Debe ser 0, 1 o 2. Usando QoS=1 por defecto.", qos);
         qos = 1;
     }
-    if (mqtt_client != NULL)
+
+    // QoS 0 es telemetría que se renueva sola: no se guarda en flash ni espera
+    // al outbox (no necesita orden con lo pendiente); sin conexión se descarta
+    if (qos == 0 && !(mqtt_client != NULL && mqtt_is_connected))
     {
-        int msg_id = esp_mqtt_client_publish(mqtt_client, topic, valor, 0, qos, retain);
-        ESP_LOGI(TAG, "Mensaje enviado al topic %s: %s (ID=%d, QoS=%d, retain=%d)", topic, valor, msg_id, qos, retain);
+        ESP_LOGD(TAG, "Sin conexión MQTT, mensaje QoS 0 para %s descartado", topic);
+        return;
+    }
+
+    // Mientras haya mensajes en el outbox los nuevos van detrás para conservar el orden
+    if (mqtt_client != NULL && mqtt_is_connected && (qos == 0 || !mqtt_outbox_pendiente()))
+    {
+        int msg_id = publicar(topic, datos, len, qos, retain);
+        if (texto) {
+            ESP_LOGI(TAG, "Mensaje enviado al topic %s: %s (ID=%d, QoS=%d, retain=%d)", topic, datos, msg_id, qos, retain);
+        } else {
+            ESP_LOGI(TAG, "Mensaje binario enviado al topic %s: %u bytes (ID=%d, QoS=%d, retain=%d)",
+                     topic, (unsigned)len, msg_id, qos, retain);
+        }
+        return;
+    }
+
+    if (mqtt_outbox_agregar(topic, datos, len, qos, retain) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Sin conexión MQTT, mensaje para %s guardado en el outbox", topic);
+        if (mqtt_is_connected && outbox_task_handle != NULL) {
+            xTaskNotify(outbox_task_handle, OUTBOX_NOTIF_REENVIAR, eSetBits);
+        }
+    }
+    else if (mqtt_client != NULL)
+    {
+        int msg_id = publicar(topic, datos, len, qos, retain);
+        ESP_LOGI(TAG, "Mensaje enviado al topic %s: %u bytes (ID=%d, QoS=%d, retain=%d)",
+                 topic, (unsigned)len, msg_id, qos, retain);
     }
     else
     {
@@ -603,6 +1052,16 @@ void mqtt_service_enviar_dato(const char *topic, const char *valor, int qos, int
     }
 }
 
+void mqtt_service_enviar_dato(const char *topic, const char *valor, int qos, int retain)
+{
+    enviar(topic, valor, strlen(valor), true, qos, retain);
+}
+
+void mqtt_service_enviar_binario(const char *topic, const uint8_t *datos, size_t len, int qos, int retain)
+{
+    enviar(topic, (const char *)datos, len, false, qos, retain);
+}
+
 int mqtt_service_suscribirse(const char *topic, int qos)
 {
     if (mqtt_client != NULL)
@@ -618,7 +1077,6 @@ int mqtt_service_suscribirse(const char *topic, int qos)
     }
 }
 
-// Modificar mqtt_service_enviar_json para manejar booleanos
 void mqtt_service_enviar_json(const char *topic, int qos, int retain, ...)
 {
     if (qos < 0 || qos > 2) {
@@ -626,33 +1084,63 @@ void mqtt_service_enviar_json(const char *topic, int qos, int retain, ...)
         qos = 1;
     }
     
-    char json_buffer[512]; // Incrementamos el tamaño
-    char *ptr = json_buffer;
-    int remaining = sizeof(json_buffer);
+    char json_buffer[512];
+    json_writer_t w;
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_writer_objeto(&w, NULL);
+
     va_list args;
     va_start(args, retain);
-
-    int written = snprintf(ptr, remaining, "{");
-    ptr += written;
-    remaining -= written;
-
-    int first = 1;
     const char *clave;
     while ((clave = va_arg(args, const char *)) != NULL) {
         const char *valor = va_arg(args, const char *);
         if (!valor) break;
-        
-        written = snprintf(ptr, remaining, "%s\"%s\":\"%s\"", first ? "" : ",", clave, valor);
-        ptr += written;
-        remaining -= written;
-        first = 0;
+        json_writer_str(&w, clave, valor);
     }
+    va_end(args);
+
+    mqtt_service_enviar_json_writer(topic, &w, qos, retain);
+}
 
-    snprintf(ptr, remaining, "}");
+esp_err_t mqtt_service_enviar_json_writer(const char *topic, json_writer_t *w, int qos, int retain)
+{
+    const char *json = json_writer_terminar(w);
+    if (json == NULL) {
+        ESP_LOGE(TAG, "JSON para %s no cabe en el buffer (%u bytes), no se envía", topic, (unsigned)w->capacidad);
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_service_enviar_dato(topic, json, qos, retain);
+    return ESP_OK;
+}
 
-    va_end(args);
+esp_err_t mqtt_service_enviar_respuesta(const char *topic, json_writer_t *w, int qos,
+                                        const void *correlacion, size_t correlacion_len)
+{
+#if CONFIG_MQTT_USAR_V5
+    // La correlación viaja como propiedad del PUBLISH: no pasa por el outbox
+    if (mqtt_client != NULL && mqtt_is_connected && !mqtt_outbox_pendiente()) {
+        const char *json = json_writer_terminar(w);
+        if (json == NULL) {
+            ESP_LOGE(TAG, "JSON para %s no cabe en el buffer (%u bytes), no se envía", topic, (unsigned)w->capacidad);
+            return ESP_ERR_NO_MEM;
+        }
+        int msg_id = mqtt_v5_publicar(mqtt_client, topic, json, 0, qos, 0, correlacion, correlacion_len);
+        ESP_LOGI(TAG, "Respuesta enviada al topic %s: %s (ID=%d)", topic, json, msg_id);
+        return ESP_OK;
+    }
+#endif
+    return mqtt_service_enviar_json_writer(topic, w, qos, 0);
+}
 
-    mqtt_service_enviar_dato(topic, json_buffer, qos, retain);
+esp_err_t mqtt_service_enviar_cbor_writer(const char *topic, cbor_writer_t *w, int qos, int retain)
+{
+    size_t len = cbor_writer_terminar(w);
+    if (len == 0) {
+        ESP_LOGE(TAG, "CBOR para %s no cabe en el buffer (%u bytes), no se envía", topic, (unsigned)w->capacidad);
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_service_enviar_binario(topic, w->buf, len, qos, retain);
+    return ESP_OK;
 }
 
 void mqtt_service_notificar_temperatura(float temperatura)
@@ -684,6 +1172,8 @@ void mqtt_service_start(void)
     }
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = CONFIG_BROKER_URL,
+        // Respaldo: los reintentos con jitter los adelanta mqtt_reconexion
+        .network.reconnect_timeout_ms = MQTT_RECONEXION_MAX_MS,
         .broker.verification.certificate = (const char *)ca_pem_start,
         .credentials.username = CONFIG_MQTT_USERNAME,
         .credentials.authentication.password = CONFIG_MQTT_PASSWORD,
@@ -720,15 +1210,41 @@ void mqtt_service_start(void)
     }
 #endif
 
+    mqtt_reensamblador_init(&reensamblador, MQTT_MAX_MENSAJE_RECIBIDO);
+    mqtt_comandos_iniciar();
+
+    // Outbox persistente para lo que se publique sin conexión
+    if (mqtt_outbox_init() == ESP_OK &&
+        tarea_hay_que_crear(&outbox_salir, &outbox_task_handle, &outbox_terminada)) {
+        xTaskCreate(mqtt_outbox_task, "mqtt_outbox_task", 3072, NULL, 4, &outbox_task_handle);
+    }
+
+#if CONFIG_MQTT_USAR_V5
+    mqtt_v5_configurar(&mqtt_cfg);
+#endif
+
+#if CONFIG_MQTT_TLS_REANUDAR_SESION
+    // Transporte propio sobre esp-tls: el de esp-mqtt no reutiliza tickets de sesión
+    if (strncmp(mqtt_cfg.broker.address.uri, "mqtts://", 8) == 0) {
+        mqtt_cfg.network.transport = tls_sesion_crear_transporte(ca_pem_start, ca_pem_end - ca_pem_start);
+    }
+#endif
+
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+#if CONFIG_MQTT_TLS_REANUDAR_SESION
+    if (mqtt_client == NULL) {
+        tls_sesion_liberar_transporte();
+    }
+#endif
+#if CONFIG_MQTT_USAR_V5
+    mqtt_v5_iniciar(mqtt_client);
+#endif
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(mqtt_client);
 
-    // Crear la tarea de reconexión si no existe
-    if (mqtt_reconnect_task_handle == NULL) {
-        // reconnect task uses little stack; allocate 2048 words
-        xTaskCreate(mqtt_reconnect_task, "mqtt_reconnect_task", 2048, NULL, 5, &mqtt_reconnect_task_handle);
-    }
+    // Antes de start: un DISCONNECTED del primer intento no puede perderse
+    mqtt_reconexion_iniciar(mqtt_client);
+    esp_mqtt_client_start(mqtt_client);
+    boot_trace_marcar(BOOT_TRACE_MQTT_INICIADO);
     
     // Crear la cola de temperatura si no existe
     if (temp_mqtt_queue == NULL) {
@@ -739,7 +1255,8 @@ void mqtt_service_start(void)
     }
     
     // Crear la tarea para envío de temperatura si no existe
-    if (temp_mqtt_task_handle == NULL) {
+    if (temp_mqtt_queue != NULL &&
+        tarea_hay_que_crear(&temp_mqtt_salir, &temp_mqtt_task_handle, &temp_mqtt_terminada)) {
         BaseType_t res = xTaskCreatePinnedToCore(
                                     temp_mqtt_task,
                                     "temp_mqtt_task",
@@ -763,28 +1280,41 @@ void mqtt_service_stop(void)
         ESP_LOGI(TAG, "MQTT service ya detenido (idempotente)");
         return;
     }
-    if (mqtt_client != NULL)
-    {
-        esp_mqtt_client_stop(mqtt_client);
-        esp_mqtt_client_destroy(mqtt_client);
-        mqtt_client = NULL;
-        mqtt_is_connected = false; // Asegurarse de actualizar el estado
-        
-        // NO reseteamos la bandera motivo_reinicio_enviado aquí,
-        // ya que queremos que permanezca true hasta el próximo reinicio real
-        
-        ESP_LOGI(TAG, "MQTT service stopped and resources released");
+
+    // Primero las tareas que publican: ninguna puede quedar dentro del cliente al destruirlo
+    TaskHandle_t outbox = pedir_salida_tarea(&outbox_salir, &outbox_task_handle);
+    if (outbox != NULL) {
+        xTaskNotify(outbox, OUTBOX_NOTIF_SALIR, eSetBits);
     }
-    
-    // Detener y eliminar la tarea de temperatura
-    if (temp_mqtt_task_handle != NULL) {
-        vTaskDelete(temp_mqtt_task_handle);
-        temp_mqtt_task_handle = NULL;
+    bool temp_viva = pedir_salida_tarea(&temp_mqtt_salir, &temp_mqtt_task_handle) != NULL;
+
+    // Detener el ejecutor de comandos (termina el comando en curso)
+    mqtt_comandos_detener();
+
+    // Los pendientes del outbox siguen en flash
+    if (outbox != NULL) {
+        esperar_salida_tarea(outbox_terminada, "mqtt_outbox_task");
+    }
+    // La cola de temperatura se conserva: mqtt_service_notificar_temperatura() la usa sin bloqueo
+    if (temp_viva) {
+        esperar_salida_tarea(temp_mqtt_terminada, "temp_mqtt_task");
     }
-    
-    // Eliminar la cola
     if (temp_mqtt_queue != NULL) {
-        vQueueDelete(temp_mqtt_queue);
-        temp_mqtt_queue = NULL;
+        xQueueReset(temp_mqtt_queue);
     }
+
+    mqtt_reconexion_detener();
+    esp_mqtt_client_stop(mqtt_client);
+    esp_mqtt_client_destroy(mqtt_client);
+    mqtt_client = NULL;
+    mqtt_is_connected = false; // Asegurarse de actualizar el estado
+#if CONFIG_MQTT_TLS_REANUDAR_SESION
+    // Nada si esp_mqtt_client_destroy() ya lo destruyó
+    tls_sesion_liberar_transporte();
+#endif
+
+    // NO reseteamos la bandera motivo_reinicio_enviado aquí,
+    // ya que queremos que permanezca true hasta el próximo reinicio real
+
+    ESP_LOGI(TAG, "MQTT service stopped and resources released");
 }
@@ -0,0 +1,161 @@
+#include "mqtt_v5.h"
+
+#if CONFIG_MQTT_USAR_V5
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "wifi_sta.h"
+
+static const char *TAG = "mqtt_v5";
+
+// Bytes de la propiedad Topic Alias (identificador + uint16)
+#define BYTES_PROPIEDAD_ALIAS   3
+#define MAX_TOPIC               96
+
+typedef struct {
+    char topic[MAX_TOPIC];
+    uint16_t publicaciones;
+    uint16_t alias;                 // 0 = sin alias
+    bool enviado;                   // El broker ya conoce el alias en esta conexión
+} candidato_t;
+
+static SemaphoreHandle_t s_mutex = NULL;
+static candidato_t s_candidatos[MQTT_V5_CANDIDATOS];
+static uint16_t s_num_alias = 0;
+static mqtt_v5_estadisticas_t s_estadisticas;
+
+void mqtt_v5_configurar(esp_mqtt_client_config_t *cfg)
+{
+    cfg->session.protocol_ver = MQTT_PROTOCOL_V_5;
+    // Clean Start = 0: con sesión vigente el broker conserva las suscripciones
+    cfg->session.disable_clean_session = true;
+}
+
+esp_err_t mqtt_v5_iniciar(esp_mqtt_client_handle_t client)
+{
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_mqtt5_user_property_item_t propiedades[] = {
+        { "fw", esp_app_get_description()->version },
+        { "mac", sta_wifi_get_mac_clean() },
+    };
+    esp_mqtt5_connection_property_config_t conexion = {
+        .session_expiry_interval = MQTT_V5_SESION_EXPIRA_S,
+        .request_problem_info = true,
+    };
+    esp_mqtt5_client_set_user_property(&conexion.user_property, propiedades,
+                                       sizeof(propiedades) / sizeof(propiedades[0]));
+    esp_err_t err = esp_mqtt5_client_set_connect_property(client, &conexion);
+    // El cliente copia las user properties; las nuestras se liberan ya
+    esp_mqtt5_client_delete_user_property(conexion.user_property);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error fijando propiedades de conexión: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "MQTT 5: sesión de %d s, hasta %d alias de tópico", MQTT_V5_SESION_EXPIRA_S, MQTT_V5_MAX_ALIAS);
+    return ESP_OK;
+}
+
+void mqtt_v5_conectado(void)
+{
+    if (s_mutex == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MQTT_V5_CANDIDATOS; i++) {
+        s_candidatos[i].enviado = false;
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+// Devuelve el candidato del tópico; si no está, reutiliza el menos publicado sin alias
+static candidato_t *obtener_candidato(const char *topic)
+{
+    candidato_t *libre = NULL;
+    for (size_t i = 0; i < MQTT_V5_CANDIDATOS; i++) {
+        candidato_t *c = &s_candidatos[i];
+        if (c->topic[0] != '\0' && strcmp(c->topic, topic) == 0) {
+            return c;
+        }
+        if (c->alias == 0 && (libre == NULL || c->publicaciones < libre->publicaciones)) {
+            libre = c;
+        }
+    }
+    if (libre == NULL || strlen(topic) >= MAX_TOPIC) {
+        return NULL;
+    }
+    strcpy(libre->topic, topic);
+    libre->publicaciones = 0;
+    libre->enviado = false;
+    return libre;
+}
+
+int mqtt_v5_publicar(esp_mqtt_client_handle_t client, const char *topic, const char *datos, int len,
+                     int qos, int retain, const void *correlacion, size_t correlacion_len)
+{
+    esp_mqtt5_publish_property_config_t propiedades = {
+        .correlation_data = correlacion,
+        .correlation_data_len = (uint16_t)correlacion_len,
+    };
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    const char *topic_envio = topic;
+    candidato_t *c = obtener_candidato(topic);
+    if (c != NULL) {
+        if (c->publicaciones < UINT16_MAX) {
+            c->publicaciones++;
+        }
+        if (c->alias == 0 && c->publicaciones >= MQTT_V5_UMBRAL_ALIAS && s_num_alias < MQTT_V5_MAX_ALIAS) {
+            c->alias = ++s_num_alias;
+            ESP_LOGI(TAG, "Alias %u asignado a %s", c->alias, topic);
+        }
+        propiedades.topic_alias = c->alias;
+        if (c->alias != 0 && c->enviado && qos == 0) {
+            topic_envio = "";
+        }
+    }
+
+    // Las propiedades se aplican a la siguiente publicación del cliente
+    esp_mqtt5_client_set_publish_property(client, &propiedades);
+    int msg_id = esp_mqtt_client_publish(client, topic_envio, datos, len, qos, retain);
+
+    if (msg_id >= 0) {
+        s_estadisticas.publicaciones++;
+        if (propiedades.topic_alias != 0) {
+            if (topic_envio[0] == '\0') {
+                s_estadisticas.con_alias++;
+                s_estadisticas.bytes_ahorrados += (int32_t)strlen(topic) - BYTES_PROPIEDAD_ALIAS;
+            } else {
+                s_estadisticas.bytes_ahorrados -= BYTES_PROPIEDAD_ALIAS;
+                c->enviado = true;
+            }
+        }
+    }
+
+    xSemaphoreGive(s_mutex);
+    return msg_id;
+}
+
+void mqtt_v5_obtener_estadisticas(mqtt_v5_estadisticas_t *estadisticas)
+{
+    if (s_mutex == NULL) {
+        memset(estadisticas, 0, sizeof(*estadisticas));
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *estadisticas = s_estadisticas;
+    xSemaphoreGive(s_mutex);
+}
+
+#endif // CONFIG_MQTT_USAR_V5
@@ -0,0 +1,331 @@
+#include "tls_sesion.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "tls_sesion";
+
+#define TLS_SESION_MAX_HOST     64
+
+typedef struct
+{
+    esp_tls_t *tls;
+    const uint8_t *ca_pem;
+    size_t ca_len;
+} tls_sesion_ctx_t;
+
+// Ticket de la última conexión correcta; se comparte entre transportes
+static esp_tls_client_session_t *s_ticket = NULL;
+static char s_ticket_host[TLS_SESION_MAX_HOST];
+static int s_ticket_puerto = 0;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static tls_sesion_estadisticas_t s_estadisticas;
+
+// Transporte vivo; tls_destruir lo pone a NULL sea quien sea quien lo destruya
+static esp_transport_handle_t s_transporte = NULL;
+
+/**
+ * Saca el ticket de la caché si es del mismo host: mientras dura el
+ * handshake es del llamador y tls_sesion_olvidar() no puede liberarlo.
+ */
+static esp_tls_client_session_t *tomar_ticket(const char *host, int puerto)
+{
+    esp_tls_client_session_t *ticket = NULL;
+    esp_tls_client_session_t *descartado = NULL;
+
+    portENTER_CRITICAL(&s_mux);
+    if (s_ticket_puerto == puerto && strcmp(s_ticket_host, host) == 0) {
+        ticket = s_ticket;
+    } else {
+        descartado = s_ticket;
+    }
+    s_ticket = NULL;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (descartado != NULL) {
+        esp_tls_free_client_session(descartado);
+    }
+    return ticket;
+}
+
+static void guardar_ticket(const char *host, int puerto, esp_tls_client_session_t *ticket)
+{
+    esp_tls_client_session_t *anterior;
+
+    portENTER_CRITICAL(&s_mux);
+    anterior = s_ticket;
+    s_ticket = ticket;
+    strlcpy(s_ticket_host, host, sizeof(s_ticket_host));
+    s_ticket_puerto = puerto;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (anterior != NULL) {
+        esp_tls_free_client_session(anterior);
+    }
+}
+
+static void registrar_handshake(bool reanudado, bool ok, uint32_t ms, uint32_t heap)
+{
+    portENTER_CRITICAL(&s_mux);
+    if (!ok) {
+        s_estadisticas.fallidos++;
+    } else if (reanudado) {
+        s_estadisticas.reanudados++;
+        s_estadisticas.ms_reanudado_ultimo = ms;
+        if (ms > s_estadisticas.ms_reanudado_max) {
+            s_estadisticas.ms_reanudado_max = ms;
+        }
+        if (heap > s_estadisticas.heap_reanudado_max) {
+            s_estadisticas.heap_reanudado_max = heap;
+        }
+    } else {
+        s_estadisticas.completos++;
+        s_estadisticas.ms_completo_ultimo = ms;
+        if (ms > s_estadisticas.ms_completo_max) {
+            s_estadisticas.ms_completo_max = ms;
+        }
+        if (heap > s_estadisticas.heap_completo_max) {
+            s_estadisticas.heap_completo_max = heap;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    if (ok) {
+        ESP_LOGI(TAG, "Handshake %s en %" PRIu32 " ms, pico de heap %" PRIu32 " bytes",
+                 reanudado ? "con ticket" : "completo", ms, heap);
+    } else {
+        ESP_LOGW(TAG, "Handshake %s fallido tras %" PRIu32 " ms",
+                 reanudado ? "con ticket" : "completo", ms);
+    }
+}
+
+static int esperar_socket(tls_sesion_ctx_t *ctx, bool lectura, int timeout_ms)
+{
+    int fd = -1;
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK || fd < 0) {
+        return -1;
+    }
+
+    fd_set fds;
+    fd_set errores;
+    FD_ZERO(&fds);
+    FD_ZERO(&errores);
+    FD_SET(fd, &fds);
+    FD_SET(fd, &errores);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(fd + 1, lectura ? &fds : NULL, lectura ? NULL : &fds, &errores,
+                     timeout_ms < 0 ? NULL : &tv);
+    if (ret > 0 && FD_ISSET(fd, &errores)) {
+        ESP_LOGE(TAG, "Error en el socket TLS (errno %d)", errno);
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_conectar(esp_transport_handle_t t, const char *host, int puerto, int timeout_ms)
+{
+    tls_sesion_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+    }
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL) {
+        return -1;
+    }
+
+    esp_tls_client_session_t *ticket = tomar_ticket(host, puerto);
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = ctx->ca_pem,
+        .cacert_bytes = ctx->ca_len,
+        .timeout_ms = timeout_ms,
+        .client_session = ticket,
+    };
+
+    size_t heap_antes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    bool monitor = (heap_caps_monitor_local_minimum_free_size_start() == ESP_OK);
+    int64_t inicio = esp_timer_get_time();
+
+    int ret = esp_tls_conn_new_sync(host, strlen(host), puerto, &cfg, ctx->tls);
+
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - inicio) / 1000);
+    size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    if (monitor) {
+        heap_caps_monitor_local_minimum_free_size_stop();
+    }
+    uint32_t heap = (monitor && heap_antes > heap_min) ? (uint32_t)(heap_antes - heap_min) : 0;
+
+    registrar_handshake(ticket != NULL, ret > 0, ms, heap);
+
+    if (ret <= 0) {
+        // Un ticket rechazado no debe impedir el siguiente handshake completo
+        if (ticket != NULL) {
+            esp_tls_free_client_session(ticket);
+        }
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+        return -1;
+    }
+
+    // TLS 1.2 entrega el ticket nuevo dentro del handshake
+    esp_tls_client_session_t *nuevo = esp_tls_get_client_session(ctx->tls);
+    if (nuevo != NULL) {
+        if (ticket != NULL) {
+            esp_tls_free_client_session(ticket);
+        }
+        guardar_ticket(host, puerto, nuevo);
+    } else if (ticket != NULL) {
+        guardar_ticket(host, puerto, ticket);
+    }
+    return 0;
+}
+
+static int tls_leer(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_sesion_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls == NULL) {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    // Lo ya descifrado en mbedTLS no se ve en el socket
+    if (esp_tls_get_bytes_avail(ctx->tls) <= 0) {
+        int listo = esperar_socket(ctx, true, timeout_ms);
+        if (listo <= 0) {
+            return listo == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+        }
+    }
+
+    int ret = esp_tls_conn_read(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ret;
+}
+
+static int tls_escribir(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_sesion_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls == NULL) {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int listo = esperar_socket(ctx, false, timeout_ms);
+    if (listo <= 0) {
+        return listo == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int ret = esp_tls_conn_write(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_WRITE || ret == ESP_TLS_ERR_SSL_WANT_READ) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ret;
+}
+
+static int tls_esperar_lectura(esp_transport_handle_t t, int timeout_ms)
+{
+    tls_sesion_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls != NULL && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+    return esperar_socket(ctx, true, timeout_ms);
+}
+
+static int tls_esperar_escritura(esp_transport_handle_t t, int timeout_ms)
+{
+    return esperar_socket(esp_transport_get_context_data(t), false, timeout_ms);
+}
+
+static int tls_cerrar(esp_transport_handle_t t)
+{
+    tls_sesion_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_destruir(esp_transport_handle_t t)
+{
+    tls_cerrar(t);
+    free(esp_transport_get_context_data(t));
+    if (s_transporte == t) {
+        s_transporte = NULL;
+    }
+    return 0;
+}
+
+esp_transport_handle_t tls_sesion_crear_transporte(const uint8_t *ca_pem, size_t ca_len)
+{
+    // Un solo cliente MQTT: si el anterior sigue vivo se reutiliza en vez de crear otro
+    if (s_transporte != NULL) {
+        tls_sesion_ctx_t *anterior = esp_transport_get_context_data(s_transporte);
+        anterior->ca_pem = ca_pem;
+        anterior->ca_len = ca_len;
+        return s_transporte;
+    }
+
+    tls_sesion_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    esp_transport_handle_t t = esp_transport_init();
+    if (ctx == NULL || t == NULL) {
+        ESP_LOGE(TAG, "Sin memoria para el transporte TLS");
+        free(ctx);
+        if (t != NULL) {
+            esp_transport_destroy(t);
+        }
+        return NULL;
+    }
+
+    ctx->ca_pem = ca_pem;
+    ctx->ca_len = ca_len;
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, tls_conectar, tls_leer, tls_escribir, tls_cerrar,
+                           tls_esperar_lectura, tls_esperar_escritura, tls_destruir);
+    esp_transport_set_default_port(t, 8883);
+    s_transporte = t;
+    return t;
+}
+
+void tls_sesion_liberar_transporte(void)
+{
+    if (s_transporte != NULL) {
+        esp_transport_destroy(s_transporte);
+    }
+}
+
+void tls_sesion_olvidar(void)
+{
+    esp_tls_client_session_t *ticket;
+
+    portENTER_CRITICAL(&s_mux);
+    ticket = s_ticket;
+    s_ticket = NULL;
+    s_ticket_host[0] = '\0';
+    s_ticket_puerto = 0;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (ticket != NULL) {
+        esp_tls_free_client_session(ticket);
+    }
+}
+
+void tls_sesion_obtener_estadisticas(tls_sesion_estadisticas_t *estadisticas)
+{
+    portENTER_CRITICAL(&s_mux);
+    *estadisticas = s_estadisticas;
+    portEXIT_CRITICAL(&s_mux);
+}
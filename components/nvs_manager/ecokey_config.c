@@ -0,0 +1,390 @@
+#include "ecokey_config.h"
+#include "nvs_manager.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "ECOKEY_CONFIG";
+
+// Claves sueltas anteriores al blob; solo se leen para migrar
+#define LEGADO_APP_ESTADO       "app_estado"
+#define LEGADO_ESTADO_RELE      "estado_rele"
+#define LEGADO_MODO             "modo_operacion"
+#define LEGADO_TEMPORIZADOR     "temporizador"
+#define LEGADO_MAC_OBJETIVO     "mac_objetivo"
+#define LEGADO_SSID             "ssid"
+#define LEGADO_PASSWORD         "password"
+
+static ecokey_config_t s_config;
+static SemaphoreHandle_t s_mutex = NULL;   // Serializa las modificaciones
+
+static void valores_por_defecto(ecokey_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->version = ECOKEY_CONFIG_VERSION;
+    cfg->longitud = sizeof(ecokey_config_t);
+    cfg->app_estado = ECOKEY_CONFIG_APP_ESTADO_NINGUNO;
+    cfg->modo_operacion = ECOKEY_MODO_SIN_DEFINIR;
+    cfg->temporizador_min = ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO;
+}
+
+static bool temporizador_valido(uint32_t minutos)
+{
+    return minutos >= ECOKEY_CONFIG_TEMPORIZADOR_MIN && minutos <= ECOKEY_CONFIG_TEMPORIZADOR_MAX;
+}
+
+/**
+ * Corrige los campos fuera de rango; devuelve cuántos se corrigieron
+ */
+static int validar(ecokey_config_t *cfg)
+{
+    int corregidos = 0;
+
+    if (!temporizador_valido(cfg->temporizador_min)) {
+        ESP_LOGW(TAG, "Temporizador fuera de rango (%u), usando %d min",
+                 cfg->temporizador_min, ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO);
+        cfg->temporizador_min = ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO;
+        corregidos++;
+    }
+    if (cfg->modo_operacion > ECOKEY_MODO_AUTOMATICO) {
+        cfg->modo_operacion = ECOKEY_MODO_SIN_DEFINIR;
+        corregidos++;
+    }
+    // Un blob dañado puede dejar en un bool un byte distinto de 0/1
+    uint8_t byte;
+    memcpy(&byte, &cfg->estado_rele, 1);
+    if (byte > 1) {
+        cfg->estado_rele = true;
+        corregidos++;
+    }
+    memcpy(&byte, &cfg->mac_objetivo_valida, 1);
+    if (byte > 1) {
+        cfg->mac_objetivo_valida = false;
+        corregidos++;
+    }
+    // Cadenas siempre terminadas aunque el blob esté dañado
+    if (memchr(cfg->ssid, '\0', sizeof(cfg->ssid)) == NULL) {
+        cfg->ssid[0] = '\0';
+        corregidos++;
+    }
+    if (memchr(cfg->password, '\0', sizeof(cfg->password)) == NULL) {
+        cfg->password[0] = '\0';
+        corregidos++;
+    }
+    return corregidos;
+}
+
+static esp_err_t guardar(void)
+{
+    s_config.version = ECOKEY_CONFIG_VERSION;
+    s_config.longitud = sizeof(ecokey_config_t);
+    esp_err_t err = nvs_manager_set_blob(ECOKEY_CONFIG_CLAVE_NVS, &s_config, sizeof(s_config));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error al guardar la configuración: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t ecokey_config_parsear_mac(const char *texto, uint8_t mac[6])
+{
+    if (texto == NULL || mac == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t len = strlen(texto);
+    size_t paso;
+    if (len == 12) {
+        paso = 2;       // AABBCCDDEEFF
+    } else if (len == 17) {
+        paso = 3;       // AA:BB:CC:DD:EE:FF o AA-BB-...
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t resultado[6];
+    for (size_t i = 0; i < 6; i++) {
+        const char *p = texto + i * paso;
+        uint8_t byte = 0;
+        for (size_t j = 0; j < 2; j++) {
+            char c = p[j];
+            uint8_t nibble;
+            if (c >= '0' && c <= '9') {
+                nibble = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                nibble = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                nibble = c - 'A' + 10;
+            } else {
+                return ESP_ERR_INVALID_ARG;
+            }
+            byte = (byte << 4) | nibble;
+        }
+        if (paso == 3 && i < 5 && p[2] != ':' && p[2] != '-') {
+            return ESP_ERR_INVALID_ARG;
+        }
+        resultado[i] = byte;
+    }
+
+    memcpy(mac, resultado, sizeof(resultado));
+    return ESP_OK;
+}
+
+/**
+ * Construye la configuración desde las claves sueltas de versiones
+ * anteriores; devuelve true si había alguna
+ */
+static bool leer_claves_legado(ecokey_config_t *cfg)
+{
+    bool encontrada = false;
+    char texto[ECOKEY_CONFIG_MAX_PASSWORD];
+
+    if (nvs_manager_key_exists(LEGADO_APP_ESTADO)) {
+        int32_t estado = nvs_manager_get_int(LEGADO_APP_ESTADO, ECOKEY_CONFIG_APP_ESTADO_NINGUNO);
+        // Fuera de uint8_t no es un estado: truncarlo daría otro válido
+        cfg->app_estado = (estado >= 0 && estado <= UINT8_MAX) ? (uint8_t)estado
+                                                               : ECOKEY_CONFIG_APP_ESTADO_NINGUNO;
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_ESTADO_RELE)) {
+        cfg->estado_rele = nvs_manager_get_int(LEGADO_ESTADO_RELE, 0) != 0;
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_MODO) &&
+        nvs_manager_get_string(LEGADO_MODO, texto, sizeof(texto)) == ESP_OK) {
+        if (strcasecmp(texto, "manual") == 0) {
+            cfg->modo_operacion = ECOKEY_MODO_MANUAL;
+        } else if (strcasecmp(texto, "automatico") == 0) {
+            cfg->modo_operacion = ECOKEY_MODO_AUTOMATICO;
+        }
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_TEMPORIZADOR) &&
+        nvs_manager_get_string(LEGADO_TEMPORIZADOR, texto, sizeof(texto)) == ESP_OK) {
+        // Se comprueba antes de estrecharlo a uint8_t: "257" no debe quedar en 1 minuto
+        char *fin;
+        long minutos = strtol(texto, &fin, 10);
+        if (fin != texto && *fin == '\0' &&
+            minutos >= ECOKEY_CONFIG_TEMPORIZADOR_MIN && minutos <= ECOKEY_CONFIG_TEMPORIZADOR_MAX) {
+            cfg->temporizador_min = (uint8_t)minutos;
+        } else {
+            ESP_LOGW(TAG, "Temporizador antiguo no válido: [%s]", texto);
+        }
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_MAC_OBJETIVO) &&
+        nvs_manager_get_string(LEGADO_MAC_OBJETIVO, texto, sizeof(texto)) == ESP_OK) {
+        cfg->mac_objetivo_valida = (ecokey_config_parsear_mac(texto, cfg->mac_objetivo) == ESP_OK);
+        if (!cfg->mac_objetivo_valida) {
+            ESP_LOGW(TAG, "MAC objetivo antigua no válida: [%s]", texto);
+        }
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_SSID)) {
+        nvs_manager_get_string(LEGADO_SSID, cfg->ssid, sizeof(cfg->ssid));
+        encontrada = true;
+    }
+    if (nvs_manager_key_exists(LEGADO_PASSWORD)) {
+        nvs_manager_get_string(LEGADO_PASSWORD, cfg->password, sizeof(cfg->password));
+    }
+    return encontrada;
+}
+
+static void borrar_claves_legado(void)
+{
+    static const char *const claves[] = {
+        LEGADO_APP_ESTADO, LEGADO_ESTADO_RELE, LEGADO_MODO, LEGADO_TEMPORIZADOR,
+        LEGADO_MAC_OBJETIVO, LEGADO_SSID, LEGADO_PASSWORD,
+    };
+    for (size_t i = 0; i < sizeof(claves) / sizeof(claves[0]); i++) {
+        if (nvs_manager_key_exists(claves[i])) {
+            nvs_manager_erase_key(claves[i]);
+        }
+    }
+}
+
+esp_err_t ecokey_config_cargar(void)
+{
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Cabe también un blob de una versión posterior más largo
+    union {
+        ecokey_config_t cfg;
+        uint8_t bytes[256];
+    } leido;
+    _Static_assert(sizeof(ecokey_config_t) <= 256, "ecokey_config_t no cabe en el buffer de carga");
+
+    valores_por_defecto(&s_config);
+
+    size_t longitud = sizeof(leido);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    if (nvs_manager_key_exists(ECOKEY_CONFIG_CLAVE_NVS)) {
+        err = nvs_manager_get_blob(ECOKEY_CONFIG_CLAVE_NVS, leido.bytes, &longitud);
+    }
+
+    if (err == ESP_OK && longitud >= offsetof(ecokey_config_t, app_estado)) {
+        // Los campos que no estaban en el blob conservan el valor por defecto
+        size_t copiar = longitud < sizeof(s_config) ? longitud : sizeof(s_config);
+        memcpy(&s_config, leido.bytes, copiar);
+        uint16_t version_leida = s_config.version;
+        bool corregida = validar(&s_config) > 0;
+
+        if (version_leida != ECOKEY_CONFIG_VERSION || corregida) {
+            ESP_LOGW(TAG, "Configuración v%u (%u bytes) actualizada a v%d",
+                     version_leida, (unsigned)longitud, ECOKEY_CONFIG_VERSION);
+            guardar();
+        }
+        ESP_LOGI(TAG, "Configuración v%d cargada", ECOKEY_CONFIG_VERSION);
+        return ESP_OK;
+    }
+
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "Blob de configuración ilegible (%s), usando valores por defecto",
+                 esp_err_to_name(err));
+    }
+
+    // Sin blob: migrar las claves sueltas, si las hay, y eliminarlas
+    if (leer_claves_legado(&s_config)) {
+        validar(&s_config);
+        err = guardar();
+        if (err == ESP_OK) {
+            borrar_claves_legado();
+            err = nvs_manager_sync();
+        }
+        ESP_LOGI(TAG, "Configuración migrada desde claves sueltas a v%d: %s",
+                 ECOKEY_CONFIG_VERSION, esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Sin configuración guardada, usando valores por defecto");
+    return ESP_OK;
+}
+
+const ecokey_config_t *ecokey_config(void)
+{
+    return &s_config;
+}
+
+esp_err_t ecokey_config_restablecer(esp_err_t (*borrar)(void))
+{
+    if (s_mutex != NULL) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+    }
+    // Con el mutex tomado ningún modificador puede volver a guardar el blob
+    // antiguo entre el borrado y el restablecimiento
+    esp_err_t err = borrar();
+    if (err == ESP_OK) {
+        valores_por_defecto(&s_config);
+    }
+    if (s_mutex != NULL) {
+        xSemaphoreGive(s_mutex);
+    }
+    return err;
+}
+
+/**
+ * Aplica un cambio de un campo bajo el mutex y guarda el blob; si nada
+ * cambió, nvs_manager lo detecta y no escribe
+ */
+#define MODIFICAR(campo, valor)                                     \
+    do {                                                            \
+        if (s_mutex == NULL) {                                      \
+            return ESP_ERR_INVALID_STATE;                           \
+        }                                                           \
+        xSemaphoreTake(s_mutex, portMAX_DELAY);                     \
+        s_config.campo = (valor);                                   \
+        esp_err_t _err = guardar();                                 \
+        xSemaphoreGive(s_mutex);                                    \
+        return _err;                                                \
+    } while (0)
+
+esp_err_t ecokey_config_set_app_estado(uint8_t estado)
+{
+    MODIFICAR(app_estado, estado);
+}
+
+esp_err_t ecokey_config_set_modo(ecokey_modo_t modo)
+{
+    if (modo > ECOKEY_MODO_AUTOMATICO) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    MODIFICAR(modo_operacion, (uint8_t)modo);
+}
+
+esp_err_t ecokey_config_set_estado_rele(bool encendido)
+{
+    MODIFICAR(estado_rele, encendido);
+}
+
+esp_err_t ecokey_config_set_temporizador(uint32_t minutos)
+{
+    if (!temporizador_valido(minutos)) {
+        ESP_LOGE(TAG, "Temporizador fuera de rango: %lu min", (unsigned long)minutos);
+        return ESP_ERR_INVALID_ARG;
+    }
+    MODIFICAR(temporizador_min, (uint8_t)minutos);
+}
+
+esp_err_t ecokey_config_set_mac_objetivo_texto(const char *mac)
+{
+    uint8_t binaria[6];
+    if (ecokey_config_parsear_mac(mac, binaria) != ESP_OK) {
+        ESP_LOGE(TAG, "MAC objetivo no válida: %s", mac ? mac : "(null)");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    memcpy(s_config.mac_objetivo, binaria, sizeof(binaria));
+    s_config.mac_objetivo_valida = true;
+    esp_err_t err = guardar();
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+esp_err_t ecokey_config_set_wifi(const char *ssid, const char *password)
+{
+    if (password == NULL) {
+        password = "";
+    }
+    if (ssid == NULL || ssid[0] == '\0' || strlen(ssid) >= ECOKEY_CONFIG_MAX_SSID ||
+        strlen(password) >= ECOKEY_CONFIG_MAX_PASSWORD) {
+        ESP_LOGE(TAG, "Credenciales WiFi no válidas");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    strlcpy(s_config.ssid, ssid, sizeof(s_config.ssid));
+    strlcpy(s_config.password, password, sizeof(s_config.password));
+    esp_err_t err = guardar();
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+esp_err_t ecokey_config_borrar_wifi(void)
+{
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    memset(s_config.ssid, 0, sizeof(s_config.ssid));
+    memset(s_config.password, 0, sizeof(s_config.password));
+    esp_err_t err = guardar();
+    xSemaphoreGive(s_mutex);
+    return err;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ECOKEY_CONFIG_VERSION               1
+#define ECOKEY_CONFIG_CLAVE_NVS             "config"
+
+#define ECOKEY_CONFIG_MAX_SSID              33      // 32 + '\0'
+#define ECOKEY_CONFIG_MAX_PASSWORD          65      // 64 + '\0'
+
+#define ECOKEY_CONFIG_TEMPORIZADOR_MIN      1       // Minutos
+#define ECOKEY_CONFIG_TEMPORIZADOR_MAX      30
+#define ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO  10
+
+#define ECOKEY_CONFIG_APP_ESTADO_NINGUNO    0xFF    // Igual que ESTADO_INVALIDO
+
+/**
+ * @brief Último modo pedido por control remoto
+ */
+typedef enum {
+    ECOKEY_MODO_SIN_DEFINIR = 0,
+    ECOKEY_MODO_MANUAL,
+    ECOKEY_MODO_AUTOMATICO,
+} ecokey_modo_t;
+
+/**
+ * @brief Configuración persistente del dispositivo
+ *
+ * Se guarda como un único blob versionado bajo ECOKEY_CONFIG_CLAVE_NVS. Los
+ * campos se añaden siempre al final: un blob de una versión anterior se
+ * completa con los valores por defecto y uno posterior se trunca.
+ */
+typedef struct {
+    uint16_t version;                           /**< ECOKEY_CONFIG_VERSION al guardar */
+    uint16_t longitud;                          /**< sizeof(ecokey_config_t) al guardar */
+
+    uint8_t app_estado;                         /**< estado_app_t o ECOKEY_CONFIG_APP_ESTADO_NINGUNO */
+    uint8_t modo_operacion;                     /**< ecokey_modo_t */
+    bool estado_rele;
+    uint8_t temporizador_min;                   /**< Ausencia antes de apagar, en minutos */
+
+    bool mac_objetivo_valida;
+    uint8_t mac_objetivo[6];                    /**< MAC del tag BLE, ya en binario */
+
+    char ssid[ECOKEY_CONFIG_MAX_SSID];          /**< Vacío si no hay credenciales */
+    char password[ECOKEY_CONFIG_MAX_PASSWORD];
+} ecokey_config_t;
+
+/**
+ * @brief Carga la configuración (una lectura) o la migra desde las claves antiguas
+ *
+ * La llama nvs_manager_init(); el resto de componentes solo lee con
+ * ecokey_config().
+ */
+esp_err_t ecokey_config_cargar(void);
+
+/**
+ * @brief Acceso de solo lectura a la configuración en RAM, sin copia
+ *
+ * El puntero es válido siempre. Los campos escalares pueden leerse en
+ * cualquier momento; ssid/password solo cambian durante la provisión.
+ */
+const ecokey_config_t *ecokey_config(void);
+
+/**
+ * @brief Borra el almacenamiento con borrar() y vuelve a los valores por defecto en RAM
+ *
+ * Para nvs_manager_erase_all(): borrar() corre con el mutex de la
+ * configuración tomado, el mismo orden (configuración y luego nvs_manager)
+ * que siguen los modificadores al guardar el blob.
+ *
+ * @return El resultado de borrar(); la RAM solo se restablece si es ESP_OK
+ */
+esp_err_t ecokey_config_restablecer(esp_err_t (*borrar)(void));
+
+/**
+ * @brief Modificadores: validan, actualizan la RAM y guardan el blob
+ *
+ * La escritura pasa por la caché de nvs_manager, así que varias
+ * modificaciones seguidas acaban en un único commit.
+ *
+ * @return ESP_ERR_INVALID_ARG si el valor no es válido (la configuración no cambia)
+ */
+esp_err_t ecokey_config_set_app_estado(uint8_t estado);
+esp_err_t ecokey_config_set_modo(ecokey_modo_t modo);
+esp_err_t ecokey_config_set_estado_rele(bool encendido);
+esp_err_t ecokey_config_set_temporizador(uint32_t minutos);
+
+/**
+ * @brief Guarda la MAC objetivo a partir de "AA:BB:CC:DD:EE:FF" (o sin separadores)
+ */
+esp_err_t ecokey_config_set_mac_objetivo_texto(const char *mac);
+
+/**
+ * @brief Guarda las credenciales WiFi (password NULL para redes abiertas)
+ */
+esp_err_t ecokey_config_set_wifi(const char *ssid, const char *password);
+
+/**
+ * @brief Borra las credenciales WiFi
+ */
+esp_err_t ecokey_config_borrar_wifi(void);
+
+/**
+ * @brief Convierte texto de MAC a binario sin modificar la configuración
+ */
+esp_err_t ecokey_config_parsear_mac(const char *texto, uint8_t mac[6]);
+
+#ifdef __cplusplus
+}
+#endif
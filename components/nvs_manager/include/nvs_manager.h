@@ -6,12 +6,41 @@
 #define NVS_MANAGER_H
 
 #include "esp_err.h"
+#include "sdkconfig.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifdef CONFIG_NVS_MANAGER_RETARDO_COMMIT_MS
+#define NVS_MANAGER_RETARDO_COMMIT_MS   CONFIG_NVS_MANAGER_RETARDO_COMMIT_MS
+#define NVS_MANAGER_MAX_CLAVES          CONFIG_NVS_MANAGER_MAX_CLAVES
+#define NVS_MANAGER_INTERVALO_MIN_CLAVE_MS  CONFIG_NVS_MANAGER_INTERVALO_MIN_CLAVE_MS
+#define NVS_MANAGER_INTERVALO_MIN_CONFIG_MS CONFIG_NVS_MANAGER_INTERVALO_MIN_CONFIG_MS
+#else
+#define NVS_MANAGER_RETARDO_COMMIT_MS   3000    // Espera desde la primera escritura hasta el commit
+#define NVS_MANAGER_MAX_CLAVES          32      // Claves que caben en la caché de RAM
+#define NVS_MANAGER_INTERVALO_MIN_CLAVE_MS  60000   // Mínimo entre dos escrituras en flash de una clave
+#define NVS_MANAGER_INTERVALO_MIN_CONFIG_MS 5000    // Lo mismo para el blob de ecokey_config
+#endif
+
+/**
+ * @brief Contadores de la caché de NVS
+ */
+typedef struct {
+    uint32_t escrituras;        /**< Llamadas a set/erase */
+    uint32_t escrituras_evitadas;   /**< set/erase con el mismo valor que ya había */
+    uint32_t escrituras_aplazadas;  /**< Volcados de una clave retrasados por el limitador */
+    uint32_t escrituras_flash;  /**< Claves escritas o borradas en flash */
+    uint32_t commits;           /**< Llamadas a nvs_commit */
+    uint32_t lecturas_ram;      /**< Lecturas servidas desde la caché */
+    uint32_t lecturas_flash;    /**< Lecturas de claves que no cupieron en la caché */
+    uint32_t claves_sucias;     /**< Claves pendientes del próximo volcado */
+    uint32_t us_ultimo_commit;  /**< Duración del último nvs_commit */
+} nvs_manager_estadisticas_t;
+
 /**
  * @brief Inicializa el subsistema de almacenamiento persistente
  * 
@@ -23,6 +52,26 @@ extern "C" {
  */
 esp_err_t nvs_manager_init(const char* namespace);
 
+/**
+ * @brief Escribe en flash las claves pendientes con un único commit
+ *
+ * Los set/erase se guardan en RAM y se vuelcan solos tras
+ * NVS_MANAGER_RETARDO_COMMIT_MS y antes de esp_restart(); un set con el
+ * mismo valor no escribe nada y una clave no se vuelca por temporizador más
+ * de una vez cada NVS_MANAGER_INTERVALO_MIN_CLAVE_MS (el blob de
+ * configuración, cada NVS_MANAGER_INTERVALO_MIN_CONFIG_MS). Esta llamada fuerza
+ * el volcado de todo (sin limitador) cuando el valor debe sobrevivir a un
+ * corte de alimentación inmediato.
+ *
+ * @return ESP_OK si todo se escribió, código de error en caso contrario
+ */
+esp_err_t nvs_manager_sync(void);
+
+/**
+ * @brief Copia los contadores de la caché
+ */
+void nvs_manager_obtener_estadisticas(nvs_manager_estadisticas_t *estadisticas);
+
 /**
  * @brief Verifica si el componente ha sido inicializado correctamente
  * 
@@ -1,7 +1,14 @@
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h> // Añadido para los especificadores de formato PRId32
 
@@ -9,39 +16,520 @@ static const char *TAG = "NVS_MANAGER";
 static char storage_namespace[16] = "ecokey"; // Valor por defecto
 static bool is_initialized = false;
 
-// Claves NVS para WiFi
-#define WIFI_NVS_SSID_KEY "ssid"
-#define WIFI_NVS_PASS_KEY "password"
+/*
+ * Caché de escritura diferida.
+ *
+ * Al iniciar se carga todo el namespace en RAM y se deja abierto un único
+ * handle. Las lecturas se sirven desde la caché; las escrituras solo marcan
+ * la clave como sucia y programan un volcado que escribe todas las claves
+ * sucias con un solo nvs_commit (por temporizador, al apagar/reiniciar o
+ * con nvs_manager_sync()). Un borrado deja una entrada "borrada" hasta el
+ * volcado. Si la caché se llena, las claves que no caben se escriben y
+ * leen directamente de flash como antes.
+ */
+typedef enum {
+    ENTRADA_LIBRE = 0,
+    ENTRADA_I32,
+    ENTRADA_STR,
+    ENTRADA_BLOB,
+    ENTRADA_BORRADA,
+} tipo_entrada_t;
+
+typedef struct {
+    char clave[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t tipo;               // tipo_entrada_t
+    bool sucia;                 // Pendiente de escribir en flash
+    int64_t ultima_escritura_us;    // Último volcado de esta clave a flash (0 = nunca)
+    size_t longitud;            // Bytes en datos (las cadenas incluyen el '\0')
+    union {
+        int32_t i32;
+        uint8_t *datos;
+    } valor;
+} entrada_cache_t;
+
+static entrada_cache_t s_cache[NVS_MANAGER_MAX_CLAVES];
+static bool s_cache_completa = false;   // Todo el namespace cupo en la caché
+static nvs_handle_t s_handle;
+static SemaphoreHandle_t s_mutex = NULL;
+static esp_timer_handle_t s_timer_volcado = NULL;
+static TaskHandle_t s_tarea_volcado = NULL;    // Escribe en flash cuando vence el temporizador
+static int64_t s_volcado_limite_us = 0;    // Vencimiento del volcado programado
+static nvs_manager_estadisticas_t s_estadisticas;
+
+static entrada_cache_t *buscar_entrada(const char *key)
+{
+    for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        if (s_cache[i].tipo != ENTRADA_LIBRE && strcmp(s_cache[i].clave, key) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void liberar_valor(entrada_cache_t *e)
+{
+    if (e->tipo == ENTRADA_STR || e->tipo == ENTRADA_BLOB) {
+        free(e->valor.datos);
+    }
+    e->valor.datos = NULL;
+    e->longitud = 0;
+}
+
+/**
+ * Entrada para una clave: la existente, una libre o una borrada ya volcada
+ */
+static entrada_cache_t *reservar_entrada(const char *key)
+{
+    entrada_cache_t *e = buscar_entrada(key);
+    if (e != NULL) {
+        return e;
+    }
+
+    entrada_cache_t *reutilizable = NULL;
+    for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        if (s_cache[i].tipo == ENTRADA_LIBRE) {
+            e = &s_cache[i];
+            break;
+        }
+        if (s_cache[i].tipo == ENTRADA_BORRADA && !s_cache[i].sucia && reutilizable == NULL) {
+            reutilizable = &s_cache[i];
+        }
+    }
+    if (e == NULL) {
+        e = reutilizable;
+    }
+    if (e != NULL) {
+        memset(e, 0, sizeof(*e));
+        strlcpy(e->clave, key, sizeof(e->clave));
+    }
+    return e;
+}
+
+/**
+ * Sustituye el valor de la entrada por una copia de datos
+ */
+static esp_err_t guardar_en_entrada(entrada_cache_t *e, tipo_entrada_t tipo, const void *datos, size_t longitud)
+{
+    if (tipo == ENTRADA_I32) {
+        liberar_valor(e);
+        memcpy(&e->valor.i32, datos, sizeof(int32_t));
+        e->longitud = sizeof(int32_t);
+    } else {
+        uint8_t *copia = malloc(longitud);
+        if (copia == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(copia, datos, longitud);
+        liberar_valor(e);
+        e->valor.datos = copia;
+        e->longitud = longitud;
+    }
+    e->tipo = tipo;
+    return ESP_OK;
+}
+
+static esp_err_t escribir_en_flash(tipo_entrada_t tipo, const char *key, const void *datos, size_t longitud)
+{
+    switch (tipo) {
+    case ENTRADA_I32: {
+        int32_t v;
+        memcpy(&v, datos, sizeof(v));
+        return nvs_set_i32(s_handle, key, v);
+    }
+    case ENTRADA_STR:
+        return nvs_set_str(s_handle, key, (const char *)datos);
+    case ENTRADA_BLOB:
+        return nvs_set_blob(s_handle, key, datos, longitud);
+    case ENTRADA_BORRADA: {
+        esp_err_t ret = nvs_erase_key(s_handle, key);
+        return ret == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : ret;
+    }
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t commit_flash(void)
+{
+    int64_t inicio = esp_timer_get_time();
+    esp_err_t ret = nvs_commit(s_handle);
+    s_estadisticas.commits++;
+    s_estadisticas.us_ultimo_commit = (uint32_t)(esp_timer_get_time() - inicio);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void programar_volcado_en(uint64_t retardo_us);
+static void programar_volcado(void);
+
+/**
+ * Intervalo mínimo entre volcados de una clave. El blob de configuración
+ * reúne el relé y el modo: con el límite general un cambio podría pasar un
+ * minuto sin llegar a flash.
+ */
+static int64_t intervalo_min_us(const entrada_cache_t *e)
+{
+    if (strcmp(e->clave, ECOKEY_CONFIG_CLAVE_NVS) == 0) {
+        return (int64_t)NVS_MANAGER_INTERVALO_MIN_CONFIG_MS * 1000;
+    }
+    return (int64_t)NVS_MANAGER_INTERVALO_MIN_CLAVE_MS * 1000;
+}
+
+/**
+ * Escribe las claves sucias y hace un único commit. Con el mutex tomado.
+ *
+ * Sin forzar (volcado por temporizador) se aplica el limitador por clave: una
+ * clave escrita en flash hace menos de su intervalo mínimo (intervalo_min_us)
+ * sigue sucia y el volcado se reprograma para cuando pueda escribirse, de
+ * modo que los cambios intermedios de una clave que oscila no llegan a flash.
+ * Si una escritura o el commit fallan, las claves siguen sucias y el volcado
+ * se vuelve a programar.
+ */
+static esp_err_t volcar_sucias(bool forzar)
+{
+    esp_err_t resultado = ESP_OK;
+    uint32_t escritas = 0;
+    int64_t ahora = esp_timer_get_time();
+    int64_t proximo_us = -1;    // Espera hasta la primera clave aplazada
+    int64_t anterior_us[NVS_MANAGER_MAX_CLAVES];    // Para deshacer si el commit falla
+    bool escrita[NVS_MANAGER_MAX_CLAVES] = {0};
+
+    for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        entrada_cache_t *e = &s_cache[i];
+        if (!e->sucia) {
+            continue;
+        }
+        if (!forzar && e->ultima_escritura_us != 0) {
+            int64_t libre_en = e->ultima_escritura_us + intervalo_min_us(e) - ahora;
+            if (libre_en > 0) {
+                s_estadisticas.escrituras_aplazadas++;
+                if (proximo_us < 0 || libre_en < proximo_us) {
+                    proximo_us = libre_en;
+                }
+                continue;
+            }
+        }
+        const void *datos = (e->tipo == ENTRADA_I32) ? (const void *)&e->valor.i32 : e->valor.datos;
+        esp_err_t ret = escribir_en_flash(e->tipo, e->clave, datos, e->longitud);
+        if (ret != ESP_OK) {
+            // Se queda sucia para el siguiente volcado
+            ESP_LOGE(TAG, "Error al escribir '%s': %s", e->clave, esp_err_to_name(ret));
+            resultado = ret;
+            continue;
+        }
+        anterior_us[i] = e->ultima_escritura_us;
+        escrita[i] = true;
+        e->sucia = false;
+        e->ultima_escritura_us = ahora;
+        escritas++;
+    }
+
+    if (escritas > 0) {
+        s_estadisticas.escrituras_flash += escritas;
+        esp_err_t ret = commit_flash();
+        ESP_LOGD(TAG, "Volcadas %" PRIu32 " claves en un commit (%" PRIu32 " us)",
+                 escritas, s_estadisticas.us_ultimo_commit);
+        if (ret != ESP_OK) {
+            // Sin commit no hay nada garantizado en flash: vuelven a estar sucias
+            for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+                if (escrita[i]) {
+                    s_cache[i].sucia = true;
+                    s_cache[i].ultima_escritura_us = anterior_us[i];
+                }
+            }
+            resultado = ret;
+        }
+    }
+
+    // Lo que falló se reintenta como una escritura nueva; lo aplazado, cuando se pueda
+    if (resultado != ESP_OK) {
+        programar_volcado();
+    }
+    if (proximo_us >= 0) {
+        programar_volcado_en((uint64_t)proximo_us);
+    }
+    return resultado;
+}
+
+/**
+ * Programa el volcado; si ya hay uno pendiente solo lo adelanta
+ */
+static void programar_volcado_en(uint64_t retardo_us)
+{
+    if (s_timer_volcado == NULL) {
+        return;
+    }
+    int64_t limite = esp_timer_get_time() + (int64_t)retardo_us;
+    if (esp_timer_is_active(s_timer_volcado)) {
+        if (limite >= s_volcado_limite_us) {
+            return;
+        }
+        esp_timer_stop(s_timer_volcado);
+    }
+    s_volcado_limite_us = limite;
+    esp_timer_start_once(s_timer_volcado, retardo_us);
+}
+
+static void programar_volcado(void)
+{
+    programar_volcado_en((uint64_t)NVS_MANAGER_RETARDO_COMMIT_MS * 1000);
+}
+
+/**
+ * Vuelca las claves sucias cuando el temporizador avisa. Las escrituras en
+ * flash no se hacen en el propio callback para no bloquear la tarea de
+ * esp_timer, que comparten el resto de temporizadores.
+ */
+static void tarea_volcado(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        volcar_sucias(false);
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+static void timer_volcado_cb(void *arg)
+{
+    xTaskNotifyGive(s_tarea_volcado);
+}
+
+/**
+ * true si la entrada ya contiene exactamente ese valor (volcado o pendiente)
+ */
+static bool mismo_valor(const entrada_cache_t *e, tipo_entrada_t tipo, const void *datos, size_t longitud)
+{
+    if (e->tipo != tipo || e->longitud != longitud) {
+        return false;
+    }
+    const void *actual = (tipo == ENTRADA_I32) ? (const void *)&e->valor.i32 : e->valor.datos;
+    return memcmp(actual, datos, longitud) == 0;
+}
+
+static void volcar_al_apagar(void)
+{
+    // Desde esp_restart(): no esperar indefinidamente a otra tarea
+    if (s_mutex != NULL && xSemaphoreTake(s_mutex, pdMS_TO_TICKS(500)) == pdTRUE) {
+        volcar_sucias(true);
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+/**
+ * Guarda un valor en la caché (o directamente en flash si no cabe)
+ */
+static esp_err_t escribir_valor(tipo_entrada_t tipo, const char *key, const void *datos, size_t longitud)
+{
+    esp_err_t ret;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_estadisticas.escrituras++;
+    entrada_cache_t *e = buscar_entrada(key);
+    if (e != NULL && mismo_valor(e, tipo, datos, longitud)) {
+        // Nada que escribir: típico de la configuración retenida que el broker reenvía
+        s_estadisticas.escrituras_evitadas++;
+        xSemaphoreGive(s_mutex);
+        return ESP_OK;
+    }
+    if (e == NULL) {
+        e = reservar_entrada(key);
+    }
+    if (e != NULL) {
+        ret = guardar_en_entrada(e, tipo, datos, longitud);
+        if (ret == ESP_OK) {
+            e->sucia = true;
+            programar_volcado();
+        }
+    } else {
+        ESP_LOGW(TAG, "Caché llena, '%s' se escribe directamente", key);
+        s_cache_completa = false;
+        ret = escribir_en_flash(tipo, key, datos, longitud);
+        if (ret == ESP_OK) {
+            s_estadisticas.escrituras_flash++;
+            ret = commit_flash();
+        }
+    }
+    xSemaphoreGive(s_mutex);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error al guardar '%s': %s", key, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+/**
+ * Lee un str/blob en buf. *longitud entra con el tamaño de buf y sale con
+ * los bytes copiados. Con el mutex tomado.
+ */
+static esp_err_t leer_datos(tipo_entrada_t tipo, const char *key, void *buf, size_t *longitud)
+{
+    entrada_cache_t *e = buscar_entrada(key);
+
+    if (e == NULL && !s_cache_completa) {
+        // Clave fuera de la caché: se lee de flash
+        s_estadisticas.lecturas_flash++;
+        return (tipo == ENTRADA_STR) ? nvs_get_str(s_handle, key, buf, longitud)
+                                     : nvs_get_blob(s_handle, key, buf, longitud);
+    }
+
+    s_estadisticas.lecturas_ram++;
+    if (e == NULL || e->tipo == ENTRADA_BORRADA) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (e->tipo != tipo) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    if (e->longitud > *longitud) {
+        *longitud = e->longitud;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(buf, e->valor.datos, e->longitud);
+    *longitud = e->longitud;
+    return ESP_OK;
+}
+
+/**
+ * Carga en la caché todas las claves i32/str/blob del namespace
+ */
+static void cargar_namespace(void)
+{
+    nvs_iterator_t it = NULL;
+    size_t cargadas = 0;
+    bool completa = true;
+
+    esp_err_t ret = nvs_entry_find(NVS_DEFAULT_PART_NAME, storage_namespace, NVS_TYPE_ANY, &it);
+    while (ret == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        if (info.type == NVS_TYPE_I32 || info.type == NVS_TYPE_STR || info.type == NVS_TYPE_BLOB) {
+            entrada_cache_t *e = reservar_entrada(info.key);
+            esp_err_t err = ESP_ERR_NO_MEM;
+            if (e != NULL && info.type == NVS_TYPE_I32) {
+                e->tipo = ENTRADA_I32;
+                e->longitud = sizeof(int32_t);
+                err = nvs_get_i32(s_handle, info.key, &e->valor.i32);
+            } else if (e != NULL) {
+                size_t longitud = 0;
+                bool es_str = (info.type == NVS_TYPE_STR);
+                err = es_str ? nvs_get_str(s_handle, info.key, NULL, &longitud)
+                             : nvs_get_blob(s_handle, info.key, NULL, &longitud);
+                uint8_t *datos = (err == ESP_OK) ? malloc(longitud > 0 ? longitud : 1) : NULL;
+                if (err == ESP_OK && datos == NULL) {
+                    err = ESP_ERR_NO_MEM;
+                }
+                if (err == ESP_OK) {
+                    err = es_str ? nvs_get_str(s_handle, info.key, (char *)datos, &longitud)
+                                 : nvs_get_blob(s_handle, info.key, datos, &longitud);
+                }
+                if (err == ESP_OK) {
+                    e->tipo = es_str ? ENTRADA_STR : ENTRADA_BLOB;
+                    e->valor.datos = datos;
+                    e->longitud = longitud;
+                } else {
+                    free(datos);
+                }
+            }
+
+            if (err == ESP_OK) {
+                cargadas++;
+            } else {
+                // Sin sitio o ilegible: esa clave se seguirá leyendo de flash
+                if (e != NULL) {
+                    memset(e, 0, sizeof(*e));
+                }
+                completa = false;
+            }
+        }
+        ret = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+
+    s_cache_completa = completa;
+    ESP_LOGI(TAG, "Caché NVS: %u claves cargadas%s", (unsigned)cargadas,
+             completa ? "" : " (namespace incompleto, resto desde flash)");
+}
 
 esp_err_t nvs_manager_init(const char* namespace)
 {
+    if (is_initialized) {
+        return ESP_OK;
+    }
+
     // Si se proporciona un namespace válido, lo usamos
     if (namespace && strlen(namespace) > 0) {
         strncpy(storage_namespace, namespace, sizeof(storage_namespace) - 1);
         storage_namespace[sizeof(storage_namespace) - 1] = '\0'; // Asegurar terminación null
     }
-    
+
     ESP_LOGI(TAG, "Inicializando NVS con namespace: %s", storage_namespace);
-    
+
     // Inicializar el almacenamiento no volátil (NVS)
     esp_err_t ret = nvs_flash_init();
-    
+
     // Si hay problemas con NVS, lo borramos y reinicializamos
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGI(TAG, "NVS requiere borrado, reinicializando...");
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
-    
+
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al inicializar NVS: %s", esp_err_to_name(ret));
         is_initialized = false;
-    } else {
-        ESP_LOGI(TAG, "NVS inicializado correctamente");
-        is_initialized = true;
+        return ret;
     }
-    
-    return ret;
+
+    // Handle persistente para toda la vida del programa
+    ret = nvs_open(storage_namespace, NVS_READWRITE, &s_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            nvs_close(s_handle);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (s_tarea_volcado == NULL &&
+        xTaskCreate(tarea_volcado, "nvs_volcado", 3072, NULL, 3, &s_tarea_volcado) != pdPASS) {
+        // Sin tarea no se crea el temporizador: se vuelca al reiniciar o con sync
+        ESP_LOGE(TAG, "Error creando la tarea de volcado");
+        s_tarea_volcado = NULL;
+    }
+
+    if (s_timer_volcado == NULL && s_tarea_volcado != NULL) {
+        esp_timer_create_args_t args_timer = {
+            .callback = timer_volcado_cb,
+            .name = "nvs_volcado"
+        };
+        ret = esp_timer_create(&args_timer, &s_timer_volcado);
+        if (ret != ESP_OK) {
+            // Sin temporizador las escrituras siguen volcándose al reiniciar o con sync
+            ESP_LOGE(TAG, "Error creando temporizador de volcado: %s", esp_err_to_name(ret));
+            s_timer_volcado = NULL;
+        }
+    }
+
+    cargar_namespace();
+    esp_register_shutdown_handler(volcar_al_apagar);
+
+    ESP_LOGI(TAG, "NVS inicializado correctamente");
+    is_initialized = true;
+
+    // Configuración tipada: una lectura desde la caché ya cargada
+    ret = ecokey_config_cargar();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error al cargar la configuración: %s", esp_err_to_name(ret));
+    }
+    return ESP_OK;
 }
 
 bool nvs_manager_is_initialized(void)
@@ -49,43 +537,53 @@ bool nvs_manager_is_initialized(void)
     return is_initialized;
 }
 
+esp_err_t nvs_manager_sync(void)
+{
+    if (!is_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_timer_volcado != NULL) {
+        esp_timer_stop(s_timer_volcado);
+    }
+    esp_err_t ret = volcar_sucias(true);
+    xSemaphoreGive(s_mutex);
+    return ret;
+}
+
+void nvs_manager_obtener_estadisticas(nvs_manager_estadisticas_t *estadisticas)
+{
+    if (s_mutex == NULL) {
+        memset(estadisticas, 0, sizeof(*estadisticas));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *estadisticas = s_estadisticas;
+    estadisticas->claves_sucias = 0;
+    for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        if (s_cache[i].sucia) {
+            estadisticas->claves_sucias++;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+}
+
 esp_err_t nvs_manager_set_int(const char* key, int32_t value)
 {
     if (!is_initialized) {
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL) {
         ESP_LOGE(TAG, "Clave no válida (NULL)");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = nvs_set_i32(handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al guardar valor '%s': %s", key, esp_err_to_name(ret));
-    } else {
-        // Confirmar los cambios de manera explícita
-        ESP_LOGI(TAG, "Haciendo commit de los cambios para la clave '%s' con valor %" PRId32, key, value);
-        ret = nvs_commit(handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
-        } else {
-            ESP_LOGI(TAG, "Commit exitoso para la clave '%s'", key);
-        }
-    }
-    
-    nvs_close(handle);
-    return ret;
+
+    ESP_LOGD(TAG, "Guardando '%s' = %" PRId32, key, value);
+    return escribir_valor(ENTRADA_I32, key, &value, sizeof(value));
 }
 
 int32_t nvs_manager_get_int(const char* key, int32_t default_value)
@@ -94,31 +592,40 @@ int32_t nvs_manager_get_int(const char* key, int32_t default_value)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return default_value;
     }
-    
+
     if (key == NULL) {
         ESP_LOGE(TAG, "Clave no válida (NULL)");
         return default_value;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
+
+    esp_err_t ret = ESP_OK;
     int32_t value = default_value;
-    
-    ret = nvs_open(storage_namespace, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return default_value;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    entrada_cache_t *e = buscar_entrada(key);
+    if (e == NULL && !s_cache_completa) {
+        s_estadisticas.lecturas_flash++;
+        ret = nvs_get_i32(s_handle, key, &value);
+    } else {
+        s_estadisticas.lecturas_ram++;
+        if (e == NULL || e->tipo == ENTRADA_BORRADA) {
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        } else if (e->tipo != ENTRADA_I32) {
+            ret = ESP_ERR_NVS_TYPE_MISMATCH;
+        } else {
+            value = e->valor.i32;
+        }
     }
-    
-    ret = nvs_get_i32(handle, key, &value);
+    xSemaphoreGive(s_mutex);
+
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGW(TAG, "Clave '%s' no encontrada, usando valor por defecto", key);
         value = default_value;
     } else if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al leer valor '%s': %s", key, esp_err_to_name(ret));
+        value = default_value;
     }
-    
-    nvs_close(handle);
+
     return value;
 }
 
@@ -128,34 +635,13 @@ esp_err_t nvs_manager_set_string(const char* key, const char* value)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL || value == NULL) {
         ESP_LOGE(TAG, "Parámetros no válidos (NULL)");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = nvs_set_str(handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al guardar string '%s': %s", key, esp_err_to_name(ret));
-    } else {
-        // Confirmar los cambios
-        ret = nvs_commit(handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
-        }
-    }
-    
-    nvs_close(handle);
-    return ret;
+
+    return escribir_valor(ENTRADA_STR, key, value, strlen(value) + 1);
 }
 
 esp_err_t nvs_manager_get_string(const char* key, char* value, size_t max_length)
@@ -164,46 +650,27 @@ esp_err_t nvs_manager_get_string(const char* key, char* value, size_t max_length
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL || value == NULL || max_length == 0) {
         ESP_LOGE(TAG, "Parámetros no válidos");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    size_t required_size = 0;
-    ret = nvs_get_str(handle, key, NULL, &required_size);
+
+    size_t longitud = max_length;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t ret = leer_datos(ENTRADA_STR, key, value, &longitud);
+    xSemaphoreGive(s_mutex);
+
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGW(TAG, "Clave '%s' no encontrada", key);
-        nvs_close(handle);
-        return ESP_ERR_NVS_NOT_FOUND;
+    } else if (ret == ESP_ERR_INVALID_SIZE || ret == ESP_ERR_NVS_INVALID_LENGTH) {
+        ESP_LOGE(TAG, "Buffer demasiado pequeño para '%s'. Se requiere %d bytes, disponible %d",
+                 key, longitud, max_length);
+        ret = ESP_ERR_INVALID_SIZE;
     } else if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al obtener tamaño para '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(handle);
-        return ret;
-    }
-    
-    if (required_size > max_length) {
-        ESP_LOGE(TAG, "Buffer demasiado pequeño para '%s'. Se requiere %d bytes, disponible %d", 
-                 key, required_size, max_length);
-        nvs_close(handle);
-        return ESP_ERR_INVALID_SIZE;
-    }
-    
-    ret = nvs_get_str(handle, key, value, &max_length);
-    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al leer string '%s': %s", key, esp_err_to_name(ret));
     }
-    
-    nvs_close(handle);
+
     return ret;
 }
 
@@ -213,12 +680,12 @@ esp_err_t nvs_manager_set_float(const char* key, float value)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL) {
         ESP_LOGE(TAG, "Clave no válida (NULL)");
         return ESP_ERR_INVALID_ARG;
     }
-    
+
     // NVS no tiene funciones específicas para float, así que lo convertimos a un blob
     return nvs_manager_set_blob(key, &value, sizeof(float));
 }
@@ -229,21 +696,21 @@ float nvs_manager_get_float(const char* key, float default_value)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return default_value;
     }
-    
+
     if (key == NULL) {
         ESP_LOGE(TAG, "Clave no válida (NULL)");
         return default_value;
     }
-    
+
     float value = default_value;
     size_t size = sizeof(float);
-    
+
     esp_err_t ret = nvs_manager_get_blob(key, &value, &size);
-    
+
     if (ret != ESP_OK || size != sizeof(float)) {
         return default_value;
     }
-    
+
     return value;
 }
 
@@ -253,34 +720,13 @@ esp_err_t nvs_manager_set_blob(const char* key, const void* data, size_t length)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL || data == NULL || length == 0) {
         ESP_LOGE(TAG, "Parámetros no válidos");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = nvs_set_blob(handle, key, data, length);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al guardar blob '%s': %s", key, esp_err_to_name(ret));
-    } else {
-        // Confirmar los cambios
-        ret = nvs_commit(handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
-        }
-    }
-    
-    nvs_close(handle);
-    return ret;
+
+    return escribir_valor(ENTRADA_BLOB, key, data, length);
 }
 
 esp_err_t nvs_manager_get_blob(const char* key, void* data, size_t* length)
@@ -289,47 +735,27 @@ esp_err_t nvs_manager_get_blob(const char* key, void* data, size_t* length)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL || data == NULL || length == NULL || *length == 0) {
         ESP_LOGE(TAG, "Parámetros no válidos");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    size_t required_size = 0;
-    ret = nvs_get_blob(handle, key, NULL, &required_size);
+
+    size_t disponible = *length;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t ret = leer_datos(ENTRADA_BLOB, key, data, length);
+    xSemaphoreGive(s_mutex);
+
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ESP_LOGW(TAG, "Clave '%s' no encontrada", key);
-        nvs_close(handle);
-        return ESP_ERR_NVS_NOT_FOUND;
+    } else if (ret == ESP_ERR_INVALID_SIZE || ret == ESP_ERR_NVS_INVALID_LENGTH) {
+        ESP_LOGE(TAG, "Buffer demasiado pequeño para '%s'. Se requiere %d bytes, disponible %d",
+                 key, *length, disponible);
+        ret = ESP_ERR_INVALID_SIZE;
     } else if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al obtener tamaño para '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(handle);
-        return ret;
-    }
-    
-    if (required_size > *length) {
-        ESP_LOGE(TAG, "Buffer demasiado pequeño para '%s'. Se requiere %d bytes, disponible %d", 
-                 key, required_size, *length);
-        nvs_close(handle);
-        return ESP_ERR_INVALID_SIZE;
-    }
-    
-    *length = required_size;
-    ret = nvs_get_blob(handle, key, data, length);
-    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al leer blob '%s': %s", key, esp_err_to_name(ret));
     }
-    
-    nvs_close(handle);
+
     return ret;
 }
 
@@ -339,59 +765,22 @@ bool nvs_manager_key_exists(const char* key)
         ESP_LOGW(TAG, "NVS no inicializado o clave nula, key_exists retorna false");
         return false;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS para verificar clave: %s", esp_err_to_name(ret));
-        return false;
-    }
-    
-    // Verificar diferentes tipos de datos
-    bool existe = false;
-    
-    // Probar como entero
-    int32_t int_value;
-    ret = nvs_get_i32(handle, key, &int_value);
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "La clave '%s' existe en NVS como entero", key);
-        existe = true;
-    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGD(TAG, "Error al verificar clave '%s' como entero: %s", key, esp_err_to_name(ret));
-    }
-    
-    // Si no existe como entero, probar como string
-    if (!existe) {
-        size_t required_size = 0;
-        ret = nvs_get_str(handle, key, NULL, &required_size);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "La clave '%s' existe en NVS como string", key);
-            existe = true;
-        } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGD(TAG, "Error al verificar clave '%s' como string: %s", key, esp_err_to_name(ret));
-        }
-    }
-    
-    // Si no existe como string, probar como blob
-    if (!existe) {
-        size_t required_size = 0;
-        ret = nvs_get_blob(handle, key, NULL, &required_size);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "La clave '%s' existe en NVS como blob", key);
-            existe = true;
-        } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGD(TAG, "Error al verificar clave '%s' como blob: %s", key, esp_err_to_name(ret));
-        }
-    }
-    
-    nvs_close(handle);
-    
-    if (!existe) {
-        ESP_LOGI(TAG, "La clave '%s' NO existe en NVS", key);
+
+    bool existe;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    entrada_cache_t *e = buscar_entrada(key);
+    if (e == NULL && !s_cache_completa) {
+        nvs_type_t tipo;
+        s_estadisticas.lecturas_flash++;
+        existe = (nvs_find_key(s_handle, key, &tipo) == ESP_OK);
+    } else {
+        s_estadisticas.lecturas_ram++;
+        existe = (e != NULL && e->tipo != ENTRADA_BORRADA);
     }
-    
+    xSemaphoreGive(s_mutex);
+
+    ESP_LOGD(TAG, "La clave '%s' %s en NVS", key, existe ? "existe" : "NO existe");
     return existe;
 }
 
@@ -401,73 +790,86 @@ esp_err_t nvs_manager_erase_key(const char* key)
         ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (key == NULL) {
         ESP_LOGE(TAG, "Clave no válida (NULL)");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = nvs_erase_key(handle, key);
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_estadisticas.escrituras++;
+    entrada_cache_t *e = buscar_entrada(key);
+    if (e != NULL) {
+        if (e->tipo != ENTRADA_BORRADA) {
+            liberar_valor(e);
+            e->tipo = ENTRADA_BORRADA;
+            e->sucia = true;
+            programar_volcado();
+        } else {
+            s_estadisticas.escrituras_evitadas++;
+        }
+    } else if (!s_cache_completa) {
+        ret = escribir_en_flash(ENTRADA_BORRADA, key, NULL, 0);
+        if (ret == ESP_OK) {
+            s_estadisticas.escrituras_flash++;
+            ret = commit_flash();
+        }
+    } else {
+        // No es un error si la clave no existe
         ESP_LOGW(TAG, "Clave '%s' no encontrada para borrar", key);
-        nvs_close(handle);
-        return ESP_OK; // No es un error si la clave no existe
-    } else if (ret != ESP_OK) {
+        s_estadisticas.escrituras_evitadas++;
+    }
+    xSemaphoreGive(s_mutex);
+
+    if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al borrar clave '%s': %s", key, esp_err_to_name(ret));
-    } else {
-        // Confirmar los cambios
-        ret = nvs_commit(handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
-        }
     }
-    
-    nvs_close(handle);
     return ret;
 }
 
-esp_err_t nvs_manager_erase_all(void)
+/**
+ * Borrado del namespace; se llama desde ecokey_config_restablecer() con el
+ * mutex de la configuración ya tomado
+ */
+static esp_err_t borrar_todo(void)
 {
-    if (!is_initialized) {
-        ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
-        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_timer_volcado != NULL) {
+        esp_timer_stop(s_timer_volcado);
     }
-    
-    nvs_handle_t handle;
-    esp_err_t ret;
-    
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS: %s", esp_err_to_name(ret));
-        return ret;
+    // Lo pendiente se descarta: el borrado se aplica de inmediato
+    for (size_t i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        liberar_valor(&s_cache[i]);
+        memset(&s_cache[i], 0, sizeof(s_cache[i]));
     }
-    
-    ret = nvs_erase_all(handle);
+    s_cache_completa = true;
+    s_estadisticas.escrituras++;
+
+    esp_err_t ret = nvs_erase_all(s_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al borrar todas las claves: %s", esp_err_to_name(ret));
     } else {
-        // Confirmar los cambios
-        ret = nvs_commit(handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error en nvs_commit: %s", esp_err_to_name(ret));
-        } else {
+        ret = commit_flash();
+        if (ret == ESP_OK) {
             ESP_LOGI(TAG, "Todas las claves borradas correctamente");
         }
     }
-    
-    nvs_close(handle);
+    xSemaphoreGive(s_mutex);
+
     return ret;
 }
 
+esp_err_t nvs_manager_erase_all(void)
+{
+    if (!is_initialized) {
+        ESP_LOGE(TAG, "NVS no inicializado. Llame a nvs_manager_init primero");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ecokey_config_restablecer(borrar_todo);
+}
+
 esp_err_t nvs_manager_save_mac(const char *mac)
 {
     if (!mac || strlen(mac) < 17) {  // MAC formato AA:BB:CC:DD:EE:FF tiene 17 caracteres
@@ -475,26 +877,10 @@ esp_err_t nvs_manager_save_mac(const char *mac)
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(storage_namespace, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error abriendo NVS: %s", esp_err_to_name(err));
-        return err;
+    esp_err_t err = nvs_manager_set_string("ble_mac", mac);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "MAC guardada correctamente: %s", mac);
     }
-
-    err = nvs_set_str(nvs_handle, "ble_mac", mac);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error guardando MAC: %s", esp_err_to_name(err));
-    } else {
-        err = nvs_commit(nvs_handle);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error en commit: %s", esp_err_to_name(err));
-        } else {
-            ESP_LOGI(TAG, "MAC guardada correctamente: %s", mac);
-        }
-    }
-
-    nvs_close(nvs_handle);
     return err;
 }
 
@@ -504,13 +890,13 @@ bool nvs_manager_has_wifi_credentials(void)
         ESP_LOGW(TAG, "NVS no inicializado");
         return false;
     }
-    
-    // Verificar si existe el SSID en NVS (requisito mínimo)
-    if (!nvs_manager_key_exists(WIFI_NVS_SSID_KEY)) {
+
+    // El SSID es el requisito mínimo
+    if (ecokey_config()->ssid[0] == '\0') {
         ESP_LOGD(TAG, "No hay SSID almacenado en NVS");
         return false;
     }
-    
+
     ESP_LOGI(TAG, "Credenciales WiFi encontradas en NVS");
     return true;
 }
@@ -522,81 +908,28 @@ esp_err_t nvs_manager_get_wifi_credentials(char *ssid, size_t ssid_len,
         ESP_LOGE(TAG, "NVS no inicializado");
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     if (!ssid || ssid_len < 33 || !password || password_len < 65) {
         ESP_LOGE(TAG, "Parámetros inválidos para obtener credenciales WiFi");
         return ESP_ERR_INVALID_ARG;
     }
-    
-    // Verificar si existe el SSID
-    if (!nvs_manager_key_exists(WIFI_NVS_SSID_KEY)) {
+
+    const ecokey_config_t *cfg = ecokey_config();
+    if (cfg->ssid[0] == '\0') {
         ESP_LOGW(TAG, "No hay SSID almacenado en NVS");
         return ESP_ERR_NOT_FOUND;
     }
-    
-    // Inicializar buffers
-    memset(ssid, 0, ssid_len);
-    memset(password, 0, password_len);
-    
-    // Obtener SSID
-    esp_err_t ret = nvs_manager_get_string(WIFI_NVS_SSID_KEY, ssid, ssid_len);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al leer SSID de NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    // Obtener password si existe (opcional)
-    if (nvs_manager_key_exists(WIFI_NVS_PASS_KEY)) {
-        ret = nvs_manager_get_string(WIFI_NVS_PASS_KEY, password, password_len);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error al leer contraseña de NVS: %s", esp_err_to_name(ret));
-            // No es error crítico, podría ser una red abierta
-        }
-    }
-    
+
+    strlcpy(ssid, cfg->ssid, ssid_len);
+    strlcpy(password, cfg->password, password_len);
+
     ESP_LOGI(TAG, "Credenciales WiFi obtenidas correctamente. SSID: %s", ssid);
     return ESP_OK;
 }
 
 esp_err_t nvs_manager_save_wifi_credentials(const char *ssid, const char *password)
 {
-    if (!is_initialized) {
-        ESP_LOGE(TAG, "NVS no inicializado");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    if (!ssid || strlen(ssid) == 0) {
-        ESP_LOGE(TAG, "SSID no válido");
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    // Guardar SSID
-    esp_err_t ret = nvs_manager_set_string(WIFI_NVS_SSID_KEY, ssid);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al guardar SSID en NVS: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    // Guardar password si existe
-    if (password && strlen(password) > 0) {
-        ret = nvs_manager_set_string(WIFI_NVS_PASS_KEY, password);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error al guardar contraseña en NVS: %s", esp_err_to_name(ret));
-            return ret;
-        }
-    } else {
-        // Si no hay password, eliminar la clave si existía
-        if (nvs_manager_key_exists(WIFI_NVS_PASS_KEY)) {
-            ret = nvs_manager_erase_key(WIFI_NVS_PASS_KEY);
-            if (ret != ESP_OK) {
-                ESP_LOGW(TAG, "Error al borrar contraseña anterior: %s", esp_err_to_name(ret));
-                // No es un error crítico
-            }
-        }
-    }
-    
-    ESP_LOGI(TAG, "Credenciales WiFi guardadas. SSID: %s", ssid);
-    return ESP_OK;
+    return nvs_manager_set_wifi_credentials(ssid, password);
 }
 
 esp_err_t nvs_manager_delete_wifi_credentials(void)
@@ -605,35 +938,17 @@ esp_err_t nvs_manager_delete_wifi_credentials(void)
         ESP_LOGE(TAG, "NVS no inicializado");
         return ESP_ERR_INVALID_STATE;
     }
-    
-    esp_err_t ret = ESP_OK;
-    bool error = false;
-    
-    // Eliminar SSID si existe
-    if (nvs_manager_key_exists(WIFI_NVS_SSID_KEY)) {
-        ret = nvs_manager_erase_key(WIFI_NVS_SSID_KEY);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error al borrar SSID: %s", esp_err_to_name(ret));
-            error = true;
-        }
-    }
-    
-    // Eliminar password si existe
-    if (nvs_manager_key_exists(WIFI_NVS_PASS_KEY)) {
-        esp_err_t ret2 = nvs_manager_erase_key(WIFI_NVS_PASS_KEY);
-        if (ret2 != ESP_OK) {
-            ESP_LOGE(TAG, "Error al borrar contraseña: %s", esp_err_to_name(ret2));
-            error = true;
-            if (ret == ESP_OK) {
-                ret = ret2; // Preservar el primer error si hubo
-            }
-        }
+
+    esp_err_t ret = ecokey_config_borrar_wifi();
+    if (ret == ESP_OK) {
+        ret = nvs_manager_sync();
     }
-    
-    if (!error) {
+
+    if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Credenciales WiFi eliminadas correctamente");
+    } else {
+        ESP_LOGE(TAG, "Error al borrar credenciales WiFi: %s", esp_err_to_name(ret));
     }
-    
     return ret;
 }
 
@@ -656,55 +971,19 @@ esp_err_t nvs_manager_set_wifi_credentials(const char *ssid, const char *passwor
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t ret;
-    nvs_handle_t nvs_handle;
-
-    // Abrir el espacio NVS para escritura
-    ret = nvs_open(storage_namespace, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir NVS para escritura: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    // Guardar el SSID
-    ret = nvs_set_str(nvs_handle, WIFI_NVS_SSID_KEY, ssid);
+    esp_err_t ret = ecokey_config_set_wifi(ssid, password);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al guardar SSID: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
+        ESP_LOGE(TAG, "Error al guardar credenciales WiFi: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Guardar la contraseña (si se proporciona)
-    if (password != NULL) {
-        ret = nvs_set_str(nvs_handle, WIFI_NVS_PASS_KEY, password);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error al guardar contraseña: %s", esp_err_to_name(ret));
-            nvs_close(nvs_handle);
-            return ret;
-        }
-    } else {
-        // Si no se proporciona contraseña, guardar cadena vacía
-        ret = nvs_set_str(nvs_handle, WIFI_NVS_PASS_KEY, "");
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Error al guardar contraseña vacía: %s", esp_err_to_name(ret));
-            nvs_close(nvs_handle);
-            return ret;
-        }
-    }
-
-    // Confirmar los cambios en NVS
-    ret = nvs_commit(nvs_handle);
+    // Confirmar los cambios en NVS sin esperar al volcado diferido
+    ret = nvs_manager_sync();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Error al hacer commit en NVS: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
         return ret;
     }
 
-    // Cerrar el espacio NVS
-    nvs_close(nvs_handle);
-    
     ESP_LOGI(TAG, "Credenciales WiFi guardadas correctamente en NVS. SSID: %s", ssid);
     return ESP_OK;
 }
-
-
@@ -4,6 +4,7 @@
 #include "esp_log.h"
 #include "mqtt_service.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include <inttypes.h> // Incluir para usar PRIx32
 
 static const char *TAG = "ota_service";
@@ -48,34 +49,16 @@ esp_err_t ota_service_start_update(const char *url, bool forzar)
         .buffer_size_tx = 1024,
     };
 
-    // Verificar preventivamente la respuesta HTTP antes de iniciar la OTA
-    ESP_LOGI(TAG, "Verificando URL antes de iniciar OTA: %s", url);
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_err_t open_ret = esp_http_client_open(client, 0);
-    if (open_ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error al abrir conexión OTA: %s", esp_err_to_name(open_ret));
-    } else {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Respuesta HTTP: %d", status);
-        
-        // Si el status es un error (4xx o 5xx), no seguir con la actualización
-        if (status >= 400) {
-            ESP_LOGE(TAG, "Error en la respuesta HTTP: %d", status);
-            esp_http_client_cleanup(client);
-            mqtt_service_enviar_json("ota/status", 1, 0, "estado", "error", 
-                                   "mensaje", "Error HTTP", "codigo", "404", 
-                                   "tipo", "respuesta", NULL);
-            return ESP_FAIL;
-        }
-    }
-    esp_http_client_cleanup(client);
-
+    // Sin conexión previa de comprobación: esp_https_ota ya rechaza las
+    // respuestas 4xx/5xx y cada conexión extra era un handshake TLS completo
     esp_https_ota_config_t ota_config = {
         .http_config = &config,
     };
 
     ESP_LOGI(TAG, "Iniciando OTA desde: %s", url);
+    int64_t inicio = esp_timer_get_time();
     esp_err_t ret = esp_https_ota(&ota_config);
+    ESP_LOGI(TAG, "OTA terminada en %" PRId64 " ms", (esp_timer_get_time() - inicio) / 1000);
 
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "OTA finalizada correctamente. Reiniciando...");
@@ -60,6 +60,14 @@ esp_err_t relay_controller_set_state(bool state);
  */
 esp_err_t relay_controller_get_state(bool *state);
 
+/**
+ * @brief Obtiene el instante (esp_timer, µs) del último cambio de nivel del GPIO del relé
+ *
+ * Se registra justo tras gpio_set_level, antes de publicar el estado por MQTT,
+ * para poder medir la latencia real de conmutación.
+ */
+int64_t relay_controller_get_ultimo_cambio_us(void);
+
 /**
  * @brief Genera un pulso en el relé (activa y luego desactiva)
  * 
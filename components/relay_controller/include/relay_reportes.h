@@ -0,0 +1,77 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Política de publicación de los reportes del relé
+ */
+#ifdef CONFIG_RELAY_REPORTE_VENTANA_MS
+#define RELAY_REPORTE_VENTANA_MS        CONFIG_RELAY_REPORTE_VENTANA_MS
+#define RELAY_HISTORIAL_INTERVALO_S     CONFIG_RELAY_HISTORIAL_INTERVALO_S
+#define RELAY_HISTORIAL_MAX_EVENTOS     CONFIG_RELAY_HISTORIAL_MAX_EVENTOS
+#define RELAY_QOS_ESTADO                CONFIG_RELAY_QOS_ESTADO
+#define RELAY_QOS_HISTORIAL             CONFIG_RELAY_QOS_HISTORIAL
+#else
+#define RELAY_REPORTE_VENTANA_MS        500     // Cambios dentro de la ventana -> un solo estado
+#define RELAY_HISTORIAL_INTERVALO_S     300     // Envío periódico del lote de historial
+#define RELAY_HISTORIAL_MAX_EVENTOS     32      // Eventos por lote (se envía antes si se llena)
+#define RELAY_QOS_ESTADO                1
+#define RELAY_QOS_HISTORIAL             1
+#endif
+
+/**
+ * @brief Contadores de publicaciones de reportes del relé
+ *
+ * idas_y_vueltas cuenta los intercambios con el broker que exige cada
+ * publicación según su QoS (0, 1 o 2), para comparar el coste por evento.
+ */
+typedef struct {
+    uint32_t eventos;               /**< Cambios del relé notificados */
+    uint32_t estados_publicados;    /**< Mensajes a dispositivos/<mac>/estado */
+    uint32_t estados_agrupados;     /**< Cambios absorbidos por la ventana */
+    uint32_t historiales_publicados;/**< Lotes enviados a dispositivos/<mac>/historial */
+    uint32_t bytes_publicados;      /**< Tópico + payload de todo lo anterior */
+    uint32_t idas_y_vueltas;
+} relay_reportes_estadisticas_t;
+
+/**
+ * @brief Crea la tarea que agrupa y publica los reportes. Es idempotente.
+ */
+esp_err_t relay_reportes_iniciar(void);
+
+/**
+ * @brief Registra un cambio del relé sin bloquear
+ *
+ * El estado se publica (retenido) al cerrar la ventana de agrupación con el
+ * último valor; el cambio se añade además al lote de historial si hay hora.
+ */
+void relay_reportes_cambio(bool encendido, bool manual);
+
+/**
+ * @brief Publica ya el estado actual (retenido), sin ventana
+ */
+void relay_reportes_publicar_estado(bool encendido, bool manual, const char *tipo_reporte);
+
+/**
+ * @brief Envía el lote de historial pendiente sin esperar al intervalo
+ *
+ * No hace falta llamarla antes de reiniciar: con el primer evento se
+ * registra un manejador de esp_restart() que envía el lote y espera a que
+ * salga (o quede en el outbox).
+ */
+void relay_reportes_volcar_historial(void);
+
+/**
+ * @brief Copia los contadores de publicaciones
+ */
+void relay_reportes_obtener_estadisticas(relay_reportes_estadisticas_t *estadisticas);
+
+#ifdef __cplusplus
+}
+#endif
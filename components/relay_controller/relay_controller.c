@@ -1,6 +1,8 @@
 #include "relay_controller.h"
+#include "relay_reportes.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "mqtt_service.h"
 #include "wifi_sta.h"
 #include "time_manager.h"
@@ -15,57 +17,12 @@ static const char *TAG = "RELAY_CONTROLLER";
 
 static bool relay_state = false;
 static bool relay_initialized = false;
+static int64_t relay_ultimo_cambio_us = 0; // Instante del último cambio de GPIO
 
-static void enviar_estado_actual_y_historico(const char *mac_topic, const char *estado_str)
+// Los reportes se agrupan y publican desde la tarea de relay_reportes
+static void notificar_cambio(void)
 {
-    char fecha_actual[24] = {0};
-    esp_err_t fecha_ok = time_manager_get_fecha_actual(fecha_actual, sizeof(fecha_actual));
-
-    // Obtener el modo actual para incluirlo en el reporte
-    estado_app_t estado_actual = app_control_obtener_estado_actual();
-    const char *modo_str = (estado_actual == ESTADO_MANUAL) ? "manual" : "automatico";
-
-    // Tópico de estado actual
-    char topic_estado[64];
-    snprintf(topic_estado, sizeof(topic_estado), "dispositivos/%s/estado", mac_topic);
-
-    // Para cambios normales del relé, incluimos TipoReporte "cambio" y Modo
-    if (fecha_ok == ESP_OK && strlen(fecha_actual) > 0) {
-        mqtt_service_enviar_json(topic_estado, 2, 1, 
-                               "Estado", estado_str, 
-                               "Modo", modo_str,
-                               "Fecha", fecha_actual,
-                               "TipoReporte", "cambio",
-                               NULL);
-    } else {
-        mqtt_service_enviar_json(topic_estado, 2, 1, 
-                               "Estado", estado_str,
-                               "Modo", modo_str,
-                               "TipoReporte", "cambio",
-                               NULL);
-    }
-
-    // Tópico histórico con fecha (solo si hay fecha) - también incluye Modo
-    if (fecha_ok == ESP_OK && strlen(fecha_actual) > 0) {
-        char fecha_formateada[24] = {0};
-        const char *src = fecha_actual;
-        char *dst = fecha_formateada;
-        while (*src && (dst - fecha_formateada) < (int)sizeof(fecha_formateada) - 1) {
-            if (*src == ' ' || *src == ':') *dst++ = '_';
-            else if (*src == '-' || (*src >= '0' && *src <= '9')) *dst++ = *src;
-            src++;
-        }
-        *dst = '\0';
-
-        char topic_historico[96];
-        snprintf(topic_historico, sizeof(topic_historico), "dispositivos/%s/historial/%s", mac_topic, fecha_formateada);
-        mqtt_service_enviar_json(topic_historico, 2, 1, 
-                               "Estado", estado_str, 
-                               "Modo", modo_str,
-                               "Fecha", fecha_actual,
-                               "TipoReporte", "historico",
-                               NULL);
-    }
+    relay_reportes_cambio(relay_state, app_control_obtener_estado_actual() == ESTADO_MANUAL);
 }
 
 esp_err_t relay_controller_init(void)
@@ -97,6 +54,13 @@ esp_err_t relay_controller_init(void)
     relay_state = false;
     gpio_set_level(RELAY_GPIO_PIN, (RELAY_ACTIVE_HIGH && relay_state) ? 1 : 0);
 
+    ret = relay_reportes_iniciar();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error al iniciar los reportes del relé: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
     relay_initialized = true;
     ESP_LOGI(TAG, "Relay controller inicializado en GPIO %d, activo en %s, estado inicial: APAGADO (seguro)",
              RELAY_GPIO_PIN, RELAY_ACTIVE_HIGH ? "ALTO" : "BAJO");
@@ -115,10 +79,10 @@ esp_err_t relay_controller_activate(void)
     if (!relay_state)
     {
         gpio_set_level(RELAY_GPIO_PIN, RELAY_ACTIVE_HIGH ? 1 : 0);
+        relay_ultimo_cambio_us = esp_timer_get_time();
         relay_state = true;
         
-        const char *mac_topic = sta_wifi_get_mac_clean();
-        enviar_estado_actual_y_historico(mac_topic, "Encendido");
+        notificar_cambio();
         ESP_LOGI(TAG, "Relé activado");
     }
 
@@ -136,16 +100,21 @@ esp_err_t relay_controller_deactivate(void)
     if (relay_state)
     {
         gpio_set_level(RELAY_GPIO_PIN, RELAY_ACTIVE_HIGH ? 0 : 1);
+        relay_ultimo_cambio_us = esp_timer_get_time();
         relay_state = false;
         
-        const char *mac_topic = sta_wifi_get_mac_clean();
-        enviar_estado_actual_y_historico(mac_topic, "Apagado");
+        notificar_cambio();
         ESP_LOGI(TAG, "Relé desactivado");
     }
 
     return ESP_OK;
 }
 
+int64_t relay_controller_get_ultimo_cambio_us(void)
+{
+    return relay_ultimo_cambio_us;
+}
+
 esp_err_t relay_controller_set_state(bool state)
 {
     if (state)
@@ -213,36 +182,14 @@ esp_err_t relay_controller_reportar_estado_inicial(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    const char *estado_str = relay_state ? "Encendido" : "Apagado";
-    
     // Obtener el modo actual para incluirlo en el reporte
-    estado_app_t estado_actual = app_control_obtener_estado_actual();
-    const char *modo_str = (estado_actual == ESTADO_MANUAL) ? "manual" : "automatico";
-    
-    char fecha_actual[24] = {0};
-    esp_err_t fecha_ok = time_manager_get_fecha_actual(fecha_actual, sizeof(fecha_actual));
+    bool manual = app_control_obtener_estado_actual() == ESTADO_MANUAL;
     
-    // Tópico de estado actual
-    char topic_estado[64];
-    snprintf(topic_estado, sizeof(topic_estado), "dispositivos/%s/estado", mac_topic);
+    ESP_LOGI(TAG, "Reportando estado inicial del relé: %s, modo: %s",
+             relay_state ? "Encendido" : "Apagado", manual ? "manual" : "automatico");
     
-     ESP_LOGI(TAG, "Reportando estado inicial del relé: %s, modo: %s", estado_str, modo_str);
-    
-    // Reporte inicial con los mismos campos que los demás reportes
-    if (fecha_ok == ESP_OK && strlen(fecha_actual) > 0) {
-        mqtt_service_enviar_json(topic_estado, 2, 1, 
-                               "Estado", estado_str, 
-                               "Modo", modo_str,
-                               "Fecha", fecha_actual,
-                               "TipoReporte", "inicial",
-                               NULL);
-    } else {
-        mqtt_service_enviar_json(topic_estado, 2, 1, 
-                               "Estado", estado_str,
-                               "Modo", modo_str,
-                               "TipoReporte", "inicial",
-                               NULL);
-    }
+    // Reporte inicial con los mismos campos que los demás reportes, sin ventana de agrupación
+    relay_reportes_publicar_estado(relay_state, manual, "inicial");
     
     return ESP_OK;
 }
\ No newline at end of file
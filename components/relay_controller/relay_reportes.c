@@ -0,0 +1,286 @@
+#include "relay_reportes.h"
+#include <inttypes.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mqtt_service.h"
+#include "time_manager.h"
+#include "wifi_sta.h"
+
+static const char *TAG = "RELAY_REPORTES";
+
+#define NOTIF_CAMBIO            (1 << 0)
+#define NOTIF_VOLCAR            (1 << 1)
+#define NOTIF_APAGADO           (1 << 2)    // Volcado pedido desde esp_restart(): confirmar
+
+// Espera máxima del volcado antes de reiniciar (cubre la ventana de agrupación)
+#define VOLCADO_APAGADO_MS      (RELAY_REPORTE_VENTANA_MS + 1000)
+
+// [dt,e,m] ocupa como mucho 16 bytes con dt de hasta 10 cifras
+#define HISTORIAL_JSON_MAX      (96 + 16 * RELAY_HISTORIAL_MAX_EVENTOS)
+
+// Un evento del lote: segundos desde el primero, estado y modo
+typedef struct {
+    uint32_t dt;
+    uint8_t encendido;
+    uint8_t manual;
+} evento_t;
+
+static TaskHandle_t s_tarea = NULL;
+static SemaphoreHandle_t s_mutex = NULL;
+static SemaphoreHandle_t s_volcado_apagado = NULL;  // La tarea terminó el volcado de apagado
+static bool s_manejador_apagado = false;
+
+// Último estado pendiente de publicar
+static bool s_encendido = false;
+static bool s_manual = false;
+static uint32_t s_cambios_en_ventana = 0;
+
+// Lote de historial, con el primer instante como base de los deltas
+static int64_t s_historial_inicio = 0;
+static TickType_t s_historial_tick = 0;
+static evento_t s_historial[RELAY_HISTORIAL_MAX_EVENTOS];
+static size_t s_num_historial = 0;
+
+static relay_reportes_estadisticas_t s_estadisticas;
+
+static void contar_publicacion(const char *topic, const json_writer_t *w, int qos)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_estadisticas.bytes_publicados += strlen(topic) + w->longitud;
+    s_estadisticas.idas_y_vueltas += qos;
+    xSemaphoreGive(s_mutex);
+}
+
+void relay_reportes_publicar_estado(bool encendido, bool manual, const char *tipo_reporte)
+{
+    char topic[64];
+    snprintf(topic, sizeof(topic), "dispositivos/%s/estado", sta_wifi_get_mac_clean());
+
+    char fecha[24] = {0};
+    bool con_fecha = time_manager_get_fecha_actual(fecha, sizeof(fecha)) == ESP_OK && fecha[0] != '\0';
+
+    char json[128];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "Estado", encendido ? "Encendido" : "Apagado");
+    json_writer_str(&w, "Modo", manual ? "manual" : "automatico");
+    if (con_fecha) {
+        json_writer_str(&w, "Fecha", fecha);
+    }
+    json_writer_str(&w, "TipoReporte", tipo_reporte);
+
+    if (mqtt_service_enviar_json_writer(topic, &w, RELAY_QOS_ESTADO, 1) == ESP_OK && s_mutex != NULL) {
+        contar_publicacion(topic, &w, RELAY_QOS_ESTADO);
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        s_estadisticas.estados_publicados++;
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+/**
+ * Envía el lote como {"TipoReporte":"historico","Inicio":<unix>,"Eventos":[[dt,e,m],...]}
+ * a un único tópico sin retener; dt son segundos desde Inicio, e=1 encendido, m=1 manual.
+ */
+static void publicar_historial(void)
+{
+    static evento_t eventos[RELAY_HISTORIAL_MAX_EVENTOS];
+    static char json[HISTORIAL_JSON_MAX];
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    size_t num = s_num_historial;
+    int64_t inicio = s_historial_inicio;
+    memcpy(eventos, s_historial, num * sizeof(evento_t));
+    s_num_historial = 0;
+    xSemaphoreGive(s_mutex);
+
+    if (num == 0) {
+        return;
+    }
+
+    char topic[64];
+    snprintf(topic, sizeof(topic), "dispositivos/%s/historial", sta_wifi_get_mac_clean());
+
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "TipoReporte", "historico");
+    json_writer_int(&w, "Inicio", inicio);
+    json_writer_array(&w, "Eventos");
+    for (size_t i = 0; i < num; i++) {
+        json_writer_array(&w, NULL);
+        json_writer_uint(&w, NULL, eventos[i].dt);
+        json_writer_uint(&w, NULL, eventos[i].encendido);
+        json_writer_uint(&w, NULL, eventos[i].manual);
+        json_writer_cerrar(&w);
+    }
+
+    if (mqtt_service_enviar_json_writer(topic, &w, RELAY_QOS_HISTORIAL, 0) == ESP_OK) {
+        contar_publicacion(topic, &w, RELAY_QOS_HISTORIAL);
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        s_estadisticas.historiales_publicados++;
+        relay_reportes_estadisticas_t e = s_estadisticas;
+        xSemaphoreGive(s_mutex);
+
+        ESP_LOGI(TAG, "Historial enviado: %u eventos. Total: %" PRIu32 " eventos, %" PRIu32 " mensajes, %" PRIu32
+                 " bytes, %" PRIu32 " idas y vueltas", (unsigned)num, e.eventos,
+                 e.estados_publicados + e.historiales_publicados, e.bytes_publicados, e.idas_y_vueltas);
+    }
+}
+
+static void relay_reportes_task(void *pvParameters)
+{
+    uint32_t bits;
+
+    while (1) {
+        // El lote vence un intervalo después de su primer evento; sin lote no hay plazo
+        TickType_t espera = portMAX_DELAY;
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        if (s_num_historial > 0) {
+            TickType_t transcurrido = xTaskGetTickCount() - s_historial_tick;
+            TickType_t intervalo = pdMS_TO_TICKS(RELAY_HISTORIAL_INTERVALO_S * 1000);
+            espera = (transcurrido < intervalo) ? intervalo - transcurrido : 0;
+        }
+        xSemaphoreGive(s_mutex);
+
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, espera) != pdTRUE) {
+            // Intervalo cumplido antes de llenar el lote
+            publicar_historial();
+            continue;
+        }
+
+        if (bits & NOTIF_CAMBIO) {
+            // Los cambios que lleguen durante la ventana solo actualizan el último estado
+            vTaskDelay(pdMS_TO_TICKS(RELAY_REPORTE_VENTANA_MS));
+
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            bool encendido = s_encendido;
+            bool manual = s_manual;
+            if (s_cambios_en_ventana > 1) {
+                s_estadisticas.estados_agrupados += s_cambios_en_ventana - 1;
+            }
+            s_cambios_en_ventana = 0;
+            xSemaphoreGive(s_mutex);
+
+            relay_reportes_publicar_estado(encendido, manual, "cambio");
+        }
+
+        if (bits & NOTIF_VOLCAR) {
+            publicar_historial();
+        }
+        if (bits & NOTIF_APAGADO) {
+            xSemaphoreGive(s_volcado_apagado);
+        }
+    }
+}
+
+/**
+ * Antes de reiniciar (OTA, comando, botón, provisión) se envía el lote
+ * pendiente: si no, los cambios desde el último envío se pierden. Publica la
+ * propia tarea, con su pila, y aquí solo se espera la confirmación. Sin
+ * conexión el lote queda en el outbox de flash y sale tras el arranque.
+ */
+static void volcar_al_apagar(void)
+{
+    if (s_tarea == NULL || xTaskGetCurrentTaskHandle() == s_tarea) {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    size_t pendientes = s_num_historial;
+    xSemaphoreGive(s_mutex);
+    if (pendientes == 0) {
+        return;
+    }
+
+    xSemaphoreTake(s_volcado_apagado, 0);      // Descarta una confirmación antigua
+    xTaskNotify(s_tarea, NOTIF_VOLCAR | NOTIF_APAGADO, eSetBits);
+    if (xSemaphoreTake(s_volcado_apagado, pdMS_TO_TICKS(VOLCADO_APAGADO_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Historial sin enviar antes de reiniciar (%u eventos)", (unsigned)pendientes);
+    }
+}
+
+esp_err_t relay_reportes_iniciar(void)
+{
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_volcado_apagado == NULL) {
+        s_volcado_apagado = xSemaphoreCreateBinary();
+        if (s_volcado_apagado == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_tarea == NULL) {
+        if (xTaskCreate(relay_reportes_task, "relay_reportes", 3072, NULL, 4, &s_tarea) != pdPASS) {
+            ESP_LOGE(TAG, "Error creando tarea de reportes");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+void relay_reportes_cambio(bool encendido, bool manual)
+{
+    if (s_tarea == NULL) {
+        return;
+    }
+
+    int64_t ahora = time_manager_get_unix_time_now();
+    bool lleno = false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_estadisticas.eventos++;
+    s_encendido = encendido;
+    s_manual = manual;
+    s_cambios_en_ventana++;
+
+    // Sin hora sincronizada el cambio no entra en el historial; con el lote
+    // lleno y aún sin enviar, el cambio solo cuenta para el estado
+    if (ahora > 0 && s_num_historial < RELAY_HISTORIAL_MAX_EVENTOS) {
+        if (s_num_historial == 0) {
+            s_historial_inicio = ahora;
+            s_historial_tick = xTaskGetTickCount();
+        }
+        evento_t *ev = &s_historial[s_num_historial++];
+        // Con hora ya hay WiFi: registrado después que el de WiFi, esp_restart()
+        // lo llama antes de pararla (los manejadores van en orden inverso)
+        if (!s_manejador_apagado) {
+            s_manejador_apagado = esp_register_shutdown_handler(volcar_al_apagar) == ESP_OK;
+        }
+        ev->dt = (ahora > s_historial_inicio) ? (uint32_t)(ahora - s_historial_inicio) : 0;
+        ev->encendido = encendido;
+        ev->manual = manual;
+        lleno = s_num_historial >= RELAY_HISTORIAL_MAX_EVENTOS;
+    }
+    xSemaphoreGive(s_mutex);
+
+    xTaskNotify(s_tarea, NOTIF_CAMBIO | (lleno ? NOTIF_VOLCAR : 0), eSetBits);
+}
+
+void relay_reportes_volcar_historial(void)
+{
+    if (s_tarea != NULL) {
+        xTaskNotify(s_tarea, NOTIF_VOLCAR, eSetBits);
+    }
+}
+
+void relay_reportes_obtener_estadisticas(relay_reportes_estadisticas_t *estadisticas)
+{
+    if (estadisticas == NULL) {
+        return;
+    }
+    if (s_mutex == NULL) {
+        memset(estadisticas, 0, sizeof(*estadisticas));
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *estadisticas = s_estadisticas;
+    xSemaphoreGive(s_mutex);
+}
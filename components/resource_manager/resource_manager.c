@@ -16,8 +16,10 @@ static const resource_config_t resource_configs[] = {
     },
     [RESOURCE_TYPE_AUTOMATICO] = {
         .min_heap_required = 20 * 1024,    // 20KB
-        // Automatico task observed <1k words usage, keep some margin
-        .min_stack_size = 2048,
+        // automatico_task publica por MQTT (escritura TLS en la propia tarea si hay
+        // conexión), escribe el modelo de ocupación en NVS y usa localtime_r:
+        // con 2048 bytes se desbordaba. Se vigila en resource_manager_monitor()
+        .min_stack_size = 6144,
         .warning_heap_level = 10 * 1024,   // 10KB
         .component_name = "AUTOMATICO"
     },
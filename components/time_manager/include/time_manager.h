@@ -35,6 +35,13 @@ esp_err_t time_manager_init(const char* ntp_server);
  */
 esp_err_t time_manager_sync_ntp(void);
 
+/**
+ * @brief Espera, sin lanzar una nueva sincronización, a que haya hora NTP.
+ * @param timeout_ms Tiempo máximo de espera en milisegundos.
+ * @return ESP_OK si la hora ya se sincronizó alguna vez, ESP_ERR_TIMEOUT si no.
+ */
+esp_err_t time_manager_esperar_sincronizacion(uint32_t timeout_ms);
+
 /**
  * @brief Devuelve la hora UNIX almacenada tras la última sincronización NTP.
  */
@@ -19,6 +19,7 @@
 #include "freertos/task.h"
 #include "esp_event.h"
 #include "esp_netif.h" // <-- Añade esta línea
+#include "boot_trace.h"
 #include <stdlib.h> // Para setenv
 
 
@@ -38,6 +39,7 @@ static void time_sync_notification_cb(struct timeval *tv)
     s_unix_time_synced = now;
     s_boot_time_synced_us = esp_timer_get_time();
     s_time_synced = true;
+    boot_trace_marcar(BOOT_TRACE_NTP);
     ESP_LOGI(TAG, "Sincronización NTP exitosa. UNIX=%lld, boot_us=%lld", s_unix_time_synced, s_boot_time_synced_us);
 }
 
@@ -100,6 +102,17 @@ esp_err_t time_manager_sync_ntp(void)
     }
 }
 
+esp_err_t time_manager_esperar_sincronizacion(uint32_t timeout_ms)
+{
+    // s_time_synced se borra en cada resincronización; la hora sincronizada no
+    uint32_t esperado_ms = 0;
+    while (s_unix_time_synced == 0 && esperado_ms < timeout_ms) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        esperado_ms += 100;
+    }
+    return (s_unix_time_synced != 0) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
 static void time_manager_sync_task(void *arg)
 {
     ESP_LOGI(TAG, "time_manager_sync_task watermark=%u",
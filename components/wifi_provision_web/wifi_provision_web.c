@@ -1,6 +1,8 @@
 #include "wifi_provision_web.h"
 #include "nvs_manager.h"
+#include "ecokey_config.h"
 #include "cJSON.h"
+#include <stdlib.h>
 #include <string.h>
 #include <esp_wifi.h>
 #include <esp_log.h>
@@ -83,11 +85,22 @@ static esp_err_t custom_data_post_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // Guardar datos en NVS vía nvs_manager
-    nvs_manager_set_string("mac_objetivo", j_mac->valuestring);
-    nvs_manager_set_string("ssid", j_ssid->valuestring);
-    nvs_manager_set_string("password", j_pass->valuestring);
-    nvs_manager_set_string("temporizador", j_temp->valuestring);
+    // Validar antes de guardar nada: la configuración solo acepta valores correctos
+    uint8_t mac_bin[6];
+    int temporizador = atoi(j_temp->valuestring);
+    if (ecokey_config_parsear_mac(j_mac->valuestring, mac_bin) != ESP_OK ||
+        temporizador < ECOKEY_CONFIG_TEMPORIZADOR_MIN || temporizador > ECOKEY_CONFIG_TEMPORIZADOR_MAX)
+    {
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"MAC o temporizador no válidos\"}");
+        cJSON_Delete(root);
+        return ESP_FAIL;
+    }
+
+    // Guardar datos en la configuración (un solo blob en NVS)
+    ecokey_config_set_mac_objetivo_texto(j_mac->valuestring);
+    ecokey_config_set_temporizador(temporizador);
+    nvs_manager_set_wifi_credentials(j_ssid->valuestring, j_pass->valuestring);
 
     wifi_config_t wifi_cfg = {0};
     strncpy((char *)wifi_cfg.sta.ssid, j_ssid->valuestring, sizeof(wifi_cfg.sta.ssid));
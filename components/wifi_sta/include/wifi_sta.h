@@ -125,6 +125,18 @@ void sta_wifi_set_ignore_connection_errors(bool ignore_connection_errors);
  */
 esp_err_t sta_wifi_get_mac(char *mac_str, size_t len);
 
+/**
+ * @brief Callback de cambios del enlace: true al obtener IP, false al perder el AP
+ */
+typedef void (*sta_wifi_enlace_cb_t)(bool conectado, void *arg);
+
+/**
+ * @brief Registra el callback de cambios del enlace (uno solo; NULL lo elimina)
+ *
+ * Se llama desde el bucle de eventos por defecto: no debe bloquear.
+ */
+void sta_wifi_registrar_enlace_cb(sta_wifi_enlace_cb_t cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
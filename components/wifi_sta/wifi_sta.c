@@ -1,6 +1,8 @@
 #include "wifi_sta.h"
 #include "nvs_manager.h"  // Incluir el gestor de NVS
 #include "esp_wifi.h"
+#include "esp_mac.h"
+#include "boot_trace.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "freertos/timers.h"
@@ -43,6 +45,10 @@ static wifi_sta_reconnect_config_t s_reconnect_config = {
     .initial_interval_ms = DEFAULT_INITIAL_RECONNECT_INTERVAL,
     .max_interval_ms = DEFAULT_MAX_RECONNECT_INTERVAL};
 
+// Aviso de cambios del enlace a otros componentes
+static sta_wifi_enlace_cb_t s_enlace_cb = NULL;
+static void *s_enlace_cb_arg = NULL;
+
 // Contador de intentos de reconexión
 static uint8_t s_reconnect_attempts = 0;
 static uint16_t s_current_interval_ms = 0;
@@ -204,6 +210,10 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
 
             // Mostrar información sobre la razón de desconexión
             ESP_LOGW(TAG, "Desconectado del AP, razón: %d", event->reason);
+            if (s_enlace_cb != NULL)
+            {
+                s_enlace_cb(false, s_enlace_cb_arg);
+            }
 
             // Iniciar el proceso de reconexión si está habilitado
             if (s_reconnect_config.enabled && !s_reconnecting)
@@ -222,6 +232,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         {
             ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
             ESP_LOGI(TAG, "IP obtenida:" IPSTR, IP2STR(&event->ip_info.ip));
+            boot_trace_marcar(BOOT_TRACE_WIFI_CONECTADO);
             s_connected = true;
             s_reconnecting = false;
             if (s_reconnect_timer != NULL)
@@ -229,6 +240,31 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                 xTimerStop(s_reconnect_timer, 0);
             }
             xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            if (s_enlace_cb != NULL)
+            {
+                s_enlace_cb(true, s_enlace_cb_arg);
+            }
+        }
+    }
+}
+
+void sta_wifi_registrar_enlace_cb(sta_wifi_enlace_cb_t cb, void *arg)
+{
+    s_enlace_cb_arg = arg;
+    s_enlace_cb = cb;
+}
+
+// La MAC de estación sale del eFuse: está disponible antes de conectar
+static void cargar_mac(void)
+{
+    if (s_mac_str[0] == '\0') {
+        uint8_t mac[6];
+        if (esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK) {
+            // MAC limpia (sin dos puntos)
+            snprintf(s_mac_clean, sizeof(s_mac_clean), "%02X%02X%02X%02X%02X%02X",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            snprintf(s_mac_str, sizeof(s_mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
         }
     }
 }
@@ -424,16 +460,7 @@ esp_err_t sta_wifi_connect(const char *ssid, const char *password, uint32_t time
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (s_mac_str[0] == '\0') {
-        uint8_t mac[6];
-        if (esp_wifi_get_mac(WIFI_IF_STA, mac) == ESP_OK) {
-            snprintf(s_mac_str, sizeof(s_mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-            // MAC limpia (sin dos puntos)
-            snprintf(s_mac_clean, sizeof(s_mac_clean), "%02X%02X%02X%02X%02X%02X",
-                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        }
-    }
+    cargar_mac();
 
     // Limpiar bits de eventos previos
     xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
@@ -551,11 +578,13 @@ esp_err_t sta_wifi_connect(const char *ssid, const char *password, uint32_t time
 
 const char *sta_wifi_get_mac_str(void)
 {
+    cargar_mac();
     return s_mac_str;
 }
 
 const char *sta_wifi_get_mac_clean(void)
 {
+    cargar_mac();
     return s_mac_clean;
 }
 
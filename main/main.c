@@ -6,6 +6,7 @@
 #include "esp_system.h"
 #include "app_inicializacion.h" // Inicialización de componentes básicos
 #include "app_control.h"        // Control de estados1
+#include "boot_trace.h"
 
 static const char *TAG = "MAIN";
 static const char *TAG_RESET = "RESET_INFO"; // TAG específico para información de reinicio
@@ -58,6 +59,7 @@ static const char* obtener_descripcion_reset(esp_reset_reason_t motivo)
 
 void app_main(void)
 {
+    boot_trace_marcar(BOOT_TRACE_APP_MAIN);
     ESP_LOGI(TAG, "Iniciando aplicación EcoKey");
 
     // Obtener y mostrar el motivo del último reinicio
@@ -69,24 +71,14 @@ void app_main(void)
     ESP_LOGW(TAG_RESET, "║  MOTIVO DEL ÚLTIMO REINICIO: %-8s ║", str_motivo_reinicio_global);
     ESP_LOGW(TAG_RESET, "╚══════════════════════════════════════╝");
 
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Pausa para estabilidad
-    
-    // 1. Inicializar todos los componentes básicos (incluido app_control)
+    // 1. Inicializar los componentes y arrancar el estado guardado; las etapas
+    //    independientes (red, NTP, MQTT, modo) se ejecutan en paralelo
     if (inicializar_componentes() != ESP_OK)
     {
         ESP_LOGE(TAG, "Error durante la inicialización de componentes");
         return; // Terminamos la ejecución si hay error crítico
     }
 
-    ESP_LOGI(TAG, "Inicialización completada, iniciando estado de la aplicación");
-
-    // 2. Iniciar el estado adecuado según la configuración guardada o lógica predeterminada
-    if (app_control_iniciar_estado() != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error al iniciar el estado de la aplicación");
-        return; // Terminamos si no se puede iniciar ningún estado
-    }
-
     ESP_LOGI(TAG, "Aplicación en ejecución con estado inicial activado");
 
     
@@ -0,0 +1,67 @@
+// Dobles comunes de ESP-IDF para las pruebas de host: errores, log y reinicio
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#define MAX_MANEJADORES_APAGADO 8
+
+static shutdown_handler_t s_manejadores[MAX_MANEJADORES_APAGADO];
+static int s_num_manejadores;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static __thread char texto[16];
+    if (code == ESP_OK) {
+        return "ESP_OK";
+    }
+    snprintf(texto, sizeof(texto), "0x%x", (unsigned)code);
+    return texto;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < s_num_manejadores; i++) {
+        if (s_manejadores[i] == handler) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (s_num_manejadores == MAX_MANEJADORES_APAGADO) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_manejadores[s_num_manejadores++] = handler;
+    return ESP_OK;
+}
+
+void esp_restart(void)
+{
+    // Como esp_restart(): en orden inverso al registro
+    for (int i = s_num_manejadores - 1; i >= 0; i--) {
+        s_manejadores[i]();
+    }
+}
+
+size_t strlcpy(char *destino, const char *origen, size_t tam)
+{
+    size_t longitud = strlen(origen);
+    if (tam > 0) {
+        size_t n = longitud < tam - 1 ? longitud : tam - 1;
+        memcpy(destino, origen, n);
+        destino[n] = '\0';
+    }
+    return longitud;
+}
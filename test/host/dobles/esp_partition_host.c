@@ -0,0 +1,97 @@
+// Partición de datos en RAM con la semántica de la flash NOR: escribir solo
+// pasa bits de 1 a 0, borrar pone el sector entero a 0xFF
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#define SECTOR          4096
+#define TAM_PARTICION   0xA0000     // spiffs en partitions.csv
+
+esp_partition_host_estado_t esp_partition_host = { .corte_tras = -1 };
+
+static uint8_t s_flash[TAM_PARTICION];
+static uint32_t s_borrados[TAM_PARTICION / SECTOR];
+static const esp_partition_t s_particion = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+    .address = 0x360000,
+    .size = TAM_PARTICION,
+    .erase_size = SECTOR,
+    .label = "spiffs",
+};
+
+void esp_partition_host_formatear(void)
+{
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    memset(s_borrados, 0, sizeof(s_borrados));
+    esp_partition_host = (esp_partition_host_estado_t){ .corte_tras = -1 };
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t tipo, esp_partition_subtype_t subtipo,
+                                                const char *etiqueta)
+{
+    if (tipo != ESP_PARTITION_TYPE_DATA || (etiqueta != NULL && strcmp(etiqueta, s_particion.label) != 0)) {
+        return NULL;
+    }
+    return &s_particion;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *destino, size_t longitud)
+{
+    if (offset + longitud > p->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(destino, s_flash + offset, longitud);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *origen, size_t longitud)
+{
+    if (offset + longitud > p->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Tras el corte no llega nada más a la flash; la escritura del corte queda a medias
+    if (esp_partition_host.corte_tras == 0) {
+        return ESP_OK;
+    }
+    if (esp_partition_host.corte_tras > 0 && --esp_partition_host.corte_tras == 0) {
+        longitud /= 2;
+    }
+    const uint8_t *datos = origen;
+    for (size_t i = 0; i < longitud; i++) {
+        s_flash[offset + i] &= datos[i];
+    }
+    esp_partition_host.escrituras++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t longitud)
+{
+    if (offset % SECTOR != 0 || longitud % SECTOR != 0 || offset + longitud > p->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (esp_partition_host.corte_tras == 0) {
+        return ESP_OK;
+    }
+    memset(s_flash + offset, 0xFF, longitud);
+    for (size_t s = offset / SECTOR; s < (offset + longitud) / SECTOR; s++) {
+        esp_partition_host.borrados++;
+        if (++s_borrados[s] > esp_partition_host.borrados_max_sector) {
+            esp_partition_host.borrados_max_sector = s_borrados[s];
+        }
+    }
+    return ESP_OK;
+}
+
+// CRC-32 IEEE reflejado, como la función de la ROM
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
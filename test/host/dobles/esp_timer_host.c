@@ -0,0 +1,135 @@
+// esp_timer con reloj virtual: los callbacks se ejecutan dentro de esp_timer_host_avanzar()
+#include <pthread.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+
+#define MAX_TEMPORIZADORES  16
+
+struct temporizador_host {
+    esp_timer_cb_t callback;
+    void *arg;
+    bool activo;
+    int64_t vence;
+    uint64_t periodo;
+};
+
+// Con dobles/freertos_host.c enlazado, cada callback espera a que las tareas
+// terminen lo que haya disparado: el reloj virtual no avanza mientras tanto
+void freertos_host_esperar_reposo(void) __attribute__((weak));
+
+static struct temporizador_host *s_temporizadores[MAX_TEMPORIZADORES];
+static int64_t s_ahora;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int64_t esp_timer_get_time(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    int64_t t = s_ahora;
+    pthread_mutex_unlock(&s_mutex);
+    return t;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < MAX_TEMPORIZADORES; i++) {
+        if (s_temporizadores[i] == NULL) {
+            s_temporizadores[i] = calloc(1, sizeof(struct temporizador_host));
+            s_temporizadores[i]->callback = args->callback;
+            s_temporizadores[i]->arg = args->arg;
+            *handle = s_temporizadores[i];
+            pthread_mutex_unlock(&s_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t arrancar(esp_timer_handle_t t, uint64_t us, uint64_t periodo)
+{
+    pthread_mutex_lock(&s_mutex);
+    esp_err_t ret = t->activo ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (ret == ESP_OK) {
+        t->activo = true;
+        t->vence = s_ahora + (int64_t)us;
+        t->periodo = periodo;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return ret;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    return arrancar(t, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    return arrancar(t, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_mutex);
+    esp_err_t ret = t->activo ? ESP_OK : ESP_ERR_INVALID_STATE;
+    t->activo = false;
+    pthread_mutex_unlock(&s_mutex);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < MAX_TEMPORIZADORES; i++) {
+        if (s_temporizadores[i] == t) {
+            s_temporizadores[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+    free(t);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_mutex);
+    bool activo = t->activo;
+    pthread_mutex_unlock(&s_mutex);
+    return activo;
+}
+
+void esp_timer_host_avanzar(int64_t us)
+{
+    pthread_mutex_lock(&s_mutex);
+    int64_t fin = s_ahora + us;
+    for (;;) {
+        // El siguiente que vence dentro del intervalo
+        struct temporizador_host *siguiente = NULL;
+        for (int i = 0; i < MAX_TEMPORIZADORES; i++) {
+            struct temporizador_host *t = s_temporizadores[i];
+            if (t != NULL && t->activo && t->vence <= fin &&
+                (siguiente == NULL || t->vence < siguiente->vence)) {
+                siguiente = t;
+            }
+        }
+        if (siguiente == NULL) {
+            break;
+        }
+        s_ahora = siguiente->vence;
+        if (siguiente->periodo > 0) {
+            siguiente->vence += (int64_t)siguiente->periodo;
+        } else {
+            siguiente->activo = false;
+        }
+        // Sin el mutex: el callback puede rearmar o parar temporizadores
+        pthread_mutex_unlock(&s_mutex);
+        siguiente->callback(siguiente->arg);
+        if (freertos_host_esperar_reposo != NULL) {
+            freertos_host_esperar_reposo();
+        }
+        pthread_mutex_lock(&s_mutex);
+    }
+    s_ahora = fin;
+    pthread_mutex_unlock(&s_mutex);
+}
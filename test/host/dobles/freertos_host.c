@@ -0,0 +1,527 @@
+// FreeRTOS de host sobre pthreads: lo justo para la lógica de los componentes
+//
+// Todo el estado de los dobles (notificaciones, semáforos, colas, eventos)
+// se protege con un único mutex y cada cambio despierta a todos los que
+// esperan; cada espera se describe con una condición, así que
+// freertos_host_esperar_reposo() puede saber si alguna tarea tiene trabajo.
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define MAX_TAREAS  32
+
+typedef bool (*condicion_t)(void *arg);
+
+struct tarea_host {
+    TaskFunction_t fn;
+    void *arg;
+    UBaseType_t prioridad;
+    bool creada;                // Con xTaskCreate (no el hilo principal de la prueba)
+    bool terminada;
+    uint32_t valor;             // Valor de notificación
+    bool pendiente;             // Hay notificación sin recoger
+    // Espera en curso: bloqueada mientras condicion(arg_condicion) sea falsa
+    bool bloqueada;
+    condicion_t condicion;
+    void *arg_condicion;
+};
+
+static pthread_mutex_t s_kernel = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cambio = PTHREAD_COND_INITIALIZER;
+static struct tarea_host *s_tareas[MAX_TAREAS];
+static __thread struct tarea_host *t_actual;
+
+static pthread_mutex_t s_critica;
+static pthread_once_t s_critica_once = PTHREAD_ONCE_INIT;
+
+static void iniciar_critica(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_critica, &attr);
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    pthread_once(&s_critica_once, iniciar_critica);
+    pthread_mutex_lock(&s_critica);
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&s_critica);
+}
+
+/* ---- Núcleo: esperas con condición ---- */
+
+static struct tarea_host *nueva_tarea(TaskFunction_t fn, void *arg, UBaseType_t prioridad)
+{
+    struct tarea_host *t = calloc(1, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+    t->prioridad = prioridad;
+    return t;
+}
+
+// La tarea que llama sin haber sido creada (main de la prueba) también puede recibir avisos
+static struct tarea_host *tarea_actual(void)
+{
+    if (t_actual == NULL) {
+        t_actual = nueva_tarea(NULL, NULL, 1);
+    }
+    return t_actual;
+}
+
+static bool nunca(void *arg)
+{
+    return false;
+}
+
+/**
+ * Espera con s_kernel tomado hasta que condicion(arg) sea cierta o venza el
+ * plazo; devuelve el valor final de la condición
+ */
+static bool esperar(condicion_t condicion, void *arg, TickType_t espera)
+{
+    struct tarea_host *t = tarea_actual();
+    struct timespec plazo;
+    if (espera != portMAX_DELAY) {
+        clock_gettime(CLOCK_REALTIME, &plazo);
+        uint64_t ns = (uint64_t)pdTICKS_TO_MS(espera) * 1000000ULL + (uint64_t)plazo.tv_nsec;
+        plazo.tv_sec += ns / 1000000000ULL;
+        plazo.tv_nsec = ns % 1000000000ULL;
+    }
+
+    bool listo = condicion(arg);
+    while (!listo) {
+        t->condicion = condicion;
+        t->arg_condicion = arg;
+        t->bloqueada = true;
+        pthread_cond_broadcast(&s_cambio);      // Por si alguien espera el reposo
+        int r = (espera == portMAX_DELAY) ? pthread_cond_wait(&s_cambio, &s_kernel)
+                                          : pthread_cond_timedwait(&s_cambio, &s_kernel, &plazo);
+        t->bloqueada = false;
+        listo = condicion(arg);
+        if (r == ETIMEDOUT) {
+            break;
+        }
+    }
+    return listo;
+}
+
+static void hubo_cambio(void)
+{
+    pthread_cond_broadcast(&s_cambio);
+}
+
+static bool tareas_en_reposo(void *arg)
+{
+    for (int i = 0; i < MAX_TAREAS; i++) {
+        struct tarea_host *t = s_tareas[i];
+        if (t == NULL || t == arg || t->terminada) {
+            continue;
+        }
+        if (!t->bloqueada || t->condicion(t->arg_condicion)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void freertos_host_esperar_reposo(void)
+{
+    pthread_mutex_lock(&s_kernel);
+    esperar(tareas_en_reposo, tarea_actual(), portMAX_DELAY);
+    pthread_mutex_unlock(&s_kernel);
+}
+
+/* ---- Tareas ---- */
+
+static void *trampolin(void *arg)
+{
+    struct tarea_host *t = arg;
+    t_actual = t;
+    t->fn(t->arg);
+    // Una tarea de FreeRTOS no retorna, pero en host se trata como vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *nombre, uint32_t pila, void *arg,
+                                   UBaseType_t prioridad, TaskHandle_t *handle, BaseType_t nucleo)
+{
+    struct tarea_host *t = nueva_tarea(fn, arg, prioridad);
+    t->creada = true;
+
+    pthread_mutex_lock(&s_kernel);
+    int libre = -1;
+    for (int i = 0; i < MAX_TAREAS && libre < 0; i++) {
+        if (s_tareas[i] == NULL) {
+            libre = i;
+        }
+    }
+    if (libre < 0) {
+        pthread_mutex_unlock(&s_kernel);
+        free(t);
+        return pdFAIL;
+    }
+    s_tareas[libre] = t;
+    // Como en FreeRTOS, el handle existe antes de que la tarea empiece
+    if (handle != NULL) {
+        *handle = t;
+    }
+    pthread_t hilo;
+    if (pthread_create(&hilo, NULL, trampolin, t) != 0) {
+        s_tareas[libre] = NULL;
+        if (handle != NULL) {
+            *handle = NULL;
+        }
+        pthread_mutex_unlock(&s_kernel);
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(hilo);
+    pthread_mutex_unlock(&s_kernel);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *nombre, uint32_t pila, void *arg,
+                       UBaseType_t prioridad, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, nombre, pila, arg, prioridad, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t tarea)
+{
+    // Solo se admite que una tarea se borre a sí misma: borrar otra a mitad de
+    // trabajo (con un mutex tomado) es justo lo que los componentes deben evitar
+    if (tarea != NULL && tarea != t_actual) {
+        fprintf(stderr, "vTaskDelete de otra tarea no soportado en host\n");
+        abort();
+    }
+    struct tarea_host *t = tarea_actual();
+    pthread_mutex_lock(&s_kernel);
+    t->terminada = true;
+    for (int i = 0; i < MAX_TAREAS; i++) {
+        if (s_tareas[i] == t) {
+            s_tareas[i] = NULL;    // El handle queda colgando, como en FreeRTOS
+        }
+    }
+    hubo_cambio();
+    pthread_mutex_unlock(&s_kernel);
+    pthread_exit(NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (TickType_t)(t.tv_sec * configTICK_RATE_HZ + t.tv_nsec / (1000000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    pthread_mutex_lock(&s_kernel);
+    esperar(nunca, NULL, ticks);
+    pthread_mutex_unlock(&s_kernel);
+}
+
+void vTaskDelayUntil(TickType_t *anterior, TickType_t incremento)
+{
+    *anterior += incremento;
+    int32_t falta = (int32_t)(*anterior - xTaskGetTickCount());
+    if (falta > 0) {
+        vTaskDelay((TickType_t)falta);
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return tarea_actual();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t tarea)
+{
+    return (tarea != NULL ? tarea : tarea_actual())->prioridad;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t tarea)
+{
+    return 1024;
+}
+
+/* ---- Notificaciones ---- */
+
+BaseType_t xTaskNotify(TaskHandle_t t, uint32_t valor, eNotifyAction accion)
+{
+    pthread_mutex_lock(&s_kernel);
+    switch (accion) {
+    case eSetBits:                  t->valor |= valor; break;
+    case eIncrement:                t->valor++; break;
+    case eSetValueWithOverwrite:    t->valor = valor; break;
+    default:                        break;
+    }
+    t->pendiente = true;
+    hubo_cambio();
+    pthread_mutex_unlock(&s_kernel);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t)
+{
+    return xTaskNotify(t, 0, eIncrement);
+}
+
+static bool hay_notificacion(void *arg)
+{
+    return ((struct tarea_host *)arg)->pendiente;
+}
+
+static bool valor_no_nulo(void *arg)
+{
+    return ((struct tarea_host *)arg)->valor != 0;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t limpiar_entrada, uint32_t limpiar_salida, uint32_t *valor, TickType_t espera)
+{
+    struct tarea_host *t = tarea_actual();
+    pthread_mutex_lock(&s_kernel);
+    if (!t->pendiente) {
+        t->valor &= ~limpiar_entrada;
+    }
+    bool ok = esperar(hay_notificacion, t, espera);
+    if (valor != NULL) {
+        *valor = t->valor;
+    }
+    if (ok) {
+        t->valor &= ~limpiar_salida;
+        t->pendiente = false;
+    }
+    pthread_mutex_unlock(&s_kernel);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t limpiar, TickType_t espera)
+{
+    struct tarea_host *t = tarea_actual();
+    pthread_mutex_lock(&s_kernel);
+    esperar(valor_no_nulo, t, espera);
+    uint32_t valor = t->valor;
+    if (valor != 0) {
+        t->valor = limpiar ? 0 : valor - 1;
+    }
+    t->pendiente = (t->valor != 0);
+    pthread_mutex_unlock(&s_kernel);
+    return valor;
+}
+
+/* ---- Semáforos ---- */
+
+struct semaforo_host {
+    bool tomado;
+};
+
+static bool semaforo_libre(void *arg)
+{
+    return !((struct semaforo_host *)arg)->tomado;
+}
+
+static SemaphoreHandle_t nuevo_semaforo(bool tomado)
+{
+    struct semaforo_host *s = calloc(1, sizeof(*s));
+    s->tomado = tomado;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return nuevo_semaforo(false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return nuevo_semaforo(true);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t espera)
+{
+    pthread_mutex_lock(&s_kernel);
+    bool ok = esperar(semaforo_libre, s, espera);
+    if (ok) {
+        s->tomado = true;
+    }
+    pthread_mutex_unlock(&s_kernel);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s_kernel);
+    bool estaba = s->tomado;
+    s->tomado = false;
+    hubo_cambio();
+    pthread_mutex_unlock(&s_kernel);
+    return estaba ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    free(s);
+}
+
+/* ---- Colas ---- */
+
+struct cola_host {
+    UBaseType_t longitud, tam, cabeza, ocupados;
+    uint8_t *datos;
+};
+
+static bool cola_con_sitio(void *arg)
+{
+    struct cola_host *c = arg;
+    return c->ocupados < c->longitud;
+}
+
+static bool cola_con_datos(void *arg)
+{
+    return ((struct cola_host *)arg)->ocupados > 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t longitud, UBaseType_t tam_elemento)
+{
+    struct cola_host *c = calloc(1, sizeof(*c));
+    c->longitud = longitud;
+    c->tam = tam_elemento;
+    c->datos = calloc(longitud, tam_elemento);
+    return c;
+}
+
+BaseType_t xQueueSend(QueueHandle_t c, const void *elemento, TickType_t espera)
+{
+    pthread_mutex_lock(&s_kernel);
+    bool ok = esperar(cola_con_sitio, c, espera);
+    if (ok) {
+        memcpy(c->datos + ((c->cabeza + c->ocupados) % c->longitud) * c->tam, elemento, c->tam);
+        c->ocupados++;
+        hubo_cambio();
+    }
+    pthread_mutex_unlock(&s_kernel);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t c, void *elemento, TickType_t espera)
+{
+    pthread_mutex_lock(&s_kernel);
+    bool ok = esperar(cola_con_datos, c, espera);
+    if (ok) {
+        memcpy(elemento, c->datos + c->cabeza * c->tam, c->tam);
+        c->cabeza = (c->cabeza + 1) % c->longitud;
+        c->ocupados--;
+        hubo_cambio();
+    }
+    pthread_mutex_unlock(&s_kernel);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t c)
+{
+    pthread_mutex_lock(&s_kernel);
+    c->cabeza = 0;
+    c->ocupados = 0;
+    hubo_cambio();
+    pthread_mutex_unlock(&s_kernel);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t c)
+{
+    pthread_mutex_lock(&s_kernel);
+    UBaseType_t n = c->ocupados;
+    pthread_mutex_unlock(&s_kernel);
+    return n;
+}
+
+void vQueueDelete(QueueHandle_t c)
+{
+    free(c->datos);
+    free(c);
+}
+
+/* ---- Grupos de eventos ---- */
+
+struct grupo_eventos_host {
+    EventBits_t bits;
+};
+
+// Cada espera lleva sus propios bits: varias tareas pueden esperar en el mismo grupo
+struct espera_eventos {
+    struct grupo_eventos_host *grupo;
+    EventBits_t esperados;
+    bool todos;
+};
+
+static bool bits_listos(void *arg)
+{
+    struct espera_eventos *e = arg;
+    EventBits_t bits = e->grupo->bits & e->esperados;
+    return e->todos ? bits == e->esperados : bits != 0;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct grupo_eventos_host));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&s_kernel);
+    g->bits |= bits;
+    EventBits_t r = g->bits;
+    hubo_cambio();
+    pthread_mutex_unlock(&s_kernel);
+    return r;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&s_kernel);
+    EventBits_t r = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&s_kernel);
+    return r;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&s_kernel);
+    EventBits_t r = g->bits;
+    pthread_mutex_unlock(&s_kernel);
+    return r;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t limpiar,
+                                BaseType_t todos, TickType_t espera)
+{
+    struct espera_eventos e = { .grupo = g, .esperados = bits, .todos = todos };
+    pthread_mutex_lock(&s_kernel);
+    bool ok = esperar(bits_listos, &e, espera);
+    EventBits_t r = g->bits;
+    if (ok && limpiar) {
+        g->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&s_kernel);
+    return r;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g)
+{
+    free(g);
+}
@@ -0,0 +1,258 @@
+// NVS en RAM: lo escrito queda pendiente hasta nvs_commit(), como en la flash real
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define MAX_CLAVES      64
+#define MAX_VALOR       1024
+
+typedef struct {
+    bool usada;
+    char clave[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t tipo;
+    size_t longitud;
+    uint8_t datos[MAX_VALOR];
+} entrada_t;
+
+struct nvs_opaque_iterator_t {
+    int indice;
+};
+
+nvs_host_estado_t nvs_host;
+
+static entrada_t s_flash[MAX_CLAVES];
+static entrada_t s_pendiente[MAX_CLAVES];
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static entrada_t *buscar(entrada_t *tabla, const char *clave)
+{
+    for (int i = 0; i < MAX_CLAVES; i++) {
+        if (tabla[i].usada && strcmp(tabla[i].clave, clave) == 0) {
+            return &tabla[i];
+        }
+    }
+    return NULL;
+}
+
+// Consume un fallo inyectado si lo hay
+static bool fallo_inyectado(void)
+{
+    if (nvs_host.fallos_pendientes > 0) {
+        nvs_host.fallos_pendientes--;
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t escribir(const char *clave, nvs_type_t tipo, const void *valor, size_t longitud)
+{
+    if (strlen(clave) >= NVS_KEY_NAME_MAX_SIZE || longitud > MAX_VALOR) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    pthread_mutex_lock(&s_mutex);
+    if (fallo_inyectado()) {
+        pthread_mutex_unlock(&s_mutex);
+        return ESP_FAIL;
+    }
+    entrada_t *e = buscar(s_pendiente, clave);
+    for (int i = 0; e == NULL && i < MAX_CLAVES; i++) {
+        if (!s_pendiente[i].usada) {
+            e = &s_pendiente[i];
+        }
+    }
+    if (e == NULL) {
+        pthread_mutex_unlock(&s_mutex);
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    e->usada = true;
+    strcpy(e->clave, clave);
+    e->tipo = tipo;
+    e->longitud = longitud;
+    memcpy(e->datos, valor, longitud);
+    nvs_host.escrituras++;
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+static esp_err_t leer(const char *clave, nvs_type_t tipo, void *valor, size_t *longitud)
+{
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(s_pendiente, clave);
+    if (e == NULL) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (e->tipo != tipo) {
+        ret = ESP_ERR_NVS_TYPE_MISMATCH;
+    } else if (valor == NULL) {
+        *longitud = e->longitud;
+    } else if (*longitud < e->longitud) {
+        ret = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(valor, e->datos, e->longitud);
+        *longitud = e->longitud;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return ret;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    memset(s_flash, 0, sizeof(s_flash));
+    memset(s_pendiente, 0, sizeof(s_pendiente));
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t modo, nvs_handle_t *h)
+{
+    *h = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_mutex);
+    bool falla = nvs_host.fallos_commit_pendientes > 0;
+    if (falla) {
+        nvs_host.fallos_commit_pendientes--;
+    } else {
+        falla = fallo_inyectado();
+    }
+    if (falla) {
+        pthread_mutex_unlock(&s_mutex);
+        return ESP_FAIL;
+    }
+    memcpy(s_flash, s_pendiente, sizeof(s_flash));
+    nvs_host.commits++;
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *k, int32_t v)
+{
+    return escribir(k, NVS_TYPE_I32, &v, sizeof(v));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *k, int32_t *v)
+{
+    size_t l = sizeof(*v);
+    return leer(k, NVS_TYPE_I32, v, &l);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *k, const char *v)
+{
+    return escribir(k, NVS_TYPE_STR, v, strlen(v) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *k, char *v, size_t *l)
+{
+    return leer(k, NVS_TYPE_STR, v, l);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *k, const void *v, size_t l)
+{
+    return escribir(k, NVS_TYPE_BLOB, v, l);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *k, void *v, size_t *l)
+{
+    return leer(k, NVS_TYPE_BLOB, v, l);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *k)
+{
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(s_pendiente, k);
+    if (e != NULL) {
+        e->usada = false;
+        nvs_host.escrituras++;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return e != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_mutex);
+    memset(s_pendiente, 0, sizeof(s_pendiente));
+    nvs_host.escrituras++;
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t nvs_find_key(nvs_handle_t h, const char *k, nvs_type_t *t)
+{
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(s_pendiente, k);
+    if (e != NULL && t != NULL) {
+        *t = e->tipo;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return e != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+// El iterador recorre la "flash", como tras un arranque
+static esp_err_t avanzar(nvs_iterator_t *it)
+{
+    while ((*it)->indice < MAX_CLAVES && !s_flash[(*it)->indice].usada) {
+        (*it)->indice++;
+    }
+    if ((*it)->indice >= MAX_CLAVES) {
+        free(*it);
+        *it = NULL;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char *part, const char *ns, nvs_type_t t, nvs_iterator_t *it)
+{
+    *it = calloc(1, sizeof(**it));
+    return avanzar(it);
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it)
+{
+    (*it)->indice++;
+    return avanzar(it);
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t *info)
+{
+    strcpy(info->key, s_flash[it->indice].clave);
+    info->type = s_flash[it->indice].tipo;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t it)
+{
+    free(it);
+}
+
+void nvs_host_reiniciar(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    memcpy(s_pendiente, s_flash, sizeof(s_pendiente));
+    pthread_mutex_unlock(&s_mutex);
+}
+
+const void *nvs_host_valor_en_flash(const char *k, size_t *longitud)
+{
+    entrada_t *e = buscar(s_flash, k);
+    if (e != NULL && longitud != NULL) {
+        *longitud = e->longitud;
+    }
+    return e != NULL ? e->datos : NULL;
+}
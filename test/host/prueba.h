@@ -0,0 +1,26 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Aserción de las pruebas de host: informa de la línea y sale con 1
+ *
+ * No depende de NDEBUG, así que también se comprueba en compilaciones Release.
+ */
+#define COMPROBAR(cond)                                                         \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: falla: %s\n", __FILE__, __LINE__, #cond);   \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define COMPROBAR_IGUAL(a, b)                                                   \
+    do {                                                                        \
+        long long _a = (long long)(a), _b = (long long)(b);                     \
+        if (_a != _b) {                                                         \
+            fprintf(stderr, "%s:%d: falla: %s == %s (%lld != %lld)\n",          \
+                    __FILE__, __LINE__, #a, #b, _a, _b);                        \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
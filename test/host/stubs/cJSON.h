@@ -0,0 +1,9 @@
+#pragma once
+// Solo el tipo y lo que llama mqtt_router.c: las pruebas de host no enlazan
+// cJSON y la del router da su propia implementación para contar los análisis
+#include <stddef.h>
+
+typedef struct cJSON cJSON;
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length);
+void cJSON_Delete(cJSON *item);
@@ -0,0 +1,4 @@
+#pragma once
+#define IRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+// Los registros van a stderr para no mezclarse con la salida de las pruebas
+#define ESP_LOG_STUB(nivel, tag, fmt, ...) fprintf(stderr, nivel " (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, fmt, ...) ESP_LOG_STUB("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_LOG_STUB("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_LOG_STUB("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGV(tag, fmt, ...) ((void)(tag))
+
+uint32_t esp_log_timestamp(void);
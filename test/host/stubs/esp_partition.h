@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t tipo, esp_partition_subtype_t subtipo,
+                                                const char *etiqueta);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *destino, size_t longitud);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *origen, size_t longitud);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t longitud);
+
+/** @brief Contadores del doble para las pruebas */
+typedef struct {
+    uint32_t escrituras;    /**< Llamadas a esp_partition_write */
+    uint32_t borrados;      /**< Sectores borrados */
+    uint32_t borrados_max_sector;   /**< Borrados del sector más gastado */
+    int32_t corte_tras;     /**< >= 0: escrituras que se completan antes del corte de luz */
+} esp_partition_host_estado_t;
+extern esp_partition_host_estado_t esp_partition_host;
+
+/** @brief Flash nueva (todo a 0xFF) del tamaño de la partición spiffs de partitions.csv */
+void esp_partition_host_formatear(void);
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC,
+    ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT,
+} esp_reset_reason_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_reset_reason_t esp_reset_reason(void);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+
+/**
+ * @brief En el host no reinicia: ejecuta los manejadores registrados y vuelve
+ */
+void esp_restart(void);
@@ -0,0 +1,29 @@
+#pragma once
+// esp_timer de host con reloj virtual: el tiempo solo avanza con
+// esp_timer_host_avanzar(), que ejecuta los temporizadores vencidos en orden
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct temporizador_host *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time(void);
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+/** @brief Avanza el reloj virtual ejecutando los temporizadores que vencen */
+void esp_timer_host_avanzar(int64_t us);
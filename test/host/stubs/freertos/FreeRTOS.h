@@ -0,0 +1,37 @@
+#pragma once
+// FreeRTOS de host: tareas sobre pthreads, tick de 1 ms (ver dobles/freertos_host.c)
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_system.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+#define portMAX_DELAY           0xffffffffu
+#define configTICK_RATE_HZ      1000
+#define configMAX_TASK_NAME_LEN 16
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define pdTICKS_TO_MS(t)        ((uint32_t)(t) * 1000 / configTICK_RATE_HZ)
+#define tskIDLE_PRIORITY        0
+#define tskNO_AFFINITY          0x7fffffff
+#define PRO_CPU_NUM             0
+#define APP_CPU_NUM             1
+#define portYIELD_FROM_ISR(x)   ((void)(x))
+
+// Secciones críticas: un único mutex recursivo global
+typedef struct { int reservado; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void portENTER_CRITICAL(portMUX_TYPE *mux);
+void portEXIT_CRITICAL(portMUX_TYPE *mux);
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)     portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)      portEXIT_CRITICAL(mux)
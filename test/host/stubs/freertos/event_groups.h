@@ -0,0 +1,13 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct grupo_eventos_host *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t grupo, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t grupo, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t grupo);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t grupo, EventBits_t bits, BaseType_t limpiar,
+                                BaseType_t todos, TickType_t espera);
+void vEventGroupDelete(EventGroupHandle_t grupo);
@@ -0,0 +1,12 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct cola_host *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t longitud, UBaseType_t tam_elemento);
+BaseType_t xQueueSend(QueueHandle_t cola, const void *elemento, TickType_t espera);
+BaseType_t xQueueReceive(QueueHandle_t cola, void *elemento, TickType_t espera);
+BaseType_t xQueueReset(QueueHandle_t cola);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t cola);
+void vQueueDelete(QueueHandle_t cola);
+#define xQueueSendToBack(c, e, t) xQueueSend(c, e, t)
@@ -0,0 +1,34 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct tarea_host *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite } eNotifyAction;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *nombre, uint32_t pila, void *arg,
+                       UBaseType_t prioridad, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *nombre, uint32_t pila, void *arg,
+                                   UBaseType_t prioridad, TaskHandle_t *handle, BaseType_t nucleo);
+void vTaskDelete(TaskHandle_t tarea);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *anterior, TickType_t incremento);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t tarea);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t tarea);
+
+BaseType_t xTaskNotify(TaskHandle_t tarea, uint32_t valor, eNotifyAction accion);
+BaseType_t xTaskNotifyGive(TaskHandle_t tarea);
+BaseType_t xTaskNotifyWait(uint32_t limpiar_entrada, uint32_t limpiar_salida, uint32_t *valor, TickType_t espera);
+uint32_t ulTaskNotifyTake(BaseType_t limpiar, TickType_t espera);
+#define xTaskNotifyFromISR(t, v, a, w) xTaskNotify(t, v, a)
+#define vTaskNotifyGiveFromISR(t, w)   ((void)xTaskNotifyGive(t))
+
+/**
+ * @brief Solo en host: espera a que todas las tareas creadas estén bloqueadas sin nada pendiente
+ *
+ * Las pruebas con reloj virtual la usan para que el trabajo que dispara un
+ * temporizador termine antes de volver a avanzar el reloj.
+ */
+void freertos_host_esperar_reposo(void);
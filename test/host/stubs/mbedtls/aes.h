@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+
+#define MBEDTLS_AES_ENCRYPT                 1
+#define MBEDTLS_AES_DECRYPT                 0
+#define MBEDTLS_ERR_AES_INVALID_KEY_LENGTH  -0x0020
+#define MBEDTLS_ERR_AES_BAD_INPUT_DATA      -0x0021
+
+// Solo AES-128 en cifrado, lo que usa ble_rpa_resolver.c (dobles/aes_host.c)
+typedef struct {
+    uint8_t claves_ronda[176];
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx);
+void mbedtls_aes_free(mbedtls_aes_context *ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits);
+int mbedtls_aes_crypt_ecb(mbedtls_aes_context *ctx, int mode,
+                          const unsigned char input[16], unsigned char output[16]);
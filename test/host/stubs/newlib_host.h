@@ -0,0 +1,5 @@
+#pragma once
+// Funciones de newlib que glibc no tiene; se incluye en todas las fuentes
+#include <stddef.h>
+
+size_t strlcpy(char *destino, const char *origen, size_t tam);
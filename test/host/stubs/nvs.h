@@ -0,0 +1,62 @@
+#pragma once
+// NVS de host en RAM (ver dobles/nvs_host.c); un solo namespace
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef enum {
+    NVS_TYPE_U8 = 0x01, NVS_TYPE_I8 = 0x11, NVS_TYPE_U16 = 0x02, NVS_TYPE_I16 = 0x12,
+    NVS_TYPE_U32 = 0x04, NVS_TYPE_I32 = 0x14, NVS_TYPE_U64 = 0x08, NVS_TYPE_I64 = 0x18,
+    NVS_TYPE_STR = 0x21, NVS_TYPE_BLOB = 0x42, NVS_TYPE_ANY = 0xff,
+} nvs_type_t;
+
+#define NVS_KEY_NAME_MAX_SIZE   16
+#define NVS_DEFAULT_PART_NAME   "nvs"
+
+typedef struct {
+    char namespace_name[16];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+} nvs_entry_info_t;
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+#define ESP_ERR_NVS_BASE                0x1100
+#define ESP_ERR_NVS_NOT_FOUND           (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH       (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_INVALID_LENGTH      (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES       (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   (ESP_ERR_NVS_BASE + 0x10)
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t modo, nvs_handle_t *h);
+void nvs_close(nvs_handle_t h);
+esp_err_t nvs_commit(nvs_handle_t h);
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *k, int32_t v);
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *k, int32_t *v);
+esp_err_t nvs_set_str(nvs_handle_t h, const char *k, const char *v);
+esp_err_t nvs_get_str(nvs_handle_t h, const char *k, char *v, size_t *l);
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *k, const void *v, size_t l);
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *k, void *v, size_t *l);
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *k);
+esp_err_t nvs_erase_all(nvs_handle_t h);
+esp_err_t nvs_find_key(nvs_handle_t h, const char *k, nvs_type_t *t);
+esp_err_t nvs_entry_find(const char *part, const char *ns, nvs_type_t t, nvs_iterator_t *it);
+esp_err_t nvs_entry_next(nvs_iterator_t *it);
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t *info);
+void nvs_release_iterator(nvs_iterator_t it);
+
+/** @brief Contadores del doble para las pruebas */
+typedef struct {
+    uint32_t escrituras;    /**< set/erase que llegan a la "flash" */
+    uint32_t commits;
+    uint32_t fallos_pendientes;     /**< Próximos set/commit que devolverán ESP_FAIL */
+    uint32_t fallos_commit_pendientes;  /**< Próximos commit que devolverán ESP_FAIL */
+} nvs_host_estado_t;
+extern nvs_host_estado_t nvs_host;
+
+/** @brief Simula un reinicio: se pierde lo escrito sin commit */
+void nvs_host_reiniciar(void);
+
+/** @brief Valor en "flash" (tras commit) de una clave, o NULL */
+const void *nvs_host_valor_en_flash(const char *k, size_t *longitud);
@@ -0,0 +1,3 @@
+#pragma once
+// Sin opciones de menuconfig: los componentes usan los valores por defecto de
+// sus cabeceras. Las pruebas que necesiten una opción la definen antes de incluir.
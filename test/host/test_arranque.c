@@ -0,0 +1,330 @@
+// Grafo de arranque: orden de dependencias, etapas en paralelo, omisiones, fallos críticos y línea de tiempo
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "arranque.h"
+#include "prueba.h"
+
+#define GRAFOS_ALEATORIOS   200
+
+/*
+ * Reloj real en lugar del virtual de esp_timer_host.c: las etapas duermen en
+ * sus trabajadores a la vez y la línea de tiempo debe reflejar ese solape.
+ */
+static struct timespec s_t0;
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec - s_t0.tv_sec) * 1000000LL + (t.tv_nsec - s_t0.tv_nsec) / 1000;
+}
+
+// Comportamiento de cada etapa de la prueba y lo que se observó al ejecutarla
+typedef struct {
+    uint32_t ms;
+    esp_err_t resultado;
+    int llamadas;
+    int inicio_seq;             // Orden global de inicio y fin (el reloj puede empatar)
+    int fin_seq;
+} etapa_prueba_t;
+
+static etapa_prueba_t s_prueba[ARRANQUE_MAX_ETAPAS];
+static int s_seq;
+static int s_en_curso;
+static int s_max_en_curso;
+
+static esp_err_t ejecutar(int i)
+{
+    etapa_prueba_t *e = &s_prueba[i];
+    e->inicio_seq = __atomic_add_fetch(&s_seq, 1, __ATOMIC_SEQ_CST);
+    e->llamadas++;
+    int en_curso = __atomic_add_fetch(&s_en_curso, 1, __ATOMIC_SEQ_CST);
+    int max = __atomic_load_n(&s_max_en_curso, __ATOMIC_SEQ_CST);
+    while (en_curso > max &&
+           !__atomic_compare_exchange_n(&s_max_en_curso, &max, en_curso, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    }
+    if (e->ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(e->ms));
+    }
+    __atomic_sub_fetch(&s_en_curso, 1, __ATOMIC_SEQ_CST);
+    e->fin_seq = __atomic_add_fetch(&s_seq, 1, __ATOMIC_SEQ_CST);
+    return e->resultado;
+}
+
+// arranque_fn_t no lleva argumento: una función por índice
+#define ETAPA(i) static esp_err_t etapa_##i(void) { return ejecutar(i); }
+ETAPA(0) ETAPA(1) ETAPA(2) ETAPA(3) ETAPA(4) ETAPA(5) ETAPA(6) ETAPA(7)
+ETAPA(8) ETAPA(9) ETAPA(10) ETAPA(11) ETAPA(12) ETAPA(13) ETAPA(14) ETAPA(15)
+
+static const arranque_fn_t s_fn[ARRANQUE_MAX_ETAPAS] = {
+    etapa_0, etapa_1, etapa_2, etapa_3, etapa_4, etapa_5, etapa_6, etapa_7,
+    etapa_8, etapa_9, etapa_10, etapa_11, etapa_12, etapa_13, etapa_14, etapa_15,
+};
+
+static void reiniciar(void)
+{
+    memset(s_prueba, 0, sizeof(s_prueba));
+    s_seq = s_en_curso = s_max_en_curso = 0;
+}
+
+/*
+ * Invariantes de cualquier arranque: todo termina, una etapa ejecutada empezó
+ * después de todas sus dependencias y con las imprescindibles en OK, y una
+ * omitida no se llamó. Devuelve si alguna etapa crítica falló.
+ */
+static bool comprobar_invariantes(const arranque_etapa_t *etapas, size_t num)
+{
+    bool fallo_critico = false;
+    for (size_t i = 0; i < num; i++) {
+        const arranque_registro_t *r = arranque_obtener_registro(i);
+        const etapa_prueba_t *e = &s_prueba[i];
+        COMPROBAR(r != NULL);
+        COMPROBAR(r->estado == ARRANQUE_OK || r->estado == ARRANQUE_FALLIDA || r->estado == ARRANQUE_OMITIDA);
+        COMPROBAR(r->fin_us >= r->inicio_us);
+        COMPROBAR(e->llamadas <= 1);
+        if (r->estado == ARRANQUE_FALLIDA && etapas[i].critica) {
+            fallo_critico = true;
+        }
+        if (e->llamadas == 0) {
+            COMPROBAR_IGUAL(r->estado, ARRANQUE_OMITIDA);
+            COMPROBAR_IGUAL(r->error, ESP_OK);
+            continue;
+        }
+        COMPROBAR_IGUAL(r->error, e->resultado);
+        for (size_t j = 0; j < num; j++) {
+            if (((etapas[i].requiere | etapas[i].despues_de) & ARRANQUE_DEP(j)) == 0) {
+                continue;
+            }
+            const arranque_registro_t *dep = arranque_obtener_registro(j);
+            COMPROBAR(s_prueba[j].llamadas == 0 || s_prueba[j].fin_seq < e->inicio_seq);
+            COMPROBAR(dep->fin_us <= r->inicio_us);
+            if (etapas[i].requiere & ARRANQUE_DEP(j)) {
+                COMPROBAR_IGUAL(dep->estado, ARRANQUE_OK);
+            }
+        }
+    }
+    COMPROBAR(arranque_obtener_registro(num) == NULL);
+    COMPROBAR(s_max_en_curso <= ARRANQUE_TRABAJADORES);
+    return fallo_critico;
+}
+
+// El grafo de app_inicializacion.c, con duraciones de orden realista divididas entre 10
+enum {
+    E_NVS, E_LED, E_RELE, E_BOTON, E_CERTIFICADOS, E_WIFI, E_CONEXION, E_NTP, E_MQTT, E_MODO, NUM_E
+};
+
+static const arranque_etapa_t s_firmware[NUM_E] = {
+    [E_NVS]          = {"NVS", etapa_0, 0, 0, true},
+    [E_LED]          = {"LED", etapa_1, 0, 0, true},
+    [E_RELE]         = {"RELE", etapa_2, 0, 0, true},
+    [E_BOTON]        = {"BOTON", etapa_3, ARRANQUE_DEP(E_NVS), 0, true},
+    [E_CERTIFICADOS] = {"CERTIFICADOS", etapa_4, 0, 0, false},
+    [E_WIFI]         = {"WIFI", etapa_5, ARRANQUE_DEP(E_NVS), 0, false},
+    [E_CONEXION]     = {"CONEXION", etapa_6, ARRANQUE_DEP(E_WIFI), 0, false},
+    [E_NTP]          = {"NTP", etapa_7, ARRANQUE_DEP(E_CONEXION), 0, false},
+    [E_MQTT]         = {"MQTT", etapa_8, ARRANQUE_DEP(E_WIFI), ARRANQUE_DEP(E_CERTIFICADOS), false},
+    [E_MODO]         = {"MODO", etapa_9, ARRANQUE_DEP(E_NVS) | ARRANQUE_DEP(E_LED) | ARRANQUE_DEP(E_RELE),
+                        ARRANQUE_DEP(E_MQTT), true},
+};
+
+static const uint32_t s_ms_firmware[NUM_E] = {
+    [E_NVS] = 4, [E_LED] = 1, [E_RELE] = 1, [E_BOTON] = 1, [E_CERTIFICADOS] = 2,
+    [E_WIFI] = 15, [E_CONEXION] = 250, [E_NTP] = 60, [E_MQTT] = 3, [E_MODO] = 40,
+};
+
+static void reiniciar_firmware(void)
+{
+    reiniciar();
+    for (int i = 0; i < NUM_E; i++) {
+        s_prueba[i].ms = s_ms_firmware[i];
+    }
+}
+
+/*
+ * El modo (escaneo BLE) queda listo mientras la conexión WiFi sigue en curso.
+ * Los tiempos impresos dependen de la carga del PC; solo se comprueba el orden.
+ */
+static void probar_firmware(void)
+{
+    reiniciar_firmware();
+    COMPROBAR(arranque_ejecutar(s_firmware, NUM_E) == ESP_OK);
+    COMPROBAR(!comprobar_invariantes(s_firmware, NUM_E));
+    for (int i = 0; i < NUM_E; i++) {
+        COMPROBAR_IGUAL(arranque_obtener_registro(i)->estado, ARRANQUE_OK);
+    }
+    COMPROBAR(s_max_en_curso >= 2);
+
+    const arranque_registro_t *modo = arranque_obtener_registro(E_MODO);
+    const arranque_registro_t *conexion = arranque_obtener_registro(E_CONEXION);
+    const arranque_registro_t *ntp = arranque_obtener_registro(E_NTP);
+    COMPROBAR(modo->fin_us < conexion->fin_us);
+
+    uint32_t serie_ms = 0;
+    for (int i = 0; i < NUM_E; i++) {
+        serie_ms += s_ms_firmware[i];
+    }
+    printf("arranque: modo listo en %lld ms, red y hora en %lld ms, %u ms en serie (host, duraciones /10)\n",
+           (long long)modo->fin_us / 1000, (long long)ntp->fin_us / 1000, serie_ms);
+}
+
+// Sin credenciales WIFI no aplica: la red se omite y el modo arranca igual
+static void probar_sin_credenciales(void)
+{
+    reiniciar_firmware();
+    s_prueba[E_WIFI].resultado = ESP_ERR_NOT_SUPPORTED;
+    COMPROBAR(arranque_ejecutar(s_firmware, NUM_E) == ESP_OK);
+    COMPROBAR(!comprobar_invariantes(s_firmware, NUM_E));
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_WIFI)->estado, ARRANQUE_OMITIDA);
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_WIFI)->error, ESP_ERR_NOT_SUPPORTED);
+    COMPROBAR_IGUAL(s_prueba[E_CONEXION].llamadas, 0);
+    COMPROBAR_IGUAL(s_prueba[E_NTP].llamadas, 0);
+    COMPROBAR_IGUAL(s_prueba[E_MQTT].llamadas, 0);
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_MODO)->estado, ARRANQUE_OK);
+}
+
+static void probar_fallos(void)
+{
+    // Un fallo no crítico en "despues_de" no impide la etapa: MQTT arranca sin certificados
+    reiniciar_firmware();
+    s_prueba[E_CERTIFICADOS].resultado = ESP_FAIL;
+    COMPROBAR(arranque_ejecutar(s_firmware, NUM_E) == ESP_OK);
+    COMPROBAR(!comprobar_invariantes(s_firmware, NUM_E));
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_CERTIFICADOS)->estado, ARRANQUE_FALLIDA);
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_MQTT)->estado, ARRANQUE_OK);
+
+    // Un fallo crítico se devuelve y el modo, que lo requiere, no se lanza
+    reiniciar_firmware();
+    s_prueba[E_RELE].resultado = ESP_ERR_TIMEOUT;
+    COMPROBAR(arranque_ejecutar(s_firmware, NUM_E) == ESP_ERR_TIMEOUT);
+    COMPROBAR(comprobar_invariantes(s_firmware, NUM_E));
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_RELE)->estado, ARRANQUE_FALLIDA);
+    COMPROBAR_IGUAL(s_prueba[E_MODO].llamadas, 0);
+    COMPROBAR_IGUAL(arranque_obtener_registro(E_MODO)->estado, ARRANQUE_OMITIDA);
+}
+
+static void probar_grafos_no_validos(void)
+{
+    arranque_etapa_t etapas[NUM_E];
+
+    reiniciar();
+    memcpy(etapas, s_firmware, sizeof(etapas));
+    etapas[E_NVS].requiere = ARRANQUE_DEP(E_MODO);      // NVS -> MODO -> NVS
+    COMPROBAR(arranque_ejecutar(etapas, NUM_E) == ESP_ERR_INVALID_ARG);
+
+    memcpy(etapas, s_firmware, sizeof(etapas));
+    etapas[E_NTP].despues_de = ARRANQUE_DEP(E_NTP);
+    COMPROBAR(arranque_ejecutar(etapas, NUM_E) == ESP_ERR_INVALID_ARG);
+
+    memcpy(etapas, s_firmware, sizeof(etapas));
+    etapas[E_MQTT].requiere |= ARRANQUE_DEP(NUM_E);
+    COMPROBAR(arranque_ejecutar(etapas, NUM_E) == ESP_ERR_INVALID_ARG);
+
+    memcpy(etapas, s_firmware, sizeof(etapas));
+    etapas[E_LED].fn = NULL;
+    COMPROBAR(arranque_ejecutar(etapas, NUM_E) == ESP_ERR_INVALID_ARG);
+
+    COMPROBAR(arranque_ejecutar(NULL, NUM_E) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(arranque_ejecutar(s_firmware, 0) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(arranque_ejecutar(s_firmware, ARRANQUE_MAX_ETAPAS + 1) == ESP_ERR_INVALID_ARG);
+
+    // Ninguna etapa se llamó
+    for (int i = 0; i < NUM_E; i++) {
+        COMPROBAR_IGUAL(s_prueba[i].llamadas, 0);
+    }
+}
+
+static uint32_t s_azar = 0x2545F491;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+/*
+ * Grafos acíclicos aleatorios de hasta ARRANQUE_MAX_ETAPAS etapas: cada una
+ * depende solo de etapas anteriores en un orden barajado, con duraciones de
+ * 0 a 2 ms y algún fallo u omisión.
+ */
+static void probar_grafos_aleatorios(void)
+{
+    arranque_etapa_t etapas[ARRANQUE_MAX_ETAPAS];
+    int orden[ARRANQUE_MAX_ETAPAS];
+    int fallos_criticos = 0, max_paralelo = 0;
+
+    for (int g = 0; g < GRAFOS_ALEATORIOS; g++) {
+        size_t num = 1 + azar() % ARRANQUE_MAX_ETAPAS;
+        reiniciar();
+        for (size_t i = 0; i < num; i++) {
+            orden[i] = (int)i;
+        }
+        for (size_t i = num - 1; i > 0; i--) {
+            size_t j = azar() % (i + 1);
+            int t = orden[i];
+            orden[i] = orden[j];
+            orden[j] = t;
+        }
+
+        bool critico = false;
+        for (size_t k = 0; k < num; k++) {
+            int i = orden[k];
+            etapas[i] = (arranque_etapa_t){ .nombre = "ALEATORIA", .fn = s_fn[i] };
+            for (size_t d = 0; d < k; d++) {
+                uint32_t r = azar() % 8;
+                if (r == 0) {
+                    etapas[i].requiere |= ARRANQUE_DEP(orden[d]);
+                } else if (r == 1) {
+                    etapas[i].despues_de |= ARRANQUE_DEP(orden[d]);
+                }
+            }
+            uint32_t r = azar() % 20;
+            s_prueba[i].ms = azar() % 3;
+            s_prueba[i].resultado = r == 0 ? ESP_FAIL : r == 1 ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+            etapas[i].critica = azar() % 4 == 0;
+            critico |= etapas[i].critica && s_prueba[i].resultado == ESP_FAIL;
+        }
+
+        esp_err_t ret = arranque_ejecutar(etapas, num);
+        bool fallo_critico = comprobar_invariantes(etapas, num);
+        COMPROBAR_IGUAL(ret, fallo_critico ? ESP_FAIL : ESP_OK);
+        // Sin fallo crítico se llama a toda etapa cuyas imprescindibles salieron bien
+        if (!critico) {
+            COMPROBAR(!fallo_critico);
+            uint32_t correctas = 0;
+            for (size_t j = 0; j < num; j++) {
+                if (arranque_obtener_registro(j)->estado == ARRANQUE_OK) {
+                    correctas |= ARRANQUE_DEP(j);
+                }
+            }
+            for (size_t i = 0; i < num; i++) {
+                COMPROBAR_IGUAL(s_prueba[i].llamadas, (etapas[i].requiere & ~correctas) == 0);
+            }
+        }
+        fallos_criticos += fallo_critico;
+        if (s_max_en_curso > max_paralelo) {
+            max_paralelo = s_max_en_curso;
+        }
+    }
+    COMPROBAR(fallos_criticos > 0);
+    COMPROBAR_IGUAL(max_paralelo, ARRANQUE_TRABAJADORES);
+}
+
+int main(void)
+{
+    alarm(60);  // Un trabajador que no ve el final cuelga la prueba
+    clock_gettime(CLOCK_MONOTONIC, &s_t0);
+    probar_firmware();
+    probar_sin_credenciales();
+    probar_fallos();
+    probar_grafos_no_validos();
+    probar_grafos_aleatorios();
+    printf("test_arranque: OK\n");
+    return 0;
+}
@@ -0,0 +1,347 @@
+// Modelo de ocupación: aprendizaje, persistencia y años de semanas frente al duty cycle fijo
+#include <string.h>
+#include "automatico_logica.h"
+#include "automatico_ocupacion.h"
+#include "prueba.h"
+
+#define SEMANAS                 1000
+#define SEMANAS_APRENDIZAJE     4           // No cuentan en las métricas
+#define TIMEOUT_MS              (10 * 60 * 1000LL)
+#define MINUTO_MS               (60 * 1000LL)
+#define HORA_MS                 (60 * MINUTO_MS)
+#define DIA_MS                  (24 * HORA_MS)
+#define SEMANA_MS               (7 * DIA_MS)
+#define MAX_PRESENCIAS          64
+
+/* ---- Aprendizaje y persistencia ---- */
+
+static void probar_aprendizaje(void)
+{
+    automatico_ocupacion_t modelo;
+    automatico_ocupacion_init(&modelo);
+
+    // A priori: entre ambos umbrales, duty cycle base en todas las horas
+    uint8_t prior = automatico_ocupacion_probabilidad(&modelo, 1, 8);
+    COMPROBAR(prior > AUTOMATICO_OCUPACION_UMBRAL_BAJO && prior < AUTOMATICO_OCUPACION_UMBRAL_ALTO);
+    COMPROBAR_IGUAL(automatico_ocupacion_pausa_ms(&modelo, 1, 8, 5000, 30000), 5000);
+    COMPROBAR(!modelo.sucio);
+
+    // El lunes a las 8 se llega; a las 3 de la madrugada nunca
+    for (int semana = 0; semana < 8; semana++) {
+        automatico_ocupacion_observar(&modelo, 1, 3, false);
+        automatico_ocupacion_observar(&modelo, 1, 8, false);
+        automatico_ocupacion_observar(&modelo, 1, 8, true);
+        automatico_ocupacion_observar(&modelo, 1, 9, false);    // Consolida las 8
+        if (semana == 0) {
+            // Una llegada basta para escanear sin pausas a esa hora
+            COMPROBAR_IGUAL(automatico_ocupacion_pausa_ms(&modelo, 1, 8, 5000, 30000), 0);
+            COMPROBAR(modelo.sucio);
+        }
+    }
+    COMPROBAR_IGUAL(automatico_ocupacion_pausa_ms(&modelo, 1, 8, 5000, 30000), 0);
+    COMPROBAR_IGUAL(automatico_ocupacion_pausa_ms(&modelo, 1, 3, 5000, 30000), 30000);
+    COMPROBAR(automatico_ocupacion_probabilidad(&modelo, 1, 8) > 90);
+    COMPROBAR(automatico_ocupacion_probabilidad(&modelo, 1, 3) <= AUTOMATICO_OCUPACION_UMBRAL_BAJO);
+
+    // Las horas no observadas (equipo apagado) conservan el a priori
+    COMPROBAR_IGUAL(automatico_ocupacion_probabilidad(&modelo, 2, 8), prior);
+    COMPROBAR_IGUAL(automatico_ocupacion_pausa_ms(&modelo, 7, 0, 5000, 30000), 5000);
+
+    // Una costumbre que cambia se olvida en unos meses
+    for (int semana = 0; semana < 16; semana++) {
+        automatico_ocupacion_observar(&modelo, 1, 8, false);
+        automatico_ocupacion_observar(&modelo, 1, 9, false);
+    }
+    COMPROBAR(automatico_ocupacion_probabilidad(&modelo, 1, 8) <= AUTOMATICO_OCUPACION_UMBRAL_BAJO);
+}
+
+static void probar_persistencia(void)
+{
+    automatico_ocupacion_t modelo, cargado;
+    automatico_ocupacion_init(&modelo);
+    automatico_ocupacion_observar(&modelo, 4, 18, true);
+    automatico_ocupacion_observar(&modelo, 4, 19, false);
+
+    automatico_ocupacion_init(&cargado);
+    COMPROBAR(automatico_ocupacion_cargar(&cargado, &modelo.tabla, sizeof(modelo.tabla)));
+    COMPROBAR(memcmp(&cargado.tabla, &modelo.tabla, sizeof(modelo.tabla)) == 0);
+    COMPROBAR(!cargado.sucio);
+
+    // Un blob de otra versión o de otro tamaño no toca el modelo
+    automatico_ocupacion_tabla_t otra = modelo.tabla;
+    otra.version++;
+    automatico_ocupacion_init(&cargado);
+    COMPROBAR(!automatico_ocupacion_cargar(&cargado, &otra, sizeof(otra)));
+    COMPROBAR(!automatico_ocupacion_cargar(&cargado, &modelo.tabla, sizeof(modelo.tabla) - 1));
+    COMPROBAR(!automatico_ocupacion_cargar(&cargado, NULL, sizeof(modelo.tabla)));
+    COMPROBAR_IGUAL(automatico_ocupacion_probabilidad(&cargado, 4, 18),
+                    automatico_ocupacion_probabilidad(&cargado, 0, 0));
+}
+
+/* ---- Reproducción ---- */
+
+typedef struct {
+    int64_t llegada_ms;         // Desde el inicio de la semana (lunes 00:00)
+    int64_t salida_ms;
+} presencia_t;
+
+typedef struct {
+    presencia_t presencias[MAX_PRESENCIAS];
+    int num;
+} semana_t;
+
+typedef struct {
+    uint32_t llegadas;
+    uint32_t llegadas_lentas;   // Detectadas tras más de la pausa base
+    int64_t latencia_suma_ms;
+    int64_t latencia_max_ms;
+    int64_t ausencia_ms;
+    int64_t escaneo_ms;
+    int64_t noche_ausencia_ms;  // 0:00 a 6:00
+    int64_t noche_escaneo_ms;
+    uint32_t escrituras;
+} metricas_t;
+
+// Estado de una estrategia a lo largo de todas las semanas
+typedef struct {
+    bool adaptativa;
+    automatico_ocupacion_t modelo;
+    int64_t ultimo_guardado_ms;
+    metricas_t m;
+    bool medir;
+} estrategia_t;
+
+static uint32_t s_azar = 1;
+
+static uint32_t azar(void)
+{
+    // xorshift32: misma secuencia en cualquier libc
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static int64_t entre(int64_t desde_ms, int64_t hasta_ms)
+{
+    return desde_ms + azar() % (uint32_t)(hasta_ms - desde_ms + 1);
+}
+
+static void agregar(semana_t *semana, int64_t llegada_ms, int64_t salida_ms)
+{
+    if (salida_ms > llegada_ms && semana->num < MAX_PRESENCIAS) {
+        semana->presencias[semana->num++] = (presencia_t){llegada_ms, salida_ms};
+    }
+}
+
+/*
+ * Semana de oficina: de lunes a viernes llegada entre las 7:30 y las 8:30,
+ * comida de 40 a 80 min hacia las 13:30, alguna pausa corta y salida entre las
+ * 17:30 y las 19:00. Algún sábado por la mañana se pasa un rato y alguna noche
+ * entra el vigilante: llegadas improbables que miden el peor caso.
+ */
+static void generar_semana(semana_t *semana)
+{
+    semana->num = 0;
+    for (int dia = 0; dia < 7; dia++) {
+        int64_t base = dia * DIA_MS;
+        // Se agregan en orden: la ronda de madrugada antes que la jornada
+        if (azar() % 50 == 0) {
+            int64_t ronda = base + entre(1 * HORA_MS, 5 * HORA_MS);
+            agregar(semana, ronda, ronda + entre(5 * MINUTO_MS, 15 * MINUTO_MS));
+        }
+        if (dia >= 5) {
+            if (dia == 5 && azar() % 10 == 0) {
+                int64_t visita = base + entre(10 * HORA_MS, 12 * HORA_MS);
+                agregar(semana, visita, visita + entre(30 * MINUTO_MS, 2 * HORA_MS));
+            }
+            continue;
+        }
+
+        int64_t llegada = base + entre(7 * HORA_MS + 30 * MINUTO_MS, 8 * HORA_MS + 30 * MINUTO_MS);
+        int64_t comida = base + entre(13 * HORA_MS, 14 * HORA_MS);
+        int64_t vuelta = comida + entre(40 * MINUTO_MS, 80 * MINUTO_MS);
+        int64_t salida = base + entre(17 * HORA_MS + 30 * MINUTO_MS, 19 * HORA_MS);
+        int64_t cafe = entre(llegada + HORA_MS, comida - HORA_MS);
+        int64_t cafe_fin = cafe + entre(10 * MINUTO_MS, 25 * MINUTO_MS);
+
+        agregar(semana, llegada, cafe);
+        agregar(semana, cafe_fin, comida);
+        agregar(semana, vuelta, salida);
+    }
+}
+
+// Día de la semana como tm_wday (0 = domingo) y hora, con el instante 0 un lunes a las 00:00
+static void slot(int64_t t_ms, uint8_t *dia, uint8_t *hora)
+{
+    *dia = (uint8_t)((1 + t_ms / DIA_MS) % 7);
+    *hora = (uint8_t)((t_ms % DIA_MS) / HORA_MS);
+}
+
+// Como actualizar_modelo_ocupacion() y guardar_modelo_ocupacion() de estado_automatico.c
+static uint32_t observar(estrategia_t *e, int64_t t_ms, bool llegada)
+{
+    if (!e->adaptativa) {
+        return AUTOMATICO_DUTY_PAUSA_MS;
+    }
+    uint8_t dia, hora;
+    slot(t_ms, &dia, &hora);
+    automatico_ocupacion_observar(&e->modelo, dia, hora, llegada);
+    if (e->modelo.sucio && t_ms - e->ultimo_guardado_ms >= AUTOMATICO_OCUPACION_GUARDADO_MS) {
+        e->modelo.sucio = false;
+        e->ultimo_guardado_ms = t_ms;
+        e->m.escrituras++;
+    }
+    return automatico_ocupacion_pausa_ms(&e->modelo, dia, hora,
+                                         AUTOMATICO_DUTY_PAUSA_MS, AUTOMATICO_OCUPACION_PAUSA_MAX_MS);
+}
+
+// Parte del intervalo entre las 0:00 y las 6:00
+static int64_t noche_ms(int64_t desde_ms, int64_t hasta_ms)
+{
+    int64_t total = 0;
+    for (int64_t t = desde_ms; t < hasta_ms;) {
+        int64_t fin_hora = (t / HORA_MS + 1) * HORA_MS;
+        int64_t fin = fin_hora < hasta_ms ? fin_hora : hasta_ms;
+        if ((t % DIA_MS) < 6 * HORA_MS) {
+            total += fin - t;
+        }
+        t = fin;
+    }
+    return total;
+}
+
+static void contar_escaneo(estrategia_t *e, int64_t desde_ms, int64_t hasta_ms)
+{
+    if (e->medir) {
+        e->m.escaneo_ms += hasta_ms - desde_ms;
+        e->m.noche_escaneo_ms += noche_ms(desde_ms, hasta_ms);
+    }
+}
+
+/*
+ * Relé apagado desde 'desde' hasta la llegada: el duty cycle de automatico_logica.c
+ * (el plazo de ausencia ya venció al apagar por timeout) pidiendo la pausa al
+ * modelo en cada cambio, como EVT_DUTY. La llegada se detecta al empezar el
+ * siguiente tramo de escaneo si cae en una pausa.
+ */
+static void ausencia(estrategia_t *e, int64_t desde_ms, int64_t llegada_ms)
+{
+    bool escaneando = true;
+    int64_t t = desde_ms;
+    int64_t deteccion = llegada_ms;
+    if (e->medir) {
+        e->m.ausencia_ms += llegada_ms - desde_ms;
+        e->m.noche_ausencia_ms += noche_ms(desde_ms, llegada_ms);
+    }
+
+    for (;;) {
+        uint32_t pausa = observar(e, t, false);
+        int64_t fin;
+        if (escaneando && pausa == 0) {
+            fin = t + AUTOMATICO_DUTY_ESCANEO_MS;
+        } else if (escaneando) {
+            escaneando = false;
+            fin = t + pausa;
+        } else {
+            escaneando = true;
+            fin = t + AUTOMATICO_DUTY_ESCANEO_MS;
+        }
+        if (escaneando) {
+            contar_escaneo(e, t, fin < llegada_ms ? fin : llegada_ms);
+        }
+        if (fin >= llegada_ms) {
+            deteccion = escaneando ? llegada_ms : fin;
+            break;
+        }
+        t = fin;
+    }
+
+    observar(e, deteccion, true);
+    if (e->medir) {
+        int64_t latencia = deteccion - llegada_ms;
+        e->m.llegadas++;
+        e->m.latencia_suma_ms += latencia;
+        if (latencia > e->m.latencia_max_ms) {
+            e->m.latencia_max_ms = latencia;
+        }
+        if (latencia > AUTOMATICO_DUTY_PAUSA_MS) {
+            e->m.llegadas_lentas++;
+        }
+    }
+}
+
+static void reproducir_semana(estrategia_t *e, const semana_t *semana, int64_t inicio_ms, int64_t *apagado_ms)
+{
+    for (int i = 0; i < semana->num; i++) {
+        int64_t llegada = inicio_ms + semana->presencias[i].llegada_ms;
+        int64_t salida = inicio_ms + semana->presencias[i].salida_ms;
+        // Una ausencia más corta que el timeout no llega a apagar el relé
+        if (llegada > *apagado_ms) {
+            ausencia(e, *apagado_ms, llegada);
+        }
+        *apagado_ms = salida + TIMEOUT_MS;
+    }
+}
+
+static void imprimir(const char *nombre, const metricas_t *m)
+{
+    printf("%-10s escaneo en ausencia %4.1f %% (noche %4.1f %%), %u llegadas: latencia media %5.2f s "
+           "máx %4.1f s, %4.2f %% por encima de la pausa base, %.2f escrituras NVS/día\n",
+           nombre, 100.0 * m->escaneo_ms / m->ausencia_ms, 100.0 * m->noche_escaneo_ms / m->noche_ausencia_ms,
+           m->llegadas, m->latencia_suma_ms / 1000.0 / m->llegadas, m->latencia_max_ms / 1000.0,
+           100.0 * m->llegadas_lentas / m->llegadas,
+           m->escrituras / ((SEMANAS - SEMANAS_APRENDIZAJE) * 7.0));
+}
+
+/*
+ * Las mismas semanas para el duty cycle fijo y el aprendido: el modelo tiene
+ * que escanear menos, sobre todo de noche, sin empeorar la latencia media.
+ */
+static void probar_reproduccion(void)
+{
+    static estrategia_t fija, adaptativa;
+    semana_t semana;
+    int64_t apagado_fija = 0, apagado_adaptativa = 0;
+
+    memset(&fija, 0, sizeof(fija));
+    memset(&adaptativa, 0, sizeof(adaptativa));
+    adaptativa.adaptativa = true;
+    automatico_ocupacion_init(&adaptativa.modelo);
+
+    s_azar = 2024;
+    for (int s = 0; s < SEMANAS; s++) {
+        generar_semana(&semana);
+        fija.medir = adaptativa.medir = s >= SEMANAS_APRENDIZAJE;
+        reproducir_semana(&fija, &semana, s * SEMANA_MS, &apagado_fija);
+        reproducir_semana(&adaptativa, &semana, s * SEMANA_MS, &apagado_adaptativa);
+    }
+    imprimir("fijo", &fija.m);
+    imprimir("aprendido", &adaptativa.m);
+
+    COMPROBAR_IGUAL(fija.m.llegadas, adaptativa.m.llegadas);
+    COMPROBAR(fija.m.llegadas > (SEMANAS - SEMANAS_APRENDIZAJE) * 15);
+
+    // Fijo: la mitad del tiempo y nunca más de una pausa
+    COMPROBAR(fija.m.latencia_max_ms <= AUTOMATICO_DUTY_PAUSA_MS);
+    COMPROBAR(fija.m.escaneo_ms * 100 / fija.m.ausencia_ms >= 49);
+
+    // Aprendido: menos de la mitad de radio, de noche menos de un tercio, y sin esperar a las horas habituales
+    COMPROBAR(adaptativa.m.escaneo_ms * 2 < fija.m.escaneo_ms);
+    COMPROBAR(adaptativa.m.noche_escaneo_ms * 3 < fija.m.noche_escaneo_ms);
+    COMPROBAR(adaptativa.m.latencia_suma_ms < fija.m.latencia_suma_ms);
+    COMPROBAR(adaptativa.m.latencia_max_ms <= AUTOMATICO_OCUPACION_PAUSA_MAX_MS);
+    COMPROBAR(adaptativa.m.llegadas_lentas * 20 < adaptativa.m.llegadas);
+
+    // Escrituras espaciadas: como mucho una cada AUTOMATICO_OCUPACION_GUARDADO_MS
+    COMPROBAR(adaptativa.m.escrituras <= (SEMANAS - SEMANAS_APRENDIZAJE) * SEMANA_MS / AUTOMATICO_OCUPACION_GUARDADO_MS);
+}
+
+int main(void)
+{
+    probar_aprendizaje();
+    probar_persistencia();
+    probar_reproduccion();
+    printf("test_automatico_ocupacion: OK\n");
+    return 0;
+}
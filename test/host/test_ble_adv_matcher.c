@@ -0,0 +1,388 @@
+// Reglas de contenido de anuncio: iBeacon, Eddystone-UID, fabricante con máscara, AD malformadas y paquetes por segundo
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "ble_adv_matcher.h"
+#include "prueba.h"
+
+#define PAQUETES_BENCH  (1 << 22)
+#define TRAZA           1024
+
+static ble_adv_matcher_t s_matcher;
+
+static const uint8_t UUID_OFICINA[16] = {
+    0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2, 0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0,
+};
+static const uint8_t ESPACIO[10] = { 0xED, 0xD1, 0xEB, 0xEA, 0xC0, 0x4E, 0x5D, 0xEF, 0xA0, 0x17 };
+static const uint8_t INSTANCIA[6] = { 0x0B, 0xDB, 0x87, 0x53, 0x9B, 0x67 };
+
+/*
+ * Página de guarda: el paquete se copia al final de una página seguida de otra
+ * sin permisos, así cualquier lectura más allá de la longitud aborta la prueba.
+ */
+static uint8_t *s_pagina;
+static long s_tam_pagina;
+
+static const uint8_t *al_borde(const uint8_t *datos, uint8_t longitud)
+{
+    uint8_t *destino = s_pagina + s_tam_pagina - longitud;
+    memcpy(destino, datos, longitud);
+    return destino;
+}
+
+static int buscar(const uint8_t *datos, uint8_t longitud)
+{
+    return ble_adv_matcher_buscar(&s_matcher, al_borde(datos, longitud), longitud);
+}
+
+// [flags][fabricante Apple: 02 15 uuid major minor tx]
+static uint8_t ibeacon(uint8_t *p, const uint8_t uuid[16], uint16_t major, uint16_t minor)
+{
+    uint8_t n = 0;
+    p[n++] = 2; p[n++] = 0x01; p[n++] = 0x06;
+    p[n++] = 26; p[n++] = 0xFF; p[n++] = 0x4C; p[n++] = 0x00; p[n++] = 0x02; p[n++] = 0x15;
+    memcpy(&p[n], uuid, 16);
+    n += 16;
+    p[n++] = major >> 8; p[n++] = major & 0xFF;
+    p[n++] = minor >> 8; p[n++] = minor & 0xFF;
+    p[n++] = 0xC5;
+    return n;
+}
+
+// [flags][lista de servicios FEAA][service data: AA FE 00 tx espacio instancia 00 00]
+static uint8_t eddystone_uid(uint8_t *p, const uint8_t espacio[10], const uint8_t instancia[6])
+{
+    uint8_t n = 0;
+    p[n++] = 2; p[n++] = 0x01; p[n++] = 0x06;
+    p[n++] = 3; p[n++] = 0x03; p[n++] = 0xAA; p[n++] = 0xFE;
+    p[n++] = 23; p[n++] = 0x16; p[n++] = 0xAA; p[n++] = 0xFE; p[n++] = 0x00; p[n++] = 0xEB;
+    memcpy(&p[n], espacio, 10);
+    n += 10;
+    memcpy(&p[n], instancia, 6);
+    n += 6;
+    p[n++] = 0; p[n++] = 0;
+    return n;
+}
+
+static uint8_t fabricante(uint8_t *p, uint16_t company_id, const uint8_t *datos, uint8_t longitud)
+{
+    uint8_t n = 0;
+    p[n++] = 2; p[n++] = 0x01; p[n++] = 0x06;
+    p[n++] = 3 + longitud; p[n++] = 0xFF; p[n++] = company_id & 0xFF; p[n++] = company_id >> 8;
+    if (longitud > 0) {
+        memcpy(&p[n], datos, longitud);
+    }
+    return n + longitud;
+}
+
+static void compilar_reglas(void)
+{
+    ble_adv_regla_t reglas[6] = {0};
+
+    reglas[0].tipo = BLE_ADV_REGLA_IBEACON;
+    reglas[0].target_idx = 1;
+    memcpy(reglas[0].ibeacon.uuid, UUID_OFICINA, 16);
+    reglas[0].ibeacon.major = 100;
+    reglas[0].ibeacon.minor = 7;
+
+    // Mismo UUID, cualquier minor del major 200
+    reglas[1].tipo = BLE_ADV_REGLA_IBEACON;
+    reglas[1].target_idx = 2;
+    memcpy(reglas[1].ibeacon.uuid, UUID_OFICINA, 16);
+    reglas[1].ibeacon.major = 200;
+    reglas[1].ibeacon.minor = -1;
+
+    reglas[2].tipo = BLE_ADV_REGLA_EDDYSTONE_UID;
+    reglas[2].target_idx = 3;
+    memcpy(reglas[2].eddystone.espacio, ESPACIO, 10);
+    memcpy(reglas[2].eddystone.instancia, INSTANCIA, 6);
+
+    // Cualquier instancia de otro namespace
+    reglas[3].tipo = BLE_ADV_REGLA_EDDYSTONE_UID;
+    reglas[3].target_idx = 4;
+    memcpy(reglas[3].eddystone.espacio, ESPACIO, 10);
+    reglas[3].eddystone.espacio[9] ^= 0xFF;
+    reglas[3].eddystone.cualquier_instancia = true;
+
+    // Company 0x0059 con el nibble alto del primer byte a 0xA y el tercero exacto
+    reglas[4].tipo = BLE_ADV_REGLA_FABRICANTE;
+    reglas[4].target_idx = 5;
+    reglas[4].fabricante.company_id = 0x0059;
+    reglas[4].fabricante.longitud = 3;
+    reglas[4].fabricante.datos[0] = 0xA0;
+    reglas[4].fabricante.mascara[0] = 0xF0;
+    reglas[4].fabricante.datos[2] = 0x42;
+    reglas[4].fabricante.mascara[2] = 0xFF;
+
+    // Solo company ID; índice por encima de 255
+    reglas[5].tipo = BLE_ADV_REGLA_FABRICANTE;
+    reglas[5].target_idx = 300;
+    reglas[5].fabricante.company_id = 0x0822;
+
+    COMPROBAR_IGUAL(ble_adv_matcher_compilar(&s_matcher, reglas, 6), ESP_OK);
+}
+
+static void probar_ibeacon(void)
+{
+    uint8_t p[64];
+    uint8_t n;
+    uint8_t otro[16];
+
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    COMPROBAR_IGUAL(buscar(p, n), 1);
+    n = ibeacon(p, UUID_OFICINA, 100, 8);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    n = ibeacon(p, UUID_OFICINA, 200, 0);
+    COMPROBAR_IGUAL(buscar(p, n), 2);
+    n = ibeacon(p, UUID_OFICINA, 200, 0xFFFF);
+    COMPROBAR_IGUAL(buscar(p, n), 2);
+    n = ibeacon(p, UUID_OFICINA, 201, 7);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    // major/minor van en big endian: 0x0064 y 0x6400 no son el mismo
+    n = ibeacon(p, UUID_OFICINA, 0x6400, 7);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    memcpy(otro, UUID_OFICINA, 16);
+    otro[15] ^= 0x01;
+    n = ibeacon(p, otro, 100, 7);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    // Subtipo o longitud de iBeacon distintos: no es un iBeacon
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    p[7] = 0x03;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    p[8] = 0x14;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    // Sin el byte de potencia final (24 bytes de payload) ya no es válido
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    p[3] = 25;
+    COMPROBAR_IGUAL(buscar(p, n - 1), -1);
+}
+
+static void probar_eddystone(void)
+{
+    uint8_t p[64];
+    uint8_t n;
+    uint8_t instancia[6];
+
+    n = eddystone_uid(p, ESPACIO, INSTANCIA);
+    COMPROBAR_IGUAL(buscar(p, n), 3);
+
+    memcpy(instancia, INSTANCIA, 6);
+    instancia[5] ^= 0x01;
+    n = eddystone_uid(p, ESPACIO, instancia);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    uint8_t espacio[10];
+    memcpy(espacio, ESPACIO, 10);
+    espacio[9] ^= 0xFF;
+    n = eddystone_uid(p, espacio, instancia);
+    COMPROBAR_IGUAL(buscar(p, n), 4);
+
+    // Los dos bytes reservados son opcionales: 20 bytes de payload bastan
+    n = eddystone_uid(p, ESPACIO, INSTANCIA);
+    p[7] = 21;
+    COMPROBAR_IGUAL(buscar(p, n - 2), 3);
+
+    // Con 19 falta el último byte de la instancia
+    p[7] = 20;
+    COMPROBAR_IGUAL(buscar(p, n - 3), -1);
+
+    // Trama TLM (0x20) con el mismo contenido: no es UID
+    n = eddystone_uid(p, ESPACIO, INSTANCIA);
+    p[11] = 0x20;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    // Otro UUID de servicio
+    n = eddystone_uid(p, ESPACIO, INSTANCIA);
+    p[9] = 0xAB;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+}
+
+static void probar_fabricante(void)
+{
+    uint8_t p[64];
+    uint8_t n;
+
+    n = fabricante(p, 0x0059, (const uint8_t[]){ 0xA7, 0x00, 0x42 }, 3);
+    COMPROBAR_IGUAL(buscar(p, n), 5);
+    // El byte sin máscara puede valer cualquier cosa
+    n = fabricante(p, 0x0059, (const uint8_t[]){ 0xAF, 0x99, 0x42, 0x01 }, 4);
+    COMPROBAR_IGUAL(buscar(p, n), 5);
+    // Nibble alto distinto o tercer byte distinto
+    n = fabricante(p, 0x0059, (const uint8_t[]){ 0xB7, 0x00, 0x42 }, 3);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    n = fabricante(p, 0x0059, (const uint8_t[]){ 0xA7, 0x00, 0x43 }, 3);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    // Datos más cortos que la regla
+    n = fabricante(p, 0x0059, (const uint8_t[]){ 0xA7, 0x00 }, 2);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    // Company ID con los bytes al revés
+    n = fabricante(p, 0x5900, (const uint8_t[]){ 0xA7, 0x00, 0x42 }, 3);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+
+    // Regla solo de company ID, sin datos detrás
+    n = fabricante(p, 0x0822, NULL, 0);
+    COMPROBAR_IGUAL(buscar(p, n), 300);
+
+    // La estructura que coincide puede ir después de otras
+    uint8_t q[64];
+    uint8_t m = 0;
+    q[m++] = 5; q[m++] = 0x09; memcpy(&q[m], "Tag1", 4); m += 4;
+    m += fabricante(&q[m], 0x0822, NULL, 0);
+    COMPROBAR_IGUAL(buscar(q, m), 300);
+
+    // iBeacon con UUID desconocido: tampoco coincide como dato de fabricante
+    n = ibeacon(p, (const uint8_t[16]){0}, 1, 1);
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+}
+
+/*
+ * AD malformadas: el recorrido debe pararse sin leer fuera del buffer
+ * (la página de guarda lo comprobaría) y sin devolver coincidencias falsas.
+ */
+static void probar_malformados(void)
+{
+    uint8_t p[64];
+    uint8_t n;
+
+    COMPROBAR_IGUAL(ble_adv_matcher_buscar(&s_matcher, NULL, 0), -1);
+    COMPROBAR_IGUAL(buscar(p, 0), -1);
+
+    // Solo el byte de longitud, o longitud y tipo sin payload
+    p[0] = 5;
+    COMPROBAR_IGUAL(buscar(p, 1), -1);
+    p[0] = 1; p[1] = 0xFF;
+    COMPROBAR_IGUAL(buscar(p, 2), -1);
+
+    // Estructura de longitud 0: el resto es relleno y no se analiza
+    n = fabricante(&p[1], 0x0822, NULL, 0);
+    p[0] = 0;
+    COMPROBAR_IGUAL(buscar(p, n + 1), -1);
+
+    // Estructura válida seguida de relleno a cero: se encuentra igualmente
+    n = fabricante(p, 0x0822, NULL, 0);
+    memset(&p[n], 0, 10);
+    COMPROBAR_IGUAL(buscar(p, n + 10), 300);
+
+    // Longitud que rebasa el buffer en la primera y en la última estructura
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    p[3] = 200;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    p[0] = 0xFF;
+    COMPROBAR_IGUAL(buscar(p, n), -1);
+    n = ibeacon(p, UUID_OFICINA, 100, 7);
+    COMPROBAR_IGUAL(buscar(p, n - 1), -1);
+
+    // Eddystone truncado en cada posición posible
+    n = eddystone_uid(p, ESPACIO, INSTANCIA);
+    for (uint8_t corte = 0; corte < n - 2; corte++) {
+        COMPROBAR_IGUAL(buscar(p, corte), -1);
+    }
+
+    // Buffer lleno de 0xFF (longitudes máximas) y de basura aleatoria
+    memset(p, 0xFF, sizeof(p));
+    COMPROBAR_IGUAL(buscar(p, 31), -1);
+    uint32_t azar = 0xC0FFEEu;
+    for (int i = 0; i < 200000; i++) {
+        uint8_t longitud = azar % 32;
+        for (int j = 0; j < longitud; j++) {
+            azar ^= azar << 13;
+            azar ^= azar >> 17;
+            azar ^= azar << 5;
+            p[j] = (uint8_t)azar;
+        }
+        int idx = buscar(p, longitud);
+        COMPROBAR(idx == -1 || idx == 5 || idx == 300);
+    }
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Mezcla de una oficina: la mayoría son anuncios de teléfonos (Apple
+ * Continuity, Microsoft, nombre) que no coinciden; algunos iBeacon y
+ * Eddystone propios y ajenos.
+ */
+static void medir(void)
+{
+    static uint8_t paquetes[TRAZA][31];
+    static uint8_t longitudes[TRAZA];
+    uint32_t azar = 12345;
+    int esperados = 0;
+
+    for (int i = 0; i < TRAZA; i++) {
+        uint8_t *p = paquetes[i];
+        azar ^= azar << 13;
+        azar ^= azar >> 17;
+        azar ^= azar << 5;
+        switch (azar % 10) {
+            case 0:
+                longitudes[i] = ibeacon(p, UUID_OFICINA, 100, 7);
+                esperados++;
+                break;
+            case 1:
+                longitudes[i] = ibeacon(p, UUID_OFICINA, 300, 7);
+                break;
+            case 2:
+                longitudes[i] = eddystone_uid(p, ESPACIO, INSTANCIA);
+                esperados++;
+                break;
+            case 3:
+                longitudes[i] = fabricante(p, 0x0006, (const uint8_t[]){ 0x01, 0x09, 0x20, 0x02 }, 4);
+                break;
+            default:
+                // Apple Continuity: tipo 0x10 (Nearby Info)
+                longitudes[i] = fabricante(p, 0x004C, (const uint8_t[]){ 0x10, 0x05, 0x03, 0x1C, 0x6A, 0x2F, 0x11 }, 7);
+                break;
+        }
+    }
+
+    volatile int aciertos = 0;
+    double t0 = ahora_s();
+    for (int i = 0; i < PAQUETES_BENCH; i++) {
+        aciertos += ble_adv_matcher_buscar(&s_matcher, paquetes[i % TRAZA], longitudes[i % TRAZA]) >= 0;
+    }
+    double t1 = ahora_s();
+
+    COMPROBAR_IGUAL(aciertos, esperados * (PAQUETES_BENCH / TRAZA));
+    printf("reglas de anuncio (%d reglas): %.1f M paquetes/s, %.0f ns por paquete (host)\n",
+           s_matcher.num_reglas, PAQUETES_BENCH / (t1 - t0) / 1e6, (t1 - t0) / PAQUETES_BENCH * 1e9);
+}
+
+int main(void)
+{
+    s_tam_pagina = sysconf(_SC_PAGESIZE);
+    s_pagina = mmap(NULL, 2 * s_tam_pagina, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    COMPROBAR(s_pagina != MAP_FAILED);
+    COMPROBAR_IGUAL(mprotect(s_pagina + s_tam_pagina, s_tam_pagina, PROT_NONE), 0);
+
+    ble_adv_regla_t demasiadas[BLE_ADV_MAX_REGLAS + 1] = {0};
+    COMPROBAR_IGUAL(ble_adv_matcher_compilar(&s_matcher, demasiadas, BLE_ADV_MAX_REGLAS + 1),
+                    ESP_ERR_INVALID_SIZE);
+
+    compilar_reglas();
+    probar_ibeacon();
+    probar_eddystone();
+    probar_fabricante();
+    probar_malformados();
+    medir();
+
+    ble_adv_matcher_limpiar(&s_matcher);
+    uint8_t p[64];
+    COMPROBAR_IGUAL(buscar(p, ibeacon(p, UUID_OFICINA, 100, 7)), -1);
+
+    printf("test_ble_adv_matcher: OK\n");
+    return 0;
+}
@@ -0,0 +1,285 @@
+// Resolución de RPA: vector de la especificación, caché LRU y trazas sintéticas de rotación
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "ble_rpa_resolver.h"
+#include "prueba.h"
+
+#define TRAZA_SEGUNDOS      3600
+#define ROTACION_S          (15 * 60)   // Periodo típico de rotación de iOS y Android
+#define MAX_DISPOSITIVOS    64
+
+static ble_rpa_resolver_t s_resolver;
+
+static uint32_t s_azar = 0x2545F491u;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * RPA válida para un IRK, calculada aparte del resolvedor: prand con los dos
+ * bits altos a 01 y hash = ah(IRK, prand). Dirección en orden NimBLE.
+ */
+static void generar_rpa(const uint8_t irk[16], uint8_t addr[6])
+{
+    mbedtls_aes_context aes;
+    uint8_t entrada[16] = {0};
+    uint8_t salida[16];
+    uint32_t prand = (azar() & 0x3FFFFF) | 0x400000;
+
+    entrada[13] = (uint8_t)(prand >> 16);
+    entrada[14] = (uint8_t)(prand >> 8);
+    entrada[15] = (uint8_t)prand;
+    mbedtls_aes_init(&aes);
+    COMPROBAR_IGUAL(mbedtls_aes_setkey_enc(&aes, irk, 128), 0);
+    COMPROBAR_IGUAL(mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, entrada, salida), 0);
+    mbedtls_aes_free(&aes);
+
+    addr[5] = entrada[13];
+    addr[4] = entrada[14];
+    addr[3] = entrada[15];
+    addr[2] = salida[13];
+    addr[1] = salida[14];
+    addr[0] = salida[15];
+}
+
+// RPA de otro dispositivo: formato válido, hash al azar
+static void generar_rpa_ajena(uint8_t addr[6])
+{
+    uint32_t a = azar(), b = azar();
+    memcpy(addr, &a, 4);
+    memcpy(addr + 4, &b, 2);
+    addr[5] = (addr[5] & 0x3F) | 0x40;
+}
+
+static void probar_aes(void)
+{
+    // FIPS-197, apéndice C.1: comprueba el doble de AES antes de usarlo
+    static const uint8_t clave[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    };
+    static const uint8_t claro[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+    };
+    static const uint8_t cifrado[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+    };
+    mbedtls_aes_context aes;
+    uint8_t salida[16];
+
+    mbedtls_aes_init(&aes);
+    COMPROBAR_IGUAL(mbedtls_aes_setkey_enc(&aes, clave, 128), 0);
+    COMPROBAR_IGUAL(mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, claro, salida), 0);
+    COMPROBAR(memcmp(salida, cifrado, 16) == 0);
+    mbedtls_aes_free(&aes);
+}
+
+/*
+ * Bluetooth Core, Vol 3, Part H, D.7 (función ah): IRK ec0234a357c8ad05341010a60a397d9b
+ * y prand 708194 dan hash 0dfbaa. El IRK va MSB primero, como lo escribe la
+ * especificación; la RPA 70:81:94:0d:fb:aa llega de NimBLE con los bytes al revés.
+ */
+static void probar_vector_especificacion(void)
+{
+    static const uint8_t irk[16] = {
+        0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b,
+    };
+    uint8_t rpa[6] = { 0xaa, 0xfb, 0x0d, 0x94, 0x81, 0x70 };
+    uint8_t irk_invertido[16];
+
+    ble_rpa_resolver_init(&s_resolver);
+    COMPROBAR(ble_rpa_es_resoluble(rpa));
+    COMPROBAR_IGUAL(ble_rpa_resolver_agregar_irk(&s_resolver, 3, irk), ESP_OK);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, rpa), 3);
+    COMPROBAR_IGUAL(s_resolver.resoluciones_aes, 1);
+
+    // Un bit de diferencia en el hash o en prand ya no resuelve
+    rpa[0] ^= 0x01;
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, rpa), -1);
+    rpa[0] ^= 0x01;
+    rpa[3] ^= 0x01;
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, rpa), -1);
+    rpa[3] ^= 0x01;
+
+    // Con el IRK en orden LSB primero (como lo guarda NimBLE) tampoco
+    for (int i = 0; i < 16; i++) {
+        irk_invertido[i] = irk[15 - i];
+    }
+    COMPROBAR_IGUAL(ble_rpa_resolver_agregar_irk(&s_resolver, 3, irk_invertido), ESP_OK);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, rpa), -1);
+
+    ble_rpa_resolver_liberar(&s_resolver);
+}
+
+static void probar_cache(void)
+{
+    uint8_t irk[16];
+    uint8_t propia[6];
+    uint8_t ajenas[BLE_RPA_CACHE_SIZE + 1][6];
+
+    for (int i = 0; i < 16; i++) {
+        irk[i] = (uint8_t)azar();
+    }
+    ble_rpa_resolver_init(&s_resolver);
+    COMPROBAR_IGUAL(ble_rpa_resolver_agregar_irk(&s_resolver, 1, irk), ESP_OK);
+    generar_rpa(irk, propia);
+
+    // La segunda consulta de la misma dirección no cuesta AES, tampoco un rechazo
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, propia), 1);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, propia), 1);
+    generar_rpa_ajena(ajenas[0]);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[0]), -1);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[0]), -1);
+    COMPROBAR_IGUAL(s_resolver.consultas, 4);
+    COMPROBAR_IGUAL(s_resolver.aciertos_cache, 2);
+    COMPROBAR_IGUAL(s_resolver.resoluciones_aes, 2);
+    COMPROBAR_IGUAL(s_resolver.resueltas, 2);
+
+    // Llenar la caché: la dirección usada hace poco sobrevive, la más antigua sale
+    for (int i = 1; i < BLE_RPA_CACHE_SIZE - 1; i++) {
+        generar_rpa_ajena(ajenas[i]);
+        COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[i]), -1);
+    }
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, propia), 1);
+    generar_rpa_ajena(ajenas[BLE_RPA_CACHE_SIZE - 1]);
+    generar_rpa_ajena(ajenas[BLE_RPA_CACHE_SIZE]);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[BLE_RPA_CACHE_SIZE - 1]), -1);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[BLE_RPA_CACHE_SIZE]), -1);
+
+    uint32_t aes = s_resolver.resoluciones_aes;
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, propia), 1);
+    COMPROBAR_IGUAL(s_resolver.resoluciones_aes, aes);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, ajenas[0]), -1);
+    COMPROBAR_IGUAL(s_resolver.resoluciones_aes, aes + 1);
+
+    // Quitar el IRK invalida la caché: la dirección deja de resolver
+    ble_rpa_resolver_eliminar_irk(&s_resolver, 1);
+    COMPROBAR_IGUAL(s_resolver.num_irks, 0);
+    COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, propia), -1);
+
+    ble_rpa_resolver_liberar(&s_resolver);
+}
+
+typedef struct {
+    uint8_t addr[6];
+    int16_t esperado;
+} anuncio_t;
+
+typedef struct {
+    uint8_t irk[16];
+    int16_t objetivo;                 /**< -1 = dispositivo ajeno */
+    uint8_t rpa[6];
+    uint32_t proxima_rotacion;
+} dispositivo_t;
+
+static anuncio_t s_traza[TRAZA_SEGUNDOS * MAX_DISPOSITIVOS];
+
+/*
+ * Una hora de anuncios: cada dispositivo se oye una vez por segundo en orden
+ * aleatorio y rota su RPA cada 15 minutos con fase aleatoria. Los objetivos
+ * tienen IRK; el resto son teléfonos ajenos que también usan RPA.
+ */
+static int generar_traza(int num_objetivos, int num_ajenos)
+{
+    static dispositivo_t dispositivos[MAX_DISPOSITIVOS];
+    int orden[MAX_DISPOSITIVOS];
+    int total = num_objetivos + num_ajenos;
+    int n = 0;
+
+    COMPROBAR(num_objetivos <= BLE_RPA_MAX_IRKS && total <= MAX_DISPOSITIVOS);
+    ble_rpa_resolver_init(&s_resolver);
+    for (int d = 0; d < total; d++) {
+        dispositivo_t *disp = &dispositivos[d];
+        for (int i = 0; i < 16; i++) {
+            disp->irk[i] = (uint8_t)azar();
+        }
+        disp->objetivo = d < num_objetivos ? (int16_t)d : -1;
+        disp->proxima_rotacion = 0;
+        if (disp->objetivo >= 0) {
+            COMPROBAR_IGUAL(ble_rpa_resolver_agregar_irk(&s_resolver, (uint16_t)d, disp->irk), ESP_OK);
+        }
+        orden[d] = d;
+    }
+
+    for (uint32_t s = 0; s < TRAZA_SEGUNDOS; s++) {
+        for (int i = total - 1; i > 0; i--) {
+            int j = azar() % (i + 1);
+            int t = orden[i];
+            orden[i] = orden[j];
+            orden[j] = t;
+        }
+        for (int i = 0; i < total; i++) {
+            dispositivo_t *disp = &dispositivos[orden[i]];
+            if (s >= disp->proxima_rotacion) {
+                generar_rpa(disp->irk, disp->rpa);
+                disp->proxima_rotacion = s + (disp->proxima_rotacion == 0 ? 1 + azar() % ROTACION_S : ROTACION_S);
+            }
+            memcpy(s_traza[n].addr, disp->rpa, 6);
+            s_traza[n].esperado = disp->objetivo;
+            n++;
+        }
+    }
+    return n;
+}
+
+static double medir_traza(const char *nombre, int num_objetivos, int num_ajenos)
+{
+    int n = generar_traza(num_objetivos, num_ajenos);
+
+    double t0 = ahora_s();
+    for (int i = 0; i < n; i++) {
+        COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, s_traza[i].addr), s_traza[i].esperado);
+    }
+    double t1 = ahora_s();
+
+    COMPROBAR_IGUAL(s_resolver.consultas, n);
+    double tasa = (double)s_resolver.aciertos_cache / s_resolver.consultas;
+    uint32_t aes = s_resolver.resoluciones_aes;
+
+    // Referencia sin caché: cada anuncio prueba todos los IRK
+    ble_rpa_resolver_limpiar_cache(&s_resolver);
+    double t2 = ahora_s();
+    for (int i = 0; i < n; i++) {
+        ble_rpa_resolver_limpiar_cache(&s_resolver);
+        COMPROBAR_IGUAL(ble_rpa_resolver_buscar(&s_resolver, s_traza[i].addr), s_traza[i].esperado);
+    }
+    double t3 = ahora_s();
+
+    printf("%s (%d objetivos, %d ajenos, caché %d): aciertos de caché %.1f%%, %u AES en %d anuncios; "
+           "%.2f M resoluciones/s con caché, %.2f M sin caché (host)\n",
+           nombre, num_objetivos, num_ajenos, BLE_RPA_CACHE_SIZE, tasa * 100.0, (unsigned)aes, n,
+           n / (t1 - t0) / 1e6, n / (t3 - t2) / 1e6);
+
+    ble_rpa_resolver_liberar(&s_resolver);
+    return tasa;
+}
+
+int main(void)
+{
+    probar_aes();
+    probar_vector_especificacion();
+    probar_cache();
+
+    // Caben todos los dispositivos en la caché: solo fallan las rotaciones
+    double oficina = medir_traza("oficina", BLE_RPA_MAX_IRKS, 20);
+    COMPROBAR(oficina > 0.99);
+
+    // Más dispositivos que entradas y orden aleatorio: la LRU apenas ayuda
+    double vestibulo = medir_traza("vestíbulo", BLE_RPA_MAX_IRKS, 60);
+    COMPROBAR(vestibulo < oficina);
+
+    printf("test_ble_rpa_resolver: OK\n");
+    return 0;
+}
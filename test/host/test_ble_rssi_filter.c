@@ -0,0 +1,235 @@
+// Filtro de RSSI: convergencia del EMA, histéresis de zonas, muestras 127, reinicio y trazas de pasillo
+#include <math.h>
+#include <stdint.h>
+#include "ble_rssi_filter.h"
+#include "prueba.h"
+
+#define SHIFT       BLE_SCANNER_RSSI_EMA_SHIFT
+#define CERCA       BLE_SCANNER_RSSI_NEAR_DBM
+#define LEJOS       BLE_SCANNER_RSSI_FAR_DBM
+
+static uint32_t s_azar = 0x9E3779B9u;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static double gauss(void)
+{
+    double u1 = (azar() + 1.0) / 4294967297.0;
+    double u2 = (azar() + 1.0) / 4294967297.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void probar_convergencia(void)
+{
+    ble_rssi_filter_t f;
+    ble_rssi_filter_reset(&f);
+
+    // La primera muestra se toma tal cual y una entrada constante no deriva
+    ble_rssi_filter_actualizar(&f, -90, SHIFT, CERCA, LEJOS);
+    COMPROBAR_IGUAL(ble_rssi_filter_valor(&f), -90);
+    for (int i = 0; i < 100; i++) {
+        ble_rssi_filter_actualizar(&f, -90, SHIFT, CERCA, LEJOS);
+    }
+    COMPROBAR_IGUAL(ble_rssi_filter_valor(&f), -90);
+
+    // Escalón de 30 dB: se acerca sin pasarse y queda a menos de 1 dB del
+    // valor final en el número de muestras que predice alfa = 1/2^shift
+    int esperadas = (int)ceil(log(1.0 / 30.0) / log(1.0 - 1.0 / (1 << SHIFT)));
+    int anterior = -90;
+    int muestras = 0;
+    while (ble_rssi_filter_valor(&f) < -61) {
+        ble_rssi_filter_actualizar(&f, -60, SHIFT, CERCA, LEJOS);
+        int valor = ble_rssi_filter_valor(&f);
+        COMPROBAR(valor >= anterior && valor <= -60);
+        anterior = valor;
+        muestras++;
+        COMPROBAR(muestras <= esperadas + 1);
+    }
+    for (int i = 0; i < 100; i++) {
+        ble_rssi_filter_actualizar(&f, -60, SHIFT, CERCA, LEJOS);
+    }
+    COMPROBAR(ble_rssi_filter_valor(&f) >= -61 && ble_rssi_filter_valor(&f) <= -60);
+
+    // Y de vuelta hacia abajo, también sin rebasar
+    for (int i = 0; i < 100; i++) {
+        ble_rssi_filter_actualizar(&f, -95, SHIFT, CERCA, LEJOS);
+        COMPROBAR(ble_rssi_filter_valor(&f) >= -95);
+    }
+    COMPROBAR(ble_rssi_filter_valor(&f) <= -94);
+    printf("EMA shift %d: escalón de 30 dB a menos de 1 dB en %d muestras (previstas %d)\n",
+           SHIFT, muestras, esperadas);
+}
+
+/*
+ * Con shift 0 el valor filtrado es la muestra y se ve la histéresis sola:
+ * CERCA desde umbral_cerca inclusive, LEJOS por debajo de umbral_lejos.
+ */
+static void probar_histeresis(void)
+{
+    static const struct {
+        int8_t rssi;
+        ble_proximity_zone_t zona;
+    } pasos[] = {
+        { -75,       BLE_PROXIMITY_FAR  },  // Primera muestra en la banda: aún no está cerca
+        { CERCA - 1, BLE_PROXIMITY_FAR  },
+        { CERCA,     BLE_PROXIMITY_NEAR },
+        { -75,       BLE_PROXIMITY_NEAR },
+        { LEJOS,     BLE_PROXIMITY_NEAR },
+        { LEJOS - 1, BLE_PROXIMITY_FAR  },
+        { -75,       BLE_PROXIMITY_FAR  },
+        { CERCA - 1, BLE_PROXIMITY_FAR  },
+        { CERCA,     BLE_PROXIMITY_NEAR },
+        { -40,       BLE_PROXIMITY_NEAR },
+        { -100,      BLE_PROXIMITY_FAR  },
+    };
+    ble_rssi_filter_t f;
+
+    ble_rssi_filter_reset(&f);
+    COMPROBAR_IGUAL(f.zona, BLE_PROXIMITY_UNKNOWN);
+    for (size_t i = 0; i < sizeof(pasos) / sizeof(pasos[0]); i++) {
+        COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, pasos[i].rssi, 0, CERCA, LEJOS), pasos[i].zona);
+    }
+
+    // Fuera de la banda la primera muestra decide directamente
+    ble_rssi_filter_reset(&f);
+    COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, CERCA, SHIFT, CERCA, LEJOS), BLE_PROXIMITY_NEAR);
+    ble_rssi_filter_reset(&f);
+    COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, LEJOS - 1, SHIFT, CERCA, LEJOS), BLE_PROXIMITY_FAR);
+}
+
+static void probar_no_disponible(void)
+{
+    ble_rssi_filter_t f;
+    ble_rssi_filter_reset(&f);
+
+    // Sin medida antes de la primera muestra: ni inicializa ni decide zona
+    COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, BLE_RSSI_NO_DISPONIBLE, SHIFT, CERCA, LEJOS),
+                    BLE_PROXIMITY_UNKNOWN);
+    COMPROBAR(!f.inicializado);
+
+    ble_rssi_filter_actualizar(&f, -65, SHIFT, CERCA, LEJOS);
+    int32_t valor = f.valor_q8;
+
+    // Después tampoco arrastra el valor hacia +127 dBm ni cambia la zona
+    for (int i = 0; i < 50; i++) {
+        COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, BLE_RSSI_NO_DISPONIBLE, SHIFT, CERCA, LEJOS),
+                        BLE_PROXIMITY_NEAR);
+    }
+    COMPROBAR_IGUAL(f.valor_q8, valor);
+}
+
+/*
+ * ble_scanner reinicia el filtro al cambiar la MAC de un objetivo o tras un
+ * silencio largo: la primera muestra del nuevo dispositivo no se mezcla con
+ * el valor del anterior.
+ */
+static void probar_reinicio(void)
+{
+    ble_rssi_filter_t f;
+    ble_rssi_filter_reset(&f);
+
+    for (int i = 0; i < 50; i++) {
+        ble_rssi_filter_actualizar(&f, -50, SHIFT, CERCA, LEJOS);
+    }
+    COMPROBAR_IGUAL(f.zona, BLE_PROXIMITY_NEAR);
+
+    ble_rssi_filter_reset(&f);
+    COMPROBAR_IGUAL(f.zona, BLE_PROXIMITY_UNKNOWN);
+    COMPROBAR(!f.inicializado);
+    COMPROBAR_IGUAL(ble_rssi_filter_actualizar(&f, -92, SHIFT, CERCA, LEJOS), BLE_PROXIMITY_FAR);
+    COMPROBAR_IGUAL(ble_rssi_filter_valor(&f), -92);
+}
+
+/*
+ * Traza sintética de una tarjeta que se acerca al cuadro, se queda y se va:
+ * pérdidas log-distancia (-59 dBm a 1 m, n = 2.2), ruido de 4 dB, un 3% de
+ * desvanecimientos de 15 dB y un 2% de muestras sin RSSI (127).
+ */
+static int8_t muestra(double distancia_m)
+{
+    if (azar() % 100 < 2) {
+        return BLE_RSSI_NO_DISPONIBLE;
+    }
+    double rssi = -59.0 - 22.0 * log10(distancia_m) + 4.0 * gauss();
+    if (azar() % 100 < 3) {
+        rssi -= 15.0;
+    }
+    if (rssi < -110) {
+        rssi = -110;
+    }
+    return (int8_t)lround(rssi);
+}
+
+typedef struct {
+    int cambios;
+    int muestras_cerca;
+} resultado_traza_t;
+
+static resultado_traza_t reproducir(const int8_t *traza, int n, uint8_t shift)
+{
+    resultado_traza_t r = {0};
+    ble_rssi_filter_t f;
+    ble_rssi_filter_reset(&f);
+    ble_proximity_zone_t anterior = BLE_PROXIMITY_UNKNOWN;
+
+    for (int i = 0; i < n; i++) {
+        ble_proximity_zone_t zona = ble_rssi_filter_actualizar(&f, traza[i], shift, CERCA, LEJOS);
+        if (anterior != BLE_PROXIMITY_UNKNOWN && zona != anterior) {
+            r.cambios++;
+        }
+        r.muestras_cerca += zona == BLE_PROXIMITY_NEAR;
+        anterior = zona;
+    }
+    return r;
+}
+
+static void probar_trazas(void)
+{
+    enum { FASE = 300 };
+    static int8_t pasillo[3 * FASE];
+    static int8_t umbral[3 * FASE];
+
+    // Pasillo: de 12 m a 0.5 m, parado junto al cuadro y de vuelta a 12 m
+    for (int i = 0; i < FASE; i++) {
+        pasillo[i] = muestra(12.0 - 11.5 * i / FASE);
+        pasillo[FASE + i] = muestra(0.5);
+        pasillo[2 * FASE + i] = muestra(0.5 + 11.5 * i / FASE);
+    }
+    // Parado a la distancia de la banda de histéresis (-75 dBm de media)
+    double d_banda = pow(10.0, (-59.0 + 75.0) / 22.0);
+    for (int i = 0; i < 3 * FASE; i++) {
+        umbral[i] = muestra(d_banda);
+    }
+
+    resultado_traza_t crudo = reproducir(pasillo, 3 * FASE, 0);
+    resultado_traza_t filtrado = reproducir(pasillo, 3 * FASE, SHIFT);
+    printf("traza pasillo: %d cambios de zona sin filtro, %d con EMA shift %d; cerca %d/%d muestras\n",
+           crudo.cambios, filtrado.cambios, SHIFT, filtrado.muestras_cerca, 3 * FASE);
+    // Entra una vez y sale una vez; toda la fase junto al cuadro es CERCA
+    COMPROBAR(filtrado.cambios <= 2);
+    COMPROBAR(filtrado.muestras_cerca >= FASE);
+    COMPROBAR(crudo.cambios > filtrado.cambios);
+
+    crudo = reproducir(umbral, 3 * FASE, 0);
+    filtrado = reproducir(umbral, 3 * FASE, SHIFT);
+    printf("traza en la banda: %d cambios de zona sin filtro, %d con EMA shift %d\n",
+           crudo.cambios, filtrado.cambios, SHIFT);
+    COMPROBAR(filtrado.cambios * 5 <= crudo.cambios);
+}
+
+int main(void)
+{
+    probar_convergencia();
+    probar_histeresis();
+    probar_no_disponible();
+    probar_reinicio();
+    probar_trazas();
+    printf("test_ble_rssi_filter: OK\n");
+    return 0;
+}
@@ -0,0 +1,267 @@
+// Índice de objetivos BLE: búsquedas, colisiones de OUI y anuncios por segundo con 10, 100 y 1000 objetivos
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "prueba.h"
+
+// Se incluye el .c para medir el sondeo y el prefiltro con hash_direccion()
+#include "../../components/ble_scanner/ble_target_set.c"
+
+#define TRAZA               4096
+#define ANUNCIOS_BENCH      (TRAZA * 512)
+#define PROPORCION_OBJETIVO 20          // 1 de cada 20 anuncios es de un objetivo
+
+_Static_assert(BLE_SCANNER_MAX_TARGET_DEVICES >= 1000,
+               "la prueba se compila con CONFIG_BLE_SCANNER_MAX_TARGET_DEVICES=1000");
+
+static ble_target_set_t s_set;
+static uint8_t s_objetivos[BLE_SCANNER_MAX_TARGET_DEVICES][6];
+
+static uint32_t s_azar = 0x1234567u;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void direccion_aleatoria(uint8_t addr[6])
+{
+    uint32_t a = azar(), b = azar();
+    memcpy(addr, &a, 4);
+    memcpy(addr + 4, &b, 2);
+}
+
+/*
+ * Dirección con el OUI fijado; en orden NimBLE el OUI son los bytes 5..3 y
+ * la parte del fabricante los bytes 2..0.
+ */
+static void direccion_con_oui(uint8_t addr[6], uint32_t oui, uint32_t nic)
+{
+    addr[0] = nic & 0xFF;
+    addr[1] = (nic >> 8) & 0xFF;
+    addr[2] = (nic >> 16) & 0xFF;
+    addr[3] = oui & 0xFF;
+    addr[4] = (oui >> 8) & 0xFF;
+    addr[5] = (oui >> 16) & 0xFF;
+}
+
+/*
+ * Como el recorrido que hacía ble_app_scan_cb_s3 antes del índice, pero
+ * comparando los 6 bytes para que el resultado sea el mismo.
+ */
+static int buscar_lineal(const uint8_t addr[6], int num_objetivos)
+{
+    for (int i = 0; i < num_objetivos; i++) {
+        if (memcmp(s_objetivos[i], addr, 6) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Longitud máxima del sondeo lineal de las direcciones insertadas: con el
+ * índice al 50% como máximo debe mantenerse en unas pocas ranuras.
+ */
+static uint32_t sondeo_maximo(const ble_target_set_t *set, int num_objetivos)
+{
+    uint32_t maximo = 0;
+    for (int i = 0; i < num_objetivos; i++) {
+        uint32_t lo;
+        uint16_t hi;
+        empaquetar_direccion(s_objetivos[i], &lo, &hi);
+        uint32_t pos = (hash_direccion(lo, hi) >> 8) & SLOT_MASK;
+        uint32_t n = 1;
+        while (set->slots[pos].addr_lo != lo || set->slots[pos].addr_hi != hi) {
+            pos = (pos + 1) & SLOT_MASK;
+            n++;
+        }
+        if (n > maximo) {
+            maximo = n;
+        }
+    }
+    return maximo;
+}
+
+static void cargar(int num_objetivos)
+{
+    ble_target_set_limpiar(&s_set);
+    for (int i = 0; i < num_objetivos; i++) {
+        COMPROBAR_IGUAL(ble_target_set_insertar(&s_set, s_objetivos[i], (uint16_t)i), ESP_OK);
+    }
+    COMPROBAR_IGUAL(s_set.num_entradas, num_objetivos);
+}
+
+static void probar_busqueda(void)
+{
+    uint8_t addr[6] = {0};
+
+    ble_target_set_limpiar(&s_set);
+    COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, addr), -1);
+
+    for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+        direccion_aleatoria(s_objetivos[i]);
+    }
+    cargar(BLE_SCANNER_MAX_TARGET_DEVICES);
+    for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+        COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, s_objetivos[i]), i);
+    }
+
+    // Índices por encima de 255: antes se truncaban a uint8_t
+    COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, s_objetivos[999]), 999);
+
+    // Insertar una dirección existente actualiza el índice sin ocupar otra ranura
+    COMPROBAR_IGUAL(ble_target_set_insertar(&s_set, s_objetivos[7], 500), ESP_OK);
+    COMPROBAR_IGUAL(s_set.num_entradas, BLE_SCANNER_MAX_TARGET_DEVICES);
+    COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, s_objetivos[7]), 500);
+
+    // Ninguna dirección ajena se confunde con un objetivo
+    for (int i = 0; i < 100000; i++) {
+        direccion_aleatoria(addr);
+        if (buscar_lineal(addr, BLE_SCANNER_MAX_TARGET_DEVICES) < 0) {
+            COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, addr), -1);
+        }
+    }
+
+    // Un solo bit de diferencia en cualquier byte no acierta
+    for (int byte = 0; byte < 6; byte++) {
+        memcpy(addr, s_objetivos[3], 6);
+        addr[byte] ^= 0x01;
+        COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, addr), -1);
+    }
+
+    // Lleno: el índice rechaza más direcciones de las que tiene ranuras
+    ble_target_set_limpiar(&s_set);
+    int insertadas = 0;
+    for (int i = 0; i < BLE_TARGET_SET_SLOTS + 1; i++) {
+        direccion_con_oui(addr, 0xABCDEF, (uint32_t)i);
+        if (ble_target_set_insertar(&s_set, addr, 0) == ESP_OK) {
+            insertadas++;
+        }
+    }
+    COMPROBAR_IGUAL(insertadas, BLE_TARGET_SET_SLOTS);
+    direccion_con_oui(addr, 0xABCDEF, BLE_TARGET_SET_SLOTS + 7);
+    COMPROBAR_IGUAL(ble_target_set_insertar(&s_set, addr, 0), ESP_ERR_NO_MEM);
+}
+
+/*
+ * Un despliegue típico: cientos de tarjetas del mismo fabricante con números
+ * de serie consecutivos. Con el mac_hash de 4 bytes todas compartían prefijo;
+ * con el hash de 48 bits deben repartirse por el índice igual que al azar.
+ */
+static void probar_colisiones_oui(void)
+{
+    static const uint32_t ouis[] = { 0xA4C138, 0xC8FD19, 0xD0F01A };
+    uint8_t addr[6];
+
+    for (int o = 0; o < 3; o++) {
+        for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+            direccion_con_oui(s_objetivos[i], ouis[o], 0x100000u + (uint32_t)i);
+        }
+        cargar(BLE_SCANNER_MAX_TARGET_DEVICES);
+        for (int i = 0; i < BLE_SCANNER_MAX_TARGET_DEVICES; i++) {
+            COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, s_objetivos[i]), i);
+        }
+
+        // Vecinos con el mismo OUI y número de serie fuera de la lista
+        int falsos_prefiltro = 0;
+        for (uint32_t i = 0; i < 10000; i++) {
+            direccion_con_oui(addr, ouis[o], 0x200000u + i);
+            COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, addr), -1);
+            uint32_t lo;
+            uint16_t hi;
+            empaquetar_direccion(addr, &lo, &hi);
+            falsos_prefiltro += prefiltro_contiene(&s_set, hash_direccion(lo, hi));
+        }
+
+        uint32_t sondeo = sondeo_maximo(&s_set, BLE_SCANNER_MAX_TARGET_DEVICES);
+        printf("OUI %06X: %d objetivos consecutivos, sondeo máximo %u ranuras, "
+               "prefiltro deja pasar %.1f%% de los vecinos\n",
+               (unsigned)ouis[o], BLE_SCANNER_MAX_TARGET_DEVICES, (unsigned)sondeo,
+               falsos_prefiltro / 100.0);
+        COMPROBAR(sondeo <= 16);
+        COMPROBAR(falsos_prefiltro < 10000 / 4);
+    }
+
+    // Mismo caso con el antiguo prefijo de 4 bytes: todas las direcciones
+    // que solo difieren en los bytes 4..5 siguen siendo distintas
+    ble_target_set_limpiar(&s_set);
+    for (int i = 0; i < 256; i++) {
+        addr[0] = 0x11; addr[1] = 0x22; addr[2] = 0x33; addr[3] = 0x44;
+        addr[4] = (uint8_t)i; addr[5] = 0x55;
+        COMPROBAR_IGUAL(ble_target_set_insertar(&s_set, addr, (uint16_t)i), ESP_OK);
+    }
+    for (int i = 0; i < 256; i++) {
+        addr[4] = (uint8_t)i;
+        COMPROBAR_IGUAL(ble_target_set_buscar(&s_set, addr), i);
+    }
+}
+
+static void medir(int num_objetivos)
+{
+    static uint8_t anuncios[TRAZA][6];
+
+    for (int i = 0; i < num_objetivos; i++) {
+        direccion_aleatoria(s_objetivos[i]);
+    }
+    cargar(num_objetivos);
+
+    // Tráfico de un edificio: la mayoría de anuncios son de dispositivos ajenos
+    int esperados = 0;
+    for (int i = 0; i < TRAZA; i++) {
+        if (azar() % PROPORCION_OBJETIVO == 0) {
+            memcpy(anuncios[i], s_objetivos[azar() % num_objetivos], 6);
+            esperados++;
+        } else {
+            direccion_aleatoria(anuncios[i]);
+        }
+    }
+
+    volatile int aciertos = 0;
+    double t0 = ahora_s();
+    for (int i = 0; i < ANUNCIOS_BENCH; i++) {
+        aciertos += ble_target_set_buscar(&s_set, anuncios[i % TRAZA]) >= 0;
+    }
+    double t1 = ahora_s();
+
+    // La búsqueda lineal con 1000 objetivos es lenta: basta con menos anuncios
+    int anuncios_lineal = ANUNCIOS_BENCH / (num_objetivos >= 100 ? 16 : 1);
+    volatile int aciertos_lineal = 0;
+    for (int i = 0; i < anuncios_lineal; i++) {
+        aciertos_lineal += buscar_lineal(anuncios[i % TRAZA], num_objetivos) >= 0;
+    }
+    double t2 = ahora_s();
+
+    COMPROBAR_IGUAL(aciertos, esperados * (ANUNCIOS_BENCH / TRAZA));
+    COMPROBAR_IGUAL(aciertos_lineal, esperados * (anuncios_lineal / TRAZA));
+
+    double hash_por_s = ANUNCIOS_BENCH / (t1 - t0);
+    double lineal_por_s = anuncios_lineal / (t2 - t1);
+    printf("%4d objetivos: índice %.1f M anuncios/s, búsqueda lineal %.1f M anuncios/s (host)\n",
+           num_objetivos, hash_por_s / 1e6, lineal_por_s / 1e6);
+
+    if (num_objetivos >= 1000) {
+        COMPROBAR(hash_por_s > lineal_por_s);
+    }
+}
+
+int main(void)
+{
+    probar_busqueda();
+    probar_colisiones_oui();
+    medir(10);
+    medir(100);
+    medir(1000);
+    printf("test_ble_target_set: OK\n");
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Gobernador térmico: histéresis, permanencia, límite de reinicios, enfriamiento forzado y trazas de temperatura
+#include <math.h>
+#include "ble_thermal_governor.h"
+#include "prueba.h"
+
+#define MUESTREO_MS     200         // Periodo de temp_monitor_task por debajo de ECO
+#define HORA_MS         3600000LL
+
+// Misma configuración que configurar_parametros_escaneo_s3() con los umbrales por defecto
+static const ble_thermal_governor_config_t s_cfg = {
+    .temp_inicio = 55.0f,
+    .temp_fin = 85.0f,
+    .ventana = 0x0008,
+    .itvl_min = 0x0008,
+    .itvl_max = 0x0500,
+    .pasos = 8,
+    .histeresis = 2.0f,
+    .permanencia_min_ms = 10000,
+    .max_reinicios_hora = 30,
+};
+
+static void probar_extremos(void)
+{
+    ble_thermal_governor_t gov;
+    ble_thermal_governor_init(&gov, &s_cfg, 0);
+
+    COMPROBAR_IGUAL(gov.paso, 0);
+    COMPROBAR(ble_thermal_governor_duty(&gov) == 100.0f);
+
+    // El último nivel es urgente: se aplica aunque no haya pasado la permanencia
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 90.0f, 1));
+    COMPROBAR_IGUAL(gov.paso, s_cfg.pasos - 1);
+    COMPROBAR(ble_thermal_governor_duty(&gov) < 1.0f);
+}
+
+static void probar_histeresis_y_permanencia(void)
+{
+    ble_thermal_governor_t gov;
+    ble_thermal_governor_init(&gov, &s_cfg, 0);
+
+    // Un nivel cada 30/7 ≈ 4.3 °C: 62 °C es el nivel 1 pero sin la media banda no basta
+    COMPROBAR(!ble_thermal_governor_actualizar(&gov, 59.9f, 20000));
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 62.0f, 20000));
+    COMPROBAR_IGUAL(gov.paso, 1);
+
+    // Vuelta a 60 °C dentro de la banda: se queda
+    COMPROBAR(!ble_thermal_governor_actualizar(&gov, 60.0f, 40000));
+    COMPROBAR_IGUAL(gov.paso, 1);
+
+    // Subida a los 2 s: retenida por permanencia y contada
+    COMPROBAR(!ble_thermal_governor_actualizar(&gov, 70.0f, 22000));
+    COMPROBAR_IGUAL(gov.cambios_suprimidos, 1);
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 70.0f, 60000));
+    COMPROBAR_IGUAL(gov.paso, 3);
+}
+
+static void probar_limite_reinicios(void)
+{
+    ble_thermal_governor_t gov;
+    ble_thermal_governor_init(&gov, &s_cfg, 0);
+
+    // Oscilación continua: no más de la ráfaga más 30 reinicios por hora
+    int64_t t = 0;
+    for (int i = 0; i < 3600; i++) {
+        t += 1000;
+        ble_thermal_governor_actualizar(&gov, (i % 20 < 10) ? 75.0f : 56.0f, t);
+    }
+    COMPROBAR(gov.reinicios <= 3 + 30);
+    COMPROBAR(gov.cambios_suprimidos > 0);
+}
+
+static void probar_enfriamiento_forzado(void)
+{
+    ble_thermal_governor_t gov;
+    ble_thermal_governor_init(&gov, &s_cfg, 0);
+
+    uint8_t minimo = ble_thermal_governor_paso_para_duty(&gov, 50.0f);
+    COMPROBAR(minimo > 0);
+
+    // A 45 °C el nivel térmico es 0 (100 %): forzar tiene que bajar el duty
+    COMPROBAR(!ble_thermal_governor_actualizar(&gov, 45.0f, 1000));
+    float duty_libre = ble_thermal_governor_duty(&gov);
+
+    // Forzar con una temperatura sintética entre ECO y WARNING (60 °C) no
+    // movía el nivel: cae en el nivel 0 al restar la media banda
+    ble_thermal_governor_t sintetico = gov;
+    COMPROBAR(!ble_thermal_governor_actualizar(&sintetico, 60.0f, 1200));
+    COMPROBAR_IGUAL(sintetico.paso, 0);
+
+    ble_thermal_governor_fijar_minimo(&gov, minimo);
+    // Inmediato aunque acabe de arrancar (permanencia sin cumplir)
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 45.0f, 1500));
+    COMPROBAR_IGUAL(gov.paso, minimo);
+    COMPROBAR(ble_thermal_governor_duty(&gov) <= 50.0f);
+    COMPROBAR(ble_thermal_governor_duty(&gov) < duty_libre);
+
+    // El nivel inmediatamente anterior aún supera el 50 %
+    ble_thermal_governor_t anterior = gov;
+    anterior.paso = minimo - 1;
+    COMPROBAR(ble_thermal_governor_duty(&anterior) > 50.0f);
+
+    // Con el mínimo puesto la temperatura puede subir el nivel, no bajarlo
+    COMPROBAR(!ble_thermal_governor_actualizar(&gov, 30.0f, 30000));
+    COMPROBAR_IGUAL(gov.paso, minimo);
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 80.0f, 60000));
+    COMPROBAR(gov.paso > minimo);
+
+    // Al quitarlo se vuelve a bajar por histéresis
+    ble_thermal_governor_fijar_minimo(&gov, 0);
+    COMPROBAR(ble_thermal_governor_actualizar(&gov, 45.0f, 120000));
+    COMPROBAR_IGUAL(gov.paso, 0);
+}
+
+/*
+ * Referencia sin histéresis, permanencia ni límite de reinicios: como los
+ * modos fijos de antes, cada cruce de umbral reinicia el escaneo.
+ */
+static const ble_thermal_governor_config_t s_cfg_sin_gobierno = {
+    .temp_inicio = 55.0f,
+    .temp_fin = 85.0f,
+    .ventana = 0x0008,
+    .itvl_min = 0x0008,
+    .itvl_max = 0x0500,
+    .pasos = 8,
+    .histeresis = 0.0f,
+    .permanencia_min_ms = 0,
+    .max_reinicios_hora = 0,
+};
+
+static uint32_t s_azar;
+
+// Ruido del sensor interno: uniforme de ±0.4 °C
+static float ruido(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return ((float)(s_azar % 801) - 400.0f) / 1000.0f;
+}
+
+// 40 °C → 90 °C en dos horas y de vuelta en otras dos
+static float rampa_lenta(int64_t ms)
+{
+    float h = (float)ms / HORA_MS;
+    return (h < 2.0f ? 40.0f + 25.0f * h : 90.0f - 25.0f * (h - 2.0f)) + ruido();
+}
+
+// ±1.5 °C con periodo de un minuto alrededor del límite entre los niveles 0 y 1
+static float oscilacion(int64_t ms)
+{
+    float umbral = s_cfg.temp_inicio + (s_cfg.temp_fin - s_cfg.temp_inicio) / (s_cfg.pasos - 1);
+    return umbral + 1.5f * sinf(2.0f * (float)M_PI * ms / 60000.0f) + ruido();
+}
+
+// 50 °C estables con un pico de 88 °C de dos minutos a la media hora
+static float pico_emergencia(int64_t ms)
+{
+    return (ms >= 1800000 && ms < 1920000 ? 88.0f : 50.0f) + ruido();
+}
+
+typedef struct {
+    uint32_t reinicios;
+    uint32_t suprimidos;
+    float reinicios_hora;
+    float duty_efectivo;              /**< Media del duty ponderada por tiempo (%) */
+    int64_t latencia_ultimo_nivel_ms; /**< Desde la primera lectura en zona urgente, -1 = no hubo */
+    uint8_t paso_final;
+} resultado_traza_t;
+
+static resultado_traza_t reproducir(const ble_thermal_governor_config_t *cfg, float (*temperatura)(int64_t),
+                                    int64_t duracion_ms)
+{
+    resultado_traza_t r = { .latencia_ultimo_nivel_ms = -1 };
+    ble_thermal_governor_t gov;
+    double duty_ms = 0.0;
+    int64_t urgente_desde = -1;
+    float umbral_urgente = cfg->temp_fin + cfg->histeresis / 2.0f;
+
+    // Misma semilla en cada reproducción: referencia y gobernador ven la misma traza
+    s_azar = 0xBADC0FFEu;
+    ble_thermal_governor_init(&gov, cfg, 0);
+    for (int64_t t = 0; t < duracion_ms; t += MUESTREO_MS) {
+        float temp = temperatura(t);
+        ble_thermal_governor_actualizar(&gov, temp, t);
+        duty_ms += ble_thermal_governor_duty(&gov) * MUESTREO_MS;
+
+        if (temp >= umbral_urgente && urgente_desde < 0) {
+            urgente_desde = t;
+        }
+        if (gov.paso == cfg->pasos - 1 && urgente_desde >= 0 && r.latencia_ultimo_nivel_ms < 0) {
+            r.latencia_ultimo_nivel_ms = t - urgente_desde;
+        }
+    }
+
+    r.reinicios = gov.reinicios;
+    r.suprimidos = gov.cambios_suprimidos;
+    r.reinicios_hora = (float)gov.reinicios * HORA_MS / duracion_ms;
+    r.duty_efectivo = (float)(duty_ms / duracion_ms);
+    r.paso_final = gov.paso;
+    return r;
+}
+
+static void imprimir(const char *traza, const resultado_traza_t *ref, const resultado_traza_t *gob)
+{
+    printf("%-12s sin gobierno: %6.1f reinicios/h, duty efectivo %5.1f%% | "
+           "gobernador: %5.1f reinicios/h (%u suprimidos), duty efectivo %5.1f%%\n",
+           traza, ref->reinicios_hora, ref->duty_efectivo,
+           gob->reinicios_hora, (unsigned)gob->suprimidos, gob->duty_efectivo);
+}
+
+static void probar_trazas(void)
+{
+    ble_thermal_governor_t nivel;
+    ble_thermal_governor_init(&nivel, &s_cfg, 0);
+    float duty_nivel0 = ble_thermal_governor_duty(&nivel);
+    nivel.paso = 1;
+    float duty_nivel1 = ble_thermal_governor_duty(&nivel);
+    nivel.paso = s_cfg.pasos - 1;
+    float duty_minimo = ble_thermal_governor_duty(&nivel);
+
+    // Rampa: cada nivel se cruza una vez al subir y otra al bajar
+    resultado_traza_t ref = reproducir(&s_cfg_sin_gobierno, rampa_lenta, 4 * HORA_MS);
+    resultado_traza_t gob = reproducir(&s_cfg, rampa_lenta, 4 * HORA_MS);
+    imprimir("rampa lenta", &ref, &gob);
+    COMPROBAR(gob.reinicios <= 2u * (s_cfg.pasos - 1) + 2);
+    COMPROBAR(gob.reinicios_hora <= s_cfg.max_reinicios_hora);
+    COMPROBAR(ref.reinicios > gob.reinicios);
+    COMPROBAR(gob.duty_efectivo > duty_minimo && gob.duty_efectivo < duty_nivel0);
+    COMPROBAR_IGUAL(gob.paso_final, 0);
+
+    // Oscilación en un umbral: el límite de reinicios manda (ráfaga de 3 + 30/h)
+    ref = reproducir(&s_cfg_sin_gobierno, oscilacion, 2 * HORA_MS);
+    gob = reproducir(&s_cfg, oscilacion, 2 * HORA_MS);
+    imprimir("oscilación", &ref, &gob);
+    COMPROBAR(gob.reinicios <= 3 + 2 * s_cfg.max_reinicios_hora);
+    COMPROBAR(ref.reinicios_hora > 4.0f * gob.reinicios_hora);
+    COMPROBAR(gob.duty_efectivo >= duty_nivel1 - 0.01f && gob.duty_efectivo <= duty_nivel0 + 0.01f);
+
+    // Pico de emergencia: el último nivel entra en la misma lectura y luego se recupera
+    ref = reproducir(&s_cfg_sin_gobierno, pico_emergencia, HORA_MS);
+    gob = reproducir(&s_cfg, pico_emergencia, HORA_MS);
+    imprimir("pico", &ref, &gob);
+    COMPROBAR_IGUAL(gob.latencia_ultimo_nivel_ms, 0);
+    COMPROBAR(gob.reinicios <= 2u * (s_cfg.pasos - 1));
+    COMPROBAR_IGUAL(gob.paso_final, 0);
+    COMPROBAR(gob.duty_efectivo < duty_nivel0);
+}
+
+int main(void)
+{
+    probar_extremos();
+    probar_histeresis_y_permanencia();
+    probar_limite_reinicios();
+    probar_enfriamiento_forzado();
+    probar_trazas();
+    printf("test_ble_thermal_governor: OK\n");
+    return 0;
+}
@@ -0,0 +1,316 @@
+// Escritor CBOR: forma más corta de cada cabecera, desbordamiento y telemetría térmica frente a JSON
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "ble_scanner.h"
+#include "ble_telemetria.h"
+#include "prueba.h"
+
+#define ITERACIONES_BENCH   200000
+
+/*
+ * Mensaje térmico de referencia, el mismo que mide test_json_writer. Lo
+ * decodifica también tools/telemetria_cbor.py en la prueba telemetria_cbor_py:
+ * si cambia aquí, cambia allí.
+ */
+#define TERMICO_HEX \
+    "ac0001011901e702020319017704190264051904d206190e10071878080109183c0a070b03"
+
+static size_t a_hex(const uint8_t *datos, size_t n, char *hex)
+{
+    for (size_t i = 0; i < n; i++) {
+        sprintf(hex + 2 * i, "%02x", datos[i]);
+    }
+    hex[2 * n] = '\0';
+    return 2 * n;
+}
+
+// Ejecuta la llamada sobre w y compara con los bytes esperados, en hex para que el fallo se lea
+#define COMPROBAR_CBOR(llamada, esperado) do {                      \
+        uint8_t buf_[32];                                           \
+        char hex_[sizeof(buf_) * 2 + 1];                            \
+        cbor_writer_t w_;                                           \
+        cbor_writer_init(&w_, buf_, sizeof(buf_));                  \
+        cbor_writer_t *w = &w_;                                     \
+        llamada;                                                    \
+        size_t n_ = cbor_writer_terminar(&w_);                      \
+        COMPROBAR(n_ > 0);                                          \
+        a_hex(buf_, n_, hex_);                                      \
+        if (strcmp(hex_, esperado) != 0) {                          \
+            fprintf(stderr, "%s:%d: %s -> %s, se esperaba %s\n",    \
+                    __FILE__, __LINE__, #llamada, hex_, esperado);  \
+            exit(1);                                                \
+        }                                                           \
+    } while (0)
+
+// Vectores del apéndice A de RFC 8949 en cada frontera de longitud del argumento
+static void probar_enteros(void)
+{
+    COMPROBAR_CBOR(cbor_writer_uint(w, 0), "00");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 23), "17");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 24), "1818");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 255), "18ff");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 256), "190100");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 65535), "19ffff");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 65536), "1a00010000");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 4294967295u), "1affffffff");
+    COMPROBAR_CBOR(cbor_writer_uint(w, 4294967296u), "1b0000000100000000");
+    COMPROBAR_CBOR(cbor_writer_uint(w, UINT64_MAX), "1bffffffffffffffff");
+
+    COMPROBAR_CBOR(cbor_writer_int(w, 10), "0a");
+    COMPROBAR_CBOR(cbor_writer_int(w, -1), "20");
+    COMPROBAR_CBOR(cbor_writer_int(w, -10), "29");
+    COMPROBAR_CBOR(cbor_writer_int(w, -24), "37");
+    COMPROBAR_CBOR(cbor_writer_int(w, -25), "3818");
+    COMPROBAR_CBOR(cbor_writer_int(w, -100), "3863");
+    COMPROBAR_CBOR(cbor_writer_int(w, -1000), "3903e7");
+    COMPROBAR_CBOR(cbor_writer_int(w, INT64_MIN), "3b7fffffffffffffff");
+}
+
+static void probar_tipos(void)
+{
+    COMPROBAR_CBOR(cbor_writer_str(w, ""), "60");
+    COMPROBAR_CBOR(cbor_writer_str(w, "IETF"), "6449455446");
+    COMPROBAR_CBOR(cbor_writer_str(w, "\xc3\xbc"), "62c3bc");
+    COMPROBAR_CBOR(cbor_writer_str(w, "aaaaaaaaaaaaaaaaaaaaaaaa"),
+                   "7818616161616161616161616161616161616161616161616161");
+    COMPROBAR_CBOR(cbor_writer_str(w, NULL), "f6");
+    COMPROBAR_CBOR(cbor_writer_bool(w, false), "f4");
+    COMPROBAR_CBOR(cbor_writer_bool(w, true), "f5");
+
+    COMPROBAR_CBOR(cbor_writer_array(w, 0), "80");
+    COMPROBAR_CBOR(cbor_writer_int(cbor_writer_int(cbor_writer_int(cbor_writer_array(w, 3), 1), 2), 3),
+                   "83010203");
+    COMPROBAR_CBOR(cbor_writer_array(w, 25), "9819");
+    COMPROBAR_CBOR(cbor_writer_mapa(w, 0), "a0");
+    COMPROBAR_CBOR(cbor_writer_str(cbor_writer_str(cbor_writer_mapa(w, 1), "a"), "b"), "a161616162");
+    COMPROBAR_CBOR(cbor_writer_mapa(w, 300), "b9012c");
+}
+
+static void probar_desbordamiento(void)
+{
+    uint8_t buf[4];
+    cbor_writer_t w;
+
+    // Cabe justo
+    cbor_writer_init(&w, buf, sizeof(buf));
+    cbor_writer_uint(cbor_writer_uint(&w, 1), 1000);
+    COMPROBAR_IGUAL(cbor_writer_terminar(&w), 4);
+
+    // Una cabecera que no cabe entera no deja bytes a medias y lo siguiente no se escribe
+    cbor_writer_init(&w, buf, sizeof(buf));
+    cbor_writer_uint(&w, 1);
+    cbor_writer_uint(&w, 65536);
+    COMPROBAR(w.desbordado);
+    COMPROBAR_IGUAL(w.longitud, 1);
+    cbor_writer_uint(&w, 2);
+    COMPROBAR_IGUAL(w.longitud, 1);
+    COMPROBAR_IGUAL(cbor_writer_terminar(&w), 0);
+
+    // Texto cuya cabecera cabe pero el contenido no
+    cbor_writer_init(&w, buf, sizeof(buf));
+    cbor_writer_str(&w, "hola");
+    COMPROBAR_IGUAL(cbor_writer_terminar(&w), 0);
+
+    // Sin buffer
+    cbor_writer_init(&w, NULL, 0);
+    cbor_writer_bool(&w, true);
+    COMPROBAR_IGUAL(cbor_writer_terminar(&w), 0);
+}
+
+typedef struct {
+    float temp;
+    ble_thermal_mode_t modo;
+    float duty;
+    float temp_max;
+    uint32_t detecciones;
+    uint32_t tiempo_critico;
+    uint32_t tiempo_emergencia;
+    ble_telemetria_cuadro_t cuadro;
+    uint32_t intervalo_ms;
+    uint32_t reinicios;
+    uint32_t suprimidos;
+} termico_t;
+
+static const termico_t TERMICO_REF = {
+    .temp = 48.7f, .modo = BLE_THERMAL_MODE_WARNING, .duty = 37.5f, .temp_max = 61.2f,
+    .detecciones = 1234, .tiempo_critico = 3600, .tiempo_emergencia = 120,
+    .cuadro = BLE_TELEMETRIA_CUADRO_TIBIO, .intervalo_ms = 60, .reinicios = 7, .suprimidos = 3,
+};
+
+// Igual que el reporte térmico de ble_scanner.c con CONFIG_BLE_TELEMETRIA_CBOR
+static size_t codificar_cbor(uint8_t *buf, size_t capacidad, const termico_t *t)
+{
+    cbor_writer_t w;
+    cbor_writer_init(&w, buf, capacidad);
+    cbor_writer_mapa(&w, 1 + BLE_TELEMETRIA_TERMICO_NUM_CAMPOS);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_CLAVE_ESQUEMA), BLE_TELEMETRIA_ESQUEMA_TERMICO);
+    cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TEMP_DC), lroundf(t->temp * 10.0f));
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_MODO), t->modo);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_DUTY_PM), lroundf(t->duty * 10.0f));
+    cbor_writer_int(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TEMP_MAX_DC), lroundf(t->temp_max * 10.0f));
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_DETECCIONES), t->detecciones);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TIEMPO_CRITICO_S), t->tiempo_critico);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_TIEMPO_EMERGENCIA_S), t->tiempo_emergencia);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_ESTADO_CUADRO), t->cuadro);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_INTERVALO_ESCANEO_MS), t->intervalo_ms);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_REINICIOS_GAP), t->reinicios);
+    cbor_writer_uint(cbor_writer_uint(&w, BLE_TELEMETRIA_TERMICO_CAMBIOS_SUPRIMIDOS), t->suprimidos);
+    return cbor_writer_terminar(&w);
+}
+
+// Igual que el reporte térmico de ble_scanner.c sin CBOR
+static size_t codificar_json(char *buf, size_t capacidad, const termico_t *t)
+{
+    static const char *const modos[] = {"NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"};
+    static const char *const cuadros[] = {"NORMAL", "TIBIO", "CALIENTE", "SOBRECALENTADO"};
+    char duty_str[16];
+    snprintf(duty_str, sizeof(duty_str), "%.1f%%", t->duty);
+
+    json_writer_t w;
+    json_writer_init(&w, buf, capacidad);
+    json_writer_objeto(&w, NULL);
+    json_writer_float(&w, "temp", t->temp, 1);
+    json_writer_str(&w, "modo_termico", modos[t->modo]);
+    json_writer_str(&w, "duty_cycle", duty_str);
+    json_writer_float(&w, "temp_max", t->temp_max, 1);
+    json_writer_uint(&w, "detecciones", t->detecciones);
+    json_writer_uint(&w, "tiempo_critico", t->tiempo_critico);
+    json_writer_uint(&w, "tiempo_emergencia", t->tiempo_emergencia);
+    json_writer_str(&w, "trabajo", "INTENSIVO_AUSENTE");
+    json_writer_str(&w, "estado_cuadro", cuadros[t->cuadro]);
+    json_writer_uint(&w, "intervalo_escaneo", t->intervalo_ms);
+    json_writer_uint(&w, "reinicios_gap", t->reinicios);
+    json_writer_uint(&w, "cambios_suprimidos", t->suprimidos);
+    return json_writer_terminar(&w) != NULL ? w.longitud : 0;
+}
+
+/*
+ * Lector mínimo de enteros CBOR (tipos mayores 0, 1 y 5) para comprobar la
+ * ida y vuelta del mensaje térmico sin depender del decodificador de Python.
+ * Devuelve el tipo mayor, o -1 si el byte inicial no es uno de esos.
+ */
+static int leer(const uint8_t **p, const uint8_t *fin, int64_t *valor)
+{
+    COMPROBAR(*p < fin);
+    uint8_t inicial = *(*p)++;
+    int mayor = inicial >> 5;
+    uint8_t info = inicial & 0x1F;
+    uint64_t arg = info;
+    if (info >= 24) {
+        COMPROBAR(info <= 27);
+        size_t n = (size_t)1 << (info - 24);
+        COMPROBAR(*p + n <= fin);
+        arg = 0;
+        for (size_t i = 0; i < n; i++) {
+            arg = (arg << 8) | *(*p)++;
+        }
+        // Forma más corta: el argumento no cabría en una cabecera menor
+        COMPROBAR(arg >= (n == 1 ? 24 : (uint64_t)1 << (4 * n)));
+    }
+    if (mayor == 1) {
+        *valor = -1 - (int64_t)arg;
+    } else if (mayor == 0 || mayor == 5) {
+        *valor = (int64_t)arg;
+    } else {
+        return -1;
+    }
+    return mayor;
+}
+
+static void probar_telemetria_termica(void)
+{
+    uint8_t buf[64];
+    char hex[sizeof(buf) * 2 + 1];
+    termico_t t = TERMICO_REF;
+
+    size_t n = codificar_cbor(buf, sizeof(buf), &t);
+    COMPROBAR(n > 0);
+    a_hex(buf, n, hex);
+    COMPROBAR(strcmp(hex, TERMICO_HEX) == 0);
+
+    // Ida y vuelta: claves del esquema en orden y los valores en sus unidades
+    const int64_t esperado[1 + BLE_TELEMETRIA_TERMICO_NUM_CAMPOS] = {
+        BLE_TELEMETRIA_ESQUEMA_TERMICO, 487, BLE_THERMAL_MODE_WARNING, 375, 612, 1234, 3600, 120,
+        BLE_TELEMETRIA_CUADRO_TIBIO, 60, 7, 3,
+    };
+    const uint8_t *p = buf, *fin = buf + n;
+    int64_t v;
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 5);
+    COMPROBAR_IGUAL(v, 1 + BLE_TELEMETRIA_TERMICO_NUM_CAMPOS);
+    for (int clave = 0; clave <= BLE_TELEMETRIA_TERMICO_NUM_CAMPOS; clave++) {
+        COMPROBAR_IGUAL(leer(&p, fin, &v), 0);
+        COMPROBAR_IGUAL(v, clave);
+        COMPROBAR(leer(&p, fin, &v) >= 0);
+        COMPROBAR_IGUAL(v, esperado[clave]);
+    }
+    COMPROBAR(p == fin);
+
+    // Temperaturas bajo cero y contadores de 32 bits caben en el buffer del escáner
+    t.temp = -12.3f;
+    t.temp_max = -0.04f;
+    t.detecciones = t.tiempo_critico = t.tiempo_emergencia = UINT32_MAX;
+    t.reinicios = t.suprimidos = UINT32_MAX;
+    n = codificar_cbor(buf, sizeof(buf), &t);
+    COMPROBAR(n > 0);
+    p = buf;
+    fin = buf + n;
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 5);
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 0);
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 0);
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 0);
+    COMPROBAR_IGUAL(leer(&p, fin, &v), 1);
+    COMPROBAR_IGUAL(v, -123);
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * El mismo reporte térmico en los dos formatos. El JSON incluye el snprintf
+ * del duty, como en el escáner.
+ */
+static void medir(void)
+{
+    uint8_t cbor[64];
+    char json[400];
+    size_t bytes_cbor = 0, bytes_json = 0;
+    termico_t t = TERMICO_REF;
+
+    double t0 = ahora_s();
+    for (int i = 0; i < ITERACIONES_BENCH; i++) {
+        t.temp = 48.7f + (i & 7);
+        t.detecciones = (uint32_t)i;
+        bytes_cbor = codificar_cbor(cbor, sizeof(cbor), &t);
+    }
+    double t1 = ahora_s();
+    for (int i = 0; i < ITERACIONES_BENCH; i++) {
+        t.temp = 48.7f + (i & 7);
+        t.detecciones = (uint32_t)i;
+        bytes_json = codificar_json(json, sizeof(json), &t);
+    }
+    double t2 = ahora_s();
+
+    COMPROBAR(bytes_cbor > 0 && bytes_json > 0);
+    COMPROBAR(bytes_cbor * 4 < bytes_json);
+    printf("telemetría térmica: CBOR %zu bytes, %.0f ns; JSON %zu bytes, %.0f ns por mensaje (host)\n",
+           bytes_cbor, (t1 - t0) / ITERACIONES_BENCH * 1e9,
+           bytes_json, (t2 - t1) / ITERACIONES_BENCH * 1e9);
+}
+
+int main(void)
+{
+    probar_enteros();
+    probar_tipos();
+    probar_desbordamiento();
+    probar_telemetria_termica();
+    medir();
+    printf("test_cbor_writer: OK\n");
+    return 0;
+}
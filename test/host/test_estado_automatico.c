@@ -0,0 +1,664 @@
+// Simulador del modo automático: estado_automatico.c completo con reloj virtual y GAP, GPIO y MQTT falsos
+//
+//   test_estado_automatico [semanas]   (por defecto 8 semanas sintéticas por juego de parámetros)
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ble_rssi_filter.h"
+#include "prueba.h"
+
+/*
+ * Se incluye el .c para olvidar el modelo de ocupación aprendido (sus
+ * estáticas) entre juegos de parámetros, como test_mqtt_outbox.c con el outbox.
+ */
+#include "../../components/estado_automatico/estado_automatico.c"
+
+#define ANUNCIO_INTERVALO_MS      1000        // Intervalo de anuncio típico de un tag
+#define ANUNCIO_RETARDO_MAX_MS    10          // advDelay aleatorio del estándar BLE
+#define SENSIBILIDAD_DBM          (-90)       // Por debajo el anuncio no se recibe
+#define RUIDO_DBM                 4           // Desviación del RSSI de cada anuncio
+#define RSSI_REINICIO_FILTRO_MS   10000       // Mismo valor que ble_scanner.c
+
+#define RSSI_MESA                 (-62)       // En la mesa, junto al armario
+#define RSSI_SALA                 (-80)       // En la sala, lejos del armario
+#define RSSI_OCULTO               (-110)      // Presente sin cobertura (móvil en un cajón)
+
+#define EPOCA_LUNES               1767571200LL    // 2026-01-05 00:00 UTC, lunes
+#define SEGUNDOS_DIA              (24 * 3600)
+#define H(h, m)                   ((h) * 3600 + (m) * 60)
+#define MAX_TRAMOS                512
+#define SEMANAS_POR_DEFECTO       8
+
+/* ---- Trazas de ocupación ---- */
+
+typedef struct {
+    uint32_t inicio_s;          // Segundos desde el inicio de la traza
+    uint32_t fin_s;
+    int8_t rssi;                // RSSI medio del tag en el tramo
+} tramo_t;
+
+// Tramos ordenados en los que el tag está presente; entre ellos, ausencia
+typedef struct {
+    tramo_t tramos[MAX_TRAMOS];
+    int num;
+    uint32_t duracion_s;
+    uint8_t perdida_pct;        // Anuncios perdidos al azar además de los de cobertura
+} traza_t;
+
+// Lunes anotado a mano: llegada, una reunión lejos de la mesa, el móvil en un cajón, pausas y comida
+static const tramo_t s_lunes[] = {
+    {H(8, 2),   H(9, 40),  RSSI_MESA},
+    {H(9, 40),  H(9, 52),  RSSI_SALA},
+    {H(9, 52),  H(11, 5),  RSSI_MESA},
+    // 11:05-11:20 café
+    {H(11, 20), H(13, 10), RSSI_MESA},
+    // 13:10-14:05 comida
+    {H(14, 5),  H(15, 30), RSSI_MESA},
+    {H(15, 30), H(15, 33), RSSI_OCULTO},
+    {H(15, 33), H(16, 40), RSSI_MESA},
+    // 16:40-16:44 aseo
+    {H(16, 44), H(18, 15), RSSI_MESA},
+};
+#define LUNES_LLEGADAS  4
+
+typedef struct {
+    uint32_t llegadas;              // Presencias que empiezan tras una ausencia
+    uint32_t encendidos;
+    uint32_t apagados_en_falso;     // Relé apagado con el tag presente
+    uint32_t latencias;             // Llegadas con el relé apagado que acabaron encendiéndolo
+    double latencia_suma_s;
+    double latencia_max_s;
+    double total_s;
+    double presente_s;
+    double rele_s;
+    double desperdicio_s;           // Relé encendido sin nadie
+    double sin_servicio_s;          // Tag presente con el relé apagado
+    double escaneo_s;
+    uint32_t escrituras_nvs;
+} metricas_t;
+
+/* ---- Dobles de GAP, GPIO, NVS y MQTT ---- */
+
+// GAP falso: escaneo, filtro de RSSI real y suscripción de la tarea
+static struct {
+    bool escaneando;
+    bool detectado;
+    int64_t ultima_deteccion_us;
+    ble_rssi_filter_t filtro;
+    TaskHandle_t tarea;
+    uint32_t bits;
+} s_gap;
+
+static struct {
+    bool encendido;
+    int64_t ultimo_cambio_us;
+} s_rele;
+
+static struct {
+    automatico_ocupacion_tabla_t tabla;
+    size_t longitud;
+} s_nvs;
+
+static ecokey_config_t s_config = {
+    .temporizador_min = 10,
+    .mac_objetivo_valida = true,
+    .mac_objetivo = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF},
+};
+
+// Estado de la reproducción en curso
+static struct {
+    const traza_t *traza;
+    int tramo;                  // Tramo actual o siguiente
+    int64_t inicio_us;          // Reloj virtual al empezar la traza
+    int64_t ultima_muestra_us;
+    int64_t llegada_us;         // Inicio de la presencia en curso
+    int64_t apagado_us;         // Último apagado del relé
+    bool presente;
+    bool terminando;            // El apagado de estado_automatico_detener() no cuenta
+    esp_timer_handle_t anuncio;
+    metricas_t *m;
+} s_sim;
+
+static uint32_t s_azar = 1;
+
+static uint32_t azar(void)
+{
+    // xorshift32: misma secuencia en cualquier libc
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+// Ruido aproximadamente normal (Irwin-Hall con 4 uniformes) de desviación RUIDO_DBM
+static int ruido_dbm(void)
+{
+    double suma = 0;
+    for (int i = 0; i < 4; i++) {
+        suma += (azar() % 10000) / 10000.0;
+    }
+    return (int)lround((suma - 2.0) * RUIDO_DBM * sqrt(3.0));
+}
+
+static const tramo_t *tramo_en(int64_t t_ms)
+{
+    const traza_t *traza = s_sim.traza;
+    while (s_sim.tramo < traza->num && (int64_t)traza->tramos[s_sim.tramo].fin_s * 1000 <= t_ms) {
+        s_sim.tramo++;
+    }
+    if (s_sim.tramo < traza->num && (int64_t)traza->tramos[s_sim.tramo].inicio_s * 1000 <= t_ms) {
+        return &traza->tramos[s_sim.tramo];
+    }
+    return NULL;
+}
+
+/*
+ * Acumula las métricas desde la muestra anterior con el estado que había y
+ * toma la presencia actual. Se llama antes de cada cambio del relé o del
+ * escaneo y en cada anuncio, así los tiempos son exactos salvo en los bordes
+ * de los tramos (menos de un intervalo de anuncio).
+ */
+static void integrar(void)
+{
+    int64_t ahora = esp_timer_get_time();
+    double dt = (ahora - s_sim.ultima_muestra_us) / 1e6;
+    s_sim.ultima_muestra_us = ahora;
+    metricas_t *m = s_sim.m;
+    if (m == NULL) {
+        return;
+    }
+
+    m->total_s += dt;
+    if (s_sim.presente) {
+        m->presente_s += dt;
+    }
+    if (s_rele.encendido) {
+        m->rele_s += dt;
+        if (!s_sim.presente) {
+            m->desperdicio_s += dt;
+        }
+    } else if (s_sim.presente) {
+        m->sin_servicio_s += dt;
+    }
+    if (s_gap.escaneando) {
+        m->escaneo_s += dt;
+    }
+
+    const tramo_t *tramo = tramo_en((ahora - s_sim.inicio_us) / 1000);
+    if (tramo != NULL && !s_sim.presente) {
+        m->llegadas++;
+        s_sim.llegada_us = s_sim.inicio_us + (int64_t)tramo->inicio_s * 1000000;
+    }
+    s_sim.presente = tramo != NULL;
+}
+
+/*
+ * Anuncio del tag: se recibe si se está escaneando, el tag está presente y su
+ * RSSI con ruido supera la sensibilidad. Lo recibido pasa por el mismo filtro
+ * que el callback de escaneo de ble_scanner.c y despierta a la tarea suscrita.
+ */
+static void anuncio_cb(void *arg)
+{
+    integrar();
+    uint32_t retardo_ms = ANUNCIO_INTERVALO_MS + azar() % (ANUNCIO_RETARDO_MAX_MS + 1);
+    esp_timer_start_once(s_sim.anuncio, (uint64_t)retardo_ms * 1000);
+
+    if (!s_sim.presente || !s_gap.escaneando) {
+        return;
+    }
+    int rssi = s_sim.traza->tramos[s_sim.tramo].rssi + ruido_dbm();
+    if (rssi < SENSIBILIDAD_DBM || azar() % 100 < s_sim.traza->perdida_pct) {
+        return;
+    }
+
+    int64_t ahora = esp_timer_get_time();
+    if ((ahora - s_gap.ultima_deteccion_us) / 1000 > RSSI_REINICIO_FILTRO_MS) {
+        ble_rssi_filter_reset(&s_gap.filtro);
+    }
+    ble_rssi_filter_actualizar(&s_gap.filtro, (int8_t)rssi, BLE_SCANNER_RSSI_EMA_SHIFT,
+                               BLE_SCANNER_RSSI_NEAR_DBM, BLE_SCANNER_RSSI_FAR_DBM);
+    s_gap.ultima_deteccion_us = ahora;
+    s_gap.detectado = true;
+    if (s_gap.tarea != NULL) {
+        xTaskNotify(s_gap.tarea, s_gap.bits, eSetBits);
+    }
+}
+
+static void fijar_escaneo(bool activo)
+{
+    integrar();
+    s_gap.escaneando = activo;
+}
+
+esp_err_t ble_scanner_iniciar(const ble_scanner_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_deinicializar(void)
+{
+    fijar_escaneo(false);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_detener(void)
+{
+    fijar_escaneo(false);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_reiniciar(void)
+{
+    fijar_escaneo(true);
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_configurar_mac_objetivo(uint16_t mac_index, const uint8_t *mac)
+{
+    return ESP_OK;
+}
+
+bool ble_scanner_tag_detectado(uint16_t mac_index)
+{
+    bool detectado = s_gap.detectado;
+    s_gap.detectado = false;
+    return detectado;
+}
+
+bool ble_scanner_tag_cerca(uint16_t mac_index)
+{
+    if ((esp_timer_get_time() - s_gap.ultima_deteccion_us) / 1000 > RSSI_REINICIO_FILTRO_MS) {
+        return false;
+    }
+    return s_gap.filtro.zona == BLE_PROXIMITY_NEAR;
+}
+
+int64_t ble_scanner_obtener_ultima_deteccion_us(uint16_t mac_index)
+{
+    return s_gap.ultima_deteccion_us;
+}
+
+esp_err_t ble_scanner_suscribir_deteccion_tarea(TaskHandle_t tarea, uint32_t bits)
+{
+    s_gap.tarea = tarea;
+    s_gap.bits = bits;
+    return ESP_OK;
+}
+
+esp_err_t ble_scanner_desuscribir_presencia(ble_scanner_presencia_cb_t cb, TaskHandle_t tarea)
+{
+    if (s_gap.tarea == tarea) {
+        s_gap.tarea = NULL;
+    }
+    return ESP_OK;
+}
+
+// GPIO del relé falso: cada cambio alimenta las métricas
+esp_err_t relay_controller_set_state(bool estado)
+{
+    integrar();
+    if (estado == s_rele.encendido) {
+        return ESP_OK;
+    }
+    int64_t ahora = esp_timer_get_time();
+    s_rele.encendido = estado;
+    s_rele.ultimo_cambio_us = ahora;
+
+    metricas_t *m = s_sim.m;
+    if (estado) {
+        m->encendidos++;
+        // Latencia de detección: solo llegadas que encontraron el relé apagado
+        if (s_sim.presente && s_sim.apagado_us <= s_sim.llegada_us) {
+            double latencia_s = (ahora - s_sim.llegada_us) / 1e6;
+            m->latencias++;
+            m->latencia_suma_s += latencia_s;
+            if (latencia_s > m->latencia_max_s) {
+                m->latencia_max_s = latencia_s;
+            }
+        }
+    } else {
+        s_sim.apagado_us = ahora;
+        if (s_sim.presente && !s_sim.terminando) {
+            m->apagados_en_falso++;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t relay_controller_activate(void)
+{
+    return relay_controller_set_state(true);
+}
+
+esp_err_t relay_controller_deactivate(void)
+{
+    return relay_controller_set_state(false);
+}
+
+int64_t relay_controller_get_ultimo_cambio_us(void)
+{
+    return s_rele.ultimo_cambio_us;
+}
+
+const ecokey_config_t *ecokey_config(void)
+{
+    return &s_config;
+}
+
+esp_err_t ecokey_config_set_temporizador(uint32_t minutos)
+{
+    s_config.temporizador_min = (uint8_t)minutos;
+    return ESP_OK;
+}
+
+esp_err_t nvs_manager_set_blob(const char *key, const void *data, size_t length)
+{
+    COMPROBAR(strcmp(key, OCUPACION_NVS_KEY) == 0 && length <= sizeof(s_nvs.tabla));
+    memcpy(&s_nvs.tabla, data, length);
+    s_nvs.longitud = length;
+    if (s_sim.m != NULL) {
+        s_sim.m->escrituras_nvs++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_manager_get_blob(const char *key, void *data, size_t *length)
+{
+    if (s_nvs.longitud == 0 || *length < s_nvs.longitud) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(data, &s_nvs.tabla, s_nvs.longitud);
+    *length = s_nvs.longitud;
+    return ESP_OK;
+}
+
+// Hora local: la traza empieza un lunes a las 00:00 (TZ=UTC0)
+int64_t time_manager_get_unix_time_now(void)
+{
+    return EPOCA_LUNES + (esp_timer_get_time() - s_sim.inicio_us) / 1000000;
+}
+
+esp_err_t time_manager_get_fecha_actual(char *buffer, size_t buffer_size)
+{
+    snprintf(buffer, buffer_size, "%lld", (long long)time_manager_get_unix_time_now());
+    return ESP_OK;
+}
+
+void mqtt_service_enviar_json(const char *topic, int qos, int retain, ...)
+{
+}
+
+esp_err_t mqtt_service_enviar_json_writer(const char *topic, json_writer_t *w, int qos, int retain)
+{
+    return ESP_OK;
+}
+
+const char *sta_wifi_get_mac_clean(void)
+{
+    return "aabbccddeeff";
+}
+
+esp_err_t led_blink_stop(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t resource_manager_create_context(resource_type_t type, TaskHandle_t *task_handle,
+                                          resource_context_t *context)
+{
+    memset(context, 0, sizeof(*context));
+    context->config.min_stack_size = 4096;
+    return ESP_OK;
+}
+
+esp_err_t resource_manager_validate(resource_context_t *context)
+{
+    return ESP_OK;
+}
+
+void resource_manager_monitor(resource_context_t *context, const char *checkpoint)
+{
+}
+
+void resource_manager_cleanup(resource_context_t *context, void (*cleanup_callback)(void))
+{
+    if (cleanup_callback != NULL) {
+        cleanup_callback();
+    }
+}
+
+void resource_manager_set_active(resource_context_t *context, bool active)
+{
+}
+
+bool resource_manager_check_memory_leak(resource_context_t *context)
+{
+    return false;
+}
+
+/* ---- Reproducción ---- */
+
+/*
+ * Reproduce una traza de principio a fin con el modo automático en marcha: el
+ * reloj virtual avanza de golpe y cada anuncio o plazo vencido espera a que la
+ * tarea termine de procesarlo, así una semana tarda lo que tarden sus eventos.
+ */
+static void reproducir(const traza_t *traza, uint32_t timeout_min, metricas_t *m)
+{
+    memset(&s_gap, 0, sizeof(s_gap));
+    ble_rssi_filter_reset(&s_gap.filtro);
+    s_gap.ultima_deteccion_us = INT64_MIN / 2;
+    s_sim.traza = traza;
+    s_sim.tramo = 0;
+    s_sim.inicio_us = esp_timer_get_time();
+    s_sim.ultima_muestra_us = s_sim.inicio_us;
+    s_sim.llegada_us = 0;
+    s_sim.apagado_us = s_sim.inicio_us;
+    s_sim.presente = false;
+    s_sim.terminando = false;
+    s_sim.m = m;
+    s_config.temporizador_min = (uint8_t)timeout_min;
+
+    COMPROBAR(estado_automatico_iniciar() == ESP_OK);
+    freertos_host_esperar_reposo();
+    COMPROBAR(!s_rele.encendido);
+    COMPROBAR(s_gap.escaneando);
+
+    COMPROBAR(esp_timer_start_once(s_sim.anuncio, ANUNCIO_INTERVALO_MS * 1000) == ESP_OK);
+    esp_timer_host_avanzar((int64_t)traza->duracion_s * 1000000);
+    esp_timer_stop(s_sim.anuncio);
+
+    integrar();
+    s_sim.terminando = true;
+    COMPROBAR(estado_automatico_detener() == ESP_OK);
+    freertos_host_esperar_reposo();
+    COMPROBAR(automatico_task_handle == NULL);
+    COMPROBAR(!s_rele.encendido && !s_gap.escaneando);
+    s_sim.m = NULL;
+}
+
+// Olvida el modelo de ocupación aprendido, en memoria y en NVS
+static void olvidar_modelo(void)
+{
+    s_ocupacion_cargada = false;
+    s_nvs.longitud = 0;
+    memset(&s_latencia, 0, sizeof(s_latencia));
+}
+
+static uint32_t exponencial_s(uint32_t media_s)
+{
+    double u = (azar() % 10000 + 1) / 10001.0;
+    return (uint32_t)(-log(u) * media_s) + 1;
+}
+
+static void agregar_tramo(traza_t *traza, uint32_t inicio_s, uint32_t fin_s, int8_t rssi)
+{
+    if (fin_s > inicio_s && traza->num < MAX_TRAMOS) {
+        traza->tramos[traza->num++] = (tramo_t){inicio_s, fin_s, rssi};
+    }
+}
+
+/*
+ * Semana de oficina sintética: de lunes a viernes llegada hacia las 8, comida
+ * hacia las 13 y salida hacia las 18; dentro, ratos en la mesa, en el resto de
+ * la sala, con el tag sin cobertura y ausencias cortas. Al llegar uno se sienta
+ * a la mesa. El fin de semana no hay nadie.
+ */
+static void generar_semana(traza_t *traza, uint32_t semilla)
+{
+    s_azar = semilla;
+    traza->num = 0;
+    traza->duracion_s = 7 * SEGUNDOS_DIA;
+    traza->perdida_pct = 10;
+
+    for (uint32_t dia = 0; dia < 5; dia++) {
+        uint32_t base = dia * SEGUNDOS_DIA;
+        uint32_t t = base + H(7, 30) + azar() % H(1, 0);
+        uint32_t comida = base + H(13, 0) + azar() % H(1, 0);
+        uint32_t vuelta = comida + H(0, 40) + azar() % H(0, 40);
+        uint32_t salida = base + H(17, 30) + azar() % H(1, 30);
+        bool llegando = true;
+
+        while (t < salida) {
+            if (t >= comida && t < vuelta) {
+                t = vuelta;
+                llegando = true;
+                continue;
+            }
+            uint32_t limite = t < comida ? comida : salida;
+            uint32_t p = llegando ? 0 : azar() % 100;
+            uint32_t duracion;
+            int8_t rssi = 0;
+            if (p < 70) {
+                duracion = exponencial_s(40 * 60);
+                rssi = RSSI_MESA;
+            } else if (p < 85) {
+                duracion = exponencial_s(5 * 60);
+                rssi = RSSI_SALA;
+            } else if (p < 92) {
+                duracion = exponencial_s(3 * 60);
+                rssi = RSSI_OCULTO;
+            } else {
+                duracion = exponencial_s(6 * 60);    // Ausencia corta
+            }
+            uint32_t fin = t + duracion < limite ? t + duracion : limite;
+            if (rssi != 0) {
+                agregar_tramo(traza, t, fin, rssi);
+            }
+            llegando = rssi == 0;
+            t = fin;
+        }
+    }
+}
+
+static void imprimir(const char *nombre, uint32_t timeout_min, const metricas_t *m)
+{
+    double dias = m->total_s / SEGUNDOS_DIA;
+    printf("%s timeout %2u min: %4u llegadas, latencia media %4.1f s máx %4.1f s, "
+           "%3u apagados en falso (%5.1f min sin relé con el tag presente), "
+           "relé %4.1f h/día (%4.2f h sin nadie), escaneo %4.1f %%, %u escrituras NVS\n",
+           nombre, timeout_min, m->llegadas,
+           m->latencias ? m->latencia_suma_s / m->latencias : 0.0, m->latencia_max_s,
+           m->apagados_en_falso, m->sin_servicio_s / 60.0,
+           m->rele_s / 3600.0 / dias, m->desperdicio_s / 3600.0 / dias,
+           100.0 * m->escaneo_s / m->total_s, m->escrituras_nvs);
+}
+
+// Tras una llegada la detección espera como mucho la pausa más larga, un tramo y el filtro
+#define LATENCIA_MAX_S  ((AUTOMATICO_OCUPACION_PAUSA_MAX_MS + AUTOMATICO_DUTY_ESCANEO_MS) / 1000 + 10)
+
+// Invariantes que valen para cualquier traza
+static void comprobar_metricas(const metricas_t *m, uint32_t timeout_min)
+{
+    COMPROBAR(m->llegadas > 0);
+    COMPROBAR(m->latencias > 0);
+    COMPROBAR(m->latencia_max_s <= LATENCIA_MAX_S);
+    // Sin detecciones el relé se apaga a los timeout_min de la última: nunca más por cada salida
+    COMPROBAR(m->desperdicio_s <= m->llegadas * (timeout_min * 60.0 + 2));
+    COMPROBAR(m->escaneo_s > 0 && m->escaneo_s < m->total_s);
+    COMPROBAR(m->rele_s >= m->presente_s - m->sin_servicio_s - 1);
+}
+
+static void probar_lunes_grabado(void)
+{
+    static traza_t traza;
+    memcpy(traza.tramos, s_lunes, sizeof(s_lunes));
+    traza.num = sizeof(s_lunes) / sizeof(s_lunes[0]);
+    traza.duracion_s = SEGUNDOS_DIA;
+    traza.perdida_pct = 10;
+
+    static const uint32_t timeouts[] = {2, 10};
+    metricas_t m[2];
+    for (int i = 0; i < 2; i++) {
+        memset(&m[i], 0, sizeof(m[i]));
+        olvidar_modelo();
+        s_azar = 1;
+        reproducir(&traza, timeouts[i], &m[i]);
+        imprimir("lunes grabado", timeouts[i], &m[i]);
+        comprobar_metricas(&m[i], timeouts[i]);
+        COMPROBAR_IGUAL(m[i].llegadas, LUNES_LLEGADAS);
+    }
+
+    // 2 min: los 3 min con el móvil en el cajón apagan el relé con alguien en la mesa
+    COMPROBAR(m[0].apagados_en_falso >= 1);
+    COMPROBAR(m[0].encendidos > LUNES_LLEGADAS);
+
+    // 10 min: ningún apagado en falso; el aseo (4 min) no apaga, el café (15 min) sí
+    COMPROBAR_IGUAL(m[1].apagados_en_falso, 0);
+    COMPROBAR_IGUAL(m[1].latencias, LUNES_LLEGADAS - 1);
+    COMPROBAR_IGUAL(m[1].encendidos, LUNES_LLEGADAS - 1);
+    COMPROBAR(m[1].desperdicio_s > m[0].desperdicio_s);
+}
+
+/*
+ * Barrido de parámetros: las mismas semanas sintéticas con cada timeout; el
+ * modelo de ocupación aprende de una semana a la siguiente y se olvida al
+ * cambiar de juego de parámetros.
+ */
+static void probar_semanas_sinteticas(int semanas)
+{
+    static traza_t traza;
+    static const uint32_t timeouts[] = {2, 5, 10, 15};
+    const int num = sizeof(timeouts) / sizeof(timeouts[0]);
+    metricas_t m[sizeof(timeouts) / sizeof(timeouts[0])];
+
+    for (int i = 0; i < num; i++) {
+        memset(&m[i], 0, sizeof(m[i]));
+        olvidar_modelo();
+        for (int s = 0; s < semanas; s++) {
+            generar_semana(&traza, 1000 + s);
+            reproducir(&traza, timeouts[i], &m[i]);
+        }
+        char nombre[32];
+        snprintf(nombre, sizeof(nombre), "%d semanas", semanas);
+        imprimir(nombre, timeouts[i], &m[i]);
+        comprobar_metricas(&m[i], timeouts[i]);
+        if (i > 0) {
+            COMPROBAR_IGUAL(m[i].llegadas, m[0].llegadas);
+        }
+    }
+    // Un timeout más largo cambia apagados en falso por relé encendido sin nadie
+    COMPROBAR(m[0].apagados_en_falso > m[num - 1].apagados_en_falso);
+    COMPROBAR(m[0].desperdicio_s < m[num - 1].desperdicio_s);
+}
+
+int main(int argc, char **argv)
+{
+    int semanas = argc > 1 ? atoi(argv[1]) : SEMANAS_POR_DEFECTO;
+    COMPROBAR(semanas > 0);
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    const esp_timer_create_args_t args = {
+        .callback = anuncio_cb,
+        .name = "anuncio_tag",
+    };
+    COMPROBAR(esp_timer_create(&args, &s_sim.anuncio) == ESP_OK);
+
+    probar_lunes_grabado();
+    probar_semanas_sinteticas(semanas);
+    printf("test_estado_automatico: OK\n");
+    return 0;
+}
@@ -0,0 +1,321 @@
+// json_writer: escapado, anidamiento, desbordamiento, arrays largos y coste frente a snprintf y cJSON
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "json_writer.h"
+#include "prueba.h"
+#ifdef PRUEBA_CON_CJSON
+#include "cJSON.h"
+#endif
+
+#define ITERACIONES_BENCH   200000
+#define PILA_MEDIDA         (64 * 1024)
+#define PATRON_PILA         0xA5
+
+static void probar_basico(void)
+{
+    char buf[200];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "a", "x\"y\n\x01");
+    json_writer_int(&w, "n", -12);
+    json_writer_float(&w, "f", 1.25f, 2);
+    json_writer_bool(&w, "b", false);
+    json_writer_str(&w, "nulo", NULL);
+    json_writer_array(&w, "arr");
+    json_writer_int(&w, NULL, 1);
+    json_writer_objeto(&w, NULL);
+    json_writer_uint(&w, "u", UINT64_MAX);
+    // terminar() cierra lo que quede abierto
+    const char *json = json_writer_terminar(&w);
+    COMPROBAR(json != NULL);
+    COMPROBAR(strcmp(json, "{\"a\":\"x\\\"y\\n\\u0001\",\"n\":-12,\"f\":1.25,\"b\":false,\"nulo\":null,"
+                           "\"arr\":[1,{\"u\":18446744073709551615}]}") == 0);
+    COMPROBAR_IGUAL(w.longitud, strlen(json));
+}
+
+static void probar_desbordamiento(void)
+{
+    char buf[10];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "abc", "defgh");
+    COMPROBAR(json_writer_terminar(&w) == NULL);
+    COMPROBAR_IGUAL(buf[0], '\0');
+
+    // Justo al límite: 9 caracteres y el '\0'
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_objeto(&w, NULL);
+    json_writer_str(&w, "a", "b");
+    const char *json = json_writer_terminar(&w);
+    COMPROBAR(json != NULL && strcmp(json, "{\"a\":\"b\"}") == 0);
+
+    // Más niveles de los que admite
+    char grande[64];
+    json_writer_init(&w, grande, sizeof(grande));
+    for (int i = 0; i <= JSON_WRITER_MAX_PROFUNDIDAD; i++) {
+        json_writer_array(&w, NULL);
+    }
+    COMPROBAR(json_writer_terminar(&w) == NULL);
+}
+
+/*
+ * Con un contador de 8 bits el elemento 257 (contador de vuelta a 0) salía
+ * sin coma. Se compara con el mismo array construido a mano.
+ */
+static void probar_array_largo(void)
+{
+    static char buf[8192];
+    static char esperado[8192];
+    json_writer_t w;
+    size_t n = 0;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_objeto(&w, NULL);
+    json_writer_array(&w, "v");
+    n += snprintf(esperado + n, sizeof(esperado) - n, "{\"v\":[");
+    for (int i = 0; i < 1000; i++) {
+        json_writer_int(&w, NULL, i);
+        n += snprintf(esperado + n, sizeof(esperado) - n, "%s%d", i ? "," : "", i);
+    }
+    json_writer_cerrar(&w);
+    json_writer_int(&w, "fin", 1);
+    snprintf(esperado + n, sizeof(esperado) - n, "],\"fin\":1}");
+
+    const char *json = json_writer_terminar(&w);
+    COMPROBAR(json != NULL);
+    COMPROBAR(strcmp(json, esperado) == 0);
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Mensaje de telemetría térmica, con los mismos campos que publica ble_scanner
+static size_t codificar_telemetria(char *buf, size_t capacidad, float temp, uint32_t detecciones)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, capacidad);
+    json_writer_objeto(&w, NULL);
+    json_writer_float(&w, "temp", temp, 1);
+    json_writer_str(&w, "modo_termico", "WARNING");
+    json_writer_str(&w, "duty_cycle", "37.5%");
+    json_writer_float(&w, "temp_max", 61.2f, 1);
+    json_writer_uint(&w, "detecciones", detecciones);
+    json_writer_uint(&w, "tiempo_critico", 3600);
+    json_writer_uint(&w, "tiempo_emergencia", 120);
+    json_writer_str(&w, "trabajo", "INTENSIVO_AUSENTE");
+    json_writer_str(&w, "estado_cuadro", "TIBIO");
+    json_writer_uint(&w, "intervalo_escaneo", 60);
+    json_writer_uint(&w, "reinicios_gap", 7);
+    json_writer_uint(&w, "cambios_suprimidos", 3);
+    return json_writer_terminar(&w) != NULL ? w.longitud : 0;
+}
+
+/*
+ * Camino anterior (mqtt_service_enviar_json antes de json_writer): pares
+ * clave/valor de texto con snprintf en un buffer de 512 bytes en la pila. Los
+ * números se formateaban antes a cadenas y salían entre comillas.
+ */
+static size_t codificar_snprintf_va(char *json_buffer, size_t capacidad, ...)
+{
+    char *ptr = json_buffer;
+    int remaining = (int)capacidad;
+    va_list args;
+    va_start(args, capacidad);
+
+    int written = snprintf(ptr, remaining, "{");
+    ptr += written;
+    remaining -= written;
+
+    int first = 1;
+    const char *clave;
+    while ((clave = va_arg(args, const char *)) != NULL) {
+        const char *valor = va_arg(args, const char *);
+        if (!valor) break;
+
+        written = snprintf(ptr, remaining, "%s\"%s\":\"%s\"", first ? "" : ",", clave, valor);
+        ptr += written;
+        remaining -= written;
+        first = 0;
+    }
+
+    snprintf(ptr, remaining, "}");
+    va_end(args);
+    return strlen(json_buffer);
+}
+
+static size_t codificar_snprintf(char *buf, size_t capacidad, float temp, uint32_t detecciones)
+{
+    char temp_str[16], temp_max_str[16], detecciones_str[16];
+    snprintf(temp_str, sizeof(temp_str), "%.1f", temp);
+    snprintf(temp_max_str, sizeof(temp_max_str), "%.1f", 61.2f);
+    snprintf(detecciones_str, sizeof(detecciones_str), "%lu", (unsigned long)detecciones);
+    return codificar_snprintf_va(buf, capacidad,
+                                 "temp", temp_str, "modo_termico", "WARNING", "duty_cycle", "37.5%",
+                                 "temp_max", temp_max_str, "detecciones", detecciones_str,
+                                 "tiempo_critico", "3600", "tiempo_emergencia", "120",
+                                 "trabajo", "INTENSIVO_AUSENTE", "estado_cuadro", "TIBIO",
+                                 "intervalo_escaneo", "60", "reinicios_gap", "7", "cambios_suprimidos", "3",
+                                 NULL);
+}
+
+#ifdef PRUEBA_CON_CJSON
+static size_t s_cjson_reservas;
+static size_t s_cjson_bytes;
+
+static void *contar_malloc(size_t n)
+{
+    s_cjson_reservas++;
+    s_cjson_bytes += n;
+    return malloc(n);
+}
+
+// Árbol de cJSON e impresión en el buffer del llamador, sin la copia de cJSON_Print
+static size_t codificar_cjson(char *buf, size_t capacidad, float temp, uint32_t detecciones)
+{
+    cJSON *raiz = cJSON_CreateObject();
+    // Redondeo a una décima: si no, el float sale como 48.70000076293945
+    cJSON_AddNumberToObject(raiz, "temp", lroundf(temp * 10.0f) / 10.0);
+    cJSON_AddStringToObject(raiz, "modo_termico", "WARNING");
+    cJSON_AddStringToObject(raiz, "duty_cycle", "37.5%");
+    cJSON_AddNumberToObject(raiz, "temp_max", 61.2);
+    cJSON_AddNumberToObject(raiz, "detecciones", detecciones);
+    cJSON_AddNumberToObject(raiz, "tiempo_critico", 3600);
+    cJSON_AddNumberToObject(raiz, "tiempo_emergencia", 120);
+    cJSON_AddStringToObject(raiz, "trabajo", "INTENSIVO_AUSENTE");
+    cJSON_AddStringToObject(raiz, "estado_cuadro", "TIBIO");
+    cJSON_AddNumberToObject(raiz, "intervalo_escaneo", 60);
+    cJSON_AddNumberToObject(raiz, "reinicios_gap", 7);
+    cJSON_AddNumberToObject(raiz, "cambios_suprimidos", 3);
+    bool ok = cJSON_PrintPreallocated(raiz, buf, (int)capacidad, false);
+    cJSON_Delete(raiz);
+    return ok ? strlen(buf) : 0;
+}
+#endif
+
+typedef size_t (*codificador_t)(char *buf, size_t capacidad, float temp, uint32_t detecciones);
+
+/*
+ * Pila usada por un mensaje, como uxTaskGetStackHighWaterMark: se ejecuta en un
+ * hilo con una pila propia rellena de un patrón y se busca el primer byte
+ * tocado. Incluye el buffer de salida, que en el firmware también está en la
+ * pila de la tarea que publica.
+ */
+static void *un_mensaje(void *arg)
+{
+    char buf[512];
+    volatile size_t bytes = ((codificador_t)arg)(buf, sizeof(buf), 48.7f, 1234);
+    (void)bytes;
+    return NULL;
+}
+
+static void *nada(void *arg)
+{
+    return NULL;
+}
+
+static size_t pila_bruta(void *(*cuerpo)(void *), codificador_t codificador)
+{
+    void *pila;
+    pthread_attr_t attr;
+    pthread_t hilo;
+
+    COMPROBAR_IGUAL(posix_memalign(&pila, 4096, PILA_MEDIDA), 0);
+    memset(pila, PATRON_PILA, PILA_MEDIDA);
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, pila, PILA_MEDIDA);
+    COMPROBAR_IGUAL(pthread_create(&hilo, &attr, cuerpo, (void *)codificador), 0);
+    pthread_join(hilo, NULL);
+    pthread_attr_destroy(&attr);
+
+    // La pila crece hacia abajo: lo no tocado queda al principio del bloque
+    size_t libre = 0;
+    while (libre < PILA_MEDIDA && ((uint8_t *)pila)[libre] == PATRON_PILA) {
+        libre++;
+    }
+    free(pila);
+    return PILA_MEDIDA - libre;
+}
+
+static size_t pila_usada(codificador_t codificador)
+{
+    // Se descuenta lo que glibc usa al arrancar un hilo vacío (TLS y arranque)
+    return pila_bruta(un_mensaje, codificador) - pila_bruta(nada, NULL);
+}
+
+typedef struct {
+    size_t bytes;
+    double ns;
+    size_t pila;
+} medida_t;
+
+static medida_t medir_codificador(codificador_t codificador, char *ultimo, size_t capacidad)
+{
+    medida_t m = {0};
+    double t0 = ahora_s();
+    for (int i = 0; i < ITERACIONES_BENCH; i++) {
+        m.bytes = codificador(ultimo, capacidad, 48.7f + (i & 7), (uint32_t)i);
+    }
+    double t1 = ahora_s();
+    COMPROBAR(m.bytes > 0);
+    m.ns = (t1 - t0) / ITERACIONES_BENCH * 1e9;
+    m.pila = pila_usada(codificador);
+    return m;
+}
+
+static void imprimir(const char *nombre, const medida_t *m)
+{
+    printf("telemetría JSON %-11s %3zu bytes, %5.0f ns por mensaje, %6.1f MB/s, pila %5zu bytes (host)\n",
+           nombre, m->bytes, m->ns, m->bytes / m->ns * 1e3, m->pila);
+}
+
+static void medir(void)
+{
+    char buf[512];
+    char referencia[512];
+
+    // El mismo mensaje en los tres caminos: el último de la serie
+    medida_t writer = medir_codificador(codificar_telemetria, referencia, sizeof(referencia));
+    imprimir("json_writer", &writer);
+
+    medida_t antiguo = medir_codificador(codificar_snprintf, buf, sizeof(buf));
+    imprimir("snprintf", &antiguo);
+    // El camino antiguo lo entrecomilla todo: más bytes y números como texto
+    COMPROBAR(antiguo.bytes > writer.bytes);
+    COMPROBAR(strstr(buf, "\"detecciones\":\"") != NULL);
+    // Sin comparar la pila: los dos pasan por el vfprintf de glibc (json_writer
+    // para los float), que domina la medida y no es el de newlib del firmware
+    COMPROBAR(writer.pila > 0 && antiguo.pila > 0);
+
+#ifdef PRUEBA_CON_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = contar_malloc, .free_fn = free };
+    cJSON_InitHooks(&hooks);
+    medida_t cjson = medir_codificador(codificar_cjson, buf, sizeof(buf));
+    imprimir("cJSON", &cjson);
+    printf("cJSON: %.1f reservas y %.0f bytes de montón por mensaje; json_writer y snprintf: 0 (host)\n",
+           (double)s_cjson_reservas / ITERACIONES_BENCH, (double)s_cjson_bytes / ITERACIONES_BENCH);
+    // Mismos campos, tipos y orden: cJSON y json_writer dan el mismo texto
+    COMPROBAR(strcmp(buf, referencia) == 0);
+#else
+    printf("telemetría JSON cJSON: sin cJSON en el host (IDF_PATH o libcjson), referencia omitida\n");
+#endif
+}
+
+int main(void)
+{
+    probar_basico();
+    probar_desbordamiento();
+    probar_array_largo();
+    medir();
+    printf("test_json_writer: OK\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Ejecutor de comandos: acks, y parada ordenada de la tarea (desde fuera y desde un comando)
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mqtt_comandos.h"
+#include "mqtt_service.h"
+#include "wifi_sta.h"
+#include "prueba.h"
+
+// Acks publicados, por estado
+static int s_aceptados, s_completados, s_fallidos;
+static int s_ejecutados;
+
+static void contar_ack(const json_writer_t *w)
+{
+    const char *json = w->buf;
+    if (strstr(json, "\"aceptado\"") != NULL) {
+        s_aceptados++;
+    } else if (strstr(json, "\"completado\"") != NULL) {
+        s_completados++;
+    } else if (strstr(json, "\"fallido\"") != NULL) {
+        s_fallidos++;
+    }
+}
+
+esp_err_t mqtt_service_enviar_json_writer(const char *topic, json_writer_t *w, int qos, int retain)
+{
+    COMPROBAR(strcmp(topic, "dispositivos/aabbccddeeff/respuesta") == 0);
+    contar_ack(w);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_service_enviar_respuesta(const char *topic, json_writer_t *w, int qos,
+                                        const void *correlacion, size_t correlacion_len)
+{
+    contar_ack(w);
+    return ESP_OK;
+}
+
+const char *sta_wifi_get_mac_clean(void)
+{
+    return "aabbccddeeff";
+}
+
+static esp_err_t comando_lento(const void *params)
+{
+    vTaskDelay(pdMS_TO_TICKS(*(const int *)params));
+    s_ejecutados++;
+    return ESP_OK;
+}
+
+// Como un cambio a modo configuración: detiene el servicio desde el propio ejecutor
+static esp_err_t comando_detener(const void *params)
+{
+    mqtt_comandos_detener();
+    if (params != NULL && *(const bool *)params) {
+        mqtt_comandos_iniciar();    // Vuelta atrás antes de que la tarea salga
+    }
+    s_ejecutados++;
+    return ESP_OK;
+}
+
+static void esperar_ejecutados(int n)
+{
+    for (int i = 0; i < 2000 && s_ejecutados < n; i++) {
+        vTaskDelay(1);
+    }
+    COMPROBAR_IGUAL(s_ejecutados, n);
+}
+
+static void probar_acks(void)
+{
+    int ms = 1;
+    s_ejecutados = s_aceptados = s_completados = 0;
+    COMPROBAR(mqtt_comandos_iniciar() == ESP_OK);
+    COMPROBAR(mqtt_comandos_encolar("lento", "c1", NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    esperar_ejecutados(2);
+    freertos_host_esperar_reposo();
+    COMPROBAR_IGUAL(s_aceptados, 1);     // Sin id no hay acks
+    COMPROBAR_IGUAL(s_completados, 1);
+
+    mqtt_comando_metricas_t m[MQTT_COMANDO_MAX_TIPOS];
+    COMPROBAR_IGUAL(mqtt_comandos_obtener_metricas(m, MQTT_COMANDO_MAX_TIPOS), 1);
+    COMPROBAR_IGUAL(m[0].ejecutados, 2);
+}
+
+/*
+ * Parada con un comando en curso: termina el comando, descarta los de la cola
+ * y la tarea sale por sí misma (el doble de FreeRTOS aborta si se borra otra
+ * tarea con vTaskDelete).
+ */
+static void probar_parada_con_comando_en_curso(void)
+{
+    int ms = 200;
+    s_ejecutados = 0;
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    mqtt_comandos_detener();
+    COMPROBAR_IGUAL(s_ejecutados, 1);
+
+    // Sin ejecutor lo encolado espera al siguiente inicio
+    int corto = 1;
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &corto, sizeof(corto)) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    COMPROBAR_IGUAL(s_ejecutados, 1);
+
+    COMPROBAR(mqtt_comandos_iniciar() == ESP_OK);
+    esperar_ejecutados(2);
+    mqtt_comandos_detener();
+    mqtt_comandos_detener();    // Idempotente
+}
+
+static void probar_parada_desde_un_comando(void)
+{
+    int ms = 1;
+    bool reiniciar = false;
+    s_ejecutados = 0;
+    COMPROBAR(mqtt_comandos_iniciar() == ESP_OK);
+    COMPROBAR(mqtt_comandos_encolar("detener", NULL, NULL, comando_detener, &reiniciar, sizeof(reiniciar)) == ESP_OK);
+    esperar_ejecutados(1);
+    freertos_host_esperar_reposo();
+
+    // La tarea salió al terminar el comando: lo siguiente no se ejecuta hasta iniciar
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    COMPROBAR_IGUAL(s_ejecutados, 1);
+    COMPROBAR(mqtt_comandos_iniciar() == ESP_OK);
+    esperar_ejecutados(2);
+
+    // Parar y volver a iniciar dentro del mismo comando: la tarea sigue siendo el ejecutor
+    reiniciar = true;
+    COMPROBAR(mqtt_comandos_encolar("detener", NULL, NULL, comando_detener, &reiniciar, sizeof(reiniciar)) == ESP_OK);
+    esperar_ejecutados(3);
+    COMPROBAR(mqtt_comandos_encolar("lento", NULL, NULL, comando_lento, &ms, sizeof(ms)) == ESP_OK);
+    esperar_ejecutados(4);
+    mqtt_comandos_detener();
+}
+
+int main(void)
+{
+    alarm(60);  // Una confirmación de salida que no llega cuelga la prueba
+    probar_acks();
+    probar_parada_con_comando_en_curso();
+    probar_parada_desde_un_comando();
+    printf("test_mqtt_comandos: OK\n");
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Outbox en flash: 10k mensajes sin conexión, reinicios, cortes de luz y desbordamiento
+#include <string.h>
+#include <time.h>
+#include "esp_partition.h"
+#include "prueba.h"
+
+/*
+ * Se incluye el .c para simular el reinicio: sus estáticas vuelven a cero y
+ * mqtt_outbox_init() reconstruye el estado leyendo solo la flash.
+ */
+#include "../../components/mqtt_service/mqtt_outbox.c"
+
+#define TOPIC           "dispositivos/aabbccddeeff/rele"
+#define MENSAJES        10000
+
+static char s_topic[MQTT_OUTBOX_MAX_TOPIC];
+static char s_datos[MQTT_OUTBOX_MAX_MENSAJE];
+
+static double ahora_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void reiniciar(void)
+{
+    s_particion = NULL;
+    s_num_sectores = 0;
+    s_cola = 0;
+    s_escritura = (posicion_t){0};
+    s_lectura = (posicion_t){0};
+    s_seq = 0;
+    memset(&s_estadisticas, 0, sizeof(s_estadisticas));
+    esp_partition_host.corte_tras = -1;
+    COMPROBAR(mqtt_outbox_init() == ESP_OK);
+}
+
+static void agregar(uint32_t n)
+{
+    char datos[64];
+    int l = snprintf(datos, sizeof(datos), "{\"e\":%u,\"n\":%u}", n & 1, n);
+    COMPROBAR(mqtt_outbox_agregar(TOPIC, datos, l, 1, 0) == ESP_OK);
+}
+
+// Número del siguiente mensaje pendiente, o -1 si no hay
+static long siguiente(mqtt_outbox_entrada_t *entrada)
+{
+    unsigned estado, n;
+    if (mqtt_outbox_siguiente(entrada, s_topic, s_datos) != ESP_OK) {
+        return -1;
+    }
+    s_datos[entrada->longitud] = '\0';
+    COMPROBAR(strcmp(s_topic, TOPIC) == 0);
+    COMPROBAR(sscanf(s_datos, "{\"e\":%u,\"n\":%u}", &estado, &n) == 2);
+    COMPROBAR_IGUAL(estado, n & 1);
+    COMPROBAR_IGUAL(entrada->qos, 1);
+    return n;
+}
+
+static void probar_recuperacion_10k(void)
+{
+    mqtt_outbox_entrada_t entrada;
+
+    esp_partition_host_formatear();
+    reiniciar();
+    double t0 = ahora_ms();
+    for (uint32_t i = 0; i < MENSAJES; i++) {
+        agregar(i);
+    }
+    double t_agregar = ahora_ms() - t0;
+    COMPROBAR_IGUAL(s_estadisticas.descartados, 0);
+
+    // Dos reinicios seguidos sin conexión: no se pierde ni se duplica nada
+    reiniciar();
+    reiniciar();
+    COMPROBAR_IGUAL(s_estadisticas.pendientes, MENSAJES);
+
+    // Reenvío con un reinicio a mitad: lo confirmado no vuelve
+    for (long i = 0; i < MENSAJES / 2; i++) {
+        COMPROBAR_IGUAL(siguiente(&entrada), i);
+        COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+    }
+    t0 = ahora_ms();
+    reiniciar();
+    double t_recuperar = ahora_ms() - t0;
+    COMPROBAR_IGUAL(s_estadisticas.pendientes, MENSAJES / 2);
+    t0 = ahora_ms();
+    for (long i = MENSAJES / 2; i < MENSAJES; i++) {
+        COMPROBAR_IGUAL(siguiente(&entrada), i);
+        COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+    }
+    double t_reenviar = (ahora_ms() - t0) * 2;
+    COMPROBAR_IGUAL(siguiente(&entrada), -1);
+    COMPROBAR(!mqtt_outbox_pendiente());
+
+    // Solo la lógica del outbox sobre RAM: en el ESP32 dominan las escrituras y borrados de flash
+    printf("10k: agregar %.1f ms, recuperar %.1f ms, leer y confirmar %.1f ms (host)\n",
+           t_agregar, t_recuperar, t_reenviar);
+    printf("10k: %u escrituras, %u sectores borrados, sector más gastado %u borrados; "
+           "al ritmo de reenvío (%d ms) se vacía en %d s\n",
+           esp_partition_host.escrituras, esp_partition_host.borrados,
+           esp_partition_host.borrados_max_sector, MQTT_OUTBOX_INTERVALO_REENVIO_MS,
+           MENSAJES * MQTT_OUTBOX_INTERVALO_REENVIO_MS / 1000);
+}
+
+/*
+ * Corte de luz en cada una de las escrituras de un agregar y de un confirmar:
+ * lo que ya era VALIDO se conserva, lo cortado no se entrega a medias y el
+ * outbox sigue aceptando mensajes tras reiniciar.
+ */
+static void probar_cortes_de_luz(void)
+{
+    mqtt_outbox_entrada_t entrada;
+
+    // agregar() escribe cabecera, topic, payload y estado
+    for (int corte = 1; corte <= 4; corte++) {
+        esp_partition_host_formatear();
+        reiniciar();
+        for (uint32_t i = 0; i < 100; i++) {
+            agregar(i);
+        }
+        esp_partition_host.corte_tras = corte;
+        agregar(100);
+        reiniciar();
+        agregar(101);
+
+        for (long i = 0; i < 100; i++) {
+            COMPROBAR_IGUAL(siguiente(&entrada), i);
+            COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+        }
+        COMPROBAR_IGUAL(siguiente(&entrada), 101);
+        COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+        COMPROBAR_IGUAL(siguiente(&entrada), -1);
+    }
+
+    // Corte al confirmar: entrega al menos una vez, el mensaje vuelve tras reiniciar
+    esp_partition_host_formatear();
+    reiniciar();
+    agregar(0);
+    agregar(1);
+    COMPROBAR_IGUAL(siguiente(&entrada), 0);
+    esp_partition_host.corte_tras = 1;
+    mqtt_outbox_confirmar(&entrada);
+    reiniciar();
+    COMPROBAR_IGUAL(siguiente(&entrada), 0);
+}
+
+// Reenvíos parciales, reinicios y llenado al azar: el orden nunca retrocede
+static void probar_aleatorio(void)
+{
+    mqtt_outbox_entrada_t entrada;
+    uint32_t escritos = 0;
+    long esperado = 0;
+
+    esp_partition_host_formatear();
+    reiniciar();
+    srand(1234);
+    for (int ronda = 0; ronda < 50; ronda++) {
+        int n = rand() % 400;
+        for (int i = 0; i < n; i++) {
+            agregar(escritos++);
+        }
+        if (rand() % 3 == 0) {
+            reiniciar();
+        }
+        int k = rand() % 500;
+        for (int i = 0; i < k; i++) {
+            long n_leido = siguiente(&entrada);
+            if (n_leido < 0) {
+                break;
+            }
+            COMPROBAR(n_leido >= esperado);
+            esperado = n_leido + 1;
+            COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+            if (rand() % 50 == 0) {
+                reiniciar();
+            }
+        }
+    }
+    for (long n_leido; (n_leido = siguiente(&entrada)) >= 0;) {
+        COMPROBAR(n_leido >= esperado);
+        esperado = n_leido + 1;
+        COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+    }
+    COMPROBAR_IGUAL(esperado, escritos);
+}
+
+// Outbox lleno: se descartan los más antiguos, el resto sale en orden y hasta el último
+static void probar_desbordamiento(void)
+{
+    mqtt_outbox_entrada_t entrada;
+    const uint32_t total = 2 * MENSAJES;
+
+    esp_partition_host_formatear();
+    reiniciar();
+    for (uint32_t i = 0; i < total; i++) {
+        agregar(i);
+    }
+    uint32_t descartados = s_estadisticas.descartados;
+    COMPROBAR(descartados > 0);
+    reiniciar();
+
+    long primero = siguiente(&entrada), anterior = primero - 1;
+    COMPROBAR(primero > 0);
+    for (long n_leido = primero; n_leido >= 0; n_leido = siguiente(&entrada)) {
+        COMPROBAR_IGUAL(n_leido, anterior + 1);
+        anterior = n_leido;
+        COMPROBAR(mqtt_outbox_confirmar(&entrada) == ESP_OK);
+    }
+    COMPROBAR_IGUAL(anterior, total - 1);
+    COMPROBAR_IGUAL(primero, descartados);
+    printf("desbordamiento: %u de %u descartados, entregados %ld..%ld\n",
+           descartados, total, primero, anterior);
+}
+
+int main(void)
+{
+    probar_recuperacion_10k();
+    probar_cortes_de_luz();
+    probar_aleatorio();
+    probar_desbordamiento();
+    printf("test_mqtt_outbox: OK\n");
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Reensamblado de MQTT_EVENT_DATA: mensajes de hasta 16 KB en muchos fragmentos, descartes y memoria
+#include <stdlib.h>
+#include <string.h>
+#include "prueba.h"
+
+/*
+ * Con PSRAM, como el firmware con CONFIG_SPIRAM=y: se incluye el .c para
+ * compilarlo con la opción y empezar cada prueba con un reensamblador nuevo.
+ */
+#define CONFIG_SPIRAM 1
+#include "../../components/mqtt_service/mqtt_reensamblador.c"
+
+#define TOPIC       "dispositivos/aabbccddeeff"
+#define MENSAJES    2000
+
+// Memoria falsa: cuenta las reservas y puede quedarse sin PSRAM o sin nada
+static struct {
+    int reservas;
+    uint32_t ultimas_caps;
+    bool sin_psram;
+    bool sin_interna;
+} s_heap;
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    s_heap.ultimas_caps = caps;
+    if ((caps & MALLOC_CAP_SPIRAM) ? s_heap.sin_psram : s_heap.sin_interna) {
+        return NULL;
+    }
+    s_heap.reservas++;
+    return malloc(size);
+}
+
+static char s_mensaje[MQTT_MAX_MENSAJE_RECIBIDO + 1];
+
+static void rellenar(size_t total, uint32_t semilla)
+{
+    for (size_t i = 0; i < total; i++) {
+        semilla = semilla * 1103515245u + 12345u;
+        s_mensaje[i] = (char)(semilla >> 16);
+    }
+}
+
+/*
+ * Entrega el mensaje como el cliente MQTT: el tópico solo en el primer evento
+ * y fragmentos de 'fragmento' bytes. Devuelve el resultado del último.
+ */
+static mqtt_reensamblado_t enviar(mqtt_reensamblador_t *r, size_t total, size_t fragmento)
+{
+    mqtt_reensamblado_t res = MQTT_REENSAMBLADO_INCOMPLETO;
+    for (size_t offset = 0; offset < total; offset += fragmento) {
+        size_t longitud = total - offset < fragmento ? total - offset : fragmento;
+        res = mqtt_reensamblador_agregar(r, offset ? NULL : TOPIC, offset ? 0 : strlen(TOPIC),
+                                         s_mensaje + offset, longitud, offset, total);
+        if (offset + longitud < total) {
+            COMPROBAR(res != MQTT_REENSAMBLADO_COMPLETO);
+        }
+    }
+    return res;
+}
+
+static void comprobar_completo(const mqtt_reensamblador_t *r, size_t total)
+{
+    COMPROBAR_IGUAL(r->total, total);
+    COMPROBAR(strcmp(r->topic, TOPIC) == 0);
+    COMPROBAR_IGUAL(r->topic_len, strlen(TOPIC));
+    COMPROBAR(memcmp(r->buf, s_mensaje, total) == 0);
+}
+
+// 16 KB con fragmentos desde 1 byte hasta el mensaje entero; un único buffer para todos
+static void probar_16k(void)
+{
+    static const size_t fragmentos[] = {1, 7, 100, 1024, 4095, 4096, 8191, 16383, 16384};
+    mqtt_reensamblador_t r;
+    memset(&s_heap, 0, sizeof(s_heap));
+    mqtt_reensamblador_init(&r, MQTT_MAX_MENSAJE_RECIBIDO);
+
+    for (size_t i = 0; i < sizeof(fragmentos) / sizeof(fragmentos[0]); i++) {
+        rellenar(MQTT_MAX_MENSAJE_RECIBIDO, (uint32_t)i);
+        COMPROBAR_IGUAL(enviar(&r, MQTT_MAX_MENSAJE_RECIBIDO, fragmentos[i]), MQTT_REENSAMBLADO_COMPLETO);
+        comprobar_completo(&r, MQTT_MAX_MENSAJE_RECIBIDO);
+    }
+    COMPROBAR_IGUAL(s_heap.reservas, 1);
+    COMPROBAR(s_heap.ultimas_caps & MALLOC_CAP_SPIRAM);
+    free(r.buf);
+}
+
+// Tamaños y fragmentos al azar hasta 16 KB, seguidos en el mismo reensamblador
+static void probar_aleatorio(void)
+{
+    mqtt_reensamblador_t r;
+    memset(&s_heap, 0, sizeof(s_heap));
+    mqtt_reensamblador_init(&r, MQTT_MAX_MENSAJE_RECIBIDO);
+    srand(14);
+
+    for (int i = 0; i < MENSAJES; i++) {
+        size_t total = 1 + (size_t)rand() % MQTT_MAX_MENSAJE_RECIBIDO;
+        size_t fragmento = 1 + (size_t)rand() % 2048;
+        rellenar(total, (uint32_t)i);
+        COMPROBAR_IGUAL(enviar(&r, total, fragmento), MQTT_REENSAMBLADO_COMPLETO);
+        comprobar_completo(&r, total);
+    }
+    COMPROBAR_IGUAL(s_heap.reservas, 1);
+    free(r.buf);
+}
+
+static void probar_descartes(void)
+{
+    mqtt_reensamblador_t r;
+    memset(&s_heap, 0, sizeof(s_heap));
+    mqtt_reensamblador_init(&r, MQTT_MAX_MENSAJE_RECIBIDO);
+    rellenar(MQTT_MAX_MENSAJE_RECIBIDO + 1, 3);
+
+    // Mayor que el máximo: se descarta sin reservar y se ignora el resto de sus fragmentos
+    COMPROBAR_IGUAL(enviar(&r, MQTT_MAX_MENSAJE_RECIBIDO + 1, 1024), MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, TOPIC, strlen(TOPIC), s_mensaje, 1024, 0,
+                                               MQTT_MAX_MENSAJE_RECIBIDO + 1), MQTT_REENSAMBLADO_DESCARTADO);
+    COMPROBAR_IGUAL(s_heap.reservas, 0);
+
+    // Un fragmento que se salta bytes descarta el mensaje; el siguiente llega entero
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, TOPIC, strlen(TOPIC), s_mensaje, 100, 0, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje + 200, 100, 200, 300),
+                    MQTT_REENSAMBLADO_DESCARTADO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje + 100, 100, 100, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(enviar(&r, 300, 100), MQTT_REENSAMBLADO_COMPLETO);
+    comprobar_completo(&r, 300);
+
+    // total_data_len que cambia a mitad o un fragmento que se pasa del total
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, TOPIC, strlen(TOPIC), s_mensaje, 100, 0, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje + 100, 100, 100, 400),
+                    MQTT_REENSAMBLADO_DESCARTADO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, TOPIC, strlen(TOPIC), s_mensaje, 100, 0, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje + 100, 300, 100, 300),
+                    MQTT_REENSAMBLADO_DESCARTADO);
+
+    // Un mensaje nuevo abandona el que quedó a medias
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, TOPIC, strlen(TOPIC), s_mensaje, 100, 0, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(enviar(&r, 5000, 1000), MQTT_REENSAMBLADO_COMPLETO);
+    comprobar_completo(&r, 5000);
+
+    // Primer fragmento sin tópico o con uno que no cabe
+    char largo[MQTT_ROUTER_MAX_TOPIC];
+    memset(largo, 't', sizeof(largo));
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje, 100, 0, 300), MQTT_REENSAMBLADO_DESCARTADO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, largo, sizeof(largo), s_mensaje, 100, 0, 300),
+                    MQTT_REENSAMBLADO_DESCARTADO);
+    COMPROBAR_IGUAL(mqtt_reensamblador_agregar(&r, NULL, 0, s_mensaje + 100, 200, 100, 300),
+                    MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR_IGUAL(s_heap.reservas, 1);
+    free(r.buf);
+}
+
+// Sin PSRAM se usa RAM interna; sin memoria se descarta y se reintenta con el siguiente mensaje
+static void probar_memoria(void)
+{
+    mqtt_reensamblador_t r;
+    memset(&s_heap, 0, sizeof(s_heap));
+    mqtt_reensamblador_init(&r, MQTT_MAX_MENSAJE_RECIBIDO);
+    rellenar(4096, 5);
+
+    s_heap.sin_psram = true;
+    s_heap.sin_interna = true;
+    COMPROBAR_IGUAL(enviar(&r, 4096, 1024), MQTT_REENSAMBLADO_INCOMPLETO);
+    COMPROBAR(r.buf == NULL);
+
+    s_heap.sin_interna = false;
+    COMPROBAR_IGUAL(enviar(&r, 4096, 1024), MQTT_REENSAMBLADO_COMPLETO);
+    comprobar_completo(&r, 4096);
+    COMPROBAR_IGUAL(s_heap.reservas, 1);
+    COMPROBAR(!(s_heap.ultimas_caps & MALLOC_CAP_SPIRAM));
+    free(r.buf);
+}
+
+int main(void)
+{
+    probar_16k();
+    probar_aleatorio();
+    probar_descartes();
+    probar_memoria();
+    printf("test_mqtt_reensamblador: OK\n");
+    return 0;
+}
@@ -0,0 +1,221 @@
+// Router de tópicos: comodines, filtros no válidos, un análisis de JSON por mensaje y mensajes por segundo
+#include <string.h>
+#include <time.h>
+#include "prueba.h"
+
+/*
+ * Se incluye el .c para vaciar el árbol entre pruebas: las rutas son estáticas
+ * y en el firmware solo se registran al conectar.
+ */
+#include "../../components/mqtt_service/mqtt_router.c"
+
+#define MAC                 "aabbccddeeff"
+#define MENSAJES_BENCH      2000000
+
+// cJSON falso: cuenta los análisis y devuelve una raíz ficticia si el payload parece un objeto
+static int s_analisis, s_liberados;
+static char s_raiz;
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    s_analisis++;
+    return (buffer_length > 0 && value[0] == '{') ? (cJSON *)&s_raiz : NULL;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    if (item != NULL) {
+        s_liberados++;
+    }
+}
+
+// Qué manejadores recibieron el último mensaje, como bits de su arg
+static unsigned s_recibido;
+static const cJSON *s_json_visto;
+
+static void manejador(const mqtt_router_mensaje_t *mensaje, void *arg)
+{
+    s_recibido |= (unsigned)(uintptr_t)arg;
+    s_json_visto = mensaje->json;
+    COMPROBAR(strlen(mensaje->topic) < MQTT_ROUTER_MAX_TOPIC);
+}
+
+static void otro_manejador(const mqtt_router_mensaje_t *mensaje, void *arg)
+{
+    manejador(mensaje, arg);
+}
+
+static void reiniciar(void)
+{
+    s_nodos[0] = (nodo_t){ .hijo = NINGUNO, .hermano = NINGUNO, .ruta = NINGUNO };
+    s_num_nodos = 1;
+    s_num_rutas = 0;
+    s_analisis = s_liberados = 0;
+}
+
+static unsigned despachar(const char *topic, const char *datos)
+{
+    s_recibido = 0;
+    int num = mqtt_router_despachar(topic, strlen(topic), datos, strlen(datos), NULL);
+    COMPROBAR_IGUAL(num, __builtin_popcount(s_recibido));
+    return s_recibido;
+}
+
+enum { DISPOSITIVO = 1, OTA = 2, CMD = 4, TODO_DISPOSITIVOS = 8, TODO = 16 };
+
+static void probar_comodines(void)
+{
+    reiniciar();
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC, manejador, (void *)DISPOSITIVO) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("ota/" MAC, manejador, (void *)OTA) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/+/cmd", manejador, (void *)CMD) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/#", manejador, (void *)TODO_DISPOSITIVOS) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("#", manejador, (void *)TODO) == ESP_OK);
+
+    COMPROBAR_IGUAL(despachar("dispositivos/" MAC, "{}"), DISPOSITIVO | TODO_DISPOSITIVOS | TODO);
+    COMPROBAR_IGUAL(despachar("dispositivos/xx/cmd", "{}"), CMD | TODO_DISPOSITIVOS | TODO);
+    COMPROBAR_IGUAL(despachar("dispositivos/" MAC "/cmd/x", "{}"), TODO_DISPOSITIVOS | TODO);
+    // "a/#" coincide también con el nivel padre
+    COMPROBAR_IGUAL(despachar("dispositivos", "{}"), TODO_DISPOSITIVOS | TODO);
+    COMPROBAR_IGUAL(despachar("ota/" MAC, "{}"), OTA | TODO);
+    COMPROBAR_IGUAL(despachar("ota/otro", "{}"), TODO);
+    // Un nivel no es un prefijo
+    COMPROBAR_IGUAL(despachar("ota/" MAC "ff", "{}"), TODO);
+}
+
+static void probar_filtros(void)
+{
+    reiniciar();
+    char largo[MQTT_ROUTER_MAX_SEGMENTO + 8];
+    memset(largo, 'x', sizeof(largo) - 1);
+    largo[sizeof(largo) - 1] = '\0';
+
+    COMPROBAR(mqtt_router_registrar("a/#/b", manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar("a+/b", manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar("a/b#", manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar("", manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar(NULL, manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar("a", NULL, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR(mqtt_router_registrar(largo, manejador, NULL) == ESP_ERR_INVALID_ARG);
+    COMPROBAR_IGUAL(s_num_rutas, 0);
+
+    // Registrar otra vez (reconexión) solo actualiza arg
+    COMPROBAR(mqtt_router_registrar("ota/" MAC, manejador, (void *)OTA) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("ota/" MAC, manejador, (void *)DISPOSITIVO) == ESP_OK);
+    COMPROBAR_IGUAL(s_num_rutas, 1);
+    COMPROBAR_IGUAL(despachar("ota/" MAC, "{}"), DISPOSITIVO);
+
+    // Tópicos que no caben en el buffer del router no se entregan
+    char topic[MQTT_ROUTER_MAX_TOPIC + 1];
+    memset(topic, 'a', sizeof(topic) - 1);
+    topic[sizeof(topic) - 1] = '\0';
+    COMPROBAR(mqtt_router_registrar("#", manejador, (void *)TODO) == ESP_OK);
+    COMPROBAR_IGUAL(despachar(topic, "{}"), 0);
+    COMPROBAR_IGUAL(mqtt_router_despachar("ota", 0, "{}", 2, NULL), 0);
+}
+
+// Un solo análisis por mensaje entregado, ninguno si no hay ruta, y la misma vista para todos
+static void probar_un_analisis(void)
+{
+    reiniciar();
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC, manejador, (void *)DISPOSITIVO) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC, otro_manejador, (void *)CMD) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/+", manejador, (void *)TODO_DISPOSITIVOS) == ESP_OK);
+
+    COMPROBAR_IGUAL(despachar("dispositivos/" MAC, "{\"accion\":\"estado\"}"), DISPOSITIVO | CMD | TODO_DISPOSITIVOS);
+    COMPROBAR_IGUAL(s_analisis, 1);
+    COMPROBAR(s_json_visto == (const cJSON *)&s_raiz);
+
+    COMPROBAR_IGUAL(despachar("ota/" MAC, "{}"), 0);
+    COMPROBAR_IGUAL(s_analisis, 1);
+
+    // Payload que no es JSON: los manejadores lo reciben con json == NULL
+    COMPROBAR_IGUAL(despachar("dispositivos/" MAC, "reinicio"), DISPOSITIVO | CMD | TODO_DISPOSITIVOS);
+    COMPROBAR_IGUAL(s_analisis, 2);
+    COMPROBAR(s_json_visto == NULL);
+    COMPROBAR_IGUAL(s_liberados, 1);
+}
+
+static void probar_capacidad(void)
+{
+    char filtro[32];
+    reiniciar();
+    // Un nodo por filtro bajo la raíz: se acaban antes los nodos que las rutas
+    for (int i = 0; i < MQTT_ROUTER_MAX_NODOS - 1; i++) {
+        snprintf(filtro, sizeof(filtro), "n%d", i);
+        esp_err_t esperado = i < MQTT_ROUTER_MAX_RUTAS ? ESP_OK : ESP_ERR_NO_MEM;
+        COMPROBAR(mqtt_router_registrar(filtro, manejador, NULL) == esperado);
+    }
+    COMPROBAR(mqtt_router_registrar("otro/nivel", manejador, NULL) == ESP_ERR_NO_MEM);
+
+    // Varias rutas en el mismo nodo
+    reiniciar();
+    COMPROBAR(mqtt_router_registrar("a", manejador, (void *)DISPOSITIVO) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("a", otro_manejador, (void *)OTA) == ESP_OK);
+    COMPROBAR_IGUAL(s_num_nodos, 2);
+    COMPROBAR_IGUAL(despachar("a", "{}"), DISPOSITIVO | OTA);
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void manejador_bench(const mqtt_router_mensaje_t *mensaje, void *arg)
+{
+    (*(unsigned *)arg)++;
+}
+
+/*
+ * Las rutas del firmware (dispositivo y OTA) más comandos por tópico, y una
+ * mezcla de tópicos con uno sin ruta. El análisis de JSON es el falso: se mide
+ * solo el encaminamiento, lo que el router añade a cada mensaje.
+ */
+static void medir(void)
+{
+    static const char *const topics[] = {
+        "dispositivos/" MAC,
+        "ota/" MAC,
+        "dispositivos/" MAC "/cmd/rele",
+        "dispositivos/" MAC "/config",
+        "dispositivos/otro/cmd/rele",
+    };
+    const int num_topics = sizeof(topics) / sizeof(topics[0]);
+    unsigned entregados = 0;
+    size_t longitudes[sizeof(topics) / sizeof(topics[0])];
+
+    reiniciar();
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC, manejador_bench, &entregados) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("ota/" MAC, manejador_bench, &entregados) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC "/cmd/+", manejador_bench, &entregados) == ESP_OK);
+    COMPROBAR(mqtt_router_registrar("dispositivos/" MAC "/config", manejador_bench, &entregados) == ESP_OK);
+    for (int i = 0; i < num_topics; i++) {
+        longitudes[i] = strlen(topics[i]);
+    }
+
+    double t0 = ahora_s();
+    int encaminados = 0;
+    for (int i = 0; i < MENSAJES_BENCH; i++) {
+        int t = i % num_topics;
+        encaminados += mqtt_router_despachar(topics[t], longitudes[t], "{}", 2, NULL) > 0;
+    }
+    double t1 = ahora_s();
+
+    COMPROBAR_IGUAL(entregados, MENSAJES_BENCH / num_topics * (num_topics - 1));
+    COMPROBAR_IGUAL(encaminados, entregados);
+    printf("router: %.1f M mensajes/s, %.0f ns por mensaje con %u rutas (host, sin análisis JSON)\n",
+           MENSAJES_BENCH / (t1 - t0) / 1e6, (t1 - t0) / MENSAJES_BENCH * 1e9, s_num_rutas);
+}
+
+int main(void)
+{
+    probar_comodines();
+    probar_filtros();
+    probar_un_analisis();
+    probar_capacidad();
+    medir();
+    printf("test_mqtt_router: OK\n");
+    return 0;
+}
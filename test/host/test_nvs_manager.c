@@ -0,0 +1,408 @@
+// nvs_manager y ecokey_config sobre la NVS de RAM: borrado concurrente, migración, limitador, reintentos, un día de uso y retenidos MQTT
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ecokey_config.h"
+#include "nvs_manager.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "prueba.h"
+
+#define ITERACIONES     20000
+
+static volatile int s_parar;
+
+static void *modificador(void *arg)
+{
+    for (uint32_t i = 0; !s_parar; i++) {
+        ecokey_config_set_estado_rele(i & 1);
+        ecokey_config_set_temporizador(ECOKEY_CONFIG_TEMPORIZADOR_MIN + i % ECOKEY_CONFIG_TEMPORIZADOR_MAX);
+        ecokey_config_set_modo((i & 2) ? ECOKEY_MODO_MANUAL : ECOKEY_MODO_AUTOMATICO);
+    }
+    return NULL;
+}
+
+/*
+ * Los modificadores toman el mutex de la configuración y luego el de
+ * nvs_manager; erase_all tomaba los mismos en el orden contrario. Con los dos
+ * órdenes a la vez la prueba se quedaba colgada hasta el alarm().
+ */
+static void probar_borrado_concurrente(void)
+{
+    pthread_t hilos[2];
+    s_parar = 0;
+    for (int i = 0; i < 2; i++) {
+        COMPROBAR(pthread_create(&hilos[i], NULL, modificador, NULL) == 0);
+    }
+    for (int i = 0; i < ITERACIONES; i++) {
+        COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    }
+    s_parar = 1;
+    for (int i = 0; i < 2; i++) {
+        pthread_join(hilos[i], NULL);
+    }
+}
+
+static void probar_borrado_restablece(void)
+{
+    COMPROBAR_IGUAL(ecokey_config_set_temporizador(25), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config_set_estado_rele(true), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    COMPROBAR(nvs_host_valor_en_flash(ECOKEY_CONFIG_CLAVE_NVS, NULL) != NULL);
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config()->temporizador_min, ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO);
+    COMPROBAR(!ecokey_config()->estado_rele);
+    COMPROBAR(nvs_host_valor_en_flash(ECOKEY_CONFIG_CLAVE_NVS, NULL) == NULL);
+
+    // Si el borrado falla la RAM no se toca
+    COMPROBAR_IGUAL(ecokey_config_set_temporizador(25), ESP_OK);
+    nvs_host.fallos_pendientes = 1;
+    COMPROBAR(nvs_manager_erase_all() != ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config()->temporizador_min, 25);
+    nvs_host.fallos_pendientes = 0;
+}
+
+static void probar_migracion_legado(void)
+{
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+
+    // Valores que al truncarlos a uint8_t parecerían válidos: 257 -> 1, 258 -> 2
+    COMPROBAR_IGUAL(nvs_manager_set_string("temporizador", "257"), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_set_int("app_estado", 258), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_set_string("modo_operacion", "manual"), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config_cargar(), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config()->temporizador_min, ECOKEY_CONFIG_TEMPORIZADOR_DEFECTO);
+    COMPROBAR_IGUAL(ecokey_config()->app_estado, ECOKEY_CONFIG_APP_ESTADO_NINGUNO);
+    COMPROBAR_IGUAL(ecokey_config()->modo_operacion, ECOKEY_MODO_MANUAL);
+    COMPROBAR(!nvs_manager_key_exists("temporizador"));
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_set_string("temporizador", "15"), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_set_int("app_estado", 2), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config_cargar(), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config()->temporizador_min, 15);
+    COMPROBAR_IGUAL(ecokey_config()->app_estado, 2);
+}
+
+static void avanzar_ms(int64_t ms)
+{
+    esp_timer_host_avanzar(ms * 1000);
+}
+
+static bool rele_en_flash(void)
+{
+    size_t longitud;
+    const ecokey_config_t *cfg = nvs_host_valor_en_flash(ECOKEY_CONFIG_CLAVE_NVS, &longitud);
+    COMPROBAR(cfg != NULL && longitud == sizeof(ecokey_config_t));
+    return cfg->estado_rele;
+}
+
+/*
+ * Limitador por clave con el reloj virtual: una clave que cambia cada segundo
+ * durante una hora llega a flash como mucho una vez por intervalo, y el blob
+ * de configuración (relé, modo) con su intervalo corto.
+ */
+static void probar_limitador(void)
+{
+    int32_t valor;
+    size_t longitud;
+
+    avanzar_ms(1000);
+    uint32_t escrituras_antes = nvs_host.escrituras;
+    for (int32_t i = 1; i <= 3600; i++) {
+        COMPROBAR_IGUAL(nvs_manager_set_int("contador", i), ESP_OK);
+        avanzar_ms(1000);
+    }
+    uint32_t escrituras = nvs_host.escrituras - escrituras_antes;
+    printf("limitador: 3600 cambios en 1 h -> %u escrituras en flash\n", escrituras);
+    COMPROBAR(escrituras <= 3600 / (NVS_MANAGER_INTERVALO_MIN_CLAVE_MS / 1000) + 1);
+    COMPROBAR(escrituras > 0);
+
+    // El último valor llega en cuanto vence el intervalo
+    avanzar_ms(NVS_MANAGER_INTERVALO_MIN_CLAVE_MS);
+    const int32_t *en_flash = nvs_host_valor_en_flash("contador", &longitud);
+    COMPROBAR(en_flash != NULL);
+    memcpy(&valor, en_flash, sizeof(valor));
+    COMPROBAR_IGUAL(valor, 3600);
+
+    // Cambios de relé seguidos: cada uno en flash en pocos segundos, no en un minuto
+    const int64_t plazo_ms = NVS_MANAGER_INTERVALO_MIN_CONFIG_MS + NVS_MANAGER_RETARDO_COMMIT_MS;
+    for (int i = 0; i < 4; i++) {
+        bool encendido = (i % 2) == 0;
+        COMPROBAR_IGUAL(ecokey_config_set_estado_rele(encendido), ESP_OK);
+        avanzar_ms(plazo_ms);
+        COMPROBAR_IGUAL(rele_en_flash(), encendido);
+    }
+    COMPROBAR(plazo_ms < NVS_MANAGER_INTERVALO_MIN_CLAVE_MS);
+}
+
+/*
+ * El volcado lo hace la tarea de nvs_manager al avisarle el temporizador. Si
+ * la escritura o el commit fallan, las claves siguen sucias y el volcado se
+ * reprograma sin esperar a otra escritura.
+ */
+static void probar_reintento_tras_fallo(void)
+{
+    static const char *const claves[] = {"falla_set", "falla_commit"};
+    nvs_manager_estadisticas_t est;
+
+    for (int i = 0; i < 2; i++) {
+        COMPROBAR_IGUAL(nvs_manager_set_string(claves[i], "valor"), ESP_OK);
+        if (i == 0) {
+            nvs_host.fallos_pendientes = 1;
+        } else {
+            nvs_host.fallos_commit_pendientes = 1;
+        }
+
+        avanzar_ms(NVS_MANAGER_RETARDO_COMMIT_MS);
+        COMPROBAR_IGUAL(nvs_host.fallos_pendientes + nvs_host.fallos_commit_pendientes, 0);
+        COMPROBAR(nvs_host_valor_en_flash(claves[i], NULL) == NULL);
+        nvs_manager_obtener_estadisticas(&est);
+        COMPROBAR(est.claves_sucias > 0);
+
+        // Sin ninguna escritura nueva
+        avanzar_ms(NVS_MANAGER_RETARDO_COMMIT_MS);
+        const char *en_flash = nvs_host_valor_en_flash(claves[i], NULL);
+        COMPROBAR(en_flash != NULL && strcmp(en_flash, "valor") == 0);
+        nvs_manager_obtener_estadisticas(&est);
+        COMPROBAR_IGUAL(est.claves_sucias, 0);
+    }
+}
+
+static double ahora_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    nvs_manager_estadisticas_t est;   /**< Diferencia de contadores durante el día */
+    uint32_t commits_flash;           /**< nvs_commit que llegan al doble */
+    uint32_t llamadas_set;
+    uint32_t llamadas_get;
+    double ns_set;
+    double ns_get;
+} dia_t;
+
+/*
+ * Un día del firmware con las claves sueltas de antes de ecokey_config: cada
+ * minuto se leen el estado y la MAC objetivo, y cada 7 minutos hay un cambio
+ * de estado que escribe app_estado, estado_rele y modo_operacion por
+ * separado, con un estado intermedio 2 s antes del final.
+ */
+static dia_t simular_dia(void)
+{
+    dia_t d = {0};
+    nvs_manager_estadisticas_t antes, despues;
+    char mac[18];
+
+    nvs_manager_obtener_estadisticas(&antes);
+    uint32_t commits_antes = nvs_host.commits;
+
+    for (int minuto = 0; minuto < 24 * 60; minuto++) {
+        nvs_manager_get_int("app_estado", 0);
+        nvs_manager_get_string("mac_objetivo", mac, sizeof(mac));
+        d.llamadas_get += 2;
+
+        if (minuto % 7 == 0) {
+            int cambio = minuto / 7;
+            COMPROBAR_IGUAL(nvs_manager_set_int("app_estado", 9), ESP_OK);
+            avanzar_ms(2000);
+
+            COMPROBAR_IGUAL(nvs_manager_set_int("app_estado", 1 + cambio % 3), ESP_OK);
+            COMPROBAR_IGUAL(nvs_manager_set_int("estado_rele", cambio & 1), ESP_OK);
+            COMPROBAR_IGUAL(nvs_manager_set_string("modo_operacion", (cambio / 10) & 1 ? "manual" : "automatico"),
+                            ESP_OK);
+            d.llamadas_set += 4;
+            avanzar_ms(58000);
+        } else {
+            avanzar_ms(60000);
+        }
+    }
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+
+    nvs_manager_obtener_estadisticas(&despues);
+    d.est.escrituras = despues.escrituras - antes.escrituras;
+    d.est.escrituras_evitadas = despues.escrituras_evitadas - antes.escrituras_evitadas;
+    d.est.escrituras_flash = despues.escrituras_flash - antes.escrituras_flash;
+    d.est.commits = despues.commits - antes.commits;
+    d.est.lecturas_ram = despues.lecturas_ram - antes.lecturas_ram;
+    d.est.lecturas_flash = despues.lecturas_flash - antes.lecturas_flash;
+    d.commits_flash = nvs_host.commits - commits_antes;
+
+    // Latencia por llamada en bucle, sin avanzar el reloj virtual (sin volcados)
+    double t0 = ahora_s();
+    for (int i = 0; i < ITERACIONES; i++) {
+        nvs_manager_set_int("estado_rele", i & 1);
+    }
+    double t1 = ahora_s();
+    for (int i = 0; i < ITERACIONES; i++) {
+        nvs_manager_get_int("app_estado", 0);
+    }
+    double t2 = ahora_s();
+    d.ns_set = (t1 - t0) / ITERACIONES * 1e9;
+    d.ns_get = (t2 - t1) / ITERACIONES * 1e9;
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    return d;
+}
+
+static void imprimir_dia(const char *camino, const dia_t *d)
+{
+    printf("día %-9s %4u set, %4u get -> %4u escrituras en flash/día, %4u commits/día, "
+           "%4u lecturas de flash; %5.0f ns por set, %5.0f ns por get (host, flash en RAM)\n",
+           camino, (unsigned)d->est.escrituras, (unsigned)(d->est.lecturas_ram + d->est.lecturas_flash),
+           (unsigned)d->est.escrituras_flash, (unsigned)d->est.commits, (unsigned)d->est.lecturas_flash,
+           d->ns_set, d->ns_get);
+}
+
+/*
+ * Antes y después de la caché con el mismo código: con la caché llena de
+ * otras claves, nvs_manager escribe y lee directamente de flash con un commit
+ * por llamada, que es lo que hacía cada set/get antes de la caché.
+ */
+static void probar_dia_con_y_sin_cache(void)
+{
+    char clave[NVS_KEY_NAME_MAX_SIZE];
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    for (int i = 0; i < NVS_MANAGER_MAX_CLAVES; i++) {
+        snprintf(clave, sizeof(clave), "relleno%02d", i);
+        COMPROBAR_IGUAL(nvs_manager_set_int(clave, i), ESP_OK);
+    }
+    COMPROBAR_IGUAL(nvs_manager_set_string("mac_objetivo", "AA:BB:CC:DD:EE:FF"), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    dia_t sin_cache = simular_dia();
+    imprimir_dia("sin caché", &sin_cache);
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_set_string("mac_objetivo", "AA:BB:CC:DD:EE:FF"), ESP_OK);
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    dia_t con_cache = simular_dia();
+    imprimir_dia("con caché", &con_cache);
+
+    // Sin caché: cada set es una escritura y un commit, cada get una lectura de flash
+    COMPROBAR_IGUAL(sin_cache.est.escrituras_flash, sin_cache.llamadas_set - sin_cache.est.escrituras_evitadas);
+    COMPROBAR_IGUAL(sin_cache.est.lecturas_flash, sin_cache.llamadas_get);
+
+    // Con caché: ninguna lectura de flash, el estado intermedio no llega y un commit por cambio
+    COMPROBAR_IGUAL(con_cache.est.lecturas_flash, 0);
+    COMPROBAR(con_cache.est.escrituras_flash * 3 < sin_cache.est.escrituras_flash * 2);
+    COMPROBAR(con_cache.est.commits * 3 <= sin_cache.est.commits);
+    COMPROBAR_IGUAL(con_cache.commits_flash, con_cache.est.commits);
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+}
+
+/*
+ * mac_objetivo, temporizador y estado_rele se publican con retain: el broker
+ * los reenvía en cada reconexión y mqtt_service llama otra vez al setter con
+ * el mismo valor. Un día con una reconexión por hora, media hora de WiFi
+ * inestable (una por minuto) y unos pocos cambios reales desde la app.
+ */
+typedef struct {
+    int minuto;
+    const char *mac;
+    uint32_t temporizador;
+    bool rele;
+} retenidos_t;
+
+static const retenidos_t s_cambios_reales[] = {
+    {  7 * 60 + 30, "AA:BB:CC:DD:EE:FF", 10, true  },
+    {  9 * 60 + 10, "AA:BB:CC:DD:EE:FF", 20, true  },
+    { 13 * 60 + 45, "AA:BB:CC:DD:EE:FF", 20, false },
+    { 16 * 60 + 20, "11:22:33:44:55:66", 20, false },
+    { 18 * 60 +  5, "11:22:33:44:55:66", 20, true  },
+    { 22 * 60 + 50, "11:22:33:44:55:66", 20, false },
+};
+
+#define NUM_CAMBIOS_REALES  (sizeof(s_cambios_reales) / sizeof(s_cambios_reales[0]))
+
+static bool reconecta(int minuto)
+{
+    bool inestable = minuto >= 17 * 60 && minuto < 17 * 60 + 30;
+    return minuto % 60 == 0 || inestable;
+}
+
+static void entregar_retenidos(const retenidos_t *r)
+{
+    COMPROBAR_IGUAL(ecokey_config_set_mac_objetivo_texto(r->mac), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config_set_temporizador(r->temporizador), ESP_OK);
+    COMPROBAR_IGUAL(ecokey_config_set_estado_rele(r->rele), ESP_OK);
+}
+
+static void probar_retenidos_mqtt(void)
+{
+    retenidos_t retenidos = { 0, "AA:BB:CC:DD:EE:FF", 10, false };
+    nvs_manager_estadisticas_t antes, despues;
+    uint32_t llamadas = 0, reentregas = 0, cambios = 0, reconexiones = 0;
+    size_t siguiente = 0;
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+    entregar_retenidos(&retenidos);
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    nvs_manager_obtener_estadisticas(&antes);
+    uint32_t escrituras_host_antes = nvs_host.escrituras;
+
+    for (int minuto = 0; minuto < 24 * 60; minuto++) {
+        if (siguiente < NUM_CAMBIOS_REALES && s_cambios_reales[siguiente].minuto == minuto) {
+            // El comando llega en vivo y el broker guarda el nuevo retenido
+            const retenidos_t *c = &s_cambios_reales[siguiente++];
+            if (strcmp(c->mac, retenidos.mac) != 0) {
+                COMPROBAR_IGUAL(ecokey_config_set_mac_objetivo_texto(c->mac), ESP_OK);
+            } else if (c->temporizador != retenidos.temporizador) {
+                COMPROBAR_IGUAL(ecokey_config_set_temporizador(c->temporizador), ESP_OK);
+            } else {
+                COMPROBAR_IGUAL(ecokey_config_set_estado_rele(c->rele), ESP_OK);
+            }
+            retenidos = *c;
+            llamadas++;
+            cambios++;
+        }
+        if (reconecta(minuto)) {
+            entregar_retenidos(&retenidos);
+            llamadas += 3;
+            reentregas += 3;
+            reconexiones++;
+        }
+        avanzar_ms(60000);
+    }
+    COMPROBAR_IGUAL(nvs_manager_sync(), ESP_OK);
+    nvs_manager_obtener_estadisticas(&despues);
+
+    uint32_t evitadas = despues.escrituras_evitadas - antes.escrituras_evitadas;
+    uint32_t escrituras_flash = despues.escrituras_flash - antes.escrituras_flash;
+    // Sin comparar, cada reconexión ensuciaría el blob: el limitador de la
+    // configuración junta sus tres set en una escritura, pero no más
+    printf("retenidos MQTT: %u reconexiones, %u set en 1 día (%u reentregas, %u cambios) -> "
+           "%u escrituras evitadas, %u escrituras en flash (%u sin comparar antes de escribir)\n",
+           (unsigned)reconexiones, (unsigned)llamadas, (unsigned)reentregas, (unsigned)cambios,
+           (unsigned)evitadas, (unsigned)escrituras_flash, (unsigned)(reconexiones + cambios));
+
+    // Cada reentrega trae el valor guardado: solo los cambios reales llegan a flash
+    COMPROBAR_IGUAL(despues.escrituras - antes.escrituras, llamadas);
+    COMPROBAR_IGUAL(evitadas, reentregas);
+    COMPROBAR(escrituras_flash > 0 && escrituras_flash <= cambios);
+    COMPROBAR_IGUAL(nvs_host.escrituras - escrituras_host_antes, escrituras_flash);
+    COMPROBAR_IGUAL(rele_en_flash(), false);
+
+    COMPROBAR_IGUAL(nvs_manager_erase_all(), ESP_OK);
+}
+
+int main(void)
+{
+    alarm(60);  // Un interbloqueo cuelga la prueba: mejor fallar que esperar
+    COMPROBAR_IGUAL(nvs_manager_init(NULL), ESP_OK);
+    probar_borrado_concurrente();
+    probar_borrado_restablece();
+    probar_migracion_legado();
+    probar_limitador();
+    probar_reintento_tras_fallo();
+    probar_dia_con_y_sin_cache();
+    probar_retenidos_mqtt();
+    printf("test_nvs_manager: OK\n");
+    return 0;
+}
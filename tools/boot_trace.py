@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Resume las trazas de arranque de Ecokey y detecta regresiones de tiempo.
+
+Cada arranque publica una vez en dispositivos/<mac>/arranque (y escribe en
+el log) un JSON con el instante en µs de cada hito, según
+components/boot_trace/include/boot_trace.h. Con varias trazas se usa la
+mediana de cada hito; con --base se compara contra una referencia guardada
+con --guardar y el código de salida es 1 si algún hito empeora.
+
+Uso:
+    idf.py monitor | tee arranque.log                 # varios reinicios
+    python tools/boot_trace.py arranque.log
+    python tools/boot_trace.py arranque.log --guardar base.json
+    mosquitto_sub -t 'dispositivos/+/arranque' -C 10 | python tools/boot_trace.py --base base.json
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+# Mismo orden que boot_trace_punto_t
+ORDEN = [
+    "app_main",
+    "nvs",
+    "rele",
+    "wifi_iniciado",
+    "mqtt_iniciado",
+    "modo",
+    "primer_escaneo",
+    "primera_decision_rele",
+    "wifi_conectado",
+    "ntp",
+    "mqtt_conectado",
+    "arranque_completo",
+]
+
+
+def leer_trazas(lineas):
+    """Extrae las trazas de líneas de log o de mosquitto_sub."""
+    trazas = []
+    for linea in lineas:
+        inicio = linea.find("{")
+        if inicio < 0:
+            continue
+        try:
+            traza = json.loads(linea[inicio:].strip())
+        except ValueError:
+            continue
+        if isinstance(traza, dict) and isinstance(traza.get("puntos"), dict):
+            trazas.append(traza)
+    return trazas
+
+
+def medianas(trazas):
+    """Mediana en ms de cada hito, en el orden de ORDEN (los desconocidos al final)."""
+    valores = {}
+    for traza in trazas:
+        for punto, us in traza["puntos"].items():
+            valores.setdefault(punto, []).append(us / 1000.0)
+    claves = [p for p in ORDEN if p in valores] + sorted(p for p in valores if p not in ORDEN)
+    return {p: (statistics.median(valores[p]), min(valores[p]), max(valores[p]), len(valores[p]))
+            for p in claves}
+
+
+def imprimir_resumen(resumen, muestras):
+    print("%d arranques" % muestras)
+    print("%-22s %9s %9s %9s %4s" % ("hito", "mediana", "min", "max", "n"))
+    for punto, (mediana, minimo, maximo, n) in resumen.items():
+        print("%-22s %7.1f ms %7.1f %9.1f %4d" % (punto, mediana, minimo, maximo, n))
+
+
+def comparar(resumen, base, tolerancia, margen_ms):
+    """Devuelve True si algún hito de la base falta o empeora más de lo tolerado."""
+    regresion = False
+    print()
+    print("%-22s %9s %9s %9s" % ("hito", "base", "actual", "cambio"))
+    for punto, referencia in base["puntos"].items():
+        if punto not in resumen:
+            print("%-22s %7.1f ms %9s  REGRESIÓN (no alcanzado)" % (punto, referencia, "-"))
+            regresion = True
+            continue
+        actual = resumen[punto][0]
+        cambio = actual - referencia
+        peor = cambio > margen_ms and cambio > referencia * tolerancia / 100.0
+        print("%-22s %7.1f ms %7.1f ms %+8.1f%s" % (punto, referencia, actual, cambio,
+                                                    "  REGRESIÓN" if peor else ""))
+        regresion = regresion or peor
+    return regresion
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("ficheros", nargs="*", help="logs o salidas de mosquitto_sub (stdin si no hay)")
+    parser.add_argument("--guardar", metavar="JSON", help="guarda las medianas como referencia")
+    parser.add_argument("--base", metavar="JSON", help="compara con una referencia guardada")
+    parser.add_argument("--tolerancia", type=float, default=10.0,
+                        help="empeoramiento relativo permitido en %% (10)")
+    parser.add_argument("--margen-ms", type=float, default=50.0,
+                        help="empeoramiento absoluto siempre permitido en ms (50)")
+    args = parser.parse_args(argv[1:])
+
+    trazas = []
+    if args.ficheros:
+        for nombre in args.ficheros:
+            with open(nombre, encoding="utf-8", errors="replace") as f:
+                trazas.extend(leer_trazas(f))
+    else:
+        trazas = leer_trazas(sys.stdin)
+    if not trazas:
+        print("error: no se encontró ninguna traza de arranque", file=sys.stderr)
+        return 2
+
+    resumen = medianas(trazas)
+    imprimir_resumen(resumen, len(trazas))
+
+    if args.guardar:
+        with open(args.guardar, "w", encoding="utf-8") as f:
+            json.dump({"muestras": len(trazas),
+                       "fw": sorted({t.get("fw", "?") for t in trazas}),
+                       "puntos": {p: round(v[0], 1) for p, v in resumen.items()}},
+                      f, indent=2, ensure_ascii=False)
+            f.write("\n")
+
+    if args.base:
+        with open(args.base, encoding="utf-8") as f:
+            base = json.load(f)
+        if comparar(resumen, base, args.tolerancia, args.margen_ms):
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Decodifica la telemetría CBOR de Ecokey (tópicos .../cbor/v1) a JSON.
+
+Los esquemas reproducen components/ble_scanner/include/ble_telemetria.h y
+devuelven los mismos campos que la telemetría JSON.
+
+Uso:
+    python tools/telemetria_cbor.py a9000101...          # payloads en hex
+    mosquitto_sub -t 'dispositivos/+/+/cbor/v1' -F '%x' | python tools/telemetria_cbor.py
+"""
+
+import json
+import struct
+import sys
+
+MODOS_TERMICOS = ["NORMAL", "ECO", "WARNING", "CRITICAL", "EMERGENCY"]
+ESTADOS_CUADRO = ["NORMAL", "TIBIO", "CALIENTE", "SOBRECALENTADO"]
+
+
+def _decima(v):
+    return round(v / 10.0, 1)
+
+
+def _enum(tabla):
+    return lambda v: tabla[v] if 0 <= v < len(tabla) else v
+
+
+# clave -> (campo JSON, conversión)
+ESQUEMAS = {
+    1: ("termico_ausente", {
+        1: ("temp", _decima),
+        2: ("modo_termico", _enum(MODOS_TERMICOS)),
+        3: ("duty_cycle", lambda v: "%.1f%%" % (v / 10.0)),
+        4: ("temp_max", _decima),
+        5: ("detecciones", int),
+        6: ("tiempo_critico", int),
+        7: ("tiempo_emergencia", int),
+        8: ("estado_cuadro", _enum(ESTADOS_CUADRO)),
+        9: ("intervalo_escaneo", int),
+        10: ("reinicios_gap", int),
+        11: ("cambios_suprimidos", int),
+    }, {"trabajo": "INTENSIVO_AUSENTE"}),
+    2: ("deteccion", {
+        1: ("dispositivo", int),
+        2: ("rssi", int),
+        3: ("timestamp", int),
+    }, {"primera_vez": True}),
+}
+
+
+class ErrorCbor(ValueError):
+    pass
+
+
+def _leer(datos, pos):
+    """Decodifica un elemento CBOR desde pos; devuelve (valor, nueva_pos)."""
+    if pos >= len(datos):
+        raise ErrorCbor("fin inesperado de los datos")
+    inicial = datos[pos]
+    pos += 1
+    mayor, info = inicial >> 5, inicial & 0x1F
+
+    if mayor == 7:
+        simples = {20: False, 21: True, 22: None}
+        if info in simples:
+            return simples[info], pos
+        formatos = {25: ">e", 26: ">f", 27: ">d"}
+        if info in formatos:
+            n = struct.calcsize(formatos[info])
+            return struct.unpack_from(formatos[info], datos, pos)[0], pos + n
+        raise ErrorCbor("valor simple no soportado: %d" % info)
+
+    if info < 24:
+        arg = info
+    elif info <= 27:
+        n = 1 << (info - 24)
+        if pos + n > len(datos):
+            raise ErrorCbor("fin inesperado de los datos")
+        arg = int.from_bytes(datos[pos:pos + n], "big")
+        pos += n
+    else:
+        raise ErrorCbor("longitud indefinida no soportada")
+
+    if mayor == 0:
+        return arg, pos
+    if mayor == 1:
+        return -1 - arg, pos
+    if mayor in (2, 3):
+        bruto = bytes(datos[pos:pos + arg])
+        if len(bruto) != arg:
+            raise ErrorCbor("fin inesperado de los datos")
+        return (bruto if mayor == 2 else bruto.decode("utf-8")), pos + arg
+    if mayor == 4:
+        lista = []
+        for _ in range(arg):
+            v, pos = _leer(datos, pos)
+            lista.append(v)
+        return lista, pos
+    if mayor == 5:
+        mapa = {}
+        for _ in range(arg):
+            k, pos = _leer(datos, pos)
+            v, pos = _leer(datos, pos)
+            mapa[k] = v
+        return mapa, pos
+    raise ErrorCbor("tipo mayor no soportado: %d" % mayor)
+
+
+def decodificar(datos):
+    """Devuelve el mensaje como dict con los nombres de campo del JSON."""
+    valor, pos = _leer(datos, 0)
+    if pos != len(datos):
+        raise ErrorCbor("%d bytes sobrantes" % (len(datos) - pos))
+    if not isinstance(valor, dict) or 0 not in valor:
+        raise ErrorCbor("no es un mapa con id de esquema")
+
+    esquema = ESQUEMAS.get(valor[0])
+    if esquema is None:
+        raise ErrorCbor("esquema desconocido: %r" % valor[0])
+    nombre, campos, fijos = esquema
+
+    salida = {"esquema": nombre}
+    for clave, v in valor.items():
+        if clave == 0:
+            continue
+        if clave in campos:
+            campo, conversion = campos[clave]
+            salida[campo] = conversion(v)
+        else:
+            # Campo añadido en una versión posterior: se conserva sin nombre
+            salida["clave_%s" % clave] = v
+    salida.update(fijos)
+    return salida
+
+
+def main(argv):
+    entradas = argv[1:] or (linea.strip() for linea in sys.stdin)
+    estado = 0
+    for texto in entradas:
+        if not texto:
+            continue
+        try:
+            datos = bytes.fromhex(texto)
+            print(json.dumps(decodificar(datos), ensure_ascii=False))
+        except (ValueError, ErrorCbor) as e:
+            print("error: %s (%s)" % (e, texto), file=sys.stderr)
+            estado = 1
+    return estado
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))